@@ -0,0 +1,746 @@
+/*
+ * This program implements exact integers of any size. A bignum keeps
+ * the magnitude of the integer as 32-bit digits, least significant
+ * first, and its sign separately.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "bignum.h"
+#include "talloc.h"
+
+/* Below this many digits, schoolbook multiplication is faster. */
+#define KARATSUBA_THRESHOLD 32
+
+/* A run of digits, least significant first. */
+typedef struct {
+    uint32_t *digits;
+    int size;
+} Magnitude;
+
+/*
+ * Helper function to allocate a value of the given type.
+ */
+Value *makeNumber(valueType type) {
+    Value *value = talloc(sizeof(Value));
+    if (!value) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    value->type = type;
+    return value;
+}
+
+/*
+ * Helper function to allocate zeroed digits.
+ */
+uint32_t *makeDigits(int size) {
+    uint32_t *digits = talloc(sizeof(uint32_t) * (size > 0 ? size : 1));
+    if (!digits) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    memset(digits, 0, sizeof(uint32_t) * (size > 0 ? size : 1));
+    return digits;
+}
+
+/*
+ * Helper function to drop the leading zero digits of a magnitude.
+ */
+Magnitude trim(Magnitude m) {
+    while (m.size > 0 && m.digits[m.size - 1] == 0) {
+        m.size--;
+    }
+    return m;
+}
+
+/*
+ * Helper function to build an exact integer from a sign and a
+ * magnitude, as a fixnum if it fits.
+ */
+Value *makeExact(bool negative, Magnitude m) {
+    m = trim(m);
+    if (m.size <= 2) {
+        uint64_t n = m.size == 0 ? 0 : m.digits[0];
+        if (m.size == 2) {
+            n |= (uint64_t) m.digits[1] << 32;
+        }
+        if (n <= INT64_MAX || (negative && n == (uint64_t) INT64_MAX + 1)) {
+            Value *value = makeNumber(INT_TYPE);
+            value->i = negative ? (int64_t) (0 - n) : (int64_t) n;
+            return value;
+        }
+    }
+    Value *value = makeNumber(BIGNUM_TYPE);
+    value->big.digits = m.digits;
+    value->big.size = m.size;
+    value->big.negative = negative;
+    return value;
+}
+
+/*
+ * Helper function to get the magnitude of an exact integer. A fixnum's
+ * digits are written into `buffer'.
+ */
+Magnitude magnitudeOf(Value *value, uint32_t buffer[2]) {
+    Magnitude m;
+    if (value->type == BIGNUM_TYPE) {
+        m.digits = value->big.digits;
+        m.size = value->big.size;
+        return m;
+    }
+    uint64_t n = value->i < 0 ? 0 - (uint64_t) value->i : (uint64_t) value->i;
+    buffer[0] = (uint32_t) n;
+    buffer[1] = (uint32_t) (n >> 32);
+    m.digits = buffer;
+    m.size = 2;
+    return trim(m);
+}
+
+/*
+ * Helper function to test whether an exact integer is negative.
+ */
+bool isNegative(Value *value) {
+    return value->type == BIGNUM_TYPE ? value->big.negative : value->i < 0;
+}
+
+/*
+ * Helper function to compare two magnitudes.
+ */
+int compareMagnitude(Magnitude a, Magnitude b) {
+    if (a.size != b.size) {
+        return a.size < b.size ? -1 : 1;
+    }
+    for (int i = a.size - 1; i >= 0; i--) {
+        if (a.digits[i] != b.digits[i]) {
+            return a.digits[i] < b.digits[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Helper function to add two magnitudes.
+ */
+Magnitude addMagnitude(Magnitude a, Magnitude b) {
+    if (a.size < b.size) {
+        Magnitude t = a;
+        a = b;
+        b = t;
+    }
+    Magnitude sum = {makeDigits(a.size + 1), a.size + 1};
+    uint64_t carry = 0;
+    for (int i = 0; i < a.size; i++) {
+        carry += (uint64_t) a.digits[i] + (i < b.size ? b.digits[i] : 0);
+        sum.digits[i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    sum.digits[a.size] = (uint32_t) carry;
+    return trim(sum);
+}
+
+/*
+ * Helper function to subtract a magnitude from a larger one in place.
+ */
+void subtractInPlace(Magnitude a, Magnitude b) {
+    int64_t borrow = 0;
+    for (int i = 0; i < a.size; i++) {
+        int64_t difference = (int64_t) a.digits[i] - borrow -
+                             (i < b.size ? b.digits[i] : 0);
+        borrow = difference < 0;
+        a.digits[i] = (uint32_t) (difference + (borrow << 32));
+    }
+}
+
+/*
+ * Helper function to subtract a magnitude from a larger one.
+ */
+Magnitude subtractMagnitude(Magnitude a, Magnitude b) {
+    Magnitude difference = {makeDigits(a.size), a.size};
+    memcpy(difference.digits, a.digits, sizeof(uint32_t) * a.size);
+    subtractInPlace(difference, b);
+    return trim(difference);
+}
+
+/*
+ * Helper function to add a magnitude into a longer run of digits,
+ * starting at the given digit.
+ */
+void addInto(uint32_t *digits, int size, Magnitude m, int offset) {
+    uint64_t carry = 0;
+    int i = 0;
+    for (; i < m.size; i++) {
+        carry += (uint64_t) digits[offset + i] + m.digits[i];
+        digits[offset + i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+    for (; carry != 0 && offset + i < size; i++) {
+        carry += digits[offset + i];
+        digits[offset + i] = (uint32_t) carry;
+        carry >>= 32;
+    }
+}
+
+Magnitude multiplyMagnitude(Magnitude a, Magnitude b);
+
+/*
+ * Helper function to multiply two magnitudes into `product', which
+ * must hold a.size + b.size zeroed digits. Large balanced operands are
+ * split in halves and multiplied with three recursive products instead
+ * of four (Karatsuba).
+ */
+void multiplyInto(Magnitude a, Magnitude b, uint32_t *product) {
+    if (a.size < b.size) {
+        Magnitude t = a;
+        a = b;
+        b = t;
+    }
+    int size = a.size + b.size;
+    if (b.size < KARATSUBA_THRESHOLD) {
+        for (int i = 0; i < b.size; i++) {
+            uint64_t carry = 0;
+            for (int j = 0; j < a.size; j++) {
+                carry += (uint64_t) a.digits[j] * b.digits[i] + product[i + j];
+                product[i + j] = (uint32_t) carry;
+                carry >>= 32;
+            }
+            product[i + a.size] = (uint32_t) carry;
+        }
+        return;
+    }
+    int half = a.size / 2;
+    Magnitude a0 = trim((Magnitude) {a.digits, half});
+    Magnitude a1 = {a.digits + half, a.size - half};
+    if (b.size <= half) {
+        // Too unbalanced to split b; multiply each half of a by b
+        addInto(product, size, multiplyMagnitude(a0, b), 0);
+        addInto(product, size, multiplyMagnitude(a1, b), half);
+        return;
+    }
+    Magnitude b0 = trim((Magnitude) {b.digits, half});
+    Magnitude b1 = {b.digits + half, b.size - half};
+    Magnitude low = multiplyMagnitude(a0, b0);
+    Magnitude high = multiplyMagnitude(a1, b1);
+    Magnitude middle = multiplyMagnitude(addMagnitude(a0, a1),
+                                         addMagnitude(b0, b1));
+    subtractInPlace(middle, low);
+    subtractInPlace(middle, high);
+    addInto(product, size, low, 0);
+    addInto(product, size, trim(middle), half);
+    addInto(product, size, high, 2 * half);
+}
+
+/*
+ * Helper function to multiply two magnitudes.
+ */
+Magnitude multiplyMagnitude(Magnitude a, Magnitude b) {
+    Magnitude product = {makeDigits(a.size + b.size), a.size + b.size};
+    if (a.size > 0 && b.size > 0) {
+        multiplyInto(a, b, product.digits);
+    }
+    return trim(product);
+}
+
+/*
+ * Helper function to divide a magnitude by a single digit.
+ *
+ * Returns the remainder.
+ */
+uint32_t divideBySmall(Magnitude a, uint32_t divisor, Magnitude *quotient) {
+    Magnitude q = {makeDigits(a.size), a.size};
+    uint64_t remainder = 0;
+    for (int i = a.size - 1; i >= 0; i--) {
+        remainder = (remainder << 32) | a.digits[i];
+        q.digits[i] = (uint32_t) (remainder / divisor);
+        remainder %= divisor;
+    }
+    if (quotient) {
+        *quotient = trim(q);
+    }
+    return (uint32_t) remainder;
+}
+
+/*
+ * Helper function to divide two magnitudes with Knuth's long division
+ * (The Art of Computer Programming, vol. 2, 4.3.1, algorithm D).
+ */
+void divideMagnitude(Magnitude a, Magnitude b, Magnitude *quotient,
+                     Magnitude *remainder) {
+    if (compareMagnitude(a, b) < 0) {
+        *quotient = (Magnitude) {makeDigits(0), 0};
+        *remainder = a;
+        return;
+    }
+    if (b.size == 1) {
+        uint32_t small = divideBySmall(a, b.digits[0], quotient);
+        *remainder = (Magnitude) {makeDigits(1), 1};
+        remainder->digits[0] = small;
+        *remainder = trim(*remainder);
+        return;
+    }
+    int m = a.size;
+    int n = b.size;
+    // Shift both so that the divisor's top digit has its high bit set
+    int shift = __builtin_clz(b.digits[n - 1]);
+    uint32_t *v = makeDigits(n);
+    uint32_t *u = makeDigits(m + 1);
+    for (int i = n - 1; i >= 0; i--) {
+        uint64_t wide = (uint64_t) b.digits[i] << shift;
+        v[i] = (uint32_t) wide | (i > 0 ? (uint32_t) (((uint64_t) b.digits[i - 1] << shift) >> 32) : 0);
+    }
+    u[m] = (uint32_t) (((uint64_t) a.digits[m - 1] << shift) >> 32);
+    for (int i = m - 1; i >= 0; i--) {
+        uint64_t wide = (uint64_t) a.digits[i] << shift;
+        u[i] = (uint32_t) wide | (i > 0 ? (uint32_t) (((uint64_t) a.digits[i - 1] << shift) >> 32) : 0);
+    }
+    Magnitude q = {makeDigits(m - n + 1), m - n + 1};
+    for (int j = m - n; j >= 0; j--) {
+        // Estimate the quotient digit from the top two digits
+        uint64_t top = ((uint64_t) u[j + n] << 32) | u[j + n - 1];
+        uint64_t qhat = top / v[n - 1];
+        uint64_t rhat = top % v[n - 1];
+        while (qhat > UINT32_MAX ||
+               qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+            qhat--;
+            rhat += v[n - 1];
+            if (rhat > UINT32_MAX) {
+                break;
+            }
+        }
+        // Multiply and subtract
+        int64_t borrow = 0;
+        int64_t t;
+        for (int i = 0; i < n; i++) {
+            uint64_t p = qhat * v[i];
+            t = (int64_t) u[i + j] - borrow - (int64_t) (p & UINT32_MAX);
+            u[i + j] = (uint32_t) t;
+            borrow = (int64_t) (p >> 32) - (t >> 32);
+        }
+        t = (int64_t) u[j + n] - borrow;
+        u[j + n] = (uint32_t) t;
+        q.digits[j] = (uint32_t) qhat;
+        if (t < 0) {
+            // The estimate was one too large; add the divisor back
+            q.digits[j]--;
+            uint64_t carry = 0;
+            for (int i = 0; i < n; i++) {
+                carry += (uint64_t) u[i + j] + v[i];
+                u[i + j] = (uint32_t) carry;
+                carry >>= 32;
+            }
+            u[j + n] += (uint32_t) carry;
+        }
+    }
+    Magnitude r = {makeDigits(n), n};
+    for (int i = 0; i < n; i++) {
+        r.digits[i] = (uint32_t) ((((uint64_t) u[i + 1] << 32) | u[i]) >> shift);
+    }
+    *quotient = trim(q);
+    *remainder = trim(r);
+}
+
+/*
+ * Test whether a value is an exact integer (a fixnum or a bignum).
+ */
+bool isExactInteger(Value *value) {
+    return value->type == INT_TYPE || value->type == BIGNUM_TYPE;
+}
+
+/*
+ * Read an exact integer written in decimal, with an optional sign.
+ */
+Value *parseExactInteger(char *digits) {
+    bool negative = digits[0] == '-';
+    if (digits[0] == '-' || digits[0] == '+') {
+        digits++;
+    }
+    int length = strlen(digits);
+    Magnitude m = {makeDigits(length / 9 + 2), 0};
+    for (int start = 0; start < length; start += 9) {
+        // Fold in up to nine digits at a time
+        uint32_t chunk = 0;
+        uint32_t scale = 1;
+        for (int i = start; i < length && i < start + 9; i++) {
+            chunk = chunk * 10 + (digits[i] - '0');
+            scale *= 10;
+        }
+        uint64_t carry = chunk;
+        for (int i = 0; i < m.size; i++) {
+            carry += (uint64_t) m.digits[i] * scale;
+            m.digits[i] = (uint32_t) carry;
+            carry >>= 32;
+        }
+        if (carry != 0) {
+            m.digits[m.size++] = (uint32_t) carry;
+        }
+    }
+    return makeExact(negative, m);
+}
+
+/*
+ * Convert an integral double into an exact integer.
+ */
+Value *exactFromDouble(double d) {
+    if (d >= -9223372036854775808.0 && d < 9223372036854775808.0) {
+        Value *value = makeNumber(INT_TYPE);
+        value->i = (int64_t) d;
+        return value;
+    }
+    // |d| >= 2^63, so it is its 53-bit mantissa shifted left
+    int exponent;
+    double fraction = frexp(fabs(d), &exponent);
+    uint64_t mantissa = (uint64_t) ldexp(fraction, 53);
+    int shift = exponent - 53;
+    Magnitude m = {makeDigits(shift / 32 + 3), shift / 32 + 3};
+    int offset = shift / 32;
+    unsigned __int128 wide = (unsigned __int128) mantissa << (shift % 32);
+    m.digits[offset] = (uint32_t) wide;
+    m.digits[offset + 1] = (uint32_t) (wide >> 32);
+    m.digits[offset + 2] = (uint32_t) (wide >> 64);
+    return makeExact(d < 0, m);
+}
+
+/*
+ * Convert an exact integer into the nearest double.
+ */
+double exactToDouble(Value *value) {
+    if (value->type == INT_TYPE) {
+        return (double) value->i;
+    }
+    double result = 0;
+    for (int i = value->big.size - 1; i >= 0; i--) {
+        result = result * 4294967296.0 + value->big.digits[i];
+    }
+    return value->big.negative ? -result : result;
+}
+
+/*
+ * Helper function to add two exact integers, negating the second one
+ * first if asked to.
+ */
+Value *addSigned(Value *first, Value *second, bool negateSecond) {
+    uint32_t firstBuffer[2];
+    uint32_t secondBuffer[2];
+    Magnitude a = magnitudeOf(first, firstBuffer);
+    Magnitude b = magnitudeOf(second, secondBuffer);
+    bool aNegative = isNegative(first);
+    bool bNegative = isNegative(second) != negateSecond && b.size > 0;
+    if (aNegative == bNegative) {
+        return makeExact(aNegative, addMagnitude(a, b));
+    }
+    if (compareMagnitude(a, b) >= 0) {
+        return makeExact(aNegative, subtractMagnitude(a, b));
+    }
+    return makeExact(bNegative, subtractMagnitude(b, a));
+}
+
+/*
+ * Arithmetic on exact integers.
+ */
+Value *addExact(Value *first, Value *second) {
+    int64_t result;
+    if (first->type == INT_TYPE && second->type == INT_TYPE &&
+        !__builtin_add_overflow(first->i, second->i, &result)) {
+        Value *value = makeNumber(INT_TYPE);
+        value->i = result;
+        return value;
+    }
+    return addSigned(first, second, false);
+}
+
+Value *subtractExact(Value *first, Value *second) {
+    int64_t result;
+    if (first->type == INT_TYPE && second->type == INT_TYPE &&
+        !__builtin_sub_overflow(first->i, second->i, &result)) {
+        Value *value = makeNumber(INT_TYPE);
+        value->i = result;
+        return value;
+    }
+    return addSigned(first, second, true);
+}
+
+Value *multiplyExact(Value *first, Value *second) {
+    int64_t result;
+    if (first->type == INT_TYPE && second->type == INT_TYPE &&
+        !__builtin_mul_overflow(first->i, second->i, &result)) {
+        Value *value = makeNumber(INT_TYPE);
+        value->i = result;
+        return value;
+    }
+    uint32_t firstBuffer[2];
+    uint32_t secondBuffer[2];
+    Magnitude product = multiplyMagnitude(magnitudeOf(first, firstBuffer),
+                                          magnitudeOf(second, secondBuffer));
+    return makeExact(isNegative(first) != isNegative(second), product);
+}
+
+Value *negateExact(Value *value) {
+    Value *zero = makeNumber(INT_TYPE);
+    zero->i = 0;
+    return subtractExact(zero, value);
+}
+
+/*
+ * Divide two exact integers, rounding the quotient toward zero. The
+ * divisor must not be zero. Either result pointer may be NULL.
+ */
+void divideExact(Value *dividend, Value *divisor, Value **quotient,
+                 Value **remainder) {
+    if (dividend->type == INT_TYPE && divisor->type == INT_TYPE &&
+        !(dividend->i == INT64_MIN && divisor->i == -1)) {
+        if (quotient) {
+            *quotient = makeNumber(INT_TYPE);
+            (*quotient)->i = dividend->i / divisor->i;
+        }
+        if (remainder) {
+            *remainder = makeNumber(INT_TYPE);
+            (*remainder)->i = dividend->i % divisor->i;
+        }
+        return;
+    }
+    uint32_t firstBuffer[2];
+    uint32_t secondBuffer[2];
+    Magnitude q;
+    Magnitude r;
+    divideMagnitude(magnitudeOf(dividend, firstBuffer),
+                    magnitudeOf(divisor, secondBuffer), &q, &r);
+    // The remainder may still point into the dividend's buffer
+    Magnitude copy = {makeDigits(r.size), r.size};
+    memcpy(copy.digits, r.digits, sizeof(uint32_t) * r.size);
+    if (quotient) {
+        *quotient = makeExact(isNegative(dividend) != isNegative(divisor), q);
+    }
+    if (remainder) {
+        *remainder = makeExact(isNegative(dividend), copy);
+    }
+}
+
+/*
+ * Compare two exact integers.
+ */
+int compareExact(Value *first, Value *second) {
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        return (first->i > second->i) - (first->i < second->i);
+    }
+    bool aNegative = isNegative(first);
+    bool bNegative = isNegative(second);
+    if (aNegative != bNegative) {
+        return aNegative ? -1 : 1;
+    }
+    uint32_t firstBuffer[2];
+    uint32_t secondBuffer[2];
+    int result = compareMagnitude(magnitudeOf(first, firstBuffer),
+                                  magnitudeOf(second, secondBuffer));
+    return aNegative ? -result : result;
+}
+
+/*
+ * Returns -1, 0, or 1 for a negative, zero, or positive exact integer.
+ */
+int signOfExact(Value *value) {
+    if (value->type == BIGNUM_TYPE) {
+        return value->big.negative ? -1 : 1;
+    }
+    return (value->i > 0) - (value->i < 0);
+}
+
+/*
+ * Test whether an exact integer is odd.
+ */
+bool isOddExact(Value *value) {
+    if (value->type == BIGNUM_TYPE) {
+        return value->big.digits[0] & 1;
+    }
+    return value->i & 1;
+}
+
+/*
+ * Helper function to write an exact integer into `size' digits in two's
+ * complement. The digits must have room for the sign bit.
+ */
+void toTwosComplement(Value *value, uint32_t *digits, int size) {
+    uint32_t buffer[2];
+    Magnitude m = magnitudeOf(value, buffer);
+    memset(digits, 0, sizeof(uint32_t) * size);
+    memcpy(digits, m.digits, sizeof(uint32_t) * m.size);
+    if (isNegative(value)) {
+        uint64_t carry = 1;
+        for (int i = 0; i < size; i++) {
+            uint64_t sum = (uint64_t) (uint32_t) ~digits[i] + carry;
+            digits[i] = (uint32_t) sum;
+            carry = sum >> 32;
+        }
+    }
+}
+
+/*
+ * Helper function to read back `size' digits of two's complement,
+ * reusing the digits as the magnitude.
+ */
+Value *fromTwosComplement(uint32_t *digits, int size) {
+    bool negative = digits[size - 1] >> 31;
+    if (negative) {
+        uint64_t carry = 1;
+        for (int i = 0; i < size; i++) {
+            uint64_t sum = (uint64_t) (uint32_t) ~digits[i] + carry;
+            digits[i] = (uint32_t) sum;
+            carry = sum >> 32;
+        }
+    }
+    Magnitude m = {digits, size};
+    return makeExact(negative, m);
+}
+
+/*
+ * Combine two exact integers bit by bit, as if written in two's
+ * complement with infinitely many sign bits.
+ */
+Value *bitwiseExact(enum BitOperation operation, Value *first, Value *second) {
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        Value *value = makeNumber(INT_TYPE);
+        switch (operation) {
+            case BIT_AND:
+                value->i = first->i & second->i;
+                break;
+            case BIT_IOR:
+                value->i = first->i | second->i;
+                break;
+            default:
+                value->i = first->i ^ second->i;
+                break;
+        }
+        return value;
+    }
+    uint32_t firstBuffer[2], secondBuffer[2];
+    int firstSize = magnitudeOf(first, firstBuffer).size;
+    int secondSize = magnitudeOf(second, secondBuffer).size;
+    // One more digit than the larger magnitude always holds the sign bit
+    int size = (firstSize > secondSize ? firstSize : secondSize) + 1;
+    uint32_t *a = makeDigits(size);
+    uint32_t *b = makeDigits(size);
+    toTwosComplement(first, a, size);
+    toTwosComplement(second, b, size);
+    for (int i = 0; i < size; i++) {
+        switch (operation) {
+            case BIT_AND:
+                a[i] &= b[i];
+                break;
+            case BIT_IOR:
+                a[i] |= b[i];
+                break;
+            default:
+                a[i] ^= b[i];
+                break;
+        }
+    }
+    return fromTwosComplement(a, size);
+}
+
+/*
+ * Multiply an exact integer by 2 to the power `shift', rounding toward
+ * negative infinity when `shift' is negative.
+ */
+Value *shiftExact(Value *value, int64_t shift) {
+    if (value->type == INT_TYPE && (shift <= 0 || (shift < 63 &&
+        value->i >= -(INT64_C(1) << (62 - shift)) &&
+        value->i < (INT64_C(1) << (62 - shift))))) {
+        Value *result = makeNumber(INT_TYPE);
+        if (shift <= 0) {
+            result->i = shift <= -64 ? (value->i < 0 ? -1 : 0) : value->i >> -shift;
+        } else {
+            result->i = (int64_t) ((uint64_t) value->i << shift);
+        }
+        return result;
+    }
+    uint32_t buffer[2];
+    Magnitude m = magnitudeOf(value, buffer);
+    bool negative = isNegative(value);
+    if (shift > 0) {
+        int64_t words = shift / 32;
+        int bits = shift % 32;
+        if (m.size + words + 1 > INT32_MAX) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        Magnitude result = {makeDigits(m.size + words + 1), m.size + words + 1};
+        for (int i = 0; i < m.size; i++) {
+            uint64_t d = (uint64_t) m.digits[i] << bits;
+            result.digits[i + words] |= (uint32_t) d;
+            result.digits[i + words + 1] = (uint32_t) (d >> 32);
+        }
+        return makeExact(negative, result);
+    }
+    int64_t words = -shift / 32;
+    int bits = -shift % 32;
+    if (words >= m.size) {
+        Value *result = makeNumber(INT_TYPE);
+        result->i = negative ? -1 : 0;
+        return result;
+    }
+    // A negative number rounds down if any bit shifted out is set
+    bool inexact = bits != 0 && (m.digits[words] & ((UINT32_C(1) << bits) - 1));
+    for (int i = 0; i < words && !inexact; i++) {
+        inexact = m.digits[i] != 0;
+    }
+    Magnitude result = {makeDigits(m.size - words), m.size - words};
+    for (int i = 0; i < result.size; i++) {
+        uint64_t d = m.digits[i + words];
+        if (i + words + 1 < m.size) {
+            d |= (uint64_t) m.digits[i + words + 1] << 32;
+        }
+        result.digits[i] = (uint32_t) (d >> bits);
+    }
+    if (negative && inexact) {
+        uint32_t one = 1;
+        Magnitude unit = {&one, 1};
+        result = addMagnitude(trim(result), unit);
+    }
+    return makeExact(negative, result);
+}
+
+/*
+ * Write an exact integer in decimal into a new string.
+ */
+char *exactToString(Value *value) {
+    if (value->type == INT_TYPE) {
+        char *text = talloc(24);
+        if (!text) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        snprintf(text, 24, "%lld", (long long) value->i);
+        return text;
+    }
+    // Peel off nine decimal digits at a time, lowest first
+    Magnitude m = {value->big.digits, value->big.size};
+    int count = 0;
+    uint32_t *chunks = makeDigits(m.size * 10 / 9 + 2);
+    while (m.size > 0) {
+        chunks[count++] = divideBySmall(m, 1000000000, &m);
+    }
+    char *text = talloc(count * 9 + 2);
+    if (!text) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    char *cur = text;
+    if (value->big.negative) {
+        *cur++ = '-';
+    }
+    cur += sprintf(cur, "%u", chunks[count - 1]);
+    for (int i = count - 2; i >= 0; i--) {
+        cur += sprintf(cur, "%09u", chunks[i]);
+    }
+    return text;
+}
+
+/*
+ * Hash a bignum so that equal bignums hash the same.
+ */
+unsigned long hashBignum(Value *value) {
+    unsigned long hash = value->big.negative ? 0x9e3779b97f4a7c15UL : 0;
+    for (int i = 0; i < value->big.size; i++) {
+        hash = (hash ^ value->big.digits[i]) * 0x100000001b3UL;
+    }
+    return hash;
+}
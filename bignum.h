@@ -0,0 +1,96 @@
+/*
+ * This program implements exact integers of any size. An exact integer
+ * is an INT_TYPE fixnum when it fits in 64 bits and a BIGNUM_TYPE
+ * otherwise; every function here returns the fixnum form whenever it
+ * fits, so an integer has only one representation.
+ */
+#include <stdint.h>
+#include "value.h"
+
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+/*
+ * Test whether a value is an exact integer (a fixnum or a bignum).
+ */
+bool isExactInteger(Value *value);
+
+/*
+ * Read an exact integer written in decimal, with an optional sign.
+ */
+Value *parseExactInteger(char *digits);
+
+/*
+ * Convert an integral double into an exact integer.
+ */
+Value *exactFromDouble(double d);
+
+/*
+ * Convert an exact integer into the nearest double.
+ */
+double exactToDouble(Value *value);
+
+/*
+ * Arithmetic on exact integers.
+ */
+Value *addExact(Value *first, Value *second);
+Value *subtractExact(Value *first, Value *second);
+Value *multiplyExact(Value *first, Value *second);
+Value *negateExact(Value *value);
+
+/*
+ * Divide two exact integers, rounding the quotient toward zero, so
+ * that the remainder has the sign of the dividend. The divisor must
+ * not be zero. Either result pointer may be NULL.
+ */
+void divideExact(Value *dividend, Value *divisor, Value **quotient,
+                 Value **remainder);
+
+/*
+ * Compare two exact integers.
+ *
+ * Returns a negative number, zero, or a positive number when the
+ * first is smaller, equal, or larger.
+ */
+int compareExact(Value *first, Value *second);
+
+/*
+ * Returns -1, 0, or 1 for a negative, zero, or positive exact integer.
+ */
+int signOfExact(Value *value);
+
+/*
+ * Test whether an exact integer is odd.
+ */
+bool isOddExact(Value *value);
+
+/* The ways to combine two exact integers bit by bit. */
+enum BitOperation {
+    BIT_AND,
+    BIT_IOR,
+    BIT_XOR
+};
+
+/*
+ * Combine two exact integers bit by bit, as if written in two's
+ * complement with infinitely many sign bits.
+ */
+Value *bitwiseExact(enum BitOperation operation, Value *first, Value *second);
+
+/*
+ * Multiply an exact integer by 2 to the power `shift', rounding toward
+ * negative infinity when `shift' is negative.
+ */
+Value *shiftExact(Value *value, int64_t shift);
+
+/*
+ * Write an exact integer in decimal into a new string.
+ */
+char *exactToString(Value *value);
+
+/*
+ * Hash a bignum so that equal bignums hash the same.
+ */
+unsigned long hashBignum(Value *value);
+
+#endif
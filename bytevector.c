@@ -0,0 +1,459 @@
+/*
+ * This program implements bytevectors. A bytevector is a u8vector:
+ * its bytes are stored one after another in `data', which may point
+ * into another bytevector, for a slice, or into a file mapped into
+ * memory, for file->bytevector. A mapped file is read-only, and so are
+ * the slices taken from it.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bytevector.h"
+#include "numvector.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "bignum.h"
+#include "text.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/*
+ * Helper function to check that an argument is a bytevector.
+ */
+Value *bytevectorArgument(char *name, Value *value) {
+    if (value->type != NUMVECTOR_TYPE || value->numvec.kind != U8_VECTOR) {
+        primitiveError(name, "expects a bytevector as input");
+    }
+    return value;
+}
+
+/*
+ * Helper function to check that a bytevector argument may be changed.
+ */
+Value *writableArgument(char *name, Value *value) {
+    bytevectorArgument(name, value);
+    if (value->numvec.readOnly) {
+        primitiveError(name, "cannot change a read-only bytevector");
+    }
+    return value;
+}
+
+/*
+ * Helper function to read the optional index argument at the given
+ * position in the arguments, which must lie between `low' and `high'.
+ */
+int64_t bytevectorIndexArgument(char *name, Value *args, int position,
+                                int64_t fallback, int64_t low, int64_t high) {
+    for (int i = 0; i < position && args->type == CONS_TYPE; i++) {
+        args = cdr(args);
+    }
+    if (args->type != CONS_TYPE) {
+        return fallback;
+    }
+    Value *index = car(args);
+    if (index->type != INT_TYPE) {
+        primitiveError(name, "expects an exact integer index");
+    } else if (index->i < low || index->i > high) {
+        primitiveError(name, "index is out of range");
+    }
+    return index->i;
+}
+
+/*
+ * Helper function to check a byte to store in a bytevector.
+ */
+uint8_t byteArgument(char *name, Value *value) {
+    if (value->type != INT_TYPE || value->i < 0 || value->i > 255) {
+        primitiveError(name, "expects exact integers from 0 to 255 as bytes");
+    }
+    return (uint8_t) value->i;
+}
+
+/*
+ * Helper function to make a bytevector of the given bytes.
+ */
+Value *bytevectorOf(uint8_t *bytes, int64_t count) {
+    Value *bytevector = makeNumVector(U8_VECTOR, count);
+    memcpy(bytevector->numvec.data, bytes, count);
+    return bytevector;
+}
+
+/*
+ * Read a byte, store a byte, and measure a bytevector, for the
+ * interpreter and for compiled programs to call directly.
+ */
+Value *bytevectorU8Ref(Value *bytevector, Value *index) {
+    bytevectorArgument("bytevector-u8-ref", bytevector);
+    if (index->type != INT_TYPE || index->i < 0 ||
+        index->i >= bytevector->numvec.length) {
+        primitiveError("bytevector-u8-ref", "index is out of range");
+    }
+    return makeInteger(((uint8_t *) bytevector->numvec.data)[index->i]);
+}
+
+Value *bytevectorU8Set(Value *bytevector, Value *index, Value *byte) {
+    writableArgument("bytevector-u8-set!", bytevector);
+    if (index->type != INT_TYPE || index->i < 0 ||
+        index->i >= bytevector->numvec.length) {
+        primitiveError("bytevector-u8-set!", "index is out of range");
+    }
+    uint8_t b = byteArgument("bytevector-u8-set!", byte);
+    ((uint8_t *) bytevector->numvec.data)[index->i] = b;
+    return makeVoid();
+}
+
+Value *bytevectorLengthValue(Value *bytevector) {
+    bytevectorArgument("bytevector-length", bytevector);
+    return makeInteger(bytevector->numvec.length);
+}
+
+/*
+ * Implementing the Scheme primitive bytevector?.
+ */
+Value *primitiveIsBytevector(Value *args) {
+    checkArity(args, 1, 1);
+    Value *value = car(args);
+    return makeBoolean(value->type == NUMVECTOR_TYPE &&
+                       value->numvec.kind == U8_VECTOR);
+}
+
+/*
+ * Implementing the Scheme primitive make-bytevector, which fills the
+ * bytevector with zeros unless given a byte.
+ */
+Value *primitiveMakeBytevector(Value *args) {
+    checkArity(args, 1, 2);
+    Value *size = car(args);
+    if (size->type != INT_TYPE || size->i < 0) {
+        primitiveError("make-bytevector", "expects a non-negative length");
+    }
+    Value *bytevector = makeNumVector(U8_VECTOR, size->i);
+    if (cdr(args)->type == CONS_TYPE) {
+        memset(bytevector->numvec.data,
+               byteArgument("make-bytevector", car(cdr(args))), size->i);
+    }
+    return bytevector;
+}
+
+/*
+ * Implementing the Scheme primitive bytevector, which makes a
+ * bytevector of the given bytes.
+ */
+Value *primitiveBytevector(Value *args) {
+    Value *bytevector = makeNumVector(U8_VECTOR, length(args));
+    uint8_t *bytes = bytevector->numvec.data;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        *bytes++ = byteArgument("bytevector", car(cur));
+    }
+    return bytevector;
+}
+
+/*
+ * Implementing the Scheme primitives bytevector-length,
+ * bytevector-u8-ref, and bytevector-u8-set!.
+ */
+Value *primitiveBytevectorLength(Value *args) {
+    checkArity(args, 1, 1);
+    return bytevectorLengthValue(car(args));
+}
+
+Value *primitiveBytevectorU8Ref(Value *args) {
+    checkArity(args, 2, 2);
+    return bytevectorU8Ref(car(args), car(cdr(args)));
+}
+
+Value *primitiveBytevectorU8Set(Value *args) {
+    checkArity(args, 3, 3);
+    return bytevectorU8Set(car(args), car(cdr(args)), car(cdr(cdr(args))));
+}
+
+/*
+ * Helper function to read the endianness argument, the symbol big or
+ * little.
+ *
+ * Returns true for big-endian.
+ */
+bool bigEndianArgument(char *name, Value *value) {
+    if (value->type == SYMBOL_TYPE && !strcmp(value->s, "big")) {
+        return true;
+    } else if (value->type == SYMBOL_TYPE && !strcmp(value->s, "little")) {
+        return false;
+    }
+    primitiveError(name, "expects big or little as the endianness");
+    return false;
+}
+
+/*
+ * Helper function to find the bytes at index k of a bytevector for an
+ * integer of the given size.
+ */
+uint8_t *fieldArgument(char *name, Value *bytevector, Value *index, int size) {
+    if (index->type != INT_TYPE || index->i < 0 ||
+        index->i > bytevector->numvec.length - size) {
+        primitiveError(name, "index is out of range");
+    }
+    return (uint8_t *) bytevector->numvec.data + index->i;
+}
+
+/*
+ * Implementing bytevector-u16-ref and friends:
+ * (bytevector-u16-ref bv k endianness).
+ */
+Value *loadField(char *name, Value *args, int size, bool isSigned) {
+    checkArity(args, 3, 3);
+    Value *bytevector = bytevectorArgument(name, car(args));
+    uint8_t *bytes = fieldArgument(name, bytevector, car(cdr(args)), size);
+    bool big = bigEndianArgument(name, car(cdr(cdr(args))));
+    uint64_t bits = 0;
+    for (int i = 0; i < size; i++) {
+        int shift = 8 * (big ? size - 1 - i : i);
+        bits |= (uint64_t) bytes[i] << shift;
+    }
+    if (isSigned) {
+        // Move the sign bit to the top and back to extend it
+        int spare = 64 - 8 * size;
+        return makeInteger((int64_t) (bits << spare) >> spare);
+    } else if (bits > INT64_MAX) {
+        return addExact(shiftExact(makeInteger(bits >> 32), 32),
+                        makeInteger(bits & 0xffffffff));
+    }
+    return makeInteger(bits);
+}
+
+/*
+ * Implementing bytevector-u16-set! and friends:
+ * (bytevector-u16-set! bv k n endianness).
+ */
+Value *storeField(char *name, Value *args, int size, bool isSigned) {
+    checkArity(args, 4, 4);
+    Value *bytevector = writableArgument(name, car(args));
+    uint8_t *bytes = fieldArgument(name, bytevector, car(cdr(args)), size);
+    Value *value = car(cdr(cdr(args)));
+    bool big = bigEndianArgument(name, car(cdr(cdr(cdr(args)))));
+    // The range of the field is [low, high)
+    Value *low = makeInteger(0);
+    Value *high = shiftExact(makeInteger(1), 8 * size);
+    if (isSigned) {
+        low = negateExact(shiftExact(makeInteger(1), 8 * size - 1));
+        high = shiftExact(makeInteger(1), 8 * size - 1);
+    }
+    if (!isExactInteger(value) || compareExact(value, low) < 0 ||
+        compareExact(value, high) >= 0) {
+        primitiveError(name, "expects an exact integer that fits the field");
+    }
+    uint64_t bits;
+    if (value->type == INT_TYPE) {
+        bits = (uint64_t) value->i;
+    } else {
+        Value *lowHalf = bitwiseExact(BIT_AND, value, makeInteger(0xffffffff));
+        bits = (uint64_t) shiftExact(value, -32)->i << 32 |
+               (uint64_t) lowHalf->i;
+    }
+    for (int i = 0; i < size; i++) {
+        int shift = 8 * (big ? size - 1 - i : i);
+        bytes[i] = (uint8_t) (bits >> shift);
+    }
+    return makeVoid();
+}
+
+#define FIELD_ACCESSORS(Name, name, size, isSigned) \
+    Value *primitiveBytevector##Name##Ref(Value *args) { \
+        return loadField("bytevector-" name "-ref", args, size, isSigned); \
+    } \
+    Value *primitiveBytevector##Name##Set(Value *args) { \
+        return storeField("bytevector-" name "-set!", args, size, isSigned); \
+    }
+
+FIELD_ACCESSORS(U16, "u16", 2, false)
+FIELD_ACCESSORS(S16, "s16", 2, true)
+FIELD_ACCESSORS(U32, "u32", 4, false)
+FIELD_ACCESSORS(S32, "s32", 4, true)
+FIELD_ACCESSORS(U64, "u64", 8, false)
+FIELD_ACCESSORS(S64, "s64", 8, true)
+
+/*
+ * Implementing the Scheme primitive bytevector-copy:
+ * (bytevector-copy bv [start [end]]).
+ */
+Value *primitiveBytevectorCopy(Value *args) {
+    checkArity(args, 1, 3);
+    Value *bytevector = bytevectorArgument("bytevector-copy", car(args));
+    int64_t size = bytevector->numvec.length;
+    int64_t start = bytevectorIndexArgument("bytevector-copy", args, 1, 0, 0,
+                                            size);
+    int64_t end = bytevectorIndexArgument("bytevector-copy", args, 2, size,
+                                          start, size);
+    return bytevectorOf((uint8_t *) bytevector->numvec.data + start,
+                        end - start);
+}
+
+/*
+ * Implementing the Scheme primitive bytevector-copy!:
+ * (bytevector-copy! to at from [start [end]]). The two ranges may
+ * overlap.
+ */
+Value *primitiveBytevectorCopyInto(Value *args) {
+    checkArity(args, 3, 5);
+    Value *to = writableArgument("bytevector-copy!", car(args));
+    int64_t at = bytevectorIndexArgument("bytevector-copy!", args, 1, 0, 0,
+                                         to->numvec.length);
+    Value *from = bytevectorArgument("bytevector-copy!", car(cdr(cdr(args))));
+    int64_t size = from->numvec.length;
+    int64_t start = bytevectorIndexArgument("bytevector-copy!", args, 3, 0, 0,
+                                            size);
+    int64_t end = bytevectorIndexArgument("bytevector-copy!", args, 4, size,
+                                          start, size);
+    if (end - start > to->numvec.length - at) {
+        primitiveError("bytevector-copy!", "destination is too short");
+    }
+    memmove((uint8_t *) to->numvec.data + at,
+            (uint8_t *) from->numvec.data + start, end - start);
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitive bytevector-append.
+ */
+Value *primitiveBytevectorAppend(Value *args) {
+    int64_t total = 0;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        total += bytevectorArgument("bytevector-append",
+                                    car(cur))->numvec.length;
+    }
+    Value *bytevector = makeNumVector(U8_VECTOR, total);
+    uint8_t *bytes = bytevector->numvec.data;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        memcpy(bytes, car(cur)->numvec.data, car(cur)->numvec.length);
+        bytes += car(cur)->numvec.length;
+    }
+    return bytevector;
+}
+
+/*
+ * Implementing the Scheme primitive bytevector-slice:
+ * (bytevector-slice bv start [end]). The slice shares the bytes of the
+ * bytevector, so changing one changes the other.
+ */
+Value *primitiveBytevectorSlice(Value *args) {
+    checkArity(args, 2, 3);
+    Value *bytevector = bytevectorArgument("bytevector-slice", car(args));
+    int64_t size = bytevector->numvec.length;
+    int64_t start = bytevectorIndexArgument("bytevector-slice", args, 1, 0,
+                                            0, size);
+    int64_t end = bytevectorIndexArgument("bytevector-slice", args, 2, size,
+                                          start, size);
+    Value *slice = makeNumVector(U8_VECTOR, 0);
+    slice->numvec.data = (uint8_t *) bytevector->numvec.data + start;
+    slice->numvec.length = end - start;
+    slice->numvec.readOnly = bytevector->numvec.readOnly;
+    return slice;
+}
+
+/*
+ * Helper function to unmap a file once its bytevector is collected.
+ */
+void releaseMapping(void *data, size_t size) {
+    munmap(data, size);
+}
+
+/*
+ * Implementing the Scheme primitive file->bytevector, which maps the
+ * whole file into memory read-only instead of reading it. The mapping
+ * lasts as long as the bytevector or a slice of it does.
+ */
+Value *primitiveFileToBytevector(Value *args) {
+    checkArity(args, 1, 1);
+    if (car(args)->type != STR_TYPE) {
+        primitiveError("file->bytevector", "expects a string as input");
+    }
+    char *path = stringToC(car(args));
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        printf("Cannot open file \"%s\". ", path);
+        evaluationError();
+    }
+    Value *bytevector = makeNumVector(U8_VECTOR, 0);
+    if (info.st_size > 0) {
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            printf("Cannot map file \"%s\". ", path);
+            evaluationError();
+        }
+        // Files are mostly scanned from start to end
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        tadopt(data, info.st_size, releaseMapping);
+        bytevector->numvec.data = data;
+        bytevector->numvec.length = info.st_size;
+    }
+    bytevector->numvec.readOnly = true;
+    close(fd);
+    return bytevector;
+}
+
+/*
+ * Implementing the Scheme primitive utf8->string:
+ * (utf8->string bv [start [end]]). Strings hold bytes, so the bytes
+ * are copied as they are.
+ */
+Value *primitiveUtf8ToString(Value *args) {
+    checkArity(args, 1, 3);
+    Value *bytevector = bytevectorArgument("utf8->string", car(args));
+    int64_t size = bytevector->numvec.length;
+    int64_t start = bytevectorIndexArgument("utf8->string", args, 1, 0, 0,
+                                            size);
+    int64_t end = bytevectorIndexArgument("utf8->string", args, 2, size,
+                                          start, size);
+    return makeStringOf((char *) bytevector->numvec.data + start, end - start);
+}
+
+/*
+ * Implementing the Scheme primitive string->utf8.
+ */
+Value *primitiveStringToUtf8(Value *args) {
+    checkArity(args, 1, 1);
+    Value *string = car(args);
+    if (string->type != STR_TYPE) {
+        primitiveError("string->utf8", "expects a string as input");
+    }
+    return bytevectorOf((uint8_t *) string->str.chars, string->str.length);
+}
+
+/*
+ * Bind the bytevector primitives in the given top-level frame.
+ */
+void bindBytevectorPrimitives(Frame *topFrame) {
+    bind("bytevector?", primitiveIsBytevector, topFrame);
+    bind("make-bytevector", primitiveMakeBytevector, topFrame);
+    bind("bytevector", primitiveBytevector, topFrame);
+    bind("bytevector-length", primitiveBytevectorLength, topFrame);
+    bind("bytevector-u8-ref", primitiveBytevectorU8Ref, topFrame);
+    bind("bytevector-u8-set!", primitiveBytevectorU8Set, topFrame);
+    bind("bytevector-u16-ref", primitiveBytevectorU16Ref, topFrame);
+    bind("bytevector-u16-set!", primitiveBytevectorU16Set, topFrame);
+    bind("bytevector-s16-ref", primitiveBytevectorS16Ref, topFrame);
+    bind("bytevector-s16-set!", primitiveBytevectorS16Set, topFrame);
+    bind("bytevector-u32-ref", primitiveBytevectorU32Ref, topFrame);
+    bind("bytevector-u32-set!", primitiveBytevectorU32Set, topFrame);
+    bind("bytevector-s32-ref", primitiveBytevectorS32Ref, topFrame);
+    bind("bytevector-s32-set!", primitiveBytevectorS32Set, topFrame);
+    bind("bytevector-u64-ref", primitiveBytevectorU64Ref, topFrame);
+    bind("bytevector-u64-set!", primitiveBytevectorU64Set, topFrame);
+    bind("bytevector-s64-ref", primitiveBytevectorS64Ref, topFrame);
+    bind("bytevector-s64-set!", primitiveBytevectorS64Set, topFrame);
+    bind("bytevector-copy", primitiveBytevectorCopy, topFrame);
+    bind("bytevector-copy!", primitiveBytevectorCopyInto, topFrame);
+    bind("bytevector-append", primitiveBytevectorAppend, topFrame);
+    bind("bytevector-slice", primitiveBytevectorSlice, topFrame);
+    bind("file->bytevector", primitiveFileToBytevector, topFrame);
+    bind("utf8->string", primitiveUtf8ToString, topFrame);
+    bind("string->utf8", primitiveStringToUtf8, topFrame);
+}
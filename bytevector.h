@@ -0,0 +1,64 @@
+/*
+ * This program implements the bytevectors of R7RS, with the multi-byte
+ * accessors of R6RS. A bytevector is a u8vector, so the bulk u8vector
+ * operations work on it too, and a bytevector may be a view into
+ * another or into a file mapped into memory.
+ */
+#include "value.h"
+
+#ifndef BYTEVECTOR_H
+#define BYTEVECTOR_H
+
+/*
+ * Read a byte, store a byte, and measure a bytevector, for the
+ * interpreter and for compiled programs to call directly.
+ */
+Value *bytevectorU8Ref(Value *bytevector, Value *index);
+Value *bytevectorU8Set(Value *bytevector, Value *index, Value *byte);
+Value *bytevectorLengthValue(Value *bytevector);
+
+/*
+ * The primitives below, for compiled programs.
+ */
+Value *primitiveIsBytevector(Value *args);
+Value *primitiveMakeBytevector(Value *args);
+Value *primitiveBytevector(Value *args);
+Value *primitiveBytevectorLength(Value *args);
+Value *primitiveBytevectorU8Ref(Value *args);
+Value *primitiveBytevectorU8Set(Value *args);
+Value *primitiveBytevectorU16Ref(Value *args);
+Value *primitiveBytevectorU16Set(Value *args);
+Value *primitiveBytevectorS16Ref(Value *args);
+Value *primitiveBytevectorS16Set(Value *args);
+Value *primitiveBytevectorU32Ref(Value *args);
+Value *primitiveBytevectorU32Set(Value *args);
+Value *primitiveBytevectorS32Ref(Value *args);
+Value *primitiveBytevectorS32Set(Value *args);
+Value *primitiveBytevectorU64Ref(Value *args);
+Value *primitiveBytevectorU64Set(Value *args);
+Value *primitiveBytevectorS64Ref(Value *args);
+Value *primitiveBytevectorS64Set(Value *args);
+Value *primitiveBytevectorCopy(Value *args);
+Value *primitiveBytevectorCopyInto(Value *args);
+Value *primitiveBytevectorAppend(Value *args);
+Value *primitiveBytevectorSlice(Value *args);
+Value *primitiveFileToBytevector(Value *args);
+Value *primitiveUtf8ToString(Value *args);
+Value *primitiveStringToUtf8(Value *args);
+
+/*
+ * Bind the bytevector primitives in the given top-level frame.
+ *
+ *   bytevector? make-bytevector bytevector bytevector-length
+ *   bytevector-u8-ref bytevector-u8-set!
+ *   bytevector-u16-ref bytevector-u16-set! (bv k [n] endianness)
+ *     and the same for s16, u32, s32, u64, and s64; endianness is
+ *     the symbol big or little
+ *   bytevector-copy bytevector-copy! bytevector-append
+ *   bytevector-slice bv start [end]   a view, without copying
+ *   file->bytevector path             the file mapped read-only
+ *   utf8->string string->utf8
+ */
+void bindBytevectorPrimitives(Frame *topFrame);
+
+#endif
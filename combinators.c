@@ -0,0 +1,466 @@
+/*
+ * This program implements the list combinators map, for-each, filter,
+ * foldl, and foldr, and runs pipelines of them without intermediate
+ * lists.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "combinators.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+
+enum Combinator {
+    NO_COMBINATOR = -1,
+    MAP_COMBINATOR,
+    FOR_EACH_COMBINATOR,
+    FILTER_COMBINATOR,
+    FOLDL_COMBINATOR,
+    FOLDR_COMBINATOR
+};
+
+/* A map or filter step of a pipeline, innermost first. */
+struct Stage {
+    enum Combinator kind;
+    Value *function;
+    struct Stage *next;
+};
+
+/*
+ * Helper function to find which combinator a procedure is.
+ */
+enum Combinator combinatorOf(Value *function) {
+    if (function->type != PRIMITIVE_TYPE) {
+        return NO_COMBINATOR;
+    } else if (function->pf == primitiveMap) {
+        return MAP_COMBINATOR;
+    } else if (function->pf == primitiveForEach) {
+        return FOR_EACH_COMBINATOR;
+    } else if (function->pf == primitiveFilter) {
+        return FILTER_COMBINATOR;
+    } else if (function->pf == primitiveFoldl) {
+        return FOLDL_COMBINATOR;
+    } else if (function->pf == primitiveFoldr) {
+        return FOLDR_COMBINATOR;
+    }
+    return NO_COMBINATOR;
+}
+
+/*
+ * Test whether a procedure is one of the built-in combinators.
+ */
+bool isCombinator(Value *function) {
+    return combinatorOf(function) != NO_COMBINATOR;
+}
+
+/*
+ * Helper function to call a procedure on one argument.
+ */
+Value *callOne(Value *function, Value *arg) {
+    return apply(function, cons(arg, makeNull()));
+}
+
+/*
+ * Helper function to call a procedure on two arguments.
+ */
+Value *callTwo(Value *function, Value *first, Value *second) {
+    return apply(function, cons(first, cons(second, makeNull())));
+}
+
+/*
+ * Helper function to test whether a value is #f.
+ */
+bool isFalse(Value *value) {
+    return value->type == BOOL_TYPE && !strcmp(value->s, "#f");
+}
+
+/*
+ * Helper function to check that the list given to a combinator is a
+ * proper list.
+ */
+void checkCombinatorList(Value *list, enum Combinator kind) {
+    static char *names[] = {"map", "for-each", "filter", "foldl", "foldr"};
+    Value *cur = list;
+    while (cur->type == CONS_TYPE) {
+        cur = cdr(cur);
+    }
+    if (cur->type != NULL_TYPE) {
+        printf("%s expects list as one of its input\n", names[kind]);
+        evaluationError();
+    }
+}
+
+/*
+ * Helper function to add an item at the end of a list under
+ * construction.
+ */
+void appendItem(Value **head, Value **tail, Value *item) {
+    Value *cell = cons(item, makeNull());
+    if (*tail == NULL) {
+        *head = cell;
+    } else {
+        (*tail)->c.cdr = cell;
+    }
+    *tail = cell;
+}
+
+/*
+ * Helper function to run a combinator over a list, passing each item
+ * through the given stages first.
+ */
+Value *runPipeline(enum Combinator kind, Value *function, Value *init,
+                   struct Stage *stages, Value *list) {
+    Value *head = makeNull();
+    Value *tail = NULL;
+    Value *result = init;
+    // foldr combines from the right, so keep the items in an array
+    Value **items = NULL;
+    int count = 0;
+    if (kind == FOLDR_COMBINATOR) {
+        items = talloc(sizeof(Value *) * (length(list) + 1));
+        if (!items) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+    }
+    for (Value *cur = list; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *item = car(cur);
+        bool kept = true;
+        for (struct Stage *stage = stages; stage != NULL && kept;
+             stage = stage->next) {
+            if (stage->kind == MAP_COMBINATOR) {
+                item = callOne(stage->function, item);
+            } else {
+                kept = !isFalse(callOne(stage->function, item));
+            }
+        }
+        if (!kept) {
+            continue;
+        }
+        switch (kind) {
+            case MAP_COMBINATOR:
+                appendItem(&head, &tail, callOne(function, item));
+                break;
+            case FOR_EACH_COMBINATOR:
+                callOne(function, item);
+                break;
+            case FILTER_COMBINATOR:
+                if (!isFalse(callOne(function, item))) {
+                    appendItem(&head, &tail, item);
+                }
+                break;
+            case FOLDL_COMBINATOR:
+                result = callTwo(function, item, result);
+                break;
+            default:
+                items[count++] = item;
+                break;
+        }
+    }
+    if (kind == FOLDR_COMBINATOR) {
+        for (int i = count - 1; i >= 0; i--) {
+            result = callTwo(function, items[i], result);
+        }
+    }
+    if (kind == FOLDL_COMBINATOR || kind == FOLDR_COMBINATOR) {
+        return result;
+    } else if (kind == FOR_EACH_COMBINATOR) {
+        return makeVoid();
+    }
+    return head;
+}
+
+/*
+ * Helper function to run map or for-each over several lists at once,
+ * stopping at the end of the shortest.
+ */
+Value *runParallel(enum Combinator kind, Value *function, Value *lists) {
+    Value *head = makeNull();
+    Value *tail = NULL;
+    int count = length(lists);
+    Value **cursors = talloc(sizeof(Value *) * count);
+    if (!cursors) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        cursors[i] = car(lists);
+        checkCombinatorList(cursors[i], kind);
+        lists = cdr(lists);
+    }
+    while (true) {
+        Value *args = makeNull();
+        for (int i = count - 1; i >= 0; i--) {
+            if (cursors[i]->type != CONS_TYPE) {
+                return kind == MAP_COMBINATOR ? head : makeVoid();
+            }
+            args = cons(car(cursors[i]), args);
+        }
+        for (int i = 0; i < count; i++) {
+            cursors[i] = cdr(cursors[i]);
+        }
+        Value *result = apply(function, args);
+        if (kind == MAP_COMBINATOR) {
+            appendItem(&head, &tail, result);
+        }
+    }
+}
+
+/*
+ * Implementing the Scheme primitive map function, which stops at the
+ * end of the shortest list when given several.
+ */
+Value *primitiveMap(Value *args) {
+    if (length(args) > 2) {
+        return runParallel(MAP_COMBINATOR, car(args), cdr(args));
+    }
+    checkArity(args, 2, 2);
+    Value *list = car(cdr(args));
+    checkCombinatorList(list, MAP_COMBINATOR);
+    return runPipeline(MAP_COMBINATOR, car(args), NULL, NULL, list);
+}
+
+/*
+ * Implementing the Scheme primitive for-each function, which calls the
+ * procedure for its effects and returns nothing.
+ */
+Value *primitiveForEach(Value *args) {
+    if (length(args) > 2) {
+        return runParallel(FOR_EACH_COMBINATOR, car(args), cdr(args));
+    }
+    checkArity(args, 2, 2);
+    Value *list = car(cdr(args));
+    checkCombinatorList(list, FOR_EACH_COMBINATOR);
+    return runPipeline(FOR_EACH_COMBINATOR, car(args), NULL, NULL, list);
+}
+
+/*
+ * Implementing the Scheme primitive filter function.
+ */
+Value *primitiveFilter(Value *args) {
+    checkArity(args, 2, 2);
+    Value *list = car(cdr(args));
+    checkCombinatorList(list, FILTER_COMBINATOR);
+    return runPipeline(FILTER_COMBINATOR, car(args), NULL, NULL, list);
+}
+
+/*
+ * Implementing the Scheme primitive foldl function, which calls
+ * (f item result) from the first item to the last.
+ */
+Value *primitiveFoldl(Value *args) {
+    checkArity(args, 3, 3);
+    Value *list = car(cdr(cdr(args)));
+    checkCombinatorList(list, FOLDL_COMBINATOR);
+    return runPipeline(FOLDL_COMBINATOR, car(args), car(cdr(args)), NULL, list);
+}
+
+/*
+ * Implementing the Scheme primitive foldr function, which calls
+ * (f item result) from the last item to the first.
+ */
+Value *primitiveFoldr(Value *args) {
+    checkArity(args, 3, 3);
+    Value *list = car(cdr(cdr(args)));
+    checkCombinatorList(list, FOLDR_COMBINATOR);
+    return runPipeline(FOLDR_COMBINATOR, car(args), car(cdr(args)), NULL, list);
+}
+
+/*
+ * Helper function to look up a symbol without reporting an error.
+ *
+ * Returns NULL if the symbol is unbound.
+ */
+Value *lookUpQuietly(Value *symbol, Frame *frame) {
+    for (Frame *cur = frame; cur != NULL; cur = cur->parent) {
+        Value *binding = isBounded(symbol, cur);
+        if (binding) {
+            return car(cdr(binding));
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Helper function to test whether an expression is a call
+ * (map f list) or (filter f list) to the built-in procedures.
+ */
+enum Combinator stageOf(Value *expr, Frame *frame) {
+    if (expr->type != CONS_TYPE || car(expr)->type != SYMBOL_TYPE ||
+        length(expr) != 3) {
+        return NO_COMBINATOR;
+    }
+    Value *function = lookUpQuietly(car(expr), frame);
+    if (function == NULL) {
+        return NO_COMBINATOR;
+    }
+    enum Combinator kind = combinatorOf(function);
+    if (kind != MAP_COMBINATOR && kind != FILTER_COMBINATOR) {
+        return NO_COMBINATOR;
+    }
+    return kind;
+}
+
+/* The primitives that neither change nor read anything that can
+ * change, so that calling them element by element cannot be told from
+ * calling them stage by stage */
+static Value *(*purePrimitives[])(Value *) = {
+    primitiveAdd, primitiveMult, primitiveSub, primitiveDiv, primitiveLeq,
+    primitiveNumEqual, primitiveLess, primitiveGreater, primitiveGeq,
+    primitiveIsZero, primitiveIsPositive, primitiveIsNegative,
+    primitiveIsEven, primitiveIsOdd, primitiveMax, primitiveMin,
+    primitiveAbs, primitiveFloor, primitiveCeiling, primitiveTruncate,
+    primitiveRound, primitiveQuotient, primitiveRemainder, primitiveModulo,
+    primitiveGcd, primitiveLcm, primitiveExpt, primitiveExactToInexact,
+    primitiveInexactToExact, primitiveIsEq, primitiveIsEqv, primitiveIsPair,
+    primitiveIsNull, primitiveCons, primitiveNumberCheck,
+    primitiveIntegerCheck
+};
+
+/*
+ * Helper function to test whether a value is one of the pure
+ * primitives.
+ */
+bool isPurePrimitive(Value *value) {
+    if (value == NULL || value->type != PRIMITIVE_TYPE) {
+        return false;
+    }
+    int count = sizeof(purePrimitives) / sizeof(purePrimitives[0]);
+    for (int i = 0; i < count; i++) {
+        if (value->pf == purePrimitives[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Helper function to test whether a symbol is one of a list of
+ * formal parameters.
+ */
+bool isFormal(Value *symbol, Value *formals) {
+    for (Value *cur = formals; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        if (!strcmp(car(cur)->s, symbol->s)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Helper function to test whether an expression in the body of a
+ * lambda is pure: it uses only constants, the formal parameters, the
+ * forms quote, if, and, and or, and calls of names that refer to pure
+ * primitives in the frame of the lambda.
+ */
+bool isPureExpr(Value *expr, Value *formals, Frame *frame) {
+    if (expr->type == SYMBOL_TYPE) {
+        return isFormal(expr, formals) ||
+               isPurePrimitive(lookUpQuietly(expr, frame));
+    } else if (expr->type != CONS_TYPE) {
+        return true;
+    }
+    Value *head = car(expr);
+    if (head->type != SYMBOL_TYPE || isFormal(head, formals)) {
+        return false;
+    } else if (!strcmp(head->s, "quote")) {
+        return true;
+    } else if (strcmp(head->s, "if") && strcmp(head->s, "and") &&
+               strcmp(head->s, "or") &&
+               !isPurePrimitive(lookUpQuietly(head, frame))) {
+        return false;
+    }
+    for (Value *cur = cdr(expr); cur->type == CONS_TYPE; cur = cdr(cur)) {
+        if (!isPureExpr(car(cur), formals, frame)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Helper function to test whether a procedure given to a stage is
+ * pure: a pure primitive, or a lambda whose body is pure.
+ */
+bool isPureProcedure(Value *function) {
+    if (function->type != CLOSURE_TYPE) {
+        return isPurePrimitive(function);
+    }
+    Value *formals = function->closure.formal;
+    Value *cur = formals;
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        if (car(cur)->type != SYMBOL_TYPE) {
+            return false;
+        }
+    }
+    if (cur->type != NULL_TYPE) {
+        return false;
+    }
+    for (cur = function->closure.body; cur->type == CONS_TYPE;
+         cur = cdr(cur)) {
+        if (!isPureExpr(car(cur), formals, function->closure.frame)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Helper function to run the stages one after another, each over the
+ * whole list the one before it made, and then the combinator.
+ */
+Value *runStages(enum Combinator kind, Value *function, Value *init,
+                 struct Stage *stages, Value *list) {
+    for (struct Stage *stage = stages; stage != NULL; stage = stage->next) {
+        list = runPipeline(stage->kind, stage->function, NULL, NULL, list);
+    }
+    return runPipeline(kind, function, init, NULL, list);
+}
+
+/*
+ * Evaluate the arguments of a call to the built-in combinator
+ * `function' and run it, fused with the built-in map and filter calls
+ * that produce its list, as a single loop.
+ *
+ * Returns NULL without evaluating anything if the list argument is
+ * not itself a call to a built-in map or filter.
+ */
+Value *evalPipeline(Value *function, Value *args, Frame *frame) {
+    enum Combinator kind = combinatorOf(function);
+    bool fold = kind == FOLDL_COMBINATOR || kind == FOLDR_COMBINATOR;
+    if (length(args) != (fold ? 3 : 2)) {
+        return NULL;
+    }
+    Value *listExpr = car(fold ? cdr(cdr(args)) : cdr(args));
+    if (stageOf(listExpr, frame) == NO_COMBINATOR) {
+        return NULL;
+    }
+    // Evaluate everything in the order of the nested calls
+    Value *consumer = eval(car(args), frame);
+    Value *init = fold ? eval(car(cdr(args)), frame) : NULL;
+    struct Stage *stages = NULL;
+    bool pure = true;
+    enum Combinator stageKind;
+    while ((stageKind = stageOf(listExpr, frame)) != NO_COMBINATOR) {
+        struct Stage *stage = talloc(sizeof(struct Stage));
+        if (!stage) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        stage->kind = stageKind;
+        stage->function = eval(car(cdr(listExpr)), frame);
+        pure = pure && isPureProcedure(stage->function);
+        stage->next = stages;
+        stages = stage;
+        listExpr = car(cdr(cdr(listExpr)));
+    }
+    Value *list = eval(listExpr, frame);
+    checkCombinatorList(list, stages ? stages->kind : kind);
+    // Calls in different stages may only be interleaved if none of
+    // them can observe the others
+    if (!pure) {
+        return runStages(kind, consumer, init, stages, list);
+    }
+    return runPipeline(kind, consumer, init, stages, list);
+}
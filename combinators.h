@@ -0,0 +1,45 @@
+/*
+ * This program implements the list combinators map, for-each, filter,
+ * foldl, and foldr, and runs pipelines of them without intermediate
+ * lists.
+ */
+#include "value.h"
+
+#ifndef COMBINATORS_H
+#define COMBINATORS_H
+
+/*
+ * Implementing the Scheme primitive map, for-each, filter, foldl, and
+ * foldr functions. map and for-each also take several lists; the
+ * others take one.
+ */
+Value *primitiveMap(Value *args);
+Value *primitiveForEach(Value *args);
+Value *primitiveFilter(Value *args);
+Value *primitiveFoldl(Value *args);
+Value *primitiveFoldr(Value *args);
+
+/*
+ * Test whether a procedure is one of the built-in combinators above.
+ */
+bool isCombinator(Value *function);
+
+/*
+ * Evaluate the arguments of a call to the built-in combinator
+ * `function' and run it, fused with the built-in map and filter calls
+ * that produce its list, as a single loop. For example
+ * (foldl + 0 (map f (filter p xs))) walks xs once and conses nothing.
+ *
+ * The arguments are evaluated in the same order as for an ordinary
+ * call. The functions passed to the stages are called element by
+ * element instead of stage by stage only if each is pure: a primitive
+ * like + or odd?, or a lambda built from such primitives, its own
+ * parameters, constants, and if, and, and or. Otherwise the stages run
+ * one after another over whole lists, as they would unfused.
+ *
+ * Returns NULL without evaluating anything if the list argument is
+ * not itself a call to a built-in map or filter.
+ */
+Value *evalPipeline(Value *function, Value *args, Frame *frame);
+
+#endif
@@ -0,0 +1,1942 @@
+/*
+ * This program implements a compiler that translates a Scheme program
+ * into C code linked against the interpreter's runtime.
+ *
+ * Local variables live in environments indexed by position instead of
+ * frames searched by name, procedures become C functions, and calls to
+ * the unmodified arithmetic and list primitives are made directly.
+ */
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "compiler.h"
+#include "hashtable.h"
+#include "bignum.h"
+#include "numformat.h"
+#include "macro.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+/* A growable buffer of generated C code. */
+struct Code {
+    char *data;
+    int size;
+    int capacity;
+};
+
+typedef struct Code Code;
+
+/* A lexical scope: the variables of one environment at run time. */
+struct Scope {
+    Value *names;           /* Symbols bound in the scope, in slot order */
+    char *var;              /* C variable holding the environment */
+    bool letrec;            /* Slots may be read before they are set */
+    int function;           /* The generated C function it belongs to */
+    struct Scope *parent;
+};
+
+typedef struct Scope Scope;
+
+/* A named let or do loop whose body is being compiled. */
+struct Loop {
+    Value *name;            /* The loop name, or NULL for do */
+    Scope *nameScope;       /* The scope binding the loop name */
+    Scope *scope;           /* The scope of the loop variables */
+    int label;
+    bool inPlace;           /* Whether slots can be overwritten in place */
+};
+
+typedef struct Loop Loop;
+
+/* A primitive that compiled code may call without looking it up. */
+struct Inline {
+    char *name;
+    int arity;              /* Number of arguments, or -1 for any */
+    char *function;         /* C function taking the arguments */
+};
+
+static struct Inline inlines[] = {
+    {"+", 2, "addValues"},
+    {"-", 2, "subtractValues"},
+    {"*", 2, "multiplyValues"},
+    {"<=", 2, "lessOrEqual"},
+    {"=", 2, "numbersEqual"},
+    {"<", 2, "lessThan"},
+    {">", 2, "greaterThan"},
+    {">=", 2, "greaterOrEqual"},
+    {"car", 1, "carValue"},
+    {"cdr", 1, "cdrValue"},
+    {"fx+", 2, "fxAdd"},
+    {"fx-", 2, "fxSubtract"},
+    {"fx*", 2, "fxMultiply"},
+    {"fx=", 2, "fxEqual"},
+    {"fx<", 2, "fxLess"},
+    {"fx>", 2, "fxGreater"},
+    {"fx<=", 2, "fxLessEqual"},
+    {"fx>=", 2, "fxGreaterEqual"},
+    {"fl+", 2, "flAdd"},
+    {"fl-", 2, "flSubtract"},
+    {"fl*", 2, "flMultiply"},
+    {"fl/", 2, "flDivide"},
+    {"fl=", 2, "flEqual"},
+    {"fl<", 2, "flLess"},
+    {"fl>", 2, "flGreater"},
+    {"fl<=", 2, "flLessEqual"},
+    {"fl>=", 2, "flGreaterEqual"},
+    {"bitwise-and", 2, "bitwiseAnd"},
+    {"bitwise-ior", 2, "bitwiseIor"},
+    {"bitwise-or", 2, "bitwiseIor"},
+    {"bitwise-xor", 2, "bitwiseXor"},
+    {"arithmetic-shift", 2, "arithmeticShift"},
+    {"vector-ref", 2, "vectorRefValue"},
+    {"vector-set!", 3, "vectorSetValue"},
+    {"vector-length", 1, "vectorLengthValue"},
+    {"hash-table-ref/default", 3, "dictionaryRefDefault"},
+    {"hash-table-set!", 3, "dictionarySet"},
+    {"hash-table-contains?", 2, "dictionaryContains"},
+    {"hash-table-exists?", 2, "dictionaryContains"},
+    {"imap-ref", 3, "imapRefDefault"},
+    {"imap-set", 3, "imapSetValue"},
+    {"imap-contains?", 2, "imapContains"},
+    {"bytevector-u8-ref", 2, "bytevectorU8Ref"},
+    {"bytevector-u8-set!", 3, "bytevectorU8Set"},
+    {"bytevector-length", 1, "bytevectorLengthValue"},
+    {"string-length", 1, "stringLengthValue"},
+    {"string-ref", 2, "stringRefValue"},
+    {"string=?", 2, "stringsEqual"},
+    {"values", 2, "returnTwoValues"},
+    {"force", 1, "forceValue"},
+    {"+", -1, "primitiveAdd"},
+    {"-", -1, "primitiveSub"},
+    {"*", -1, "primitiveMult"},
+    {"/", -1, "primitiveDiv"},
+    {"<=", -1, "primitiveLeq"},
+    {"=", -1, "primitiveNumEqual"},
+    {"<", -1, "primitiveLess"},
+    {">", -1, "primitiveGreater"},
+    {">=", -1, "primitiveGeq"},
+    {"zero?", -1, "primitiveIsZero"},
+    {"positive?", -1, "primitiveIsPositive"},
+    {"negative?", -1, "primitiveIsNegative"},
+    {"even?", -1, "primitiveIsEven"},
+    {"odd?", -1, "primitiveIsOdd"},
+    {"max", -1, "primitiveMax"},
+    {"min", -1, "primitiveMin"},
+    {"abs", -1, "primitiveAbs"},
+    {"eq?", -1, "primitiveIsEq"},
+    {"eqv?", -1, "primitiveIsEqv"},
+    {"equal?", -1, "primitiveIsEqual"},
+    {"pair?", -1, "primitiveIsPair"},
+    {"null?", -1, "primitiveIsNull"},
+    {"cons", -1, "primitiveCons"},
+    {"length", -1, "primitiveLength"},
+    {"list-ref", -1, "primitiveListRef"},
+    {"list-tail", -1, "primitiveListTail"},
+    {"member", -1, "primitiveMember"},
+    {"memq", -1, "primitiveMemq"},
+    {"assq", -1, "primitiveAssq"},
+    {"assoc", -1, "primitiveAssoc"},
+    {"append", -1, "primitiveAppend"},
+    {"reverse", -1, "primitiveReverse"},
+    {"caar", -1, "primitiveCaar"},
+    {"cadr", -1, "primitiveCadr"},
+    {"cdar", -1, "primitiveCdar"},
+    {"cddr", -1, "primitiveCddr"},
+    {"caaar", -1, "primitiveCaaar"},
+    {"caadr", -1, "primitiveCaadr"},
+    {"cadar", -1, "primitiveCadar"},
+    {"caddr", -1, "primitiveCaddr"},
+    {"cdaar", -1, "primitiveCdaar"},
+    {"cdadr", -1, "primitiveCdadr"},
+    {"cddar", -1, "primitiveCddar"},
+    {"cdddr", -1, "primitiveCdddr"},
+    {"caaaar", -1, "primitiveCaaaar"},
+    {"caaadr", -1, "primitiveCaaadr"},
+    {"caadar", -1, "primitiveCaadar"},
+    {"caaddr", -1, "primitiveCaaddr"},
+    {"cadaar", -1, "primitiveCadaar"},
+    {"cadadr", -1, "primitiveCadadr"},
+    {"caddar", -1, "primitiveCaddar"},
+    {"cadddr", -1, "primitiveCadddr"},
+    {"cdaaar", -1, "primitiveCdaaar"},
+    {"cdaadr", -1, "primitiveCdaadr"},
+    {"cdadar", -1, "primitiveCdadar"},
+    {"cdaddr", -1, "primitiveCdaddr"},
+    {"cddaar", -1, "primitiveCddaar"},
+    {"cddadr", -1, "primitiveCddadr"},
+    {"cdddar", -1, "primitiveCdddar"},
+    {"cddddr", -1, "primitiveCddddr"},
+    {"number?", -1, "primitiveNumberCheck"},
+    {"integer?", -1, "primitiveIntegerCheck"},
+    {"fx+", -1, "primitiveFxAdd"},
+    {"fx-", -1, "primitiveFxSubtract"},
+    {"fx*", -1, "primitiveFxMultiply"},
+    {"fx=", -1, "primitiveFxEqual"},
+    {"fx<", -1, "primitiveFxLess"},
+    {"fx>", -1, "primitiveFxGreater"},
+    {"fx<=", -1, "primitiveFxLessEqual"},
+    {"fx>=", -1, "primitiveFxGreaterEqual"},
+    {"fl+", -1, "primitiveFlAdd"},
+    {"fl-", -1, "primitiveFlSubtract"},
+    {"fl*", -1, "primitiveFlMultiply"},
+    {"fl/", -1, "primitiveFlDivide"},
+    {"fl=", -1, "primitiveFlEqual"},
+    {"fl<", -1, "primitiveFlLess"},
+    {"fl>", -1, "primitiveFlGreater"},
+    {"fl<=", -1, "primitiveFlLessEqual"},
+    {"fl>=", -1, "primitiveFlGreaterEqual"},
+    {"bitwise-and", -1, "primitiveBitwiseAnd"},
+    {"bitwise-ior", -1, "primitiveBitwiseIor"},
+    {"bitwise-or", -1, "primitiveBitwiseIor"},
+    {"bitwise-xor", -1, "primitiveBitwiseXor"},
+    {"bitwise-not", -1, "primitiveBitwiseNot"},
+    {"arithmetic-shift", -1, "primitiveArithmeticShift"},
+    {"make-vector", -1, "primitiveMakeVector"},
+    {"vector", -1, "primitiveVector"},
+    {"vector?", -1, "primitiveIsVector"},
+    {"vector-length", -1, "primitiveVectorLength"},
+    {"vector-ref", -1, "primitiveVectorRef"},
+    {"vector-set!", -1, "primitiveVectorSet"},
+    {"vector-fill!", -1, "primitiveVectorFill"},
+    {"vector->list", -1, "primitiveVectorToList"},
+    {"list->vector", -1, "primitiveListToVector"},
+    {"make-hash-table", -1, "primitiveMakeHashTable"},
+    {"hash-table?", -1, "primitiveIsHashTable"},
+    {"hash-table-ref", -1, "primitiveHashTableRef"},
+    {"hash-table-ref/default", -1, "primitiveHashTableRefDefault"},
+    {"hash-table-set!", -1, "primitiveHashTableSet"},
+    {"hash-table-delete!", -1, "primitiveHashTableDelete"},
+    {"hash-table-exists?", -1, "primitiveHashTableContains"},
+    {"hash-table-contains?", -1, "primitiveHashTableContains"},
+    {"hash-table-update!", -1, "primitiveHashTableUpdate"},
+    {"hash-table-update!/default", -1, "primitiveHashTableUpdateDefault"},
+    {"hash-table-size", -1, "primitiveHashTableSize"},
+    {"hash-table-keys", -1, "primitiveHashTableKeys"},
+    {"hash-table-values", -1, "primitiveHashTableValues"},
+    {"hash-table-walk", -1, "primitiveHashTableWalk"},
+    {"hash-table-fold", -1, "primitiveHashTableFold"},
+    {"hash-table->alist", -1, "primitiveHashTableToAlist"},
+    {"alist->hash-table", -1, "primitiveAlistToHashTable"},
+    {"hash-table-copy", -1, "primitiveHashTableCopy"},
+    {"make-weak-key-hash-table", -1, "primitiveMakeWeakKeyHashTable"},
+    {"make-weak-value-hash-table", -1, "primitiveMakeWeakValueHashTable"},
+    {"hash-table-weakness", -1, "primitiveHashTableWeakness"},
+    {"hash", -1, "primitiveHash"},
+    {"string-hash", -1, "primitiveStringHash"},
+    {"hash-by-identity", -1, "primitiveHashByIdentity"},
+    {"imap", -1, "primitiveImap"},
+    {"imap?", -1, "primitiveIsImap"},
+    {"imap-ref", -1, "primitiveImapRef"},
+    {"imap-set", -1, "primitiveImapSet"},
+    {"imap-delete", -1, "primitiveImapDelete"},
+    {"imap-update", -1, "primitiveImapUpdate"},
+    {"imap-contains?", -1, "primitiveImapContains"},
+    {"imap-size", -1, "primitiveImapSize"},
+    {"imap-keys", -1, "primitiveImapKeys"},
+    {"imap-values", -1, "primitiveImapValues"},
+    {"imap-fold", -1, "primitiveImapFold"},
+    {"imap->alist", -1, "primitiveImapToAlist"},
+    {"alist->imap", -1, "primitiveAlistToImap"},
+    {"imap-transient", -1, "primitiveImapTransient"},
+    {"imap-set!", -1, "primitiveImapSetInPlace"},
+    {"imap-delete!", -1, "primitiveImapDeleteInPlace"},
+    {"imap-persistent!", -1, "primitiveImapPersistent"},
+    {"iset", -1, "primitiveIset"},
+    {"iset?", -1, "primitiveIsIset"},
+    {"iset-add", -1, "primitiveIsetAdd"},
+    {"iset-remove", -1, "primitiveIsetRemove"},
+    {"iset-contains?", -1, "primitiveIsetContains"},
+    {"iset-size", -1, "primitiveIsetSize"},
+    {"iset->list", -1, "primitiveIsetToList"},
+    {"list->iset", -1, "primitiveListToIset"},
+    {"iset-transient", -1, "primitiveIsetTransient"},
+    {"iset-add!", -1, "primitiveIsetAddInPlace"},
+    {"iset-remove!", -1, "primitiveIsetRemoveInPlace"},
+    {"iset-persistent!", -1, "primitiveIsetPersistent"},
+    {"sort", -1, "primitiveSort"},
+    {"sort!", -1, "primitiveSortInPlace"},
+    {"list-sort", -1, "primitiveListSort"},
+    {"vector-sort", -1, "primitiveVectorSort"},
+    {"values", -1, "primitiveValues"},
+    {"call-with-values", -1, "primitiveCallWithValues"},
+    {"floor/", -1, "primitiveFloorDivide"},
+    {"truncate/", -1, "primitiveTruncateDivide"},
+    {"force", -1, "primitiveForce"},
+    {"make-promise", -1, "primitiveMakePromise"},
+    {"promise?", -1, "primitiveIsPromise"},
+    {"stream-car", -1, "primitiveStreamCar"},
+    {"stream-cdr", -1, "primitiveStreamCdr"},
+    {"stream-pair?", -1, "primitiveIsStreamPair"},
+    {"stream-null?", -1, "primitiveIsStreamNull"},
+    {"stream-map", -1, "primitiveStreamMap"},
+    {"stream-filter", -1, "primitiveStreamFilter"},
+    {"stream-take", -1, "primitiveStreamTake"},
+    {"stream-ref", -1, "primitiveStreamRef"},
+    {"stream->list", -1, "primitiveStreamToList"},
+    {"list->stream", -1, "primitiveListToStream"},
+    {"memoize", -1, "primitiveMemoize"},
+    {"memoized?", -1, "primitiveIsMemoized"},
+    {"memoize-hits", -1, "primitiveMemoizeHits"},
+    {"memoize-misses", -1, "primitiveMemoizeMisses"},
+    {"memoize-size", -1, "primitiveMemoizeSize"},
+    {"memoize-clear!", -1, "primitiveMemoizeClear"},
+    {"make-weak-box", -1, "primitiveMakeWeakBox"},
+    {"weak-box?", -1, "primitiveIsWeakBox"},
+    {"weak-box-value", -1, "primitiveWeakBoxValue"},
+    {"weak-box-broken?", -1, "primitiveIsBroken"},
+    {"make-ephemeron", -1, "primitiveMakeEphemeron"},
+    {"ephemeron?", -1, "primitiveIsEphemeron"},
+    {"ephemeron-key", -1, "primitiveEphemeronKey"},
+    {"ephemeron-datum", -1, "primitiveEphemeronDatum"},
+    {"ephemeron-broken?", -1, "primitiveIsBroken"},
+    {"collect-garbage", -1, "primitiveCollectGarbage"},
+    {"bytevector?", -1, "primitiveIsBytevector"},
+    {"make-bytevector", -1, "primitiveMakeBytevector"},
+    {"bytevector", -1, "primitiveBytevector"},
+    {"bytevector-length", -1, "primitiveBytevectorLength"},
+    {"bytevector-u8-ref", -1, "primitiveBytevectorU8Ref"},
+    {"bytevector-u8-set!", -1, "primitiveBytevectorU8Set"},
+    {"bytevector-u16-ref", -1, "primitiveBytevectorU16Ref"},
+    {"bytevector-u16-set!", -1, "primitiveBytevectorU16Set"},
+    {"bytevector-s16-ref", -1, "primitiveBytevectorS16Ref"},
+    {"bytevector-s16-set!", -1, "primitiveBytevectorS16Set"},
+    {"bytevector-u32-ref", -1, "primitiveBytevectorU32Ref"},
+    {"bytevector-u32-set!", -1, "primitiveBytevectorU32Set"},
+    {"bytevector-s32-ref", -1, "primitiveBytevectorS32Ref"},
+    {"bytevector-s32-set!", -1, "primitiveBytevectorS32Set"},
+    {"bytevector-u64-ref", -1, "primitiveBytevectorU64Ref"},
+    {"bytevector-u64-set!", -1, "primitiveBytevectorU64Set"},
+    {"bytevector-s64-ref", -1, "primitiveBytevectorS64Ref"},
+    {"bytevector-s64-set!", -1, "primitiveBytevectorS64Set"},
+    {"bytevector-copy", -1, "primitiveBytevectorCopy"},
+    {"bytevector-copy!", -1, "primitiveBytevectorCopyInto"},
+    {"bytevector-append", -1, "primitiveBytevectorAppend"},
+    {"bytevector-slice", -1, "primitiveBytevectorSlice"},
+    {"file->bytevector", -1, "primitiveFileToBytevector"},
+    {"utf8->string", -1, "primitiveUtf8ToString"},
+    {"string->utf8", -1, "primitiveStringToUtf8"},
+    {"string?", -1, "primitiveIsString"},
+    {"make-string", -1, "primitiveMakeString"},
+    {"string", -1, "primitiveString"},
+    {"string-length", -1, "primitiveStringLength"},
+    {"string-ref", -1, "primitiveStringRef"},
+    {"string-set!", -1, "primitiveStringSet"},
+    {"substring", -1, "primitiveSubstring"},
+    {"string-append", -1, "primitiveStringAppend"},
+    {"string-copy", -1, "primitiveStringCopy"},
+    {"string=?", -1, "primitiveStringEqual"},
+    {"string<?", -1, "primitiveStringLess"},
+    {"string>?", -1, "primitiveStringGreater"},
+    {"string->number", -1, "primitiveStringToNumber"},
+    {"number->string", -1, "primitiveNumberToString"},
+    {"string->symbol", -1, "primitiveStringToSymbol"},
+    {"symbol->string", -1, "primitiveSymbolToString"},
+    {"string->list", -1, "primitiveStringToList"},
+    {"list->string", -1, "primitiveListToString"},
+    {"char?", -1, "primitiveIsChar"},
+    {"char->integer", -1, "primitiveCharToInteger"},
+    {"integer->char", -1, "primitiveIntegerToChar"},
+    {NULL, 0, NULL}
+};
+
+/* A procedure made by a define-record-type form the compiler translates,
+ * which calls may reach without looking it up. */
+struct RecordInline {
+    recordProcedureKind kind;
+    char *descriptor;       /* C variable holding the record type */
+    int64_t index;          /* Slot of an accessor or modifier */
+    int64_t *slots;         /* Slots of the constructor's arguments */
+    int count;              /* Number of constructor arguments */
+};
+
+typedef struct RecordInline RecordInline;
+
+static Code *declarations;  /* Constants, global cells and prototypes */
+static Code *constants;     /* Body of the function creating constants */
+static Code *functions;     /* Definitions of the generated functions */
+static HashTable *globals;  /* Global variable names to cell numbers */
+static HashTable *redefined;/* Names the program binds, with counts */
+static HashTable *records;  /* Record procedure names to their slots */
+static HashTable *descriptors;/* Record definitions to their types */
+static bool dynamic;        /* Whether the program loads other files */
+static int counter;         /* Source of unique names */
+
+/*
+ * Helper function to create an empty code buffer.
+ */
+Code *makeCode() {
+    Code *code = talloc(sizeof(Code));
+    if (!code) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    code->capacity = 256;
+    code->size = 0;
+    code->data = talloc(code->capacity);
+    if (!code->data) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    code->data[0] = '\0';
+    return code;
+}
+
+/*
+ * Helper function to append formatted text to a code buffer.
+ */
+void emit(Code *code, char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (code->size + needed + 1 > code->capacity) {
+        while (code->size + needed + 1 > code->capacity) {
+            code->capacity *= 2;
+        }
+        char *data = talloc(code->capacity);
+        if (!data) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        memcpy(data, code->data, code->size + 1);
+        code->data = data;
+    }
+    va_start(args, format);
+    vsnprintf(code->data + code->size, needed + 1, format, args);
+    va_end(args);
+    code->size += needed;
+}
+
+/*
+ * Helper function to remove text from a code buffer.
+ */
+void removeCode(Code *code, int position, int length) {
+    memmove(code->data + position, code->data + position + length,
+            code->size - position - length + 1);
+    code->size -= length;
+}
+
+/*
+ * Helper function to format a string allocated with talloc.
+ */
+char *formatString(char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    char *result = talloc(needed + 1);
+    if (!result) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    va_start(args, format);
+    vsnprintf(result, needed + 1, format, args);
+    va_end(args);
+    return result;
+}
+
+/*
+ * Helper function to create a fresh C identifier.
+ */
+char *freshName(char *prefix) {
+    return formatString("%s%d", prefix, counter++);
+}
+
+/*
+ * Helper function to write a C string literal for the given string.
+ */
+char *quoteString(char *s) {
+    Code *code = makeCode();
+    emit(code, "\"");
+    for (unsigned char *cur = (unsigned char *) s; *cur; cur++) {
+        if (*cur == '"' || *cur == '\\') {
+            emit(code, "\\%c", *cur);
+        } else if (*cur == '\n') {
+            emit(code, "\\n");
+        } else if (*cur == '\t') {
+            emit(code, "\\t");
+        } else if (*cur < ' ' || *cur > '~') {
+            emit(code, "\\%03o", *cur);
+        } else {
+            emit(code, "%c", *cur);
+        }
+    }
+    emit(code, "\"");
+    return code->data;
+}
+
+/*
+ * Helper function to wrap generated C text in a value, so that it can
+ * be kept in a list.
+ */
+Value *textValue(char *text) {
+    Value *value = talloc(sizeof(Value));
+    if (!value) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    value->type = STR_TYPE;
+    value->s = text;
+    return value;
+}
+
+/*
+ * Helper function to test whether an expression is a list starting
+ * with the given symbol.
+ */
+bool isForm(Value *expr, char *name) {
+    return expr->type == CONS_TYPE && car(expr)->type == SYMBOL_TYPE &&
+           !strcmp(car(expr)->s, name);
+}
+
+/*
+ * Helper function to test whether a list is a proper list of
+ * distinct symbols.
+ */
+bool isVariableList(Value *list) {
+    for (Value *cur = list; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (cur->type != CONS_TYPE || car(cur)->type != SYMBOL_TYPE) {
+            return false;
+        }
+        for (Value *next = cdr(cur); next->type == CONS_TYPE; next = cdr(next)) {
+            if (car(next)->type == SYMBOL_TYPE &&
+                !strcmp(car(cur)->s, car(next)->s)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Helper function to find the slot of a field of a record type, given
+ * the names of its fields in slot order.
+ *
+ * Returns the slot, or -1 if the type has no such field.
+ */
+int64_t fieldIndex(Value *fields, Value *field) {
+    int64_t slot = 0;
+    for (Value *cur = fields; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (!strcmp(car(cur)->s, field->s)) {
+            return slot;
+        }
+        slot++;
+    }
+    return -1;
+}
+
+/*
+ * Helper function to find the names of the fields of a define-record-type
+ * form in slot order.
+ */
+Value *recordFields(Value *args) {
+    Value *fields = makeNull();
+    for (Value *cur = cdr(cdr(cdr(args))); cur->type != NULL_TYPE;
+         cur = cdr(cur)) {
+        fields = cons(car(car(cur)), fields);
+    }
+    return reverse(fields);
+}
+
+/*
+ * Helper function to test whether the rest of a define-record-type
+ * form is valid, so that its record type can be made when the program
+ * starts. Invalid forms are left to eval to report.
+ */
+bool isRecordDefinition(Value *args) {
+    if (length(args) < 3 ||
+        car(args)->type != SYMBOL_TYPE ||
+        car(cdr(args))->type != CONS_TYPE ||
+        !isVariableList(car(cdr(args))) ||
+        car(cdr(cdr(args)))->type != SYMBOL_TYPE) {
+        return false;
+    }
+    for (Value *cur = cdr(cdr(cdr(args))); cur->type != NULL_TYPE;
+         cur = cdr(cur)) {
+        Value *spec = car(cur);
+        if (spec->type != CONS_TYPE || length(spec) < 2 || length(spec) > 3) {
+            return false;
+        }
+        for (Value *name = spec; name->type != NULL_TYPE; name = cdr(name)) {
+            if (car(name)->type != SYMBOL_TYPE) {
+                return false;
+            }
+        }
+    }
+    Value *fields = recordFields(args);
+    if (!isVariableList(fields)) {
+        return false;
+    }
+    for (Value *cur = cdr(car(cdr(args))); cur->type != NULL_TYPE;
+         cur = cdr(cur)) {
+        if (fieldIndex(fields, car(cur)) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isCompilable(Value *expr, bool topLevel);
+
+/*
+ * Helper function to test whether every expression of a list can be
+ * compiled. Bodies must not be empty.
+ */
+bool isCompilableList(Value *list, bool topLevel) {
+    if (list->type != CONS_TYPE) {
+        return false;
+    }
+    for (Value *cur = list; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (cur->type != CONS_TYPE || !isCompilable(car(cur), topLevel)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Helper function to check the bindings of a let-like form: a list of
+ * (symbol expression) pairs whose expressions can be compiled.
+ */
+bool isCompilableBindings(Value *bindings, bool distinct) {
+    Value *names = makeNull();
+    for (Value *cur = bindings; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (cur->type != CONS_TYPE) {
+            return false;
+        }
+        Value *binding = car(cur);
+        if (binding->type != CONS_TYPE || length(binding) != 2 ||
+            car(binding)->type != SYMBOL_TYPE ||
+            !isCompilable(car(cdr(binding)), false)) {
+            return false;
+        }
+        names = cons(car(binding), names);
+    }
+    return !distinct || isVariableList(names);
+}
+
+/*
+ * Check whether the compiler can translate an expression. Anything it
+ * cannot, including malformed syntax, is left to the interpreter so
+ * that errors are reported the same way.
+ */
+bool isCompilable(Value *expr, bool topLevel) {
+    switch (expr->type) {
+        case INT_TYPE:
+        case BIGNUM_TYPE:
+        case DOUBLE_TYPE:
+        case STR_TYPE:
+        case CHAR_TYPE:
+        case BOOL_TYPE:
+        case SYMBOL_TYPE:
+        case VECTOR_TYPE:
+            return true;
+        case CONS_TYPE:
+            break;
+        default:
+            return false;
+    }
+    Value *first = car(expr);
+    Value *args = cdr(expr);
+    if (first->type != SYMBOL_TYPE) {
+        return isCompilableList(expr, false);
+    }
+    char *name = first->s;
+    if (!strcmp(name, "quote")) {
+        return length(args) == 1;
+    } else if (!strcmp(name, "if")) {
+        return (length(args) == 2 || length(args) == 3) &&
+               isCompilableList(args, false);
+    } else if (!strcmp(name, "define")) {
+        return topLevel && length(args) == 2 &&
+               car(args)->type == SYMBOL_TYPE &&
+               isCompilable(car(cdr(args)), false);
+    } else if (!strcmp(name, "set!")) {
+        return length(args) == 2 && car(args)->type == SYMBOL_TYPE &&
+               isCompilable(car(cdr(args)), false);
+    } else if (!strcmp(name, "lambda")) {
+        return length(args) >= 2 &&
+               (car(args)->type == SYMBOL_TYPE || isVariableList(car(args))) &&
+               isCompilableList(cdr(args), false);
+    } else if (!strcmp(name, "let")) {
+        if (args->type == CONS_TYPE && car(args)->type == SYMBOL_TYPE) {
+            args = cdr(args);
+        }
+        return args->type == CONS_TYPE &&
+               isCompilableBindings(car(args), true) &&
+               isCompilableList(cdr(args), false);
+    } else if (!strcmp(name, "letrec")) {
+        return args->type == CONS_TYPE &&
+               isCompilableBindings(car(args), true) &&
+               isCompilableList(cdr(args), false);
+    } else if (!strcmp(name, "let*")) {
+        return args->type == CONS_TYPE &&
+               isCompilableBindings(car(args), false) &&
+               isCompilableList(cdr(args), false);
+    } else if (!strcmp(name, "begin")) {
+        return args->type == NULL_TYPE || isCompilableList(args, topLevel);
+    } else if (!strcmp(name, "and") || !strcmp(name, "or")) {
+        return args->type == NULL_TYPE || isCompilableList(args, false);
+    } else if (!strcmp(name, "cond")) {
+        for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+            if (!isCompilableList(car(cur), false)) {
+                return false;
+            }
+            if (isForm(car(cur), "else") && cdr(cur)->type != NULL_TYPE) {
+                return false;
+            }
+            if (length(car(cur)) < 2) {
+                return false;
+            }
+        }
+        return true;
+    } else if (!strcmp(name, "case")) {
+        if (args->type != CONS_TYPE || !isCompilable(car(args), false)) {
+            return false;
+        }
+        for (Value *cur = cdr(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+            Value *clause = car(cur);
+            if (clause->type != CONS_TYPE ||
+                !isCompilableList(cdr(clause), false)) {
+                return false;
+            }
+            Value *data = car(clause);
+            if (data->type == SYMBOL_TYPE && !strcmp(data->s, "else")) {
+                if (cdr(cur)->type != NULL_TYPE) {
+                    return false;
+                }
+            } else if (data->type == CONS_TYPE) {
+                for (; data->type == CONS_TYPE; data = cdr(data));
+                if (data->type != NULL_TYPE) {
+                    return false;
+                }
+            } else if (data->type != NULL_TYPE) {
+                return false;
+            }
+        }
+        return true;
+    } else if (!strcmp(name, "do")) {
+        if (length(args) < 2 || car(cdr(args))->type != CONS_TYPE ||
+            !isCompilableList(car(cdr(args)), false)) {
+            return false;
+        }
+        Value *names = makeNull();
+        for (Value *cur = car(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+            if (cur->type != CONS_TYPE) {
+                return false;
+            }
+            Value *spec = car(cur);
+            if (spec->type != CONS_TYPE || car(spec)->type != SYMBOL_TYPE ||
+                (length(spec) != 2 && length(spec) != 3) ||
+                !isCompilableList(cdr(spec), false)) {
+                return false;
+            }
+            names = cons(car(spec), names);
+        }
+        return isVariableList(names) &&
+               (cdr(cdr(args))->type == NULL_TYPE ||
+                isCompilableList(cdr(cdr(args)), false));
+    } else if (!strcmp(name, "define-record-type")) {
+        return topLevel && isRecordDefinition(args);
+    } else if (!strcmp(name, "load") ||
+               !strcmp(name, "receive") || !strcmp(name, "let-values") ||
+               !strcmp(name, "delay") || !strcmp(name, "delay-force") ||
+               !strcmp(name, "cons-stream") ||
+               !strcmp(name, "define-memoized")) {
+        return false;
+    }
+    return isCompilableList(expr, false);
+}
+
+/*
+ * Helper function to find the C variable caching the binding of a
+ * global variable.
+ */
+char *globalCell(Value *symbol) {
+    intptr_t cell = (intptr_t) hashTableGet(globals, symbol);
+    if (!cell) {
+        cell = globals->size + 1;
+        hashTablePut(globals, symbol, (void *) cell);
+        emit(declarations, "static Value *cell_%d;\n", (int) cell);
+    }
+    return formatString("cell_%d", (int) cell);
+}
+
+/*
+ * Helper function to write code building a constant datum into the
+ * constants function.
+ *
+ * Returns a C expression for the datum.
+ */
+char *buildDatum(Value *datum) {
+    switch (datum->type) {
+        case INT_TYPE:
+            if (datum->i == INT64_MIN) {
+                return formatString("makeInteger(INT64_MIN)");
+            }
+            return formatString("makeInteger(INT64_C(%lld))", (long long) datum->i);
+        case BIGNUM_TYPE:
+            return formatString("parseExactInteger(\"%s\")", exactToString(datum));
+        case DOUBLE_TYPE: {
+            if (isnan(datum->d)) {
+                return formatString("makeDouble(NAN)");
+            } else if (isinf(datum->d)) {
+                return formatString("makeDouble(%sHUGE_VAL)", datum->d < 0 ? "-" : "");
+            }
+            // The shortest form reads back exactly and keeps -0.0
+            char digits[NUMBER_BUFFER_SIZE];
+            formatDouble(datum->d, digits);
+            return formatString("makeDouble(%s)", digits);
+        }
+        case STR_TYPE:
+            return formatString("makeString(%s)", quoteString(datum->str.chars));
+        case CHAR_TYPE:
+            return formatString("makeCharacter(%d)", (int) datum->i);
+        case SYMBOL_TYPE:
+            return formatString("makeSymbol(%s)", quoteString(datum->s));
+        case BOOL_TYPE:
+            return formatString("makeBoolean(%s)",
+                          strcmp(datum->s, "#f") ? "true" : "false");
+        case CONS_TYPE: {
+            char *list = freshName("datum_");
+            emit(constants, "    Value *%s = makeNull();\n", list);
+            for (Value *cur = reverse(datum); cur->type != NULL_TYPE;
+                 cur = cdr(cur)) {
+                char *item = buildDatum(car(cur));
+                emit(constants, "    %s = cons(%s, %s);\n", list, item, list);
+            }
+            return list;
+        }
+        case VECTOR_TYPE: {
+            char *vector = freshName("datum_");
+            emit(constants, "    Value *%s = makeVector(%lld, NULL);\n", vector,
+                 (long long) datum->vec.length);
+            for (int64_t i = 0; i < datum->vec.length; i++) {
+                char *item = buildDatum(datum->vec.items[i]);
+                emit(constants, "    %s->vec.items[%lld] = %s;\n", vector,
+                     (long long) i, item);
+            }
+            return vector;
+        }
+        default:
+            return "makeNull()";
+    }
+}
+
+/*
+ * Helper function to create a constant for the given datum.
+ *
+ * Returns the name of the C variable holding it.
+ */
+char *compileConstant(Value *datum) {
+    char *name = freshName("const_");
+    emit(declarations, "static Value *%s;\n", name);
+    char *value = buildDatum(datum);
+    emit(constants, "    %s = %s;\n", name, value);
+    return name;
+}
+
+/*
+ * Helper function to find the slot of a symbol in a scope.
+ *
+ * Returns the slot number, or 0 if the scope does not bind it.
+ */
+int slotOf(Scope *scope, Value *symbol) {
+    int slot = 1;
+    for (Value *cur = scope->names; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (!strcmp(car(cur)->s, symbol->s)) {
+            return slot;
+        }
+        slot++;
+    }
+    return 0;
+}
+
+/*
+ * Helper function to find the innermost scope binding a symbol.
+ *
+ * Returns the scope, or NULL if the symbol is global.
+ */
+Scope *scopeOf(Value *symbol, Scope *scope) {
+    for (Scope *cur = scope; cur != NULL; cur = cur->parent) {
+        if (slotOf(cur, symbol)) {
+            return cur;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Helper function to create a scope.
+ */
+Scope *makeScope(Value *names, char *var, Scope *parent, int function) {
+    Scope *scope = talloc(sizeof(Scope));
+    if (!scope) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    scope->names = names;
+    scope->var = var;
+    scope->letrec = false;
+    scope->function = function;
+    scope->parent = parent;
+    return scope;
+}
+
+/*
+ * Helper function to find the location of a local variable.
+ *
+ * Returns a C lvalue for its slot, or NULL if the variable is global.
+ */
+char *variableSlot(Value *symbol, Scope *scope) {
+    Scope *local = NULL;
+    int localHops = 0;
+    int hops = 0;
+    for (Scope *cur = scope; cur != NULL; cur = cur->parent) {
+        if (cur->function == scope->function) {
+            local = cur;
+            localHops = hops;
+        }
+        int slot = slotOf(cur, symbol);
+        if (slot) {
+            if (cur->function == scope->function) {
+                return formatString("%s[%d]", cur->var, slot);
+            }
+            // Follow the parent links out of the current function
+            char *path = local->var;
+            for (int i = localHops; i < hops; i++) {
+                path = formatString("((Value **) %s[0])", path);
+            }
+            return formatString("%s[%d]", path, slot);
+        }
+        hops++;
+    }
+    return NULL;
+}
+
+/*
+ * Helper function to write code reading a variable.
+ *
+ * Returns the C variable holding its value.
+ */
+char *compileVariable(Value *symbol, Scope *scope, Code *code) {
+    char *result = freshName("t");
+    char *slot = scope ? variableSlot(symbol, scope) : NULL;
+    if (slot == NULL) {
+        emit(code, "    Value *%s = globalValue(&%s, %s);\n", result,
+             globalCell(symbol), quoteString(symbol->s));
+    } else if (scopeOf(symbol, scope)->letrec) {
+        emit(code, "    Value *%s = boundValue(%s, %s);\n", result, slot,
+             quoteString(symbol->s));
+    } else {
+        emit(code, "    Value *%s = %s;\n", result, slot);
+    }
+    return result;
+}
+
+/*
+ * Helper function to check whether an expression may create a closure
+ * over the environment it runs in.
+ */
+bool mayCapture(Value *expr) {
+    if (expr->type != CONS_TYPE) {
+        return false;
+    }
+    if (isForm(expr, "quote")) {
+        return false;
+    }
+    if (isForm(expr, "lambda") ||
+        (isForm(expr, "let") && cdr(expr)->type == CONS_TYPE &&
+         car(cdr(expr))->type == SYMBOL_TYPE)) {
+        return true;
+    }
+    for (Value *cur = expr; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        if (mayCapture(car(cur))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+char *compileExpr(Value *expr, Scope *scope, Loop *loop, Code *code);
+
+/*
+ * Helper function to check whether the C expression at the start of a
+ * line may have an effect: whether it calls a function other than one
+ * making a constant.
+ */
+bool hasEffect(char *expression) {
+    static char *constants[] = {"makeVoid();\n", "makeBoolean(true);\n",
+                                "makeBoolean(false);\n"};
+    for (int i = 0; i < 3; i++) {
+        if (!strncmp(expression, constants[i], strlen(constants[i]))) {
+            return false;
+        }
+    }
+    char *cur = expression;
+    while (*cur == '_' || isalnum((unsigned char) *cur)) {
+        cur++;
+    }
+    return cur > expression && *cur == '(';
+}
+
+/*
+ * Helper function to check whether the C expression at the start of a
+ * line is just a temporary, and if so return its name.
+ */
+char *temporaryOf(char *expression) {
+    char *cur = expression;
+    if (*cur++ != 't' || !isdigit((unsigned char) *cur)) {
+        return NULL;
+    }
+    while (isdigit((unsigned char) *cur)) {
+        cur++;
+    }
+    if (strncmp(cur, ";\n", 2)) {
+        return NULL;
+    }
+    return formatString("%.*s", (int) (cur - expression), expression);
+}
+
+/*
+ * Helper function to count the places in a code buffer from `start'
+ * on that mention a C identifier.
+ */
+int countMentions(Code *code, int start, char *name) {
+    int count = 0;
+    int length = strlen(name);
+    for (char *cur = strstr(code->data + start, name); cur != NULL;
+         cur = strstr(cur + length, name)) {
+        bool before = cur > code->data &&
+                      (cur[-1] == '_' || isalnum((unsigned char) cur[-1]));
+        bool after = cur[length] == '_' || isalnum((unsigned char) cur[length]);
+        if (!before && !after) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Helper function to check whether a line of generated code declares
+ * or sets the C variable `name'.
+ *
+ * Returns the length of the text before the value it is set to, the
+ * whole line for a bare declaration, or 0 if the line does neither.
+ */
+int settingPrefix(char *line, int length, char *name) {
+    char *declaration = formatString("    Value *%s;\n", name);
+    char *definition = formatString("    Value *%s = ", name);
+    char *assignment = formatString("    %s = ", name);
+    if (length == (int) strlen(declaration) &&
+        !strncmp(line, declaration, length)) {
+        return length;
+    } else if (!strncmp(line, definition, strlen(definition))) {
+        return strlen(definition);
+    } else if (!strncmp(line, assignment, strlen(assignment))) {
+        return strlen(assignment);
+    }
+    return 0;
+}
+
+/*
+ * Helper function to check whether the code written since `start' only
+ * declares or sets the C variable `name', and never reads it.
+ */
+bool isUnread(Code *code, int start, char *name) {
+    int settings = 0;
+    for (int position = start; position < code->size;) {
+        char *line = code->data + position;
+        int length = strchr(line, '\n') + 1 - line;
+        if (settingPrefix(line, length, name)) {
+            settings++;
+        }
+        position += length;
+    }
+    return countMentions(code, start, name) == settings;
+}
+
+/*
+ * Helper function to remove the C variable `name' from the code written
+ * since `start', where nothing reads it. The calls that compute it
+ * become statements, and plain reads are dropped, along with the
+ * temporaries only they read.
+ */
+void discardVariable(Code *code, int start, char *name) {
+    Value *freed = makeNull();
+    for (int position = start; position < code->size;) {
+        char *line = code->data + position;
+        int length = strchr(line, '\n') + 1 - line;
+        int prefix = settingPrefix(line, length, name);
+        if (prefix == 0) {
+            position += length;
+        } else if (prefix < length && hasEffect(line + prefix)) {
+            removeCode(code, position + 4, prefix - 4);
+            position += length - prefix + 4;
+        } else {
+            char *temporary = prefix < length ? temporaryOf(line + prefix)
+                                              : NULL;
+            if (temporary != NULL) {
+                freed = cons(textValue(temporary), freed);
+            }
+            removeCode(code, position, length);
+        }
+    }
+    for (Value *cur = freed; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (isUnread(code, start, car(cur)->s)) {
+            discardVariable(code, start, car(cur)->s);
+        }
+    }
+}
+
+/*
+ * Helper function to compile an expression whose value is not used,
+ * without declaring the C variable that would hold the value.
+ */
+void compileEffect(Value *expr, Scope *scope, Code *code) {
+    int start = code->size;
+    char *result = compileExpr(expr, scope, NULL, code);
+    discardVariable(code, start, result);
+}
+
+/*
+ * Helper function to compile a body, the last expression of which is
+ * in tail position.
+ *
+ * Returns the C variable holding the value of the last expression.
+ */
+char *compileBody(Value *body, Scope *scope, Loop *loop, Code *code) {
+    while (cdr(body)->type != NULL_TYPE) {
+        compileEffect(car(body), scope, code);
+        body = cdr(body);
+    }
+    return compileExpr(car(body), scope, loop, code);
+}
+
+/*
+ * Helper function to drop a loop when a scope shadows its name.
+ */
+Loop *loopInside(Loop *loop, Value *names) {
+    if (loop == NULL || loop->name == NULL) {
+        return loop;
+    }
+    for (Value *cur = names; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (!strcmp(car(cur)->s, loop->name->s)) {
+            return NULL;
+        }
+    }
+    return loop;
+}
+
+/*
+ * Helper function to write code creating an environment for a new
+ * scope inside the current function.
+ */
+Scope *openScope(Value *names, Scope *scope, Code *code, int function) {
+    char *var = freshName("e");
+    emit(code, "    Value **%s = makeEnv(%s, %d);\n", var,
+         scope ? scope->var : "NULL", length(names));
+    return makeScope(names, var, scope, function);
+}
+
+/*
+ * Helper function to compile a procedure into its own C function.
+ *
+ * Returns the name of the C function.
+ */
+char *compileProcedure(Value *formals, Value *body, Scope *scope) {
+    int function = counter++;
+    char *name = formatString("lambda_%d", function);
+    emit(declarations, "static Value *%s(int argc, Value **argv, "
+         "Value **env);\n", name);
+    Code *code = makeCode();
+    emit(code, "static Value *%s(int argc, Value **argv, Value **env) {\n",
+         name);
+    Scope *inner;
+    if (formals->type == NULL_TYPE) {
+        // With nothing to bind, the body runs in the closure's environment
+        emit(code, "    checkClosureArity(0, argc);\n");
+        emit(code, "    (void) argv;\n    (void) env;\n");
+        if (scope == NULL) {
+            inner = NULL;
+        } else {
+            inner = makeScope(scope->names, "env", scope->parent, function);
+            inner->letrec = scope->letrec;
+        }
+        char *result = compileBody(body, inner, NULL, code);
+        emit(code, "    return %s;\n}\n\n", result);
+        emit(functions, "%s", code->data);
+        return name;
+    }
+    char *var = freshName("e");
+    Value *names;
+    if (formals->type == SYMBOL_TYPE) {
+        names = cons(formals, makeNull());
+        emit(code, "    Value **%s = makeEnv(env, 1);\n", var);
+        emit(code, "    %s[1] = listOfValues(argc, argv);\n", var);
+    } else {
+        names = formals;
+        emit(code, "    checkClosureArity(%d, argc);\n", length(formals));
+        emit(code, "    Value **%s = makeEnv(env, %d);\n", var, length(formals));
+        for (int i = 0; i < length(formals); i++) {
+            emit(code, "    %s[%d] = argv[%d];\n", var, i + 1, i);
+        }
+    }
+    inner = makeScope(names, var, scope, function);
+    char *result = compileBody(body, inner, NULL, code);
+    emit(code, "    return %s;\n}\n\n", result);
+    emit(functions, "%s", code->data);
+    return name;
+}
+
+/*
+ * Helper function to compile a named LET. The loop name is bound to a
+ * compiled procedure for ordinary calls, while tail calls in the body
+ * jump back to the top of the loop.
+ */
+char *compileNamedLet(Value *args, Scope *scope, Code *code) {
+    Value *name = car(args);
+    Value *bindings = car(cdr(args));
+    Value *body = cdr(cdr(args));
+    Value *vars = makeNull();
+    Value *inits = makeNull();
+    for (Value *cur = bindings; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        vars = cons(car(car(cur)), vars);
+        inits = cons(textValue(compileExpr(car(cdr(car(cur))), scope, NULL, code)),
+                     inits);
+    }
+    vars = reverse(vars);
+    inits = reverse(inits);
+    int function = scope ? scope->function : -1;
+    Scope *nameScope = openScope(cons(name, makeNull()), scope, code, function);
+    char *procedure = compileProcedure(vars, body, nameScope);
+    emit(code, "    %s[1] = makeCompiled(%s, %s);\n", nameScope->var,
+         procedure, nameScope->var);
+    Scope *varScope = openScope(vars, nameScope, code, function);
+    int slot = 1;
+    for (Value *cur = inits; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        emit(code, "    %s[%d] = %s;\n", varScope->var, slot++, car(cur)->s);
+    }
+    Loop *inner = talloc(sizeof(Loop));
+    if (!inner) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    inner->name = name;
+    inner->nameScope = nameScope;
+    inner->scope = varScope;
+    inner->label = counter++;
+    inner->inPlace = !mayCapture(body);
+    char *result = freshName("t");
+    emit(code, "    Value *%s;\n", result);
+    int label = code->size;
+    emit(code, "loop_%d: ;\n", inner->label);
+    int labelLength = code->size - label;
+    char *value = compileBody(body, varScope, inner, code);
+    emit(code, "    %s = %s;\n", result, value);
+    // Drop the label if the body never loops back to it
+    char *jump = formatString("goto loop_%d;", inner->label);
+    if (!strstr(code->data + label, jump)) {
+        removeCode(code, label, labelLength);
+    }
+    return result;
+}
+
+/*
+ * Helper function to write the code that rebinds the variables of a
+ * loop and jumps back to its top. `values' holds the C variables with
+ * the new values, NULL for variables that keep their value.
+ */
+void emitLoopJump(Loop *loop, char **values, int count, Code *code) {
+    if (!loop->inPlace) {
+        emit(code, "    %s = copyEnv(%s, %d);\n", loop->scope->var,
+             loop->scope->var, count);
+    }
+    for (int i = 0; i < count; i++) {
+        if (values[i] != NULL) {
+            emit(code, "    %s[%d] = %s;\n", loop->scope->var, i + 1, values[i]);
+        }
+    }
+    emit(code, "    goto loop_%d;\n", loop->label);
+}
+
+/*
+ * Helper function to compile a DO loop.
+ */
+char *compileDo(Value *args, Scope *scope, Code *code) {
+    Value *vars = makeNull();
+    Value *inits = makeNull();
+    for (Value *cur = car(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        vars = cons(car(car(cur)), vars);
+        inits = cons(textValue(compileExpr(car(cdr(car(cur))), scope, NULL, code)),
+                     inits);
+    }
+    vars = reverse(vars);
+    inits = reverse(inits);
+    int function = scope ? scope->function : -1;
+    Scope *varScope = openScope(vars, scope, code, function);
+    int slot = 1;
+    for (Value *cur = inits; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        emit(code, "    %s[%d] = %s;\n", varScope->var, slot++, car(cur)->s);
+    }
+    Loop loop;
+    loop.name = NULL;
+    loop.nameScope = NULL;
+    loop.scope = varScope;
+    loop.label = counter++;
+    loop.inPlace = !mayCapture(args);
+    char *result = freshName("t");
+    emit(code, "    Value *%s;\n", result);
+    emit(code, "loop_%d: ;\n", loop.label);
+    Value *clause = car(cdr(args));
+    char *test = compileExpr(car(clause), varScope, NULL, code);
+    emit(code, "    if (isTrue(%s)) {\n", test);
+    if (cdr(clause)->type == NULL_TYPE) {
+        emit(code, "    %s = makeVoid();\n", result);
+    } else {
+        char *value = compileBody(cdr(clause), varScope, NULL, code);
+        emit(code, "    %s = %s;\n", result, value);
+    }
+    emit(code, "    } else {\n");
+    for (Value *cur = cdr(cdr(args)); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        compileEffect(car(cur), varScope, code);
+    }
+    int count = length(vars);
+    char *values[count > 0 ? count : 1];
+    int i = 0;
+    for (Value *cur = car(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *step = cdr(cdr(car(cur)));
+        values[i++] = step->type == NULL_TYPE ? NULL :
+                      compileExpr(car(step), varScope, NULL, code);
+    }
+    emitLoopJump(&loop, values, count, code);
+    emit(code, "    }\n");
+    return result;
+}
+
+/*
+ * Helper function to compile a LET, LET* or LETREC.
+ */
+char *compileLet(char *kind, Value *args, Scope *scope, Loop *loop,
+                 Code *code) {
+    Value *bindings = car(args);
+    Value *body = cdr(args);
+    int function = scope ? scope->function : -1;
+    if (bindings->type == NULL_TYPE) {
+        return compileBody(body, scope, loop, code);
+    }
+    if (!strcmp(kind, "let*")) {
+        Scope *inner = scope;
+        for (Value *cur = bindings; cur->type != NULL_TYPE; cur = cdr(cur)) {
+            Value *names = cons(car(car(cur)), makeNull());
+            char *value = compileExpr(car(cdr(car(cur))), inner, NULL, code);
+            inner = openScope(names, inner, code, function);
+            emit(code, "    %s[1] = %s;\n", inner->var, value);
+            loop = loopInside(loop, names);
+        }
+        return compileBody(body, inner, loop, code);
+    }
+    Value *names = makeNull();
+    for (Value *cur = bindings; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        names = cons(car(car(cur)), names);
+    }
+    names = reverse(names);
+    if (!strcmp(kind, "letrec")) {
+        Scope *inner = openScope(names, scope, code, function);
+        inner->letrec = true;
+        int slot = 1;
+        for (Value *cur = bindings; cur->type != NULL_TYPE; cur = cdr(cur)) {
+            char *value = compileExpr(car(cdr(car(cur))), inner, NULL, code);
+            emit(code, "    %s[%d] = %s;\n", inner->var, slot++, value);
+        }
+        return compileBody(body, inner, loopInside(loop, names), code);
+    }
+    Value *values = makeNull();
+    for (Value *cur = bindings; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        values = cons(textValue(compileExpr(car(cdr(car(cur))), scope, NULL,
+                                            code)), values);
+    }
+    values = reverse(values);
+    Scope *inner = openScope(names, scope, code, function);
+    int slot = 1;
+    for (Value *cur = values; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        emit(code, "    %s[%d] = %s;\n", inner->var, slot++, car(cur)->s);
+    }
+    return compileBody(body, inner, loopInside(loop, names), code);
+}
+
+/*
+ * Helper function to compile a COND expression.
+ */
+char *compileCond(Value *clauses, Scope *scope, Loop *loop, Code *code) {
+    char *result = freshName("t");
+    emit(code, "    Value *%s;\n", result);
+    int open = 0;
+    for (Value *cur = clauses; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *clause = car(cur);
+        if (isForm(clause, "else")) {
+            char *value = compileBody(cdr(clause), scope, loop, code);
+            emit(code, "    %s = %s;\n", result, value);
+            break;
+        }
+        char *test = compileExpr(car(clause), scope, NULL, code);
+        emit(code, "    if (isTrue(%s)) {\n", test);
+        char *value = compileBody(cdr(clause), scope, loop, code);
+        emit(code, "    %s = %s;\n    } else {\n", result, value);
+        open++;
+        if (cdr(cur)->type == NULL_TYPE) {
+            emit(code, "    %s = makeVoid();\n", result);
+        }
+    }
+    if (clauses->type == NULL_TYPE) {
+        emit(code, "    %s = makeVoid();\n", result);
+    }
+    for (int i = 0; i < open; i++) {
+        emit(code, "    }\n");
+    }
+    return result;
+}
+
+/*
+ * Helper function to compile a CASE expression into a switch over the
+ * clause numbers found in a hash table of the data.
+ */
+char *compileCase(Value *args, Scope *scope, Loop *loop, Code *code) {
+    char *key = compileExpr(car(args), scope, NULL, code);
+    char *table = freshName("case_");
+    emit(declarations, "static HashTable *%s;\n", table);
+    emit(constants, "    %s = makeHashTable(%d, hashEqv, isEqv);\n", table,
+         length(cdr(args)));
+    char *result = freshName("t");
+    emit(code, "    Value *%s = NULL;\n", result);
+    emit(code, "    switch ((intptr_t) hashTableGet(%s, %s)) {\n", table, key);
+    int clause = 1;
+    bool hasElse = false;
+    for (Value *cur = cdr(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *data = car(car(cur));
+        if (data->type == SYMBOL_TYPE) {
+            emit(code, "    default: {\n");
+            hasElse = true;
+        } else {
+            for (; data->type != NULL_TYPE; data = cdr(data)) {
+                char *datum = compileConstant(car(data));
+                emit(constants, "    if (!hashTableGet(%s, %s)) {\n", table, datum);
+                emit(constants, "        hashTablePut(%s, %s, (void *) (intptr_t) %d);\n",
+                     table, datum, clause);
+                emit(constants, "    }\n");
+            }
+            emit(code, "    case %d: {\n", clause);
+        }
+        char *value = compileBody(cdr(car(cur)), scope, loop, code);
+        emit(code, "    %s = %s;\n    break;\n    }\n", result, value);
+        clause++;
+    }
+    if (!hasElse) {
+        emit(code, "    default:\n    %s = makeVoid();\n    break;\n", result);
+    }
+    emit(code, "    }\n");
+    return result;
+}
+
+/*
+ * Helper function to compile AND and OR.
+ */
+char *compileLogic(bool isAnd, Value *args, Scope *scope, Loop *loop,
+                   Code *code) {
+    char *result = freshName("t");
+    emit(code, "    Value *%s = makeBoolean(%s);\n", result,
+         isAnd ? "true" : "false");
+    int open = 0;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        bool last = cdr(cur)->type == NULL_TYPE;
+        char *value = compileExpr(car(cur), scope, last ? loop : NULL, code);
+        emit(code, "    %s = %s;\n", result, value);
+        if (!last) {
+            emit(code, "    if (%sisTrue(%s)) {\n", isAnd ? "" : "!", value);
+            open++;
+        }
+    }
+    for (int i = 0; i < open; i++) {
+        emit(code, "    }\n");
+    }
+    return result;
+}
+
+/*
+ * Helper function to find a primitive that can be called directly
+ * with the given number of arguments.
+ */
+struct Inline *findInline(Value *symbol, int count) {
+    if (dynamic || hashTableGet(redefined, symbol)) {
+        return NULL;
+    }
+    for (struct Inline *cur = inlines; cur->name != NULL; cur++) {
+        if (!strcmp(cur->name, symbol->s) &&
+            (cur->arity == -1 || cur->arity == count)) {
+            return cur;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Helper function to find the number of arguments a procedure of a
+ * record type takes.
+ */
+int recordArity(RecordInline *procedure) {
+    switch (procedure->kind) {
+        case RECORD_CONSTRUCTOR:
+            return procedure->count;
+        case RECORD_MODIFIER:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+/*
+ * Helper function to compile a call to a procedure of a record type
+ * into a test of the record's type and a load or store of its slot.
+ */
+char *compileRecordCall(RecordInline *procedure, Value *expr,
+                        Scope *scope, Code *code) {
+    int count = length(cdr(expr));
+    char *values[count > 0 ? count : 1];
+    int i = 0;
+    for (Value *cur = cdr(expr); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        values[i++] = compileExpr(car(cur), scope, NULL, code);
+    }
+    char *result = freshName("t");
+    char *descriptor = procedure->descriptor;
+    switch (procedure->kind) {
+        case RECORD_CONSTRUCTOR:
+            emit(code, "    Value *%s = makeRecord(%s, %d);\n", result,
+                 descriptor, count);
+            for (i = 0; i < count; i++) {
+                emit(code, "    %s->record.slots[%lld] = %s;\n", result,
+                     (long long) procedure->slots[i], values[i]);
+            }
+            return result;
+        case RECORD_PREDICATE:
+            emit(code, "    Value *%s = makeBoolean(%s->type == RECORD_TYPE &&\n"
+                 "        %s->record.descriptor == %s);\n", result, values[0],
+                 values[0], descriptor);
+            return result;
+        default:
+            break;
+    }
+    emit(code, "    if (%s->type != RECORD_TYPE ||\n"
+         "        %s->record.descriptor != %s) {\n"
+         "        recordTypeError(%s);\n    }\n", values[0], values[0],
+         descriptor, quoteString(car(expr)->s));
+    if (procedure->kind == RECORD_ACCESSOR) {
+        emit(code, "    Value *%s = %s->record.slots[%lld];\n", result,
+             values[0], (long long) procedure->index);
+    } else {
+        emit(code, "    %s->record.slots[%lld] = %s;\n", values[0],
+             (long long) procedure->index, values[1]);
+        emit(code, "    Value *%s = makeVoid();\n", result);
+    }
+    return result;
+}
+
+/*
+ * Helper function to compile a procedure call.
+ */
+char *compileApplication(Value *expr, Scope *scope, Loop *loop, Code *code) {
+    Value *first = car(expr);
+    Value *args = cdr(expr);
+    int count = length(args);
+    char *result = freshName("t");
+    // A tail call to the enclosing named let jumps back to its top
+    if (loop != NULL && loop->name != NULL && first->type == SYMBOL_TYPE &&
+        !strcmp(first->s, loop->name->s) &&
+        scopeOf(first, scope) == loop->nameScope &&
+        count == length(loop->scope->names)) {
+        char *values[count > 0 ? count : 1];
+        int i = 0;
+        for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+            values[i++] = compileExpr(car(cur), scope, NULL, code);
+        }
+        emitLoopJump(loop, values, count, code);
+        emit(code, "    Value *%s = NULL;\n", result);
+        return result;
+    }
+    // The procedures of translated record types work on slots in place
+    if (first->type == SYMBOL_TYPE && !dynamic &&
+        (scope == NULL || scopeOf(first, scope) == NULL)) {
+        RecordInline *procedure = hashTableGet(records, first);
+        if (procedure != NULL && recordArity(procedure) == count) {
+            return compileRecordCall(procedure, expr, scope, code);
+        }
+    }
+    // The unmodified primitives are called without a lookup
+    if (first->type == SYMBOL_TYPE &&
+        (scope == NULL || scopeOf(first, scope) == NULL)) {
+        struct Inline *primitive = findInline(first, count);
+        if (primitive != NULL) {
+            char *values[count > 0 ? count : 1];
+            int i = 0;
+            for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+                values[i++] = compileExpr(car(cur), scope, NULL, code);
+            }
+            if (primitive->arity >= 0) {
+                emit(code, "    Value *%s = %s(", result, primitive->function);
+                for (i = 0; i < count; i++) {
+                    emit(code, i == 0 ? "%s" : ", %s", values[i]);
+                }
+                emit(code, ");\n");
+            } else {
+                char *argv = freshName("argv_");
+                emit(code, "    Value *%s[%d];\n", argv, count > 0 ? count : 1);
+                for (i = 0; i < count; i++) {
+                    emit(code, "    %s[%d] = %s;\n", argv, i, values[i]);
+                }
+                emit(code, "    Value *%s = %s(listOfValues(%d, %s));\n", result,
+                     primitive->function, count, argv);
+            }
+            return result;
+        }
+    }
+    char *function = compileExpr(first, scope, NULL, code);
+    char *argv = freshName("argv_");
+    emit(code, "    Value *%s[%d];\n", argv, count > 0 ? count : 1);
+    int i = 0;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        char *value = compileExpr(car(cur), scope, NULL, code);
+        emit(code, "    %s[%d] = %s;\n", argv, i++, value);
+    }
+    emit(code, "    Value *%s = callProcedure(%s, %d, %s);\n", result, function,
+         count, argv);
+    return result;
+}
+
+/*
+ * Write the code evaluating an expression into the given buffer.
+ * `loop' is the loop whose body the expression is in tail position
+ * of, if any.
+ *
+ * Returns a C expression for the value, which is safe to use after
+ * any code emitted later.
+ */
+char *compileExpr(Value *expr, Scope *scope, Loop *loop, Code *code) {
+    switch (expr->type) {
+        case INT_TYPE:
+        case BIGNUM_TYPE:
+        case DOUBLE_TYPE:
+        case STR_TYPE:
+        case CHAR_TYPE:
+        case BOOL_TYPE:
+        case VECTOR_TYPE:
+            return compileConstant(expr);
+        case SYMBOL_TYPE:
+            return compileVariable(expr, scope, code);
+        default:
+            break;
+    }
+    Value *first = car(expr);
+    Value *args = cdr(expr);
+    if (first->type != SYMBOL_TYPE) {
+        return compileApplication(expr, scope, loop, code);
+    }
+    char *name = first->s;
+    char *result;
+    if (!strcmp(name, "quote")) {
+        return compileConstant(car(args));
+    } else if (!strcmp(name, "if")) {
+        char *test = compileExpr(car(args), scope, NULL, code);
+        result = freshName("t");
+        emit(code, "    Value *%s;\n    if (isTrue(%s)) {\n", result, test);
+        char *value = compileExpr(car(cdr(args)), scope, loop, code);
+        emit(code, "    %s = %s;\n    } else {\n", result, value);
+        if (cdr(cdr(args))->type != NULL_TYPE) {
+            value = compileExpr(car(cdr(cdr(args))), scope, loop, code);
+        } else {
+            value = "makeVoid()";
+        }
+        emit(code, "    %s = %s;\n    }\n", result, value);
+        return result;
+    } else if (!strcmp(name, "define")) {
+        char *value = compileExpr(car(cdr(args)), scope, NULL, code);
+        emit(code, "    defineGlobal(&%s, %s, %s);\n", globalCell(car(args)),
+             quoteString(car(args)->s), value);
+        return "makeVoid()";
+    } else if (!strcmp(name, "set!")) {
+        char *value = compileExpr(car(cdr(args)), scope, NULL, code);
+        char *slot = scope ? variableSlot(car(args), scope) : NULL;
+        if (slot == NULL) {
+            emit(code, "    setGlobal(&%s, %s, %s);\n", globalCell(car(args)),
+                 quoteString(car(args)->s), value);
+        } else {
+            emit(code, "    %s = %s;\n", slot, value);
+        }
+        return "makeVoid()";
+    } else if (!strcmp(name, "lambda")) {
+        char *function = compileProcedure(car(args), cdr(args), scope);
+        result = freshName("t");
+        emit(code, "    Value *%s = makeCompiled(%s, %s);\n", result, function,
+             scope ? scope->var : "NULL");
+        return result;
+    } else if (!strcmp(name, "let")) {
+        if (car(args)->type == SYMBOL_TYPE) {
+            return compileNamedLet(args, scope, code);
+        }
+        return compileLet(name, args, scope, loop, code);
+    } else if (!strcmp(name, "let*") || !strcmp(name, "letrec")) {
+        return compileLet(name, args, scope, loop, code);
+    } else if (!strcmp(name, "begin")) {
+        if (args->type == NULL_TYPE) {
+            return "makeVoid()";
+        }
+        return compileBody(args, scope, loop, code);
+    } else if (!strcmp(name, "and")) {
+        return compileLogic(true, args, scope, loop, code);
+    } else if (!strcmp(name, "or")) {
+        return compileLogic(false, args, scope, loop, code);
+    } else if (!strcmp(name, "cond")) {
+        return compileCond(args, scope, loop, code);
+    } else if (!strcmp(name, "case")) {
+        return compileCase(args, scope, loop, code);
+    } else if (!strcmp(name, "do")) {
+        return compileDo(args, scope, code);
+    } else if (!strcmp(name, "define-record-type")) {
+        emit(code, "    bindRecordType(%s, %s, runtimeFrame);\n",
+             compileConstant(args), (char *) hashTableGet(descriptors, args));
+        return "makeVoid()";
+    }
+    return compileApplication(expr, scope, loop, code);
+}
+
+/*
+ * Helper function to count a definition of a name by the program.
+ */
+void markRedefined(Value *symbol) {
+    intptr_t count = (intptr_t) hashTableGet(redefined, symbol);
+    hashTablePut(redefined, symbol, (void *) (count + 1));
+}
+
+/*
+ * Helper function to mark the names the rest of a define-record-type
+ * form binds: the type, its constructor and predicate, and the
+ * accessors and modifiers of its fields.
+ */
+void scanRecordNames(Value *args) {
+    for (int i = 0; i < 3 && args->type == CONS_TYPE; i++) {
+        Value *name = car(args);
+        if (i == 1 && name->type == CONS_TYPE) {
+            name = car(name);
+        }
+        if (name->type == SYMBOL_TYPE) {
+            markRedefined(name);
+        }
+        args = cdr(args);
+    }
+    for (; args->type == CONS_TYPE; args = cdr(args)) {
+        if (car(args)->type != CONS_TYPE) {
+            continue;
+        }
+        for (Value *cur = cdr(car(args)); cur->type == CONS_TYPE;
+             cur = cdr(cur)) {
+            if (car(cur)->type == SYMBOL_TYPE) {
+                markRedefined(car(cur));
+            }
+        }
+    }
+}
+
+/*
+ * Helper function to find the primitives a program rebinds with
+ * define or set!, and whether it loads other files.
+ */
+void scanDefinitions(Value *expr) {
+    if (expr->type != CONS_TYPE || isForm(expr, "quote")) {
+        return;
+    }
+    if ((isForm(expr, "define") || isForm(expr, "set!")) &&
+        cdr(expr)->type == CONS_TYPE && car(cdr(expr))->type == SYMBOL_TYPE) {
+        markRedefined(car(cdr(expr)));
+    }
+    if (isForm(expr, "define-record-type")) {
+        scanRecordNames(cdr(expr));
+    }
+    if (isForm(expr, "define-memoized")) {
+        Value *rest = cdr(expr);
+        if (rest->type == CONS_TYPE && car(rest)->type == INT_TYPE) {
+            rest = cdr(rest);
+        }
+        if (rest->type == CONS_TYPE && car(rest)->type == CONS_TYPE &&
+            car(car(rest))->type == SYMBOL_TYPE) {
+            markRedefined(car(car(rest)));
+        }
+    }
+    if (isForm(expr, "load")) {
+        dynamic = true;
+    }
+    for (Value *cur = expr; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        scanDefinitions(car(cur));
+    }
+}
+
+/*
+ * Helper function to note a procedure of a record type the program
+ * defines, unless the program binds its name anywhere else.
+ *
+ * Returns the procedure, or NULL if calls must look the name up.
+ */
+RecordInline *addRecordProcedure(Value *name, recordProcedureKind kind,
+                        char *descriptor, int64_t index) {
+    if ((intptr_t) hashTableGet(redefined, name) != 1) {
+        return NULL;
+    }
+    RecordInline *procedure = talloc(sizeof(RecordInline));
+    if (!procedure) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    procedure->kind = kind;
+    procedure->descriptor = descriptor;
+    procedure->index = index;
+    procedure->slots = NULL;
+    procedure->count = 0;
+    hashTablePut(records, name, procedure);
+    return procedure;
+}
+
+/*
+ * Helper function to make the record types of the define-record-type
+ * forms at the top level of a translated form when the program starts,
+ * and note the procedures they define.
+ */
+void scanRecordTypes(Value *form) {
+    if (isForm(form, "begin")) {
+        for (Value *cur = cdr(form); cur->type != NULL_TYPE; cur = cdr(cur)) {
+            scanRecordTypes(car(cur));
+        }
+        return;
+    }
+    if (!isForm(form, "define-record-type")) {
+        return;
+    }
+    Value *args = cdr(form);
+    char *descriptor = freshName("rtd_");
+    emit(declarations, "static Value *%s;\n", descriptor);
+    emit(constants, "    %s = makeRecordType(%s);\n", descriptor,
+         compileConstant(args));
+    hashTablePut(descriptors, args, descriptor);
+    Value *fields = recordFields(args);
+    Value *spec = car(cdr(args));
+    RecordInline *constructor =
+        addRecordProcedure(car(spec), RECORD_CONSTRUCTOR, descriptor, 0);
+    if (constructor != NULL) {
+        constructor->count = length(cdr(spec));
+        constructor->slots = talloc(sizeof(int64_t) *
+                                    (constructor->count > 0 ?
+                                     constructor->count : 1));
+        if (!constructor->slots) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        int i = 0;
+        for (Value *cur = cdr(spec); cur->type != NULL_TYPE; cur = cdr(cur)) {
+            constructor->slots[i++] = fieldIndex(fields, car(cur));
+        }
+    }
+    addRecordProcedure(car(cdr(cdr(args))), RECORD_PREDICATE, descriptor, 0);
+    int64_t slot = 0;
+    for (Value *cur = cdr(cdr(cdr(args))); cur->type != NULL_TYPE;
+         cur = cdr(cur)) {
+        spec = cdr(car(cur));
+        addRecordProcedure(car(spec), RECORD_ACCESSOR, descriptor, slot);
+        if (cdr(spec)->type != NULL_TYPE) {
+            addRecordProcedure(car(cdr(spec)), RECORD_MODIFIER, descriptor,
+                               slot);
+        }
+        slot++;
+    }
+}
+
+/*
+ * Translate the parse tree of a program into a C program written to
+ * the given stream. `source' is the name of the Scheme file, used in
+ * the generated comments.
+ *
+ * Top-level forms the compiler cannot translate are embedded as data
+ * and handed to eval when the generated program runs.
+ */
+void compileProgram(Value *tree, char *source, FILE *out) {
+    declarations = makeCode();
+    constants = makeCode();
+    functions = makeCode();
+    globals = makeHashTable(16, hashEqv, isEqv);
+    redefined = makeHashTable(16, hashEqv, isEqv);
+    records = makeHashTable(16, hashEqv, isEqv);
+    descriptors = makeHashTable(16, hashPointer, isSamePointer);
+    dynamic = false;
+    counter = 0;
+    for (Value *cur = tree; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        cur->c.car = expandMacros(car(cur));
+        scanDefinitions(car(cur));
+    }
+    for (Value *cur = tree; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (isCompilable(car(cur), true)) {
+            scanRecordTypes(car(cur));
+        }
+    }
+    Value *entries = makeNull();
+    for (Value *cur = tree; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *form = car(cur);
+        char *name = freshName("toplevel_");
+        emit(declarations, "static Value *%s();\n", name);
+        Code *code = makeCode();
+        // Each form runs in a frame of its own, so that collect-garbage
+        // does not find the temporaries of the forms before it in main's
+        emit(code, "static __attribute__((noinline)) Value *%s() {\n", name);
+        char *result;
+        if (isCompilable(form, true)) {
+            result = compileExpr(form, NULL, NULL, code);
+        } else {
+            result = formatString("eval(%s, runtimeFrame)", compileConstant(form));
+        }
+        emit(code, "    return %s;\n}\n\n", result);
+        emit(functions, "%s", code->data);
+        entries = cons(textValue(name), entries);
+    }
+    fprintf(out, "/*\n * Translated from %s by the Scheme compiler.\n", source);
+    fprintf(out, " * Build it against the interpreter's objects with make.\n */\n");
+    fprintf(out, "#include <stdint.h>\n");
+    fprintf(out, "#include <math.h>\n");
+    fprintf(out, "#include \"value.h\"\n");
+    fprintf(out, "#include \"linkedlist.h\"\n");
+    fprintf(out, "#include \"talloc.h\"\n");
+    fprintf(out, "#include \"hashtable.h\"\n");
+    fprintf(out, "#include \"bignum.h\"\n");
+    fprintf(out, "#include \"lists.h\"\n");
+    fprintf(out, "#include \"fixflo.h\"\n");
+    fprintf(out, "#include \"vector.h\"\n");
+    fprintf(out, "#include \"bytevector.h\"\n");
+    fprintf(out, "#include \"dictionary.h\"\n");
+    fprintf(out, "#include \"hamt.h\"\n");
+    fprintf(out, "#include \"sort.h\"\n");
+    fprintf(out, "#include \"record.h\"\n");
+    fprintf(out, "#include \"values.h\"\n");
+    fprintf(out, "#include \"promise.h\"\n");
+    fprintf(out, "#include \"memo.h\"\n");
+    fprintf(out, "#include \"weak.h\"\n");
+    fprintf(out, "#include \"text.h\"\n");
+    fprintf(out, "#include \"interpreter.h\"\n");
+    fprintf(out, "#include \"runtime.h\"\n\n");
+    fprintf(out, "%s\n", declarations->data);
+    fprintf(out, "static void initConstants() {\n%s}\n\n", constants->data);
+    fprintf(out, "%s", functions->data);
+    fprintf(out, "int main(void) {\n");
+    fprintf(out, "    startRuntime();\n");
+    fprintf(out, "    initConstants();\n");
+    for (Value *cur = reverse(entries); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        fprintf(out, "    printResult(%s());\n", car(cur)->s);
+    }
+    fprintf(out, "    tfree();\n");
+    fprintf(out, "    return 0;\n}\n");
+}
@@ -0,0 +1,21 @@
+/*
+ * This program implements a compiler that translates a Scheme program
+ * into C code linked against the interpreter's runtime.
+ */
+#include <stdio.h>
+#include "value.h"
+
+#ifndef COMPILER_H
+#define COMPILER_H
+
+/*
+ * Translate the parse tree of a program into a C program written to
+ * the given stream. `source' is the name of the Scheme file, used in
+ * the generated comments.
+ *
+ * Top-level forms the compiler cannot translate are embedded as data
+ * and handed to eval when the generated program runs.
+ */
+void compileProgram(Value *tree, char *source, FILE *out);
+
+#endif
@@ -0,0 +1,584 @@
+/*
+ * This program implements the hash tables of SRFI 69. A table made
+ * with equal?, eqv?, or eq? hashes and compares its keys in C; one
+ * made with any other equality procedure, or given its own hash
+ * procedure, calls them back for each probe.
+ */
+#include <stdio.h>
+#include "dictionary.h"
+#include "hashtable.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "bignum.h"
+#include "talloc.h"
+#include "runtime.h"
+#include "weak.h"
+
+/* The table whose own procedures the callbacks below call. Saved and
+ * restored around each operation, since a procedure may itself use
+ * another table. */
+static Value *currentTable;
+
+/*
+ * Helper function to check that an argument is a hash table.
+ */
+Value *dictionaryArgument(char *name, Value *value) {
+    if (value->type != HASHTABLE_TYPE) {
+        primitiveError(name, "expects a hash table as input");
+    }
+    return value;
+}
+
+/*
+ * Helper function to check that an argument is a procedure.
+ */
+Value *procedureArgument(char *name, Value *value) {
+    if (value->type != PRIMITIVE_TYPE && value->type != CLOSURE_TYPE &&
+        value->type != COMPILED_TYPE && value->type != RECORD_PROCEDURE_TYPE &&
+        value->type != MEMOIZED_TYPE) {
+        primitiveError(name, "expects a procedure as input");
+    }
+    return value;
+}
+
+/*
+ * Helper function to call a procedure with a list of arguments.
+ */
+Value *callWith(Value *function, Value *args) {
+    return apply(function, args);
+}
+
+/*
+ * Helper function to hash a key with the current table's hash
+ * procedure.
+ */
+unsigned long hashCustom(Value *key) {
+    Value *hash = callWith(currentTable->dict->hash, cons(key, makeNull()));
+    if (!isExactInteger(hash)) {
+        primitiveError("hash-table",
+                       "hash procedure must return an exact integer");
+    }
+    return hashEqv(hash);
+}
+
+/*
+ * Helper function to compare two keys with the current table's
+ * equality procedure.
+ */
+bool isCustomEqual(Value *first, Value *second) {
+    Value *args = cons(first, cons(second, makeNull()));
+    return isTrue(callWith(currentTable->dict->equality, args));
+}
+
+/*
+ * Helper function to find the C hash function behind one of the
+ * built-in hash procedures, or NULL.
+ */
+unsigned long (*builtinHash(Value *procedure))(Value *) {
+    if (procedure->type != PRIMITIVE_TYPE) {
+        return NULL;
+    } else if (procedure->pf == primitiveHash ||
+               procedure->pf == primitiveEqualHash) {
+        return hashEqual;
+    } else if (procedure->pf == primitiveHashByIdentity ||
+               procedure->pf == primitiveStringHash) {
+        return hashEqv;
+    }
+    return NULL;
+}
+
+/*
+ * Helper function to create an empty hash table. `equality' and `hash'
+ * are the procedures to use, or NULL for equal? and its hash.
+ */
+Value *makeDictionary(Value *equality, Value *hash, int capacity) {
+    // The fields of the table follow the value in one block
+    Value *table = talloc(sizeof(Value) + sizeof(struct SchemeHashTable));
+    if (!table) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    bool (*equals)(Value *, Value *) = isEqual;
+    unsigned long (*hashFunction)(Value *) = hashEqual;
+    if (equality != NULL && equality->type == PRIMITIVE_TYPE &&
+        (equality->pf == primitiveIsEq || equality->pf == primitiveIsEqv)) {
+        // eq? compares numbers and strings by content, as isEqv does
+        equals = isEqv;
+        hashFunction = hashEqv;
+        equality = NULL;
+    } else if (equality != NULL && equality->type == PRIMITIVE_TYPE &&
+               equality->pf == primitiveIsEqual) {
+        equality = NULL;
+    } else if (equality != NULL) {
+        equals = isCustomEqual;
+    }
+    if (hash != NULL && builtinHash(hash)) {
+        hashFunction = builtinHash(hash);
+        hash = NULL;
+    } else if (hash != NULL) {
+        hashFunction = hashCustom;
+    }
+    table->type = HASHTABLE_TYPE;
+    table->dict = (struct SchemeHashTable *) (table + 1);
+    table->dict->table = makeHashTable(capacity, hashFunction, equals);
+    table->dict->equality = equality;
+    table->dict->hash = hash;
+    table->dict->weakness = WEAK_NONE;
+    return table;
+}
+
+/*
+ * Helper functions to look up, store, and remove a key, with the
+ * table's own procedures available to the callbacks.
+ */
+Value *dictionaryGet(Value *table, Value *key) {
+    Value *previous = currentTable;
+    currentTable = table;
+    Value *value = hashTableGet(table->dict->table, key);
+    currentTable = previous;
+    return value;
+}
+
+void dictionaryPut(Value *table, Value *key, Value *value) {
+    Value *previous = currentTable;
+    currentTable = table;
+    hashTablePut(table->dict->table, key, value);
+    currentTable = previous;
+}
+
+void dictionaryDelete(Value *table, Value *key) {
+    Value *previous = currentTable;
+    currentTable = table;
+    hashTableDelete(table->dict->table, key);
+    currentTable = previous;
+}
+
+/*
+ * Helper function to list the entries of a table as (key . value)
+ * pairs. Procedures walking a table go over this list, so that they
+ * may change the table as they go.
+ */
+Value *dictionaryEntries(Value *table) {
+    Value *entries = makeNull();
+    int position = 0;
+    Value *key;
+    void *value;
+    while (hashTableNext(table->dict->table, &position, &key, &value)) {
+        entries = cons(cons(key, value), entries);
+    }
+    return entries;
+}
+
+/*
+ * Look up, store, and test for a key, for the interpreter and for
+ * compiled programs to call directly.
+ */
+Value *dictionaryRefDefault(Value *table, Value *key, Value *fallback) {
+    dictionaryArgument("hash-table-ref/default", table);
+    Value *value = dictionaryGet(table, key);
+    return value ? value : fallback;
+}
+
+Value *dictionarySet(Value *table, Value *key, Value *value) {
+    dictionaryArgument("hash-table-set!", table);
+    dictionaryPut(table, key, value);
+    return makeVoid();
+}
+
+Value *dictionaryContains(Value *table, Value *key) {
+    dictionaryArgument("hash-table-contains?", table);
+    return makeBoolean(dictionaryGet(table, key) != NULL);
+}
+
+/*
+ * Print a hash table.
+ */
+void displayDictionary(void) {
+    printf("#hash-table");
+}
+
+/*
+ * Implementing the Scheme primitive make-hash-table.
+ */
+Value *primitiveMakeHashTable(Value *args) {
+    checkArity(args, 0, 2);
+    Value *equality = NULL;
+    Value *hash = NULL;
+    if (args->type == CONS_TYPE) {
+        equality = procedureArgument("make-hash-table", car(args));
+        if (cdr(args)->type == CONS_TYPE) {
+            hash = procedureArgument("make-hash-table", car(cdr(args)));
+        }
+    }
+    return makeDictionary(equality, hash, 8);
+}
+
+/*
+ * Helper function to make a hash table that holds its keys or its
+ * values weakly, taking the arguments of make-hash-table.
+ */
+Value *makeWeakDictionary(char *name, Value *args,
+                          hashTableWeakness weakness) {
+    checkArity(args, 0, 2);
+    Value *equality = NULL;
+    Value *hash = NULL;
+    if (args->type == CONS_TYPE) {
+        equality = procedureArgument(name, car(args));
+        if (cdr(args)->type == CONS_TYPE) {
+            hash = procedureArgument(name, car(cdr(args)));
+        }
+    }
+    Value *table = makeDictionary(equality, hash, 8);
+    table->dict->weakness = weakness;
+    registerWeakTable(table);
+    return table;
+}
+
+/*
+ * Implementing the Scheme primitives make-weak-key-hash-table and
+ * make-weak-value-hash-table.
+ */
+Value *primitiveMakeWeakKeyHashTable(Value *args) {
+    return makeWeakDictionary("make-weak-key-hash-table", args, WEAK_KEYS);
+}
+
+Value *primitiveMakeWeakValueHashTable(Value *args) {
+    return makeWeakDictionary("make-weak-value-hash-table", args,
+                              WEAK_VALUES);
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-weakness, which returns
+ * weak-keys, weak-values, or #f.
+ */
+Value *primitiveHashTableWeakness(Value *args) {
+    checkArity(args, 1, 1);
+    Value *table = dictionaryArgument("hash-table-weakness", car(args));
+    if (table->dict->weakness == WEAK_KEYS) {
+        return makeSymbol("weak-keys");
+    } else if (table->dict->weakness == WEAK_VALUES) {
+        return makeSymbol("weak-values");
+    }
+    return makeBoolean(false);
+}
+
+/*
+ * The entries are listed first, so that deleting does not disturb the
+ * walk. A table with equality or hash procedures of its own calls them
+ * on the dead keys as it deletes them.
+ */
+void sweepWeakDictionary(Value *table, bool (*isLive)(Value *)) {
+    for (Value *cur = dictionaryEntries(table); cur->type != NULL_TYPE;
+         cur = cdr(cur)) {
+        Value *key = car(car(cur));
+        Value *value = cdr(car(cur));
+        if ((table->dict->weakness == WEAK_KEYS && !isLive(key)) ||
+            (table->dict->weakness == WEAK_VALUES && !isLive(value))) {
+            dictionaryDelete(table, key);
+        }
+    }
+}
+
+/*
+ * Implementing the Scheme primitive hash-table?.
+ */
+Value *primitiveIsHashTable(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == HASHTABLE_TYPE);
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-ref. A missing key calls
+ * the optional failure thunk, or is an error; a present one is passed
+ * to the optional success procedure.
+ */
+Value *primitiveHashTableRef(Value *args) {
+    checkArity(args, 2, 4);
+    Value *table = dictionaryArgument("hash-table-ref", car(args));
+    Value *rest = cdr(cdr(args));
+    Value *value = dictionaryGet(table, car(cdr(args)));
+    if (!value) {
+        if (rest->type == NULL_TYPE) {
+            primitiveError("hash-table-ref", "key not found");
+        }
+        return callWith(procedureArgument("hash-table-ref", car(rest)), makeNull());
+    }
+    if (rest->type == CONS_TYPE && cdr(rest)->type == CONS_TYPE) {
+        Value *success = procedureArgument("hash-table-ref", car(cdr(rest)));
+        return callWith(success, cons(value, makeNull()));
+    }
+    return value;
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-ref/default.
+ */
+Value *primitiveHashTableRefDefault(Value *args) {
+    checkArity(args, 3, 3);
+    return dictionaryRefDefault(car(args), car(cdr(args)), car(cdr(cdr(args))));
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-set!.
+ */
+Value *primitiveHashTableSet(Value *args) {
+    checkArity(args, 3, 3);
+    return dictionarySet(car(args), car(cdr(args)), car(cdr(cdr(args))));
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-delete!.
+ */
+Value *primitiveHashTableDelete(Value *args) {
+    checkArity(args, 2, 2);
+    dictionaryDelete(dictionaryArgument("hash-table-delete!", car(args)),
+                     car(cdr(args)));
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitives hash-table-exists? and
+ * hash-table-contains?.
+ */
+Value *primitiveHashTableContains(Value *args) {
+    checkArity(args, 2, 2);
+    return dictionaryContains(car(args), car(cdr(args)));
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-update!, which stores
+ * the result of a procedure on the value of a key. A missing key calls
+ * the optional failure thunk for the value, or is an error.
+ */
+Value *primitiveHashTableUpdate(Value *args) {
+    checkArity(args, 3, 4);
+    Value *table = dictionaryArgument("hash-table-update!", car(args));
+    Value *key = car(cdr(args));
+    Value *update = procedureArgument("hash-table-update!", car(cdr(cdr(args))));
+    Value *value = dictionaryGet(table, key);
+    if (!value) {
+        Value *rest = cdr(cdr(cdr(args)));
+        if (rest->type == NULL_TYPE) {
+            primitiveError("hash-table-update!", "key not found");
+        }
+        value = callWith(procedureArgument("hash-table-update!", car(rest)),
+                         makeNull());
+    }
+    dictionaryPut(table, key, callWith(update, cons(value, makeNull())));
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-update!/default.
+ */
+Value *primitiveHashTableUpdateDefault(Value *args) {
+    checkArity(args, 4, 4);
+    Value *table = dictionaryArgument("hash-table-update!/default", car(args));
+    Value *key = car(cdr(args));
+    Value *update = procedureArgument("hash-table-update!/default",
+                                      car(cdr(cdr(args))));
+    Value *value = dictionaryGet(table, key);
+    if (!value) {
+        value = car(cdr(cdr(cdr(args))));
+    }
+    dictionaryPut(table, key, callWith(update, cons(value, makeNull())));
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-size.
+ */
+Value *primitiveHashTableSize(Value *args) {
+    checkArity(args, 1, 1);
+    Value *table = dictionaryArgument("hash-table-size", car(args));
+    return makeInteger(table->dict->table->size);
+}
+
+/*
+ * Implementing the Scheme primitives hash-table-keys and
+ * hash-table-values.
+ */
+Value *primitiveHashTableKeys(Value *args) {
+    checkArity(args, 1, 1);
+    Value *entries = dictionaryEntries(dictionaryArgument("hash-table-keys",
+                                                          car(args)));
+    Value *keys = makeNull();
+    for (Value *cur = entries; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        keys = cons(car(car(cur)), keys);
+    }
+    return keys;
+}
+
+Value *primitiveHashTableValues(Value *args) {
+    checkArity(args, 1, 1);
+    Value *entries = dictionaryEntries(dictionaryArgument("hash-table-values",
+                                                          car(args)));
+    Value *values = makeNull();
+    for (Value *cur = entries; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        values = cons(cdr(car(cur)), values);
+    }
+    return values;
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-walk, which calls a
+ * procedure on each key and its value.
+ */
+Value *primitiveHashTableWalk(Value *args) {
+    checkArity(args, 2, 2);
+    Value *entries = dictionaryEntries(dictionaryArgument("hash-table-walk",
+                                                          car(args)));
+    Value *visit = procedureArgument("hash-table-walk", car(cdr(args)));
+    for (Value *cur = entries; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        callWith(visit, cons(car(car(cur)), cons(cdr(car(cur)), makeNull())));
+    }
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-fold, which calls a
+ * procedure on each key, its value, and the result so far.
+ */
+Value *primitiveHashTableFold(Value *args) {
+    checkArity(args, 3, 3);
+    Value *entries = dictionaryEntries(dictionaryArgument("hash-table-fold",
+                                                          car(args)));
+    Value *combine = procedureArgument("hash-table-fold", car(cdr(args)));
+    Value *result = car(cdr(cdr(args)));
+    for (Value *cur = entries; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *call = cons(car(car(cur)), cons(cdr(car(cur)), cons(result, makeNull())));
+        result = callWith(combine, call);
+    }
+    return result;
+}
+
+/*
+ * Implementing the Scheme primitive hash-table->alist.
+ */
+Value *primitiveHashTableToAlist(Value *args) {
+    checkArity(args, 1, 1);
+    return dictionaryEntries(dictionaryArgument("hash-table->alist", car(args)));
+}
+
+/*
+ * Implementing the Scheme primitive alist->hash-table. When a key
+ * appears more than once, its first association wins.
+ */
+Value *primitiveAlistToHashTable(Value *args) {
+    checkArity(args, 1, 3);
+    Value *alist = car(args);
+    Value *table = primitiveMakeHashTable(cdr(args));
+    for (Value *cur = alist; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *entry = car(cur);
+        if (entry->type != CONS_TYPE) {
+            primitiveError("alist->hash-table", "expects a list of pairs");
+        }
+        if (!dictionaryGet(table, car(entry))) {
+            dictionaryPut(table, car(entry), cdr(entry));
+        }
+    }
+    return table;
+}
+
+/*
+ * Implementing the Scheme primitive hash-table-copy.
+ */
+Value *primitiveHashTableCopy(Value *args) {
+    checkArity(args, 1, 2);
+    Value *table = dictionaryArgument("hash-table-copy", car(args));
+    Value *copy = talloc(sizeof(Value) + sizeof(struct SchemeHashTable));
+    if (!copy) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    copy->type = HASHTABLE_TYPE;
+    copy->dict = (struct SchemeHashTable *) (copy + 1);
+    *copy->dict = *table->dict;
+    copy->dict->table = makeHashTable(table->dict->table->size,
+                                     table->dict->table->hash,
+                                     table->dict->table->equals);
+    for (Value *cur = dictionaryEntries(table); cur->type != NULL_TYPE;
+         cur = cdr(cur)) {
+        dictionaryPut(copy, car(car(cur)), cdr(car(cur)));
+    }
+    if (copy->dict->weakness != WEAK_NONE) {
+        registerWeakTable(copy);
+    }
+    return copy;
+}
+
+/*
+ * Helper function to turn a hash into a non-negative fixnum, below the
+ * optional bound given to a hash procedure.
+ */
+Value *boundedHash(char *name, unsigned long hash, Value *args) {
+    checkArity(args, 1, 2);
+    hash >>= 1;
+    if (cdr(args)->type == CONS_TYPE) {
+        Value *bound = car(cdr(args));
+        if (bound->type != INT_TYPE || bound->i <= 0) {
+            primitiveError(name, "expects a positive bound");
+        }
+        hash %= (unsigned long) bound->i;
+    }
+    return makeInteger((int64_t) hash);
+}
+
+/*
+ * Implementing the Scheme primitives hash, equal-hash, string-hash,
+ * and hash-by-identity, each with an optional bound.
+ */
+Value *primitiveHash(Value *args) {
+    checkArity(args, 1, 2);
+    return boundedHash("hash", hashEqual(car(args)), args);
+}
+
+Value *primitiveEqualHash(Value *args) {
+    checkArity(args, 1, 2);
+    return boundedHash("equal-hash", hashEqual(car(args)), args);
+}
+
+Value *primitiveStringHash(Value *args) {
+    checkArity(args, 1, 2);
+    if (car(args)->type != STR_TYPE) {
+        primitiveError("string-hash", "expects a string as input");
+    }
+    return boundedHash("string-hash", hashEqv(car(args)), args);
+}
+
+Value *primitiveHashByIdentity(Value *args) {
+    checkArity(args, 1, 2);
+    return boundedHash("hash-by-identity", hashEqv(car(args)), args);
+}
+
+/*
+ * Bind the hash table primitives in the given top-level frame.
+ */
+void bindDictionaryPrimitives(Frame *topFrame) {
+    bind("make-hash-table", primitiveMakeHashTable, topFrame);
+    bind("hash-table?", primitiveIsHashTable, topFrame);
+    bind("hash-table-ref", primitiveHashTableRef, topFrame);
+    bind("hash-table-ref/default", primitiveHashTableRefDefault, topFrame);
+    bind("hash-table-set!", primitiveHashTableSet, topFrame);
+    bind("hash-table-delete!", primitiveHashTableDelete, topFrame);
+    bind("hash-table-exists?", primitiveHashTableContains, topFrame);
+    bind("hash-table-contains?", primitiveHashTableContains, topFrame);
+    bind("hash-table-update!", primitiveHashTableUpdate, topFrame);
+    bind("hash-table-update!/default", primitiveHashTableUpdateDefault, topFrame);
+    bind("hash-table-size", primitiveHashTableSize, topFrame);
+    bind("hash-table-keys", primitiveHashTableKeys, topFrame);
+    bind("hash-table-values", primitiveHashTableValues, topFrame);
+    bind("hash-table-walk", primitiveHashTableWalk, topFrame);
+    bind("hash-table-fold", primitiveHashTableFold, topFrame);
+    bind("hash-table->alist", primitiveHashTableToAlist, topFrame);
+    bind("alist->hash-table", primitiveAlistToHashTable, topFrame);
+    bind("hash-table-copy", primitiveHashTableCopy, topFrame);
+    bind("make-weak-key-hash-table", primitiveMakeWeakKeyHashTable, topFrame);
+    bind("make-weak-value-hash-table", primitiveMakeWeakValueHashTable,
+         topFrame);
+    bind("hash-table-weakness", primitiveHashTableWeakness, topFrame);
+    bind("hash", primitiveHash, topFrame);
+    bind("equal-hash", primitiveEqualHash, topFrame);
+    bind("string-hash", primitiveStringHash, topFrame);
+    bind("hash-by-identity", primitiveHashByIdentity, topFrame);
+}
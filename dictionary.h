@@ -0,0 +1,76 @@
+/*
+ * This program implements the hash tables of SRFI 69 on top of the
+ * open-addressing tables in hashtable.c.
+ */
+#include "value.h"
+
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+/*
+ * Look up, store, and test for a key, for the interpreter and for
+ * compiled programs to call directly.
+ */
+Value *dictionaryRefDefault(Value *table, Value *key, Value *fallback);
+Value *dictionarySet(Value *table, Value *key, Value *value);
+Value *dictionaryContains(Value *table, Value *key);
+
+/*
+ * Remove the entries of a weak table whose weakly held key or value
+ * the given function reports as reclaimed, for collect-garbage.
+ */
+void sweepWeakDictionary(Value *table, bool (*isLive)(Value *));
+
+/*
+ * Print a hash table.
+ */
+void displayDictionary(void);
+
+/*
+ * The Scheme primitives of SRFI 69.
+ */
+Value *primitiveMakeHashTable(Value *args);
+Value *primitiveIsHashTable(Value *args);
+Value *primitiveHashTableRef(Value *args);
+Value *primitiveHashTableRefDefault(Value *args);
+Value *primitiveHashTableSet(Value *args);
+Value *primitiveHashTableDelete(Value *args);
+Value *primitiveHashTableContains(Value *args);
+Value *primitiveHashTableUpdate(Value *args);
+Value *primitiveHashTableUpdateDefault(Value *args);
+Value *primitiveHashTableSize(Value *args);
+Value *primitiveHashTableKeys(Value *args);
+Value *primitiveHashTableValues(Value *args);
+Value *primitiveHashTableWalk(Value *args);
+Value *primitiveHashTableFold(Value *args);
+Value *primitiveHashTableToAlist(Value *args);
+Value *primitiveAlistToHashTable(Value *args);
+Value *primitiveHashTableCopy(Value *args);
+Value *primitiveMakeWeakKeyHashTable(Value *args);
+Value *primitiveMakeWeakValueHashTable(Value *args);
+Value *primitiveHashTableWeakness(Value *args);
+Value *primitiveHash(Value *args);
+Value *primitiveEqualHash(Value *args);
+Value *primitiveStringHash(Value *args);
+Value *primitiveHashByIdentity(Value *args);
+
+/*
+ * Bind the hash table primitives in the given top-level frame.
+ *
+ *   make-hash-table [equality [hash]]   equal? unless given; eq?,
+ *                                       eqv?, and any other
+ *                                       procedure work
+ *   hash-table? hash-table-ref hash-table-ref/default hash-table-set!
+ *   hash-table-delete! hash-table-exists? hash-table-contains?
+ *   hash-table-update! hash-table-update!/default hash-table-size
+ *   hash-table-keys hash-table-values hash-table-walk hash-table-fold
+ *   hash-table->alist alist->hash-table hash-table-copy
+ *   make-weak-key-hash-table make-weak-value-hash-table
+ *                                       take the arguments of
+ *                                       make-hash-table
+ *   hash-table-weakness                 weak-keys, weak-values, or #f
+ *   hash equal-hash string-hash hash-by-identity
+ */
+void bindDictionaryPrimitives(Frame *topFrame);
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * This program speeds up calls to the arithmetic primitives by
+ * recording, at each call site, the types of the operands seen there
+ * and running a handler specialized to them. The record is kept on the
+ * call site itself, in the argument list of the call, so finding it
+ * costs one load.
+ */
+#include "feedback.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "runtime.h"
+
+enum Arithmetic {
+    NOT_ARITHMETIC = -1,
+    ARITH_ADD,
+    ARITH_SUBTRACT,
+    ARITH_MULTIPLY,
+    ARITH_DIVIDE,
+    ARITH_EQUAL,
+    ARITH_LESS,
+    ARITH_GREATER,
+    ARITH_LESS_EQUAL,
+    ARITH_GREATER_EQUAL
+};
+
+/* What a call site has seen of its operands so far, stored in the
+ * `feedback' field of the argument list. A new pair starts at 0. */
+enum Feedback {
+    SEEN_NOTHING = 0,
+    SEEN_INTEGERS,   /* Only fixnums */
+    SEEN_DOUBLES,    /* Only doubles */
+    SEEN_MIXED       /* Anything else; the site stays generic */
+};
+
+/*
+ * Helper function to find which arithmetic procedure a procedure is.
+ */
+enum Arithmetic arithmeticOf(Value *function) {
+    if (function->type != PRIMITIVE_TYPE) {
+        return NOT_ARITHMETIC;
+    } else if (function->pf == primitiveAdd) {
+        return ARITH_ADD;
+    } else if (function->pf == primitiveSub) {
+        return ARITH_SUBTRACT;
+    } else if (function->pf == primitiveMult) {
+        return ARITH_MULTIPLY;
+    } else if (function->pf == primitiveDiv) {
+        return ARITH_DIVIDE;
+    } else if (function->pf == primitiveNumEqual) {
+        return ARITH_EQUAL;
+    } else if (function->pf == primitiveLess) {
+        return ARITH_LESS;
+    } else if (function->pf == primitiveGreater) {
+        return ARITH_GREATER;
+    } else if (function->pf == primitiveLeq) {
+        return ARITH_LESS_EQUAL;
+    } else if (function->pf == primitiveGeq) {
+        return ARITH_GREATER_EQUAL;
+    }
+    return NOT_ARITHMETIC;
+}
+
+/*
+ * Test whether a procedure is one of the built-in +, -, *, /, =, <, >,
+ * <=, or >=.
+ */
+bool isArithmetic(Value *function) {
+    return arithmeticOf(function) != NOT_ARITHMETIC;
+}
+
+/*
+ * Helper function to fold the types of two more operands into what a
+ * call site has seen.
+ */
+enum Feedback recordOperands(enum Feedback seen, Value *first, Value *second) {
+    enum Feedback now = SEEN_MIXED;
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        now = SEEN_INTEGERS;
+    } else if (first->type == DOUBLE_TYPE && second->type == DOUBLE_TYPE) {
+        now = SEEN_DOUBLES;
+    }
+    return seen == SEEN_NOTHING || seen == now ? now : SEEN_MIXED;
+}
+
+/*
+ * Helper function to apply an arithmetic procedure to two fixnums.
+ *
+ * Returns NULL if the result is not a fixnum: on overflow, or for a
+ * quotient that is not an integer or a division by zero.
+ */
+Value *integerArithmetic(enum Arithmetic operation, int64_t x, int64_t y) {
+    int64_t result;
+    switch (operation) {
+        case ARITH_ADD:
+            return __builtin_add_overflow(x, y, &result) ? NULL : makeInteger(result);
+        case ARITH_SUBTRACT:
+            return __builtin_sub_overflow(x, y, &result) ? NULL : makeInteger(result);
+        case ARITH_MULTIPLY:
+            return __builtin_mul_overflow(x, y, &result) ? NULL : makeInteger(result);
+        case ARITH_DIVIDE:
+            if (y == 0 || (x == INT64_MIN && y == -1) || x % y != 0) {
+                return NULL;
+            }
+            return makeInteger(x / y);
+        case ARITH_EQUAL:
+            return makeBoolean(x == y);
+        case ARITH_LESS:
+            return makeBoolean(x < y);
+        case ARITH_GREATER:
+            return makeBoolean(x > y);
+        case ARITH_LESS_EQUAL:
+            return makeBoolean(x <= y);
+        case ARITH_GREATER_EQUAL:
+            return makeBoolean(x >= y);
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * Helper function to apply an arithmetic procedure to two doubles.
+ *
+ * Returns NULL for a division by zero, which is an error.
+ */
+Value *doubleArithmetic(enum Arithmetic operation, double x, double y) {
+    switch (operation) {
+        case ARITH_ADD:
+            return makeDouble(x + y);
+        case ARITH_SUBTRACT:
+            return makeDouble(x - y);
+        case ARITH_MULTIPLY:
+            return makeDouble(x * y);
+        case ARITH_DIVIDE:
+            return y == 0 ? NULL : makeDouble(x / y);
+        case ARITH_EQUAL:
+            return makeBoolean(x == y);
+        case ARITH_LESS:
+            return makeBoolean(x < y);
+        case ARITH_GREATER:
+            return makeBoolean(x > y);
+        case ARITH_LESS_EQUAL:
+            return makeBoolean(x <= y);
+        case ARITH_GREATER_EQUAL:
+            return makeBoolean(x >= y);
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * Evaluate the two arguments of a call to the built-in arithmetic
+ * procedure `function' and apply it, specialized to the operand types
+ * the call site has seen.
+ *
+ * Returns NULL without evaluating anything if the call does not have
+ * exactly two arguments.
+ */
+Value *evalArithmetic(Value *function, Value *args, Frame *frame) {
+    enum Arithmetic operation = arithmeticOf(function);
+    if (operation == NOT_ARITHMETIC || args->type != CONS_TYPE ||
+        cdr(args)->type != CONS_TYPE || cdr(cdr(args))->type != NULL_TYPE) {
+        return NULL;
+    }
+    Value *first = eval(car(args), frame);
+    Value *second = eval(car(cdr(args)), frame);
+    enum Feedback seen = args->c.feedback;
+    Value *result = NULL;
+    if (seen == SEEN_INTEGERS) {
+        if (first->type == INT_TYPE && second->type == INT_TYPE) {
+            result = integerArithmetic(operation, first->i, second->i);
+        }
+    } else if (seen == SEEN_DOUBLES) {
+        if (first->type == DOUBLE_TYPE && second->type == DOUBLE_TYPE) {
+            result = doubleArithmetic(operation, first->d, second->d);
+        }
+    }
+    if (result) {
+        return result;
+    }
+    // The guard failed, or the site is new or generic
+    args->c.feedback = recordOperands(seen, first, second);
+    return (function->pf)(cons(first, cons(second, makeNull())));
+}
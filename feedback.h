@@ -0,0 +1,30 @@
+/*
+ * This program speeds up calls to the arithmetic primitives by
+ * recording, at each call site, the types of the operands seen there
+ * and running a handler specialized to them.
+ */
+#include "value.h"
+
+#ifndef FEEDBACK_H
+#define FEEDBACK_H
+
+/*
+ * Test whether a procedure is one of the built-in +, -, *, /, =, <, >,
+ * <=, or >=.
+ */
+bool isArithmetic(Value *function);
+
+/*
+ * Evaluate the two arguments of a call to the built-in arithmetic
+ * procedure `function' and apply it. A call site that has only seen
+ * fixnums, or only doubles, runs an int-int or double-double handler
+ * that never converts between the two; other operands, and results
+ * the handler cannot produce (an overflow, an inexact quotient, a
+ * division by zero), go through the primitive itself.
+ *
+ * Returns NULL without evaluating anything if the call does not have
+ * exactly two arguments.
+ */
+Value *evalArithmetic(Value *function, Value *args, Frame *frame);
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * This program implements the fixnum, flonum, and bitwise operators.
+ * Each operator is a C function on two values that checks their types
+ * and computes the result in one step; the Scheme primitives fold these
+ * functions over their argument lists, and the interpreter and compiled
+ * programs call them directly when given exactly two arguments.
+ */
+#include <stdio.h>
+#include "fixflo.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "bignum.h"
+#include "runtime.h"
+
+/*
+ * Helper function to check that both operands of an fx operator are
+ * fixnums.
+ */
+void checkFixnums(char *name, Value *first, Value *second) {
+    if (first->type != INT_TYPE || second->type != INT_TYPE) {
+        primitiveError(name, "expects fixnums as input");
+    }
+}
+
+/*
+ * Helper function to check that both operands of an fl operator are
+ * flonums.
+ */
+void checkFlonums(char *name, Value *first, Value *second) {
+    if (first->type != DOUBLE_TYPE || second->type != DOUBLE_TYPE) {
+        primitiveError(name, "expects flonums as input");
+    }
+}
+
+/*
+ * Helper function to check that both operands of a bitwise operator are
+ * exact integers.
+ */
+void checkExactIntegers(char *name, Value *first, Value *second) {
+    if (!isExactInteger(first) || !isExactInteger(second)) {
+        primitiveError(name, "expects exact integers as input");
+    }
+}
+
+#define FIXNUM_OPERATOR(function, name, overflows) \
+    Value *function(Value *first, Value *second) { \
+        int64_t result; \
+        checkFixnums(name, first, second); \
+        if (overflows(first->i, second->i, &result)) { \
+            primitiveError(name, "result is not a fixnum"); \
+        } \
+        return makeInteger(result); \
+    }
+
+#define FIXNUM_COMPARISON(function, name, op) \
+    Value *function(Value *first, Value *second) { \
+        checkFixnums(name, first, second); \
+        return makeBoolean(first->i op second->i); \
+    }
+
+#define FLONUM_OPERATOR(function, name, op) \
+    Value *function(Value *first, Value *second) { \
+        checkFlonums(name, first, second); \
+        return makeDouble(first->d op second->d); \
+    }
+
+#define FLONUM_COMPARISON(function, name, op) \
+    Value *function(Value *first, Value *second) { \
+        checkFlonums(name, first, second); \
+        return makeBoolean(first->d op second->d); \
+    }
+
+#define BITWISE_OPERATOR(function, name, operation) \
+    Value *function(Value *first, Value *second) { \
+        checkExactIntegers(name, first, second); \
+        return bitwiseExact(operation, first, second); \
+    }
+
+FIXNUM_OPERATOR(fxAdd, "fx+", __builtin_add_overflow)
+FIXNUM_OPERATOR(fxSubtract, "fx-", __builtin_sub_overflow)
+FIXNUM_OPERATOR(fxMultiply, "fx*", __builtin_mul_overflow)
+FIXNUM_COMPARISON(fxEqual, "fx=", ==)
+FIXNUM_COMPARISON(fxLess, "fx<", <)
+FIXNUM_COMPARISON(fxGreater, "fx>", >)
+FIXNUM_COMPARISON(fxLessEqual, "fx<=", <=)
+FIXNUM_COMPARISON(fxGreaterEqual, "fx>=", >=)
+FLONUM_OPERATOR(flAdd, "fl+", +)
+FLONUM_OPERATOR(flSubtract, "fl-", -)
+FLONUM_OPERATOR(flMultiply, "fl*", *)
+// Division by zero gives an infinity or NaN, as in IEEE arithmetic
+FLONUM_OPERATOR(flDivide, "fl/", /)
+FLONUM_COMPARISON(flEqual, "fl=", ==)
+FLONUM_COMPARISON(flLess, "fl<", <)
+FLONUM_COMPARISON(flGreater, "fl>", >)
+FLONUM_COMPARISON(flLessEqual, "fl<=", <=)
+FLONUM_COMPARISON(flGreaterEqual, "fl>=", >=)
+BITWISE_OPERATOR(bitwiseAnd, "bitwise-and", BIT_AND)
+BITWISE_OPERATOR(bitwiseIor, "bitwise-ior", BIT_IOR)
+BITWISE_OPERATOR(bitwiseXor, "bitwise-xor", BIT_XOR)
+
+/*
+ * Shift an exact integer left by `shift' bits, or right when `shift' is
+ * negative, rounding toward negative infinity.
+ */
+Value *arithmeticShift(Value *value, Value *shift) {
+    if (!isExactInteger(value) || shift->type != INT_TYPE) {
+        primitiveError("arithmetic-shift",
+                       "expects an exact integer and a fixnum");
+    }
+    return shiftExact(value, shift->i);
+}
+
+/*
+ * Helper function to fold an operator over a list of operands, starting
+ * from `initial'.
+ */
+Value *foldOperator(Value *(*binary)(Value *, Value *), Value *initial,
+                    Value *args) {
+    Value *result = initial;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        result = binary(result, car(cur));
+    }
+    return result;
+}
+
+/*
+ * Helper function to compare each pair of neighboring arguments. All
+ * arguments are checked, even after the result is known.
+ */
+Value *chainComparison(Value *(*binary)(Value *, Value *), Value *args) {
+    checkArity(args, 2, -1);
+    bool result = true;
+    for (Value *cur = args; cdr(cur)->type != NULL_TYPE; cur = cdr(cur)) {
+        if (!isTrue(binary(car(cur), car(cdr(cur))))) {
+            result = false;
+        }
+    }
+    return makeBoolean(result);
+}
+
+/*
+ * Implementing the Scheme primitives fx+ and fx*.
+ */
+Value *primitiveFxAdd(Value *args) {
+    checkArity(args, 2, 2);
+    return fxAdd(car(args), car(cdr(args)));
+}
+
+Value *primitiveFxMultiply(Value *args) {
+    checkArity(args, 2, 2);
+    return fxMultiply(car(args), car(cdr(args)));
+}
+
+/*
+ * Implementing the Scheme primitive fx-, which negates one argument.
+ */
+Value *primitiveFxSubtract(Value *args) {
+    checkArity(args, 1, 2);
+    if (cdr(args)->type == NULL_TYPE) {
+        return fxSubtract(makeInteger(0), car(args));
+    }
+    return fxSubtract(car(args), car(cdr(args)));
+}
+
+/*
+ * Implementing the Scheme primitives fl+ and fl*. Starting from -0.0
+ * and 1.0 leaves every operand, even -0.0 and NaN, as it is.
+ */
+Value *primitiveFlAdd(Value *args) {
+    if (args->type == NULL_TYPE) {
+        return makeDouble(0.0);
+    }
+    return foldOperator(flAdd, makeDouble(-0.0), args);
+}
+
+Value *primitiveFlMultiply(Value *args) {
+    return foldOperator(flMultiply, makeDouble(1.0), args);
+}
+
+/*
+ * Implementing the Scheme primitive fl-, which negates one argument.
+ */
+Value *primitiveFlSubtract(Value *args) {
+    checkArity(args, 1, -1);
+    if (cdr(args)->type == NULL_TYPE) {
+        return flSubtract(makeDouble(-0.0), car(args));
+    }
+    return foldOperator(flSubtract, car(args), cdr(args));
+}
+
+/*
+ * Implementing the Scheme primitive fl/, which takes the reciprocal of
+ * one argument.
+ */
+Value *primitiveFlDivide(Value *args) {
+    checkArity(args, 1, -1);
+    if (cdr(args)->type == NULL_TYPE) {
+        return flDivide(makeDouble(1.0), car(args));
+    }
+    return foldOperator(flDivide, car(args), cdr(args));
+}
+
+/*
+ * Implementing the Scheme comparisons fx=, fx<, fx>, fx<=, fx>=, fl=,
+ * fl<, fl>, fl<=, and fl>=.
+ */
+Value *primitiveFxEqual(Value *args) {
+    return chainComparison(fxEqual, args);
+}
+
+Value *primitiveFxLess(Value *args) {
+    return chainComparison(fxLess, args);
+}
+
+Value *primitiveFxGreater(Value *args) {
+    return chainComparison(fxGreater, args);
+}
+
+Value *primitiveFxLessEqual(Value *args) {
+    return chainComparison(fxLessEqual, args);
+}
+
+Value *primitiveFxGreaterEqual(Value *args) {
+    return chainComparison(fxGreaterEqual, args);
+}
+
+Value *primitiveFlEqual(Value *args) {
+    return chainComparison(flEqual, args);
+}
+
+Value *primitiveFlLess(Value *args) {
+    return chainComparison(flLess, args);
+}
+
+Value *primitiveFlGreater(Value *args) {
+    return chainComparison(flGreater, args);
+}
+
+Value *primitiveFlLessEqual(Value *args) {
+    return chainComparison(flLessEqual, args);
+}
+
+Value *primitiveFlGreaterEqual(Value *args) {
+    return chainComparison(flGreaterEqual, args);
+}
+
+/*
+ * Implementing the Scheme primitives bitwise-and, bitwise-ior, and
+ * bitwise-xor, which take any number of arguments.
+ */
+Value *primitiveBitwiseAnd(Value *args) {
+    return foldOperator(bitwiseAnd, makeInteger(-1), args);
+}
+
+Value *primitiveBitwiseIor(Value *args) {
+    return foldOperator(bitwiseIor, makeInteger(0), args);
+}
+
+Value *primitiveBitwiseXor(Value *args) {
+    return foldOperator(bitwiseXor, makeInteger(0), args);
+}
+
+/*
+ * Implementing the Scheme primitive bitwise-not.
+ */
+Value *primitiveBitwiseNot(Value *args) {
+    checkArity(args, 1, 1);
+    Value *value = car(args);
+    if (value->type == INT_TYPE) {
+        return makeInteger(~value->i);
+    } else if (!isExactInteger(value)) {
+        primitiveError("bitwise-not", "expects an exact integer as input");
+    }
+    return subtractExact(makeInteger(-1), value);
+}
+
+/*
+ * Implementing the Scheme primitive arithmetic-shift.
+ */
+Value *primitiveArithmeticShift(Value *args) {
+    checkArity(args, 2, 2);
+    return arithmeticShift(car(args), car(cdr(args)));
+}
+
+/* Each primitive that agrees with an operator when given two arguments. */
+static const struct {
+    Value *(*primitive)(Value *);
+    Value *(*binary)(Value *, Value *);
+} binaryOperators[] = {
+    {primitiveFxAdd, fxAdd},
+    {primitiveFxSubtract, fxSubtract},
+    {primitiveFxMultiply, fxMultiply},
+    {primitiveFxEqual, fxEqual},
+    {primitiveFxLess, fxLess},
+    {primitiveFxGreater, fxGreater},
+    {primitiveFxLessEqual, fxLessEqual},
+    {primitiveFxGreaterEqual, fxGreaterEqual},
+    {primitiveFlAdd, flAdd},
+    {primitiveFlSubtract, flSubtract},
+    {primitiveFlMultiply, flMultiply},
+    {primitiveFlDivide, flDivide},
+    {primitiveFlEqual, flEqual},
+    {primitiveFlLess, flLess},
+    {primitiveFlGreater, flGreater},
+    {primitiveFlLessEqual, flLessEqual},
+    {primitiveFlGreaterEqual, flGreaterEqual},
+    {primitiveBitwiseAnd, bitwiseAnd},
+    {primitiveBitwiseIor, bitwiseIor},
+    {primitiveBitwiseXor, bitwiseXor},
+    {primitiveArithmeticShift, arithmeticShift},
+    {NULL, NULL}
+};
+
+/*
+ * Helper function to find the operator on two arguments behind a
+ * procedure, or NULL.
+ */
+Value *(*binaryOperatorOf(Value *function))(Value *, Value *) {
+    if (function->type != PRIMITIVE_TYPE) {
+        return NULL;
+    }
+    for (int i = 0; binaryOperators[i].primitive; i++) {
+        if (binaryOperators[i].primitive == function->pf) {
+            return binaryOperators[i].binary;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Test whether a procedure is one of the operators above that takes
+ * two arguments.
+ */
+bool isFixFlo(Value *function) {
+    return binaryOperatorOf(function) != NULL;
+}
+
+/*
+ * Evaluate the two arguments of a call to one of the operators above
+ * and apply it directly, without building an argument list.
+ *
+ * Returns NULL without evaluating anything if the call does not have
+ * exactly two arguments.
+ */
+Value *evalFixFlo(Value *function, Value *args, Frame *frame) {
+    Value *(*binary)(Value *, Value *) = binaryOperatorOf(function);
+    if (!binary || args->type != CONS_TYPE || cdr(args)->type != CONS_TYPE ||
+        cdr(cdr(args))->type != NULL_TYPE) {
+        return NULL;
+    }
+    Value *first = eval(car(args), frame);
+    Value *second = eval(car(cdr(args)), frame);
+    return binary(first, second);
+}
+
+/*
+ * Bind the fixnum, flonum, and bitwise primitives in the given
+ * top-level frame.
+ */
+void bindFixFloPrimitives(Frame *topFrame) {
+    bind("fx+", primitiveFxAdd, topFrame);
+    bind("fx-", primitiveFxSubtract, topFrame);
+    bind("fx*", primitiveFxMultiply, topFrame);
+    bind("fx=", primitiveFxEqual, topFrame);
+    bind("fx<", primitiveFxLess, topFrame);
+    bind("fx>", primitiveFxGreater, topFrame);
+    bind("fx<=", primitiveFxLessEqual, topFrame);
+    bind("fx>=", primitiveFxGreaterEqual, topFrame);
+    bind("fl+", primitiveFlAdd, topFrame);
+    bind("fl-", primitiveFlSubtract, topFrame);
+    bind("fl*", primitiveFlMultiply, topFrame);
+    bind("fl/", primitiveFlDivide, topFrame);
+    bind("fl=", primitiveFlEqual, topFrame);
+    bind("fl<", primitiveFlLess, topFrame);
+    bind("fl>", primitiveFlGreater, topFrame);
+    bind("fl<=", primitiveFlLessEqual, topFrame);
+    bind("fl>=", primitiveFlGreaterEqual, topFrame);
+    bind("bitwise-and", primitiveBitwiseAnd, topFrame);
+    bind("bitwise-ior", primitiveBitwiseIor, topFrame);
+    bind("bitwise-or", primitiveBitwiseIor, topFrame);
+    bind("bitwise-xor", primitiveBitwiseXor, topFrame);
+    bind("bitwise-not", primitiveBitwiseNot, topFrame);
+    bind("arithmetic-shift", primitiveArithmeticShift, topFrame);
+}
@@ -0,0 +1,92 @@
+/*
+ * This program implements the fixnum, flonum, and bitwise operators:
+ * fx+ and friends take only fixnums, fl+ and friends take only doubles,
+ * and bitwise-and and friends take exact integers. None of them goes
+ * through the generic numeric tower.
+ */
+#include "value.h"
+
+#ifndef FIXFLO_H
+#define FIXFLO_H
+
+/*
+ * The operators on two arguments, for the interpreter and for compiled
+ * programs to call directly. The fx operators raise an error when the
+ * result is not a fixnum.
+ */
+Value *fxAdd(Value *first, Value *second);
+Value *fxSubtract(Value *first, Value *second);
+Value *fxMultiply(Value *first, Value *second);
+Value *fxEqual(Value *first, Value *second);
+Value *fxLess(Value *first, Value *second);
+Value *fxGreater(Value *first, Value *second);
+Value *fxLessEqual(Value *first, Value *second);
+Value *fxGreaterEqual(Value *first, Value *second);
+Value *flAdd(Value *first, Value *second);
+Value *flSubtract(Value *first, Value *second);
+Value *flMultiply(Value *first, Value *second);
+Value *flDivide(Value *first, Value *second);
+Value *flEqual(Value *first, Value *second);
+Value *flLess(Value *first, Value *second);
+Value *flGreater(Value *first, Value *second);
+Value *flLessEqual(Value *first, Value *second);
+Value *flGreaterEqual(Value *first, Value *second);
+Value *bitwiseAnd(Value *first, Value *second);
+Value *bitwiseIor(Value *first, Value *second);
+Value *bitwiseXor(Value *first, Value *second);
+Value *arithmeticShift(Value *value, Value *shift);
+
+/*
+ * The same operators as Scheme primitives, taking a list of arguments.
+ */
+Value *primitiveFxAdd(Value *args);
+Value *primitiveFxSubtract(Value *args);
+Value *primitiveFxMultiply(Value *args);
+Value *primitiveFxEqual(Value *args);
+Value *primitiveFxLess(Value *args);
+Value *primitiveFxGreater(Value *args);
+Value *primitiveFxLessEqual(Value *args);
+Value *primitiveFxGreaterEqual(Value *args);
+Value *primitiveFlAdd(Value *args);
+Value *primitiveFlSubtract(Value *args);
+Value *primitiveFlMultiply(Value *args);
+Value *primitiveFlDivide(Value *args);
+Value *primitiveFlEqual(Value *args);
+Value *primitiveFlLess(Value *args);
+Value *primitiveFlGreater(Value *args);
+Value *primitiveFlLessEqual(Value *args);
+Value *primitiveFlGreaterEqual(Value *args);
+Value *primitiveBitwiseAnd(Value *args);
+Value *primitiveBitwiseIor(Value *args);
+Value *primitiveBitwiseXor(Value *args);
+Value *primitiveBitwiseNot(Value *args);
+Value *primitiveArithmeticShift(Value *args);
+
+/*
+ * Find the operator on two arguments behind a procedure, or NULL if it
+ * is not one of the operators above.
+ */
+Value *(*binaryOperatorOf(Value *function))(Value *, Value *);
+
+/*
+ * Test whether a procedure is one of the operators above that takes
+ * two arguments.
+ */
+bool isFixFlo(Value *function);
+
+/*
+ * Evaluate the two arguments of a call to one of the operators above
+ * and apply it directly, without building an argument list.
+ *
+ * Returns NULL without evaluating anything if the call does not have
+ * exactly two arguments.
+ */
+Value *evalFixFlo(Value *function, Value *args, Frame *frame);
+
+/*
+ * Bind the fixnum, flonum, and bitwise primitives in the given
+ * top-level frame.
+ */
+void bindFixFloPrimitives(Frame *topFrame);
+
+#endif
@@ -0,0 +1,828 @@
+/*
+ * This program implements persistent maps and sets as hash array
+ * mapped tries. Each node covers five bits of the hash of a key: a
+ * bitmap tells which of its 32 slots are in use, and only those are
+ * stored, each holding a key and its value or a node one level down.
+ * Keys whose whole hashes are equal share a collision node.
+ *
+ * A change copies the nodes on the path to the key and shares every
+ * other node with the old version. A transient changes nodes in place
+ * instead when they carry its edit token, that is, when it made them
+ * itself, so building a map with one costs no more than a hash table.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "hamt.h"
+#include "hashtable.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/* The bits of the hash used at each level. */
+#define HAMT_BITS 5
+
+/* A slot of a node: a key and its value, or a node one level down. */
+typedef struct HamtEntry {
+    unsigned long hash;
+    Value *key;
+    Value *value;
+    struct HamtNode *child;
+} HamtEntry;
+
+struct HamtNode {
+    uint32_t bitmap;     /* Which of the 32 slots are in use */
+    int count;           /* Entries in use */
+    int capacity;        /* Entries allocated */
+    bool collision;      /* Entries all have the same hash; no bitmap */
+    void *edit;          /* The transient that may change this node */
+    HamtEntry *entries;
+};
+
+typedef struct HamtNode HamtNode;
+
+/* The root of every empty map. It has no edit token, so it is never
+ * changed in place. */
+static HamtNode emptyNode = {0, 0, 0, false, NULL, NULL};
+
+/*
+ * Helper function to allocate a node with room for the given number of
+ * entries.
+ */
+HamtNode *makeNode(void *edit, int capacity) {
+    HamtNode *node = talloc(sizeof(HamtNode));
+    HamtEntry *entries = talloc(sizeof(HamtEntry) * capacity);
+    if (!node || !entries) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    node->bitmap = 0;
+    node->count = 0;
+    node->capacity = capacity;
+    node->collision = false;
+    node->edit = edit;
+    node->entries = entries;
+    return node;
+}
+
+/*
+ * Helper function to get a node that may be changed for the given
+ * edit and has room for `extra' more entries: the node itself if the
+ * transient made it and it has room, or else a copy.
+ */
+HamtNode *editableNode(HamtNode *node, void *edit, int extra) {
+    if (edit != NULL && node->edit == edit &&
+        node->count + extra <= node->capacity) {
+        return node;
+    }
+    // A transient will probably add more, so leave it some room
+    int capacity = node->count + extra;
+    if (edit != NULL && extra > 0 && capacity < 16) {
+        capacity *= 2;
+    }
+    HamtNode *copy = makeNode(edit, capacity);
+    memcpy(copy->entries, node->entries, sizeof(HamtEntry) * node->count);
+    copy->bitmap = node->bitmap;
+    copy->count = node->count;
+    copy->collision = node->collision;
+    return copy;
+}
+
+/*
+ * Helper function to find the slot of a hash at the given level, and
+ * where that slot is stored among the entries of a node.
+ */
+uint32_t slotBit(unsigned long hash, int shift) {
+    return (uint32_t) 1 << ((hash >> shift) & 31);
+}
+
+int slotIndex(HamtNode *node, uint32_t bit) {
+    return __builtin_popcount(node->bitmap & (bit - 1));
+}
+
+/*
+ * Helper function to open a slot for an entry at the given index.
+ */
+void insertSlot(HamtNode *node, int index, HamtEntry *entry) {
+    memmove(node->entries + index + 1, node->entries + index,
+            sizeof(HamtEntry) * (node->count - index));
+    node->entries[index] = *entry;
+    node->count++;
+}
+
+/*
+ * Helper function to close the slot at the given index.
+ */
+void removeSlot(HamtNode *node, int index) {
+    memmove(node->entries + index, node->entries + index + 1,
+            sizeof(HamtEntry) * (node->count - index - 1));
+    node->count--;
+}
+
+/*
+ * Helper function to find the entry for a key.
+ *
+ * Returns NULL if the key is not there.
+ */
+HamtEntry *findEntry(HamtNode *node, unsigned long hash, Value *key) {
+    for (int shift = 0; ; shift += HAMT_BITS) {
+        if (node->collision) {
+            for (int i = 0; i < node->count; i++) {
+                if (node->entries[i].hash == hash &&
+                    isEqual(node->entries[i].key, key)) {
+                    return &node->entries[i];
+                }
+            }
+            return NULL;
+        }
+        uint32_t bit = slotBit(hash, shift);
+        if (!(node->bitmap & bit)) {
+            return NULL;
+        }
+        HamtEntry *entry = &node->entries[slotIndex(node, bit)];
+        if (entry->child == NULL) {
+            return entry->hash == hash && isEqual(entry->key, key) ?
+                   entry : NULL;
+        }
+        node = entry->child;
+    }
+}
+
+/*
+ * Helper function to make the smallest subtrie, starting at the given
+ * level, that holds two entries with different keys.
+ */
+HamtNode *mergeEntries(void *edit, int shift, HamtEntry *first,
+                       HamtEntry *second) {
+    if (first->hash == second->hash) {
+        HamtNode *node = makeNode(edit, 2);
+        node->collision = true;
+        node->entries[0] = *first;
+        node->entries[1] = *second;
+        node->count = 2;
+        return node;
+    }
+    uint32_t firstBit = slotBit(first->hash, shift);
+    uint32_t secondBit = slotBit(second->hash, shift);
+    if (firstBit == secondBit) {
+        HamtNode *node = makeNode(edit, 1);
+        HamtNode *child = mergeEntries(edit, shift + HAMT_BITS, first, second);
+        HamtEntry entry = {0, NULL, NULL, child};
+        node->bitmap = firstBit;
+        node->entries[0] = entry;
+        node->count = 1;
+        return node;
+    }
+    HamtNode *node = makeNode(edit, 2);
+    node->bitmap = firstBit | secondBit;
+    node->entries[firstBit < secondBit ? 0 : 1] = *first;
+    node->entries[firstBit < secondBit ? 1 : 0] = *second;
+    node->count = 2;
+    return node;
+}
+
+/*
+ * Helper function to add an entry, or replace the value of its key, in
+ * the subtrie at the given level. Sets `added' if the key is new.
+ *
+ * Returns the new subtrie, which is `node' itself if nothing changed
+ * or it was changed in place.
+ */
+HamtNode *insertEntry(HamtNode *node, void *edit, int shift, HamtEntry *entry,
+                      bool *added) {
+    if (node->collision) {
+        if (node->entries[0].hash != entry->hash) {
+            // Put the collision node under a node that can tell them apart
+            HamtNode *parent = makeNode(edit, 2);
+            HamtEntry child = {0, NULL, NULL, node};
+            parent->bitmap = slotBit(node->entries[0].hash, shift);
+            parent->entries[0] = child;
+            parent->count = 1;
+            return insertEntry(parent, edit, shift, entry, added);
+        }
+        for (int i = 0; i < node->count; i++) {
+            if (isEqual(node->entries[i].key, entry->key)) {
+                HamtNode *result = editableNode(node, edit, 0);
+                result->entries[i].value = entry->value;
+                return result;
+            }
+        }
+        HamtNode *result = editableNode(node, edit, 1);
+        result->entries[result->count++] = *entry;
+        *added = true;
+        return result;
+    }
+    uint32_t bit = slotBit(entry->hash, shift);
+    int index = slotIndex(node, bit);
+    if (!(node->bitmap & bit)) {
+        HamtNode *result = editableNode(node, edit, 1);
+        insertSlot(result, index, entry);
+        result->bitmap |= bit;
+        *added = true;
+        return result;
+    }
+    HamtEntry *slot = &node->entries[index];
+    HamtEntry replacement = *slot;
+    if (slot->child != NULL) {
+        replacement.child = insertEntry(slot->child, edit, shift + HAMT_BITS,
+                                        entry, added);
+        if (replacement.child == slot->child) {
+            return node;
+        }
+    } else if (slot->hash == entry->hash && isEqual(slot->key, entry->key)) {
+        if (slot->value == entry->value) {
+            return node;
+        }
+        replacement.value = entry->value;
+    } else {
+        replacement.child = mergeEntries(edit, shift + HAMT_BITS, slot, entry);
+        replacement.key = NULL;
+        replacement.value = NULL;
+        *added = true;
+    }
+    HamtNode *result = editableNode(node, edit, 0);
+    result->entries[index] = replacement;
+    return result;
+}
+
+/*
+ * Helper function to remove the entry for a key from the subtrie at
+ * the given level. Sets `removed' if the key was there. A node left
+ * with a single key and no subtries is folded into its parent.
+ *
+ * Returns the new subtrie, NULL if it is empty.
+ */
+HamtNode *removeEntry(HamtNode *node, void *edit, int shift,
+                      unsigned long hash, Value *key, bool *removed) {
+    if (node->collision) {
+        for (int i = 0; i < node->count; i++) {
+            if (node->entries[i].hash == hash &&
+                isEqual(node->entries[i].key, key)) {
+                *removed = true;
+                if (node->count == 1) {
+                    return NULL;
+                }
+                HamtNode *result = editableNode(node, edit, 0);
+                removeSlot(result, i);
+                return result;
+            }
+        }
+        return node;
+    }
+    uint32_t bit = slotBit(hash, shift);
+    if (!(node->bitmap & bit)) {
+        return node;
+    }
+    int index = slotIndex(node, bit);
+    HamtEntry *slot = &node->entries[index];
+    if (slot->child == NULL) {
+        if (slot->hash != hash || !isEqual(slot->key, key)) {
+            return node;
+        }
+        *removed = true;
+        if (node->count == 1) {
+            return NULL;
+        }
+        HamtNode *result = editableNode(node, edit, 0);
+        removeSlot(result, index);
+        result->bitmap &= ~bit;
+        return result;
+    }
+    HamtNode *child = removeEntry(slot->child, edit, shift + HAMT_BITS, hash,
+                                  key, removed);
+    if (child == slot->child) {
+        return node;
+    }
+    HamtNode *result = editableNode(node, edit, 0);
+    if (child == NULL) {
+        removeSlot(result, index);
+        result->bitmap &= ~bit;
+        return result->count == 0 ? NULL : result;
+    }
+    if (child->count == 1 && child->entries[0].child == NULL) {
+        result->entries[index] = child->entries[0];
+    } else {
+        result->entries[index].child = child;
+    }
+    return result;
+}
+
+/*
+ * Helper function to call a C function on each key and value.
+ */
+void visitEntries(HamtNode *node,
+                  void (*visit)(Value *key, Value *value, void *state),
+                  void *state) {
+    for (int i = 0; i < node->count; i++) {
+        if (node->entries[i].child != NULL) {
+            visitEntries(node->entries[i].child, visit, state);
+        } else {
+            visit(node->entries[i].key, node->entries[i].value, state);
+        }
+    }
+}
+
+/*
+ * Helper function to make a map or set value.
+ */
+Value *makeImap(HamtNode *root, int64_t count, bool isSet, void *edit) {
+    // The fields of the map follow the value in one block
+    Value *map = talloc(sizeof(Value) + sizeof(struct ImmutableMap));
+    if (!map) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    map->type = IMAP_TYPE;
+    map->imap = (struct ImmutableMap *) (map + 1);
+    map->imap->root = root == NULL ? &emptyNode : root;
+    map->imap->count = count;
+    map->imap->isSet = isSet;
+    map->imap->transient = edit != NULL;
+    map->imap->edit = edit;
+    return map;
+}
+
+/*
+ * Helper function to make a new edit token for a transient.
+ */
+void *makeEditToken() {
+    void *edit = talloc(1);
+    if (!edit) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    return edit;
+}
+
+/*
+ * Helper function to check that an argument is a map or set, and
+ * whether it is a transient.
+ */
+Value *imapArgument(char *name, Value *value, bool isSet, bool transient) {
+    if (value->type != IMAP_TYPE || value->imap->isSet != isSet) {
+        primitiveError(name, isSet ? "expects a set as input"
+                                   : "expects a map as input");
+    } else if (value->imap->transient != transient) {
+        primitiveError(name,
+                       transient ? "expects a transient as input"
+                                 : "expects a persistent map or set as input");
+    } else if (transient && value->imap->edit == NULL) {
+        primitiveError(name, "was given a transient already made persistent");
+    }
+    return value;
+}
+
+/*
+ * Helper function to check that an argument is a map or set that may
+ * be read, transient or not.
+ */
+Value *readableArgument(char *name, Value *value, bool isSet) {
+    if (value->type != IMAP_TYPE || value->imap->isSet != isSet) {
+        primitiveError(name, isSet ? "expects a set as input"
+                                   : "expects a map as input");
+    } else if (value->imap->transient && value->imap->edit == NULL) {
+        primitiveError(name, "was given a transient already made persistent");
+    }
+    return value;
+}
+
+/*
+ * Helper function to add a key to a map or set, changing a transient
+ * in place.
+ *
+ * Returns the new version; a transient returns itself.
+ */
+Value *addKey(Value *map, Value *key, Value *value) {
+    HamtEntry entry = {hashEqual(key), key, value, NULL};
+    bool added = false;
+    HamtNode *root = insertEntry(map->imap->root, map->imap->edit, 0, &entry,
+                                 &added);
+    if (map->imap->transient) {
+        map->imap->root = root;
+        map->imap->count += added;
+        return map;
+    } else if (root == map->imap->root) {
+        return map;
+    }
+    return makeImap(root, map->imap->count + added, map->imap->isSet, NULL);
+}
+
+/*
+ * Helper function to remove a key from a map or set, changing a
+ * transient in place.
+ *
+ * Returns the new version; a transient returns itself.
+ */
+Value *removeKey(Value *map, Value *key) {
+    bool removed = false;
+    HamtNode *root = removeEntry(map->imap->root, map->imap->edit, 0,
+                                 hashEqual(key), key, &removed);
+    if (map->imap->transient) {
+        map->imap->root = root == NULL ? &emptyNode : root;
+        map->imap->count -= removed;
+        return map;
+    } else if (!removed) {
+        return map;
+    }
+    return makeImap(root, map->imap->count - 1, map->imap->isSet, NULL);
+}
+
+/*
+ * Look up, add, and test for a key, for the interpreter and for
+ * compiled programs to call directly.
+ */
+Value *imapRefDefault(Value *map, Value *key, Value *fallback) {
+    readableArgument("imap-ref", map, false);
+    HamtEntry *entry = findEntry(map->imap->root, hashEqual(key), key);
+    return entry == NULL ? fallback : entry->value;
+}
+
+Value *imapSetValue(Value *map, Value *key, Value *value) {
+    imapArgument("imap-set", map, false, false);
+    return addKey(map, key, value);
+}
+
+Value *imapContains(Value *map, Value *key) {
+    readableArgument("imap-contains?", map, false);
+    return makeBoolean(findEntry(map->imap->root, hashEqual(key), key) != NULL);
+}
+
+/*
+ * Print a map or set.
+ */
+void displayImap(Value *map) {
+    printf(map->imap->isSet ? "#iset" : "#imap");
+}
+
+/*
+ * Implementing the Scheme primitive imap, which makes a map of the
+ * given keys and values: (imap k1 v1 k2 v2 ...).
+ */
+Value *primitiveImap(Value *args) {
+    if (length(args) % 2 != 0) {
+        primitiveError("imap", "expects keys and values in pairs");
+    }
+    Value *map = makeImap(NULL, 0, false, makeEditToken());
+    for (Value *cur = args; cur->type == CONS_TYPE; cur = cdr(cdr(cur))) {
+        addKey(map, car(cur), car(cdr(cur)));
+    }
+    return makeImap(map->imap->root, map->imap->count, false, NULL);
+}
+
+/*
+ * Implementing the Scheme primitive imap?.
+ */
+Value *primitiveIsImap(Value *args) {
+    checkArity(args, 1, 1);
+    Value *value = car(args);
+    return makeBoolean(value->type == IMAP_TYPE && !value->imap->isSet);
+}
+
+/*
+ * Implementing the Scheme primitive imap-ref, which reports an error
+ * if the key is not there and no default is given.
+ */
+Value *primitiveImapRef(Value *args) {
+    checkArity(args, 2, 3);
+    Value *map = readableArgument("imap-ref", car(args), false);
+    Value *key = car(cdr(args));
+    HamtEntry *entry = findEntry(map->imap->root, hashEqual(key), key);
+    if (entry != NULL) {
+        return entry->value;
+    } else if (cdr(cdr(args))->type == CONS_TYPE) {
+        return car(cdr(cdr(args)));
+    }
+    primitiveError("imap-ref", "cannot find the key");
+    return NULL;
+}
+
+/*
+ * Implementing the Scheme primitives imap-set and imap-delete, which
+ * return a new map.
+ */
+Value *primitiveImapSet(Value *args) {
+    checkArity(args, 3, 3);
+    return imapSetValue(car(args), car(cdr(args)), car(cdr(cdr(args))));
+}
+
+Value *primitiveImapDelete(Value *args) {
+    checkArity(args, 2, 2);
+    Value *map = imapArgument("imap-delete", car(args), false, false);
+    return removeKey(map, car(cdr(args)));
+}
+
+/*
+ * Implementing the Scheme primitive imap-update, which returns a new
+ * map where the key has (f value), the value being the default if the
+ * key is not there: (imap-update m k f [default]).
+ */
+Value *primitiveImapUpdate(Value *args) {
+    checkArity(args, 3, 4);
+    Value *map = imapArgument("imap-update", car(args), false, false);
+    Value *key = car(cdr(args));
+    Value *function = car(cdr(cdr(args)));
+    HamtEntry *entry = findEntry(map->imap->root, hashEqual(key), key);
+    Value *value = NULL;
+    if (entry != NULL) {
+        value = entry->value;
+    } else if (cdr(cdr(cdr(args)))->type == CONS_TYPE) {
+        value = car(cdr(cdr(cdr(args))));
+    } else {
+        primitiveError("imap-update", "cannot find the key");
+    }
+    return addKey(map, key, apply(function, cons(value, makeNull())));
+}
+
+/*
+ * Implementing the Scheme primitives imap-contains? and imap-size.
+ */
+Value *primitiveImapContains(Value *args) {
+    checkArity(args, 2, 2);
+    return imapContains(car(args), car(cdr(args)));
+}
+
+Value *primitiveImapSize(Value *args) {
+    checkArity(args, 1, 1);
+    return makeInteger(readableArgument("imap-size", car(args),
+                                        false)->imap->count);
+}
+
+/*
+ * Helper functions to collect keys, values, and pairs into a list.
+ */
+void collectKey(Value *key, Value *value, void *state) {
+    (void) value;
+    *(Value **) state = cons(key, *(Value **) state);
+}
+
+void collectValue(Value *key, Value *value, void *state) {
+    (void) key;
+    *(Value **) state = cons(value, *(Value **) state);
+}
+
+void collectPair(Value *key, Value *value, void *state) {
+    *(Value **) state = cons(cons(key, value), *(Value **) state);
+}
+
+/*
+ * Helper function to list what the given function collects from each
+ * entry of a map or set.
+ */
+Value *collectEntries(char *name, Value *args, bool isSet,
+                      void (*collect)(Value *, Value *, void *)) {
+    checkArity(args, 1, 1);
+    Value *map = readableArgument(name, car(args), isSet);
+    Value *list = makeNull();
+    visitEntries(map->imap->root, collect, &list);
+    return list;
+}
+
+/*
+ * Implementing the Scheme primitives imap-keys, imap-values, and
+ * imap->alist. The order is that of the hashes of the keys.
+ */
+Value *primitiveImapKeys(Value *args) {
+    return collectEntries("imap-keys", args, false, collectKey);
+}
+
+Value *primitiveImapValues(Value *args) {
+    return collectEntries("imap-values", args, false, collectValue);
+}
+
+Value *primitiveImapToAlist(Value *args) {
+    return collectEntries("imap->alist", args, false, collectPair);
+}
+
+/* What imap-fold carries from one entry to the next. */
+struct FoldState {
+    Value *function;
+    Value *result;
+};
+
+/*
+ * Helper function to call the procedure of imap-fold on one entry.
+ */
+void foldEntry(Value *key, Value *value, void *state) {
+    struct FoldState *fold = state;
+    fold->result = apply(fold->function,
+                         cons(key, cons(value, cons(fold->result, makeNull()))));
+}
+
+/*
+ * Implementing the Scheme primitive imap-fold: (imap-fold f init m)
+ * calls (f key value result) for each entry.
+ */
+Value *primitiveImapFold(Value *args) {
+    checkArity(args, 3, 3);
+    Value *map = readableArgument("imap-fold", car(cdr(cdr(args))), false);
+    struct FoldState fold = {car(args), car(cdr(args))};
+    visitEntries(map->imap->root, foldEntry, &fold);
+    return fold.result;
+}
+
+/*
+ * Implementing the Scheme primitive alist->imap. A key that appears
+ * more than once keeps its first value, as assoc would find it.
+ */
+Value *primitiveAlistToImap(Value *args) {
+    checkArity(args, 1, 1);
+    Value *map = makeImap(NULL, 0, false, makeEditToken());
+    Value *cur = car(args);
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *pair = car(cur);
+        if (pair->type != CONS_TYPE) {
+            primitiveError("alist->imap", "expects a list of pairs as input");
+        }
+        Value *key = car(pair);
+        if (findEntry(map->imap->root, hashEqual(key), key) == NULL) {
+            addKey(map, key, cdr(pair));
+        }
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError("alist->imap", "expects a list of pairs as input");
+    }
+    return makeImap(map->imap->root, map->imap->count, false, NULL);
+}
+
+/*
+ * Helper function to start a transient from a map or set. It shares
+ * every node with the original, and copies each once before changing
+ * it.
+ */
+Value *startTransient(char *name, Value *args, bool isSet) {
+    checkArity(args, 1, 1);
+    Value *map = imapArgument(name, car(args), isSet, false);
+    return makeImap(map->imap->root, map->imap->count, isSet, makeEditToken());
+}
+
+/*
+ * Helper function to finish a transient. Dropping its edit token means
+ * no later change can touch the nodes it made.
+ */
+Value *finishTransient(char *name, Value *args, bool isSet) {
+    checkArity(args, 1, 1);
+    Value *transient = imapArgument(name, car(args), isSet, true);
+    transient->imap->edit = NULL;
+    return makeImap(transient->imap->root, transient->imap->count, isSet, NULL);
+}
+
+/*
+ * Implementing the Scheme primitives imap-transient, imap-set!,
+ * imap-delete!, and imap-persistent!.
+ */
+Value *primitiveImapTransient(Value *args) {
+    return startTransient("imap-transient", args, false);
+}
+
+Value *primitiveImapSetInPlace(Value *args) {
+    checkArity(args, 3, 3);
+    Value *map = imapArgument("imap-set!", car(args), false, true);
+    addKey(map, car(cdr(args)), car(cdr(cdr(args))));
+    return makeVoid();
+}
+
+Value *primitiveImapDeleteInPlace(Value *args) {
+    checkArity(args, 2, 2);
+    Value *map = imapArgument("imap-delete!", car(args), false, true);
+    removeKey(map, car(cdr(args)));
+    return makeVoid();
+}
+
+Value *primitiveImapPersistent(Value *args) {
+    return finishTransient("imap-persistent!", args, false);
+}
+
+/*
+ * Implementing the Scheme primitive iset, which makes a set of its
+ * arguments.
+ */
+Value *primitiveIset(Value *args) {
+    Value *set = makeImap(NULL, 0, true, makeEditToken());
+    for (Value *cur = args; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        addKey(set, car(cur), makeBoolean(true));
+    }
+    return makeImap(set->imap->root, set->imap->count, true, NULL);
+}
+
+/*
+ * Implementing the Scheme primitive iset?.
+ */
+Value *primitiveIsIset(Value *args) {
+    checkArity(args, 1, 1);
+    Value *value = car(args);
+    return makeBoolean(value->type == IMAP_TYPE && value->imap->isSet);
+}
+
+/*
+ * Implementing the Scheme primitives iset-add and iset-remove, which
+ * return a new set.
+ */
+Value *primitiveIsetAdd(Value *args) {
+    checkArity(args, 2, 2);
+    Value *set = imapArgument("iset-add", car(args), true, false);
+    return addKey(set, car(cdr(args)), makeBoolean(true));
+}
+
+Value *primitiveIsetRemove(Value *args) {
+    checkArity(args, 2, 2);
+    Value *set = imapArgument("iset-remove", car(args), true, false);
+    return removeKey(set, car(cdr(args)));
+}
+
+/*
+ * Implementing the Scheme primitives iset-contains?, iset-size, and
+ * iset->list.
+ */
+Value *primitiveIsetContains(Value *args) {
+    checkArity(args, 2, 2);
+    Value *set = readableArgument("iset-contains?", car(args), true);
+    Value *item = car(cdr(args));
+    HamtEntry *entry = findEntry(set->imap->root, hashEqual(item), item);
+    return makeBoolean(entry != NULL);
+}
+
+Value *primitiveIsetSize(Value *args) {
+    checkArity(args, 1, 1);
+    return makeInteger(readableArgument("iset-size", car(args),
+                                        true)->imap->count);
+}
+
+Value *primitiveIsetToList(Value *args) {
+    return collectEntries("iset->list", args, true, collectKey);
+}
+
+/*
+ * Implementing the Scheme primitive list->iset.
+ */
+Value *primitiveListToIset(Value *args) {
+    checkArity(args, 1, 1);
+    Value *cur = car(args);
+    while (cur->type == CONS_TYPE) {
+        cur = cdr(cur);
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError("list->iset", "expects a list as input");
+    }
+    return primitiveIset(car(args));
+}
+
+/*
+ * Implementing the Scheme primitives iset-transient, iset-add!,
+ * iset-remove!, and iset-persistent!.
+ */
+Value *primitiveIsetTransient(Value *args) {
+    return startTransient("iset-transient", args, true);
+}
+
+Value *primitiveIsetAddInPlace(Value *args) {
+    checkArity(args, 2, 2);
+    Value *set = imapArgument("iset-add!", car(args), true, true);
+    addKey(set, car(cdr(args)), makeBoolean(true));
+    return makeVoid();
+}
+
+Value *primitiveIsetRemoveInPlace(Value *args) {
+    checkArity(args, 2, 2);
+    Value *set = imapArgument("iset-remove!", car(args), true, true);
+    removeKey(set, car(cdr(args)));
+    return makeVoid();
+}
+
+Value *primitiveIsetPersistent(Value *args) {
+    return finishTransient("iset-persistent!", args, true);
+}
+
+/*
+ * Bind the map and set primitives in the given top-level frame.
+ */
+void bindHamtPrimitives(Frame *topFrame) {
+    bind("imap", primitiveImap, topFrame);
+    bind("imap?", primitiveIsImap, topFrame);
+    bind("imap-ref", primitiveImapRef, topFrame);
+    bind("imap-set", primitiveImapSet, topFrame);
+    bind("imap-delete", primitiveImapDelete, topFrame);
+    bind("imap-update", primitiveImapUpdate, topFrame);
+    bind("imap-contains?", primitiveImapContains, topFrame);
+    bind("imap-size", primitiveImapSize, topFrame);
+    bind("imap-keys", primitiveImapKeys, topFrame);
+    bind("imap-values", primitiveImapValues, topFrame);
+    bind("imap-fold", primitiveImapFold, topFrame);
+    bind("imap->alist", primitiveImapToAlist, topFrame);
+    bind("alist->imap", primitiveAlistToImap, topFrame);
+    bind("imap-transient", primitiveImapTransient, topFrame);
+    bind("imap-set!", primitiveImapSetInPlace, topFrame);
+    bind("imap-delete!", primitiveImapDeleteInPlace, topFrame);
+    bind("imap-persistent!", primitiveImapPersistent, topFrame);
+    bind("iset", primitiveIset, topFrame);
+    bind("iset?", primitiveIsIset, topFrame);
+    bind("iset-add", primitiveIsetAdd, topFrame);
+    bind("iset-remove", primitiveIsetRemove, topFrame);
+    bind("iset-contains?", primitiveIsetContains, topFrame);
+    bind("iset-size", primitiveIsetSize, topFrame);
+    bind("iset->list", primitiveIsetToList, topFrame);
+    bind("list->iset", primitiveListToIset, topFrame);
+    bind("iset-transient", primitiveIsetTransient, topFrame);
+    bind("iset-add!", primitiveIsetAddInPlace, topFrame);
+    bind("iset-remove!", primitiveIsetRemoveInPlace, topFrame);
+    bind("iset-persistent!", primitiveIsetPersistent, topFrame);
+}
@@ -0,0 +1,78 @@
+/*
+ * This program implements persistent maps and sets as hash array
+ * mapped tries. Adding or removing a key makes a new version that
+ * shares all but one path of nodes with the old one, so every version
+ * stays valid and each change takes O(log32 n) time.
+ */
+#include "value.h"
+
+#ifndef HAMT_H
+#define HAMT_H
+
+/*
+ * Look up, add, and test for a key, for the interpreter and for
+ * compiled programs to call directly.
+ */
+Value *imapRefDefault(Value *map, Value *key, Value *fallback);
+Value *imapSetValue(Value *map, Value *key, Value *value);
+Value *imapContains(Value *map, Value *key);
+
+/*
+ * Print a map or set.
+ */
+void displayImap(Value *map);
+
+/*
+ * The primitives below, for compiled programs.
+ */
+Value *primitiveImap(Value *args);
+Value *primitiveIsImap(Value *args);
+Value *primitiveImapRef(Value *args);
+Value *primitiveImapSet(Value *args);
+Value *primitiveImapDelete(Value *args);
+Value *primitiveImapUpdate(Value *args);
+Value *primitiveImapContains(Value *args);
+Value *primitiveImapSize(Value *args);
+Value *primitiveImapKeys(Value *args);
+Value *primitiveImapValues(Value *args);
+Value *primitiveImapFold(Value *args);
+Value *primitiveImapToAlist(Value *args);
+Value *primitiveAlistToImap(Value *args);
+Value *primitiveImapTransient(Value *args);
+Value *primitiveImapSetInPlace(Value *args);
+Value *primitiveImapDeleteInPlace(Value *args);
+Value *primitiveImapPersistent(Value *args);
+Value *primitiveIset(Value *args);
+Value *primitiveIsIset(Value *args);
+Value *primitiveIsetAdd(Value *args);
+Value *primitiveIsetRemove(Value *args);
+Value *primitiveIsetContains(Value *args);
+Value *primitiveIsetSize(Value *args);
+Value *primitiveIsetToList(Value *args);
+Value *primitiveListToIset(Value *args);
+Value *primitiveIsetTransient(Value *args);
+Value *primitiveIsetAddInPlace(Value *args);
+Value *primitiveIsetRemoveInPlace(Value *args);
+Value *primitiveIsetPersistent(Value *args);
+
+/*
+ * Bind the map and set primitives in the given top-level frame. Keys
+ * are compared with equal?.
+ *
+ *   imap k v ...  imap? imap-ref m k [default] imap-set imap-delete
+ *   imap-update m k f [default] imap-contains? imap-size imap-keys
+ *   imap-values imap-fold f init m   calls (f key value result)
+ *   imap->alist alist->imap
+ *   imap-transient imap-set! imap-delete! imap-persistent!
+ *
+ *   iset x ...  iset? iset-add iset-remove iset-contains? iset-size
+ *   iset->list list->iset
+ *   iset-transient iset-add! iset-remove! iset-persistent!
+ *
+ * A transient is a private copy of a map or set that the ! procedures
+ * change in place, for building one quickly. Once made persistent it
+ * cannot be used again.
+ */
+void bindHamtPrimitives(Frame *topFrame);
+
+#endif
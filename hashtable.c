@@ -0,0 +1,544 @@
+/*
+ * This program implements open-addressing hash tables keyed on
+ * Scheme values, used by the evaluator for constant-time lookups.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "hashtable.h"
+#include "bignum.h"
+#include "talloc.h"
+
+/* How many old slots each insertion moves while a table grows. */
+#define MIGRATE_STEP 4
+
+/* Marks a slot of the old slots whose entry has moved or been deleted. */
+static Value movedKey;
+#define MOVED_KEY (&movedKey)
+
+/*
+ * Helper function to hash a NUL-terminated string (FNV-1a).
+ */
+unsigned long hashString(char *s) {
+    unsigned long hash = 14695981039346656037UL;
+    for (unsigned char *cur = (unsigned char *) s; *cur; cur++) {
+        hash ^= *cur;
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+/*
+ * Helper function to hash a run of bytes (FNV-1a).
+ */
+unsigned long hashBytes(char *bytes, int64_t length) {
+    unsigned long hash = 14695981039346656037UL;
+    for (int64_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) bytes[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+/*
+ * Helper function to scramble the bits of an integer key so that
+ * nearby keys spread over the whole table.
+ */
+unsigned long mixBits(unsigned long key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdUL;
+    key ^= key >> 33;
+    return key;
+}
+
+/*
+ * Hash values the way eq? compares them.
+ */
+unsigned long hashEqv(Value *value) {
+    switch (value->type) {
+        case INT_TYPE:
+            return mixBits((unsigned long) value->i);
+        case BIGNUM_TYPE:
+            return mixBits(hashBignum(value));
+        case DOUBLE_TYPE: {
+            double d = value->d;
+            unsigned long bits;
+            if (d == 0) {
+                d = 0;
+            }
+            memcpy(&bits, &d, sizeof(bits));
+            return mixBits(bits);
+        }
+        case CHAR_TYPE:
+            return mixBits((unsigned long) value->i) + CHAR_TYPE;
+        case BOOL_TYPE:
+        case SYMBOL_TYPE:
+            return hashString(value->s) + value->type;
+        case STR_TYPE:
+            return hashBytes(value->str.chars, value->str.length) + STR_TYPE;
+        case NULL_TYPE:
+            return NULL_TYPE;
+        default:
+            return hashPointer(value);
+    }
+}
+
+/*
+ * Compare values the way eq? does.
+ */
+bool isEqv(Value *first, Value *second) {
+    if (first->type != second->type) {
+        return false;
+    }
+    switch (first->type) {
+        case INT_TYPE:
+            return first->i == second->i;
+        case BIGNUM_TYPE:
+            return compareExact(first, second) == 0;
+        case DOUBLE_TYPE:
+            return first->d == second->d;
+        case CHAR_TYPE:
+            return first->i == second->i;
+        case BOOL_TYPE:
+        case SYMBOL_TYPE:
+            return !strcmp(first->s, second->s);
+        case STR_TYPE:
+            return first->str.length == second->str.length &&
+                   !memcmp(first->str.chars, second->str.chars, first->str.length);
+        case NULL_TYPE:
+            return true;
+        default:
+            return first == second;
+    }
+}
+
+/*
+ * Helper function to find the size in bytes of the elements of a
+ * numeric vector.
+ */
+int numVectorElementSize(Value *vector) {
+    return vector->numvec.kind == U8_VECTOR ? 1 : 8;
+}
+
+/*
+ * Helper function to hash a value that equal? compares as a whole:
+ * a numeric vector by its elements, anything else as eq? does.
+ */
+unsigned long hashEqualLeaf(Value *value) {
+    if (value->type != NUMVECTOR_TYPE) {
+        return hashEqv(value);
+    }
+    unsigned long hash = 14695981039346656037UL + value->numvec.kind;
+    unsigned char *bytes = value->numvec.data;
+    int64_t size = value->numvec.length * numVectorElementSize(value);
+    for (int64_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+/* The values equal? and its hash have still to visit. It starts in a
+ * buffer on the C stack and moves to a larger one when that fills, so
+ * deeply nested structures cannot overflow the C stack. */
+typedef struct WalkStack {
+    Value **items;
+    int64_t size;
+    int64_t capacity;
+} WalkStack;
+
+/* The number of values a walk holds before it allocates. */
+#define WALK_BUFFER 64
+
+/*
+ * Helper function to add a value to the values a walk has to visit.
+ */
+void pushWalk(WalkStack *stack, Value *value) {
+    if (stack->size == stack->capacity) {
+        Value **items = talloc(sizeof(Value *) * stack->capacity * 2);
+        if (!items) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        memcpy(items, stack->items, sizeof(Value *) * stack->size);
+        stack->items = items;
+        stack->capacity *= 2;
+    }
+    stack->items[stack->size++] = value;
+}
+
+/* The number of values the hash of equal? mixes in. Stopping there
+ * keeps it from running forever on circular structures, and values
+ * equal? considers the same still agree on their first values. */
+#define HASH_BOUND 4096
+
+/* The number of pairs and vectors equal? compares before it starts to
+ * keep track of the ones it has met, so that it stops on circular
+ * structures too. */
+#define EQUAL_BOUND 10000
+
+/*
+ * Hash values the way equal? compares them. Pairs and vectors are
+ * visited in order with an explicit stack, and each of the first
+ * HASH_BOUND values met mixes its type, or its own hash, into the
+ * result.
+ */
+unsigned long hashEqual(Value *value) {
+    if (value->type != CONS_TYPE && value->type != VECTOR_TYPE) {
+        return hashEqualLeaf(value);
+    }
+    Value *buffer[WALK_BUFFER];
+    WalkStack stack = {buffer, 0, WALK_BUFFER};
+    unsigned long hash = value->type;
+    pushWalk(&stack, value);
+    for (int visited = 0; stack.size > 0 && visited < HASH_BOUND; visited++) {
+        Value *cur = stack.items[--stack.size];
+        if (cur->type == CONS_TYPE) {
+            hash = mixBits(hash ^ CONS_TYPE) + 1;
+            pushWalk(&stack, cur->c.cdr);
+            pushWalk(&stack, cur->c.car);
+        } else if (cur->type == VECTOR_TYPE) {
+            hash = mixBits(hash ^ (VECTOR_TYPE + cur->vec.length)) + 1;
+            for (int64_t i = cur->vec.length - 1; i >= 0; i--) {
+                pushWalk(&stack, cur->vec.items[i]);
+            }
+        } else {
+            hash = mixBits(hash ^ hashEqualLeaf(cur)) + 1;
+        }
+    }
+    return hash;
+}
+
+/*
+ * Helper function to find the representative of the class of pairs
+ * and vectors equal? has found to be the same as the given one,
+ * shortening the path to it on the way.
+ */
+Value *findClass(HashTable *classes, Value *value) {
+    Value *root = value;
+    Value *parent;
+    while ((parent = hashTableGet(classes, root)) != NULL) {
+        root = parent;
+    }
+    while (value != root) {
+        parent = hashTableGet(classes, value);
+        hashTablePut(classes, value, root);
+        value = parent;
+    }
+    return root;
+}
+
+/*
+ * Helper function to record that equal? is comparing two pairs or two
+ * vectors, by merging their classes.
+ *
+ * Returns whether they were in the same class already, in which case
+ * they are being compared elsewhere and need not be visited again.
+ */
+bool mergeClasses(HashTable *classes, Value *first, Value *second) {
+    first = findClass(classes, first);
+    second = findClass(classes, second);
+    if (first == second) {
+        return true;
+    }
+    hashTablePut(classes, first, second);
+    return false;
+}
+
+/*
+ * Compare values the way equal? does. The pairs of values still to
+ * compare are kept on an explicit stack, so neither long lists nor
+ * deep nesting use up the C stack. After EQUAL_BOUND pairs and
+ * vectors, the ones compared are merged into classes, and two already
+ * in the same class are taken to be equal, so that circular structures
+ * are compared in a number of steps bounded by their size.
+ */
+bool isEqual(Value *first, Value *second) {
+    Value *buffer[WALK_BUFFER];
+    WalkStack stack = {buffer, 0, WALK_BUFFER};
+    HashTable *classes = NULL;
+    int steps = 0;
+    pushWalk(&stack, first);
+    pushWalk(&stack, second);
+    while (stack.size > 0) {
+        second = stack.items[--stack.size];
+        first = stack.items[--stack.size];
+        if (first->type != second->type) {
+            return false;
+        }
+        if ((first->type == CONS_TYPE || first->type == VECTOR_TYPE) &&
+            first != second && steps++ >= EQUAL_BOUND) {
+            if (classes == NULL) {
+                classes = makeHashTable(16, hashPointer, isSamePointer);
+            }
+            if (mergeClasses(classes, first, second)) {
+                continue;
+            }
+        }
+        switch (first->type) {
+            case CONS_TYPE:
+                if (first == second) {
+                    break;
+                }
+                pushWalk(&stack, first->c.cdr);
+                pushWalk(&stack, second->c.cdr);
+                pushWalk(&stack, first->c.car);
+                pushWalk(&stack, second->c.car);
+                break;
+            case VECTOR_TYPE:
+                if (first == second) {
+                    break;
+                }
+                if (first->vec.length != second->vec.length) {
+                    return false;
+                }
+                for (int64_t i = first->vec.length - 1; i >= 0; i--) {
+                    pushWalk(&stack, first->vec.items[i]);
+                    pushWalk(&stack, second->vec.items[i]);
+                }
+                break;
+            case NUMVECTOR_TYPE:
+                if (first->numvec.kind != second->numvec.kind ||
+                    first->numvec.length != second->numvec.length ||
+                    memcmp(first->numvec.data, second->numvec.data,
+                           first->numvec.length *
+                           numVectorElementSize(first))) {
+                    return false;
+                }
+                break;
+            default:
+                if (!isEqv(first, second)) {
+                    return false;
+                }
+        }
+    }
+    return true;
+}
+
+/*
+ * Hash values by their address.
+ */
+unsigned long hashPointer(Value *value) {
+    return mixBits((unsigned long) (uintptr_t) value);
+}
+
+/*
+ * Compare values by their address.
+ */
+bool isSamePointer(Value *first, Value *second) {
+    return first == second;
+}
+
+/*
+ * Helper function to allocate the given number of empty slots.
+ */
+struct HashEntry *makeSlots(int count) {
+    struct HashEntry *entries = talloc(sizeof(struct HashEntry) * count);
+    if (!entries) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    memset(entries, 0, sizeof(struct HashEntry) * count);
+    return entries;
+}
+
+/*
+ * Create an empty hash table with room for at least the given number
+ * of entries, using the given hash and equality functions on keys.
+ */
+HashTable *makeHashTable(int capacity, unsigned long (*hash)(Value *),
+                         bool (*equals)(Value *, Value *)) {
+    HashTable *table = talloc(sizeof(HashTable));
+    if (!table) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    // Keep the table at most half full
+    int slots = 8;
+    while (slots < capacity * 2) {
+        slots *= 2;
+    }
+    table->entries = makeSlots(slots);
+    table->capacity = slots;
+    table->size = 0;
+    table->oldEntries = NULL;
+    table->oldCapacity = 0;
+    table->migrated = 0;
+    table->hash = hash;
+    table->equals = equals;
+    return table;
+}
+
+/*
+ * Helper function to find the slot for the given key among the current
+ * slots: either the slot holding the key or the empty slot where it
+ * would be inserted.
+ */
+struct HashEntry *findSlot(HashTable *table, Value *key) {
+    unsigned long mask = table->capacity - 1;
+    unsigned long index = table->hash(key) & mask;
+    while (true) {
+        struct HashEntry *entry = &table->entries[index];
+        if (entry->key == NULL || table->equals(entry->key, key)) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+/*
+ * Helper function to find the given key among the slots not yet moved
+ * out of the old slots while a table grows.
+ *
+ * Returns NULL if it is not there.
+ */
+struct HashEntry *findOldSlot(HashTable *table, Value *key) {
+    if (table->oldEntries == NULL) {
+        return NULL;
+    }
+    unsigned long mask = table->oldCapacity - 1;
+    unsigned long index = table->hash(key) & mask;
+    while (true) {
+        struct HashEntry *entry = &table->oldEntries[index];
+        if (entry->key == NULL) {
+            return NULL;
+        } else if (entry->key != MOVED_KEY && table->equals(entry->key, key)) {
+            return entry;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+/*
+ * Helper function to move up to `count' of the old slots of a growing
+ * table into the current ones. The moved slots are marked so that
+ * searches of the old slots still probe past them.
+ */
+void migrateSlots(HashTable *table, int count) {
+    while (table->oldEntries != NULL && count-- > 0) {
+        struct HashEntry *entry = &table->oldEntries[table->migrated];
+        if (entry->key != NULL && entry->key != MOVED_KEY) {
+            *findSlot(table, entry->key) = *entry;
+            entry->key = MOVED_KEY;
+        }
+        table->migrated++;
+        if (table->migrated == table->oldCapacity) {
+            table->oldEntries = NULL;
+            table->oldCapacity = 0;
+            table->migrated = 0;
+        }
+    }
+}
+
+/*
+ * Helper function to double the number of slots of a table. The
+ * entries move over a few at a time on later insertions, so no single
+ * insertion pays for copying the whole table.
+ */
+void growHashTable(HashTable *table) {
+    migrateSlots(table, table->oldCapacity);
+    table->oldEntries = table->entries;
+    table->oldCapacity = table->capacity;
+    table->migrated = 0;
+    table->capacity *= 2;
+    table->entries = makeSlots(table->capacity);
+}
+
+/*
+ * Look up the given key.
+ *
+ * Returns the stored value, or NULL if the key is not in the table.
+ */
+void *hashTableGet(HashTable *table, Value *key) {
+    struct HashEntry *entry = findSlot(table, key);
+    if (entry->key != NULL) {
+        return entry->value;
+    }
+    entry = findOldSlot(table, key);
+    return entry == NULL ? NULL : entry->value;
+}
+
+/*
+ * Associate the given key with the given value, replacing any
+ * existing association.
+ */
+void hashTablePut(HashTable *table, Value *key, void *value) {
+    if ((table->size + 1) * 2 > table->capacity) {
+        growHashTable(table);
+    }
+    // Four slots per insertion empty the old slots before the next growth
+    migrateSlots(table, MIGRATE_STEP);
+    struct HashEntry *entry = findSlot(table, key);
+    if (entry->key == NULL) {
+        struct HashEntry *old = findOldSlot(table, key);
+        if (old != NULL) {
+            old->key = MOVED_KEY;
+        } else {
+            table->size++;
+        }
+        entry->key = key;
+    }
+    entry->value = value;
+}
+
+/*
+ * Remove the given key and its value from the table.
+ *
+ * Returns true if the key was in the table.
+ */
+bool hashTableDelete(HashTable *table, Value *key) {
+    struct HashEntry *old = findOldSlot(table, key);
+    if (old != NULL) {
+        old->key = MOVED_KEY;
+        table->size--;
+        return true;
+    }
+    struct HashEntry *entry = findSlot(table, key);
+    if (entry->key == NULL) {
+        return false;
+    }
+    // Shift later entries of the probe run back into the hole
+    unsigned long mask = table->capacity - 1;
+    unsigned long hole = entry - table->entries;
+    unsigned long next = hole;
+    table->entries[hole].key = NULL;
+    while (true) {
+        next = (next + 1) & mask;
+        struct HashEntry *cur = &table->entries[next];
+        if (cur->key == NULL) {
+            break;
+        }
+        unsigned long home = table->hash(cur->key) & mask;
+        bool stays = hole <= next ? hole < home && home <= next
+                                  : hole < home || home <= next;
+        if (!stays) {
+            table->entries[hole] = *cur;
+            cur->key = NULL;
+            hole = next;
+        }
+    }
+    table->size--;
+    return true;
+}
+
+/*
+ * Step through the entries of a table. `position' starts at 0 and is
+ * advanced past each entry returned.
+ *
+ * Returns false, without setting the key and value, after the last
+ * entry.
+ */
+bool hashTableNext(HashTable *table, int *position, Value **key, void **value) {
+    while (*position < table->oldCapacity + table->capacity) {
+        int index = (*position)++;
+        struct HashEntry *entry = index < table->oldCapacity
+                                  ? &table->oldEntries[index]
+                                  : &table->entries[index - table->oldCapacity];
+        if (entry->key != NULL && entry->key != MOVED_KEY) {
+            *key = entry->key;
+            *value = entry->value;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,90 @@
+/*
+ * This program implements open-addressing hash tables keyed on
+ * Scheme values, used by the evaluator for constant-time lookups.
+ */
+#include <stdbool.h>
+#include "value.h"
+
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+/* A single slot of a hash table; an empty slot has a NULL key. */
+struct HashEntry {
+    Value *key;
+    void *value;
+};
+
+struct HashTable {
+    struct HashEntry *entries;
+    int capacity;   /* The number of slots, always a power of two */
+    int size;       /* The number of keys in the table */
+    /* While the table grows, the slots it had before, whose entries
+     * are moved into `entries' a few at a time; NULL otherwise. */
+    struct HashEntry *oldEntries;
+    int oldCapacity;
+    int migrated;   /* The old slots before this one have been moved */
+    unsigned long (*hash)(Value *);
+    bool (*equals)(Value *, Value *);
+};
+
+typedef struct HashTable HashTable;
+
+/*
+ * Create an empty hash table with room for at least the given number
+ * of entries, using the given hash and equality functions on keys.
+ */
+HashTable *makeHashTable(int capacity, unsigned long (*hash)(Value *),
+                         bool (*equals)(Value *, Value *));
+
+/*
+ * Look up the given key.
+ *
+ * Returns the stored value, or NULL if the key is not in the table.
+ */
+void *hashTableGet(HashTable *table, Value *key);
+
+/*
+ * Associate the given key with the given value, replacing any
+ * existing association.
+ */
+void hashTablePut(HashTable *table, Value *key, void *value);
+
+/*
+ * Remove the given key and its value from the table.
+ *
+ * Returns true if the key was in the table.
+ */
+bool hashTableDelete(HashTable *table, Value *key);
+
+/*
+ * Step through the entries of a table, in no particular order.
+ * `position' starts at 0 and is advanced past each entry returned.
+ * The table must not change during the walk.
+ *
+ * Returns false, without setting the key and value, after the last
+ * entry.
+ */
+bool hashTableNext(HashTable *table, int *position, Value **key, void **value);
+
+/*
+ * Hash and compare values the way eq? does: numbers, booleans,
+ * symbols and strings by content, everything else by identity.
+ */
+unsigned long hashEqv(Value *value);
+bool isEqv(Value *first, Value *second);
+
+/*
+ * Hash and compare values the way equal? does: pairs, vectors, and
+ * numeric vectors by their contents, everything else as eq? does.
+ * Neither recurses, so any depth of nesting is safe.
+ */
+unsigned long hashEqual(Value *value);
+bool isEqual(Value *first, Value *second);
+
+/*
+ * Hash and compare values by identity only.
+ */
+unsigned long hashPointer(Value *value);
+bool isSamePointer(Value *first, Value *second);
+
+#endif
@@ -7,11 +7,33 @@
 #include <stdbool.h>
 #include <string.h>
 #include <assert.h>
+#include <math.h>
 #include "parser.h"
 #include "linkedlist.h"
 #include "interpreter.h"
 #include "talloc.h"
 #include "tokenizer.h"
+#include "hashtable.h"
+#include "bignum.h"
+#include "macro.h"
+#include "combinators.h"
+#include "lists.h"
+#include "feedback.h"
+#include "fixflo.h"
+#include "numvector.h"
+#include "bytevector.h"
+#include "vector.h"
+#include "dictionary.h"
+#include "hamt.h"
+#include "text.h"
+#include "record.h"
+#include "sort.h"
+#include "values.h"
+#include "promise.h"
+#include "memo.h"
+#include "weak.h"
+#include "numformat.h"
+#include "runtime.h"
 
 /*
  * Print a representation of the contents of a linked list.
@@ -22,16 +44,25 @@ void displayEval(Value *list, bool newline){
     while(cur != NULL){
 	switch(cur->type){
             case INT_TYPE:
-                printf("%i ",cur->i);
+                writeInteger(cur->i, stdout);
+                putchar(' ');
+                break;
+            case BIGNUM_TYPE:
+                printf("%s ", exactToString(cur));
                 break;
             case DOUBLE_TYPE:
-                printf("%f ",cur->d);
+                writeDouble(cur->d, stdout);
+                putchar(' ');
                 break;
             case STR_TYPE:
                 printf("\"");
-                printf("%s",cur->s);
+                fwrite(cur->str.chars, 1, cur->str.length, stdout);
                 printf("\" ");
                 break;
+            case CHAR_TYPE:
+                writeCharacter(cur->i, stdout);
+                putchar(' ');
+                break;
             case SYMBOL_TYPE:
                 printf("%s ",cur->s);
             	break;
@@ -63,8 +94,50 @@ void displayEval(Value *list, bool newline){
                 newline = false;
                 break;
             case CLOSURE_TYPE:
+            case COMPILED_TYPE:
+            case RECORD_PROCEDURE_TYPE:
+            case MEMOIZED_TYPE:
                 printf("#procedure ");
                 break;
+            case NUMVECTOR_TYPE:
+                displayNumVector(cur);
+                printf(" ");
+                break;
+            case HASHTABLE_TYPE:
+                displayDictionary();
+                printf(" ");
+                break;
+            case IMAP_TYPE:
+                displayImap(cur);
+                printf(" ");
+                break;
+            case RECORD_TYPE:
+            case RECORD_DESCRIPTOR_TYPE:
+                displayRecord(cur);
+                printf(" ");
+                break;
+            case PROMISE_TYPE:
+                displayPromise();
+                printf(" ");
+                break;
+            case WEAK_TYPE:
+                displayWeak(cur);
+                printf(" ");
+                break;
+            case VECTOR_TYPE:
+                printf("#(");
+                for (int64_t i = 0; i < cur->vec.length; i++) {
+                    Value *item = cur->vec.items[i];
+                    if (item->type == CONS_TYPE) {
+                        printf("(");
+                        displayEval(item, false);
+                        printf(") ");
+                    } else {
+                        displayEval(item, false);
+                    }
+                }
+                printf(") ");
+                break;
             default:
                 printf(" ");
                 break;     
@@ -90,6 +163,46 @@ void evaluationError(){
 }
 
 
+/*
+ * Helper function to report a wrong argument to a primitive, naming
+ * the primitive.
+ */
+void primitiveError(char *name, char *message) {
+    printf("%s %s\n", name, message);
+    evaluationError();
+}
+
+
+/*
+ * Helper function to check the number of arguments given to a
+ * procedure. A `maximum' of -1 means any number.
+ */
+void checkArgumentCount(int given, int minimum, int maximum) {
+    if (given >= minimum && (maximum < 0 || given <= maximum)) {
+        return;
+    }
+    if (maximum < 0) {
+        printf("Arity mismatch. Expected: at least %i. Given: %i. ", minimum,
+               given);
+    } else if (minimum == maximum) {
+        printf("Arity mismatch. Expected: %i. Given: %i. ", minimum, given);
+    } else {
+        printf("Arity mismatch. Expected: %i to %i. Given: %i. ", minimum,
+               maximum, given);
+    }
+    evaluationError();
+}
+
+
+/*
+ * Helper function to check the number of arguments of a primitive.
+ * A `maximum' of -1 means any number.
+ */
+void checkArity(Value *args, int minimum, int maximum) {
+    checkArgumentCount(length(args), minimum, maximum);
+}
+
+
 /* 
  * Helper function to verify that all formal parameters are 
  * identifiers.
@@ -130,6 +243,19 @@ char *containsDuplicate(Value *formals) {
 }
 
 
+/*
+ * Mark the given frame and all of its ancestors as captured, so that
+ * loop forms know they can no longer rebind its slots in place.
+ */
+void markCaptured(Frame *frame) {
+    Frame *cur = frame;
+    while (cur != NULL && !cur->captured) {
+        cur->captured = true;
+        cur = cur->parent;
+    }
+}
+
+
 /*
  * Helper function to lookup symbols in the given environment.
  */
@@ -198,7 +324,6 @@ Value *isBounded(Value *var, Frame *frame) {
     while (binding->type != NULL_TYPE){
        Value *curBinding = car(binding);
 	   Value *name = car(curBinding);
-	   Value *value = car(cdr(curBinding));
 	   assert(name->type == SYMBOL_TYPE);
 	   if (!strcmp(name->s, var->s)){
             return curBinding;	      
@@ -342,17 +467,17 @@ Value *evalBegin(Value *args, Frame *frame) {
     if (body->type == NULL_TYPE)
 	return result;
     while (cdr(body)->type != NULL_TYPE) {
-	Value *curValue = eval(car(body),frame);
+	eval(car(body),frame);
 	body = cdr(body); 
    }
    return eval(car(body),frame); 
 }
 
 /*
- * Helper function to evaluate the LET special form by 
- * creating bindings and then evaluate the body.
+ * Helper function to create the frame of a LET and bind its variables
+ * in it.
  */
-Value *evalLet(Value *args, Frame *frame){
+Frame *makeLetFrame(Value *args, Frame *frame){
     Value *cur = car(args);
     if (!isNull(cur) && cur->type != CONS_TYPE) {
         printf("Invalid syntax in 'let'. ");
@@ -362,7 +487,6 @@ Value *evalLet(Value *args, Frame *frame){
         printf("Empty body in 'let'. ");
         evaluationError();
     }
-    Value *body = cdr(args);
     Frame *frameG = talloc(sizeof(Frame));
     if (!frameG) {
         printf("Error! Not enough memory!\n");
@@ -370,6 +494,7 @@ Value *evalLet(Value *args, Frame *frame){
     }
     frameG->parent = frame;
     frameG->bindings = makeNull();
+    frameG->captured = false;
     while (cur != NULL && cur->type != NULL_TYPE){
         if (car(cur)->type != CONS_TYPE || length(car(cur)) != 2) {
             printf("Invalid syntax in 'let' bindings. ");
@@ -383,21 +508,14 @@ Value *evalLet(Value *args, Frame *frame){
 	    addBindingLocal(car(car(cur)), v, frameG);
 	    cur = cdr(cur);
     }
-    // Evaluate all expressions but 
-    // only return the last expression in body
-    while (cdr(body)->type != NULL_TYPE){
-        eval(car(body), frameG);
-        body = cdr(body);
-    }
-    body = car(body);
-    return eval(body, frameG);    
+    return frameG;
 }
 
 /*
- * Helper function to evaluate the LETREC special form by 
- * creating bindings and then evaluate the body.
+ * Helper function to create the frame of a LETREC and bind its
+ * variables in it.
  */
-Value *evalLetrec(Value *args, Frame *frame){
+Frame *makeLetrecFrame(Value *args, Frame *frame){
     Value *cur = car(args);
     if (!isNull(cur) && cur->type != CONS_TYPE) {
         printf("Invalid syntax in 'letrec'. ");
@@ -407,7 +525,6 @@ Value *evalLetrec(Value *args, Frame *frame){
         printf("Empty body in 'letrec'. ");
         evaluationError();
     }
-    Value *body = cdr(args);
     Frame *frameG = talloc(sizeof(Frame));
     if (!frameG) {
         printf("Error! Not enough memory!\n");
@@ -415,6 +532,7 @@ Value *evalLetrec(Value *args, Frame *frame){
     }
     frameG->parent = frame;
     frameG->bindings = makeNull();
+    frameG->captured = false;
     while (cur != NULL && cur->type != NULL_TYPE){
         if (car(cur)->type != CONS_TYPE || length(car(cur)) != 2) {
             printf("Invalid syntax in 'letrec' bindings. ");
@@ -428,21 +546,16 @@ Value *evalLetrec(Value *args, Frame *frame){
 	    addBindingLocal(car(car(cur)), v, frameG);
 	    cur = cdr(cur);
     }
-    // Evaluate all expressions but 
-    // only return the last expression in body
-    while (cdr(body)->type != NULL_TYPE){
-        eval(car(body), frameG);
-        body = cdr(body);
-    }
-    body = car(body);
-    return eval(body, frameG);    
+    return frameG;
 }
 
 /*
- * Helper function to evaluate the LET* special form by 
- * creating bindings and then evaluate the body.
+ * Helper function to create the frames of a LET* and bind its
+ * variables in them.
+ *
+ * Returns the innermost frame.
  */
-Value *evalLetstar(Value *args, Frame *frame){
+Frame *makeLetstarFrame(Value *args, Frame *frame){
     Value *cur = car(args);
     if (!isNull(cur) && cur->type != CONS_TYPE) {
         printf("Invalid syntax in 'let*'. ");
@@ -452,7 +565,6 @@ Value *evalLetstar(Value *args, Frame *frame){
         printf("Empty body in 'let*'. ");
         evaluationError();
     }
-    Value *body = cdr(args);
     Frame *lastFrame = frame;
     while (cur != NULL && cur->type != NULL_TYPE){   
     	Frame *frameG = talloc(sizeof(Frame));
@@ -462,6 +574,7 @@ Value *evalLetstar(Value *args, Frame *frame){
     	}
     	frameG->parent = lastFrame;
     	frameG->bindings = makeNull();
+    	frameG->captured = false;
     	if (car(cur)->type != CONS_TYPE || length(car(cur)) != 2) {
             printf("Invalid syntax in 'let*' bindings. ");
             evaluationError();
@@ -475,14 +588,450 @@ Value *evalLetstar(Value *args, Frame *frame){
     	lastFrame = frameG;
     	cur = cdr(cur);
     }
-    // Evaluate all expressions but 
-    // only return the last expression in body
+    return lastFrame;
+}
+
+/*
+ * Helper function to evaluate a body in the given frame and return
+ * the value of its last expression.
+ */
+Value *evalBody(Value *body, Frame *frame){
     while (cdr(body)->type != NULL_TYPE){
-        eval(car(body), lastFrame);
+        eval(car(body), frame);
         body = cdr(body);
     }
-    body = car(body);
-    return eval(body, lastFrame);    
+    return eval(car(body), frame);
+}
+
+/*
+ * Helper function to evaluate the LET special form by 
+ * creating bindings and then evaluate the body.
+ */
+Value *evalLet(Value *args, Frame *frame){
+    return evalBody(cdr(args), makeLetFrame(args, frame));
+}
+
+/*
+ * Helper function to evaluate the LETREC special form by 
+ * creating bindings and then evaluate the body.
+ */
+Value *evalLetrec(Value *args, Frame *frame){
+    return evalBody(cdr(args), makeLetrecFrame(args, frame));
+}
+
+/*
+ * Helper function to evaluate the LET* special form by 
+ * creating bindings and then evaluate the body.
+ */
+Value *evalLetstar(Value *args, Frame *frame){
+    return evalBody(cdr(args), makeLetstarFrame(args, frame));
+}
+
+/*
+ * The analyzed form of a CASE expression: every datum of every clause
+ * is indexed so that dispatch takes one lookup.
+ */
+struct CaseTable {
+    HashTable *bodies;   /* Maps each datum to the body of its clause */
+    Value *elseBody;     /* The body of the else clause, or NULL */
+};
+
+/* Analyzed CASE expressions, keyed by the address of their clauses. */
+static HashTable *caseTables;
+
+/*
+ * Helper function to build the dispatch table of a CASE expression
+ * from its list of clauses.
+ */
+struct CaseTable *analyzeCase(Value *clauses) {
+    struct CaseTable *analyzed = talloc(sizeof(struct CaseTable));
+    if (!analyzed) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    analyzed->bodies = makeHashTable(length(clauses), hashEqv, isEqv);
+    analyzed->elseBody = NULL;
+    for (Value *cur = clauses; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *clause = car(cur);
+        if (clause->type != CONS_TYPE || cdr(clause)->type != CONS_TYPE) {
+            printf("Invalid syntax in 'case' clause. ");
+            evaluationError();
+        }
+        Value *data = car(clause);
+        if (data->type == SYMBOL_TYPE && !strcmp(data->s, "else")) {
+            if (cdr(cur)->type != NULL_TYPE) {
+                printf("Error! 'Else' clause must be last\n");
+                evaluationError();
+            }
+            analyzed->elseBody = cdr(clause);
+        } else if (data->type == CONS_TYPE || data->type == NULL_TYPE) {
+            for (; data->type != NULL_TYPE; data = cdr(data)) {
+                // The first clause listing a datum wins
+                if (!hashTableGet(analyzed->bodies, car(data))) {
+                    hashTablePut(analyzed->bodies, car(data), cdr(clause));
+                }
+            }
+        } else {
+            printf("Invalid syntax in 'case'. Expected a list of data. ");
+            evaluationError();
+        }
+    }
+    return analyzed;
+}
+
+/*
+ * Helper function to evaluate the key of a CASE expression and choose
+ * the body of the clause it selects.
+ *
+ * Returns the body, or NULL if no clause matches.
+ */
+Value *chooseCaseBody(Value *args, Frame *frame) {
+    if (args->type != CONS_TYPE) {
+        printf("Invalid syntax in 'case'. ");
+        evaluationError();
+    }
+    if (!caseTables) {
+        caseTables = makeHashTable(16, hashPointer, isSamePointer);
+    }
+    struct CaseTable *analyzed = hashTableGet(caseTables, cdr(args));
+    if (!analyzed) {
+        analyzed = analyzeCase(cdr(args));
+        hashTablePut(caseTables, cdr(args), analyzed);
+    }
+    Value *key = eval(car(args), frame);
+    Value *body = hashTableGet(analyzed->bodies, key);
+    if (!body) {
+        body = analyzed->elseBody;
+    }
+    return body;
+}
+
+/*
+ * Helper function to evaluate the CASE special form. The clauses are
+ * analyzed into a hash table the first time the expression runs, so
+ * dispatch does not depend on the number of clauses.
+ */
+Value *evalCase(Value *args, Frame *frame) {
+    Value *body = chooseCaseBody(args, frame);
+    if (!body) {
+        return evalBegin(makeNull(), frame);
+    }
+    return evalBegin(body, frame);
+}
+
+/*
+ * Helper function for the loop forms. Stores the new values of the
+ * given variables in the loop frame: in place when no closure has
+ * captured the frame, and otherwise in a fresh frame so that earlier
+ * closures keep seeing the bindings of their own iteration.
+ *
+ * Returns the frame holding the new bindings.
+ */
+Frame *rebindLoopFrame(Value *vars, Value **values, Frame *loopFrame) {
+    Frame *target = loopFrame;
+    if (loopFrame->captured) {
+        target = talloc(sizeof(Frame));
+        if (!target) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        target->parent = loopFrame->parent;
+        target->bindings = makeNull();
+        target->captured = false;
+        // Carry over the variables that are not being updated
+        Value *old = loopFrame->bindings;
+        while (old->type != NULL_TYPE) {
+            Value *name = car(car(old));
+            addBindingLocal(name, car(cdr(car(old))), target);
+            old = cdr(old);
+        }
+    }
+    int i = 0;
+    for (Value *cur = vars; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (values[i] != NULL) {
+            Value *binding = isBounded(car(cur), target);
+            assert(binding != NULL);
+            binding->c.cdr->c.car = values[i];
+        }
+        i++;
+    }
+    return target;
+}
+
+/*
+ * Helper function to evaluate the body of a named LET as a loop. 
+ * Expressions in tail position are followed through IF, COND, CASE,
+ * BEGIN, AND, OR, LET, LET*, and LETREC; a tail call to the loop name
+ * rebinds the loop variables and restarts the body instead of applying
+ * the closure.
+ */
+Value *evalLoopBody(Value *name, Value *loop, Value *vars, Value *body,
+                    Frame *loopFrame) {
+    int count = length(vars);
+    Value *values[count > 0 ? count : 1];
+    while (true) {
+        // The frame of the tail expression, below the loop frame when
+        // it is inside a LET
+        Frame *env = loopFrame;
+        Value *cur = body;
+        while (cdr(cur)->type != NULL_TYPE) {
+            eval(car(cur), env);
+            cur = cdr(cur);
+        }
+        Value *tail = car(cur);
+        bool restart = false;
+        while (!restart) {
+            if (tail->type != CONS_TYPE || car(tail)->type != SYMBOL_TYPE) {
+                return eval(tail, env);
+            }
+            Value *first = car(tail);
+            Value *args = cdr(tail);
+            if (!strcmp(first->s, "if")) {
+                if (length(args) != 3 && length(args) != 2) {
+                    printf("Number of arguments for 'if' has to be 2 or 3. ");
+                    evaluationError();
+                }
+                Value *test = eval(car(args), env);
+                if (test->type == BOOL_TYPE && !strcmp(test->s, "#f")) {
+                    if (cdr(cdr(args))->type == NULL_TYPE) {
+                        return evalBegin(makeNull(), env);
+                    }
+                    tail = car(cdr(cdr(args)));
+                } else {
+                    tail = car(cdr(args));
+                }
+            } else if (!strcmp(first->s, "begin")) {
+                if (args->type == NULL_TYPE) {
+                    return evalBegin(args, env);
+                }
+                while (cdr(args)->type != NULL_TYPE) {
+                    eval(car(args), env);
+                    args = cdr(args);
+                }
+                tail = car(args);
+            } else if (!strcmp(first->s, "and") || !strcmp(first->s, "or")) {
+                bool isAnd = !strcmp(first->s, "and");
+                if (args->type == NULL_TYPE) {
+                    return makeBoolean(isAnd);
+                }
+                Value *result = NULL;
+                while (cdr(args)->type != NULL_TYPE) {
+                    Value *value = eval(car(args), env);
+                    bool isFalse = value->type == BOOL_TYPE &&
+                                   !strcmp(value->s, "#f");
+                    if (isFalse == isAnd) {
+                        result = value;
+                        break;
+                    }
+                    args = cdr(args);
+                }
+                if (result) {
+                    return result;
+                }
+                tail = car(args);
+            } else if (!strcmp(first->s, "case")) {
+                Value *chosen = chooseCaseBody(args, env);
+                if (chosen == NULL) {
+                    return evalBegin(makeNull(), env);
+                }
+                while (cdr(chosen)->type != NULL_TYPE) {
+                    eval(car(chosen), env);
+                    chosen = cdr(chosen);
+                }
+                tail = car(chosen);
+            } else if ((!strcmp(first->s, "let") &&
+                        (args->type != CONS_TYPE ||
+                         car(args)->type != SYMBOL_TYPE)) ||
+                       !strcmp(first->s, "let*") ||
+                       !strcmp(first->s, "letrec")) {
+                if (args->type != CONS_TYPE) {
+                    printf("Invalid syntax in '%s'. ", first->s);
+                    evaluationError();
+                }
+                if (!strcmp(first->s, "let")) {
+                    env = makeLetFrame(args, env);
+                } else if (!strcmp(first->s, "let*")) {
+                    env = makeLetstarFrame(args, env);
+                } else {
+                    env = makeLetrecFrame(args, env);
+                }
+                Value *letBody = cdr(args);
+                while (cdr(letBody)->type != NULL_TYPE) {
+                    eval(car(letBody), env);
+                    letBody = cdr(letBody);
+                }
+                tail = car(letBody);
+            } else if (!strcmp(first->s, "cond")) {
+                Value *clauses = args;
+                Value *chosen = NULL;
+                while (clauses->type != NULL_TYPE) {
+                    Value *test = car(car(clauses));
+                    if (test->type == SYMBOL_TYPE && !strcmp(test->s, "else")) {
+                        if (cdr(clauses)->type != NULL_TYPE) {
+                            printf("Error! 'Else' clause must be last\n");
+                            evaluationError();
+                        }
+                        chosen = cdr(car(clauses));
+                        break;
+                    }
+                    Value *testValue = eval(test, env);
+                    if (!(testValue->type == BOOL_TYPE && 
+                          !strcmp(testValue->s, "#f"))) {
+                        chosen = cdr(car(clauses));
+                        break;
+                    }
+                    clauses = cdr(clauses);
+                }
+                if (chosen == NULL) {
+                    return evalBegin(makeNull(), env);
+                }
+                while (cdr(chosen)->type != NULL_TYPE) {
+                    eval(car(chosen), env);
+                    chosen = cdr(chosen);
+                }
+                tail = car(chosen);
+            } else if (!strcmp(first->s, name->s) &&
+                       lookUpSymbol(first, env) == loop) {
+                if (length(args) != count) {
+                    printf("Expected %i arguments, supplied %i. ", 
+                           count, length(args));
+                    evaluationError();
+                }
+                int i = 0;
+                for (Value *arg = args; arg->type != NULL_TYPE; arg = cdr(arg)) {
+                    values[i++] = eval(car(arg), env);
+                }
+                loopFrame = rebindLoopFrame(vars, values, loopFrame);
+                restart = true;
+            } else {
+                return eval(tail, env);
+            }
+        }
+    }
+}
+
+/*
+ * Helper function to evaluate a named LET. The loop name is bound to
+ * a closure over the loop variables so that it can still be called
+ * from anywhere, but tail calls run as iterations of a single frame.
+ */
+Value *evalNamedLet(Value *args, Frame *frame) {
+    Value *name = car(args);
+    if (cdr(args)->type != CONS_TYPE) {
+        printf("Invalid syntax in 'let'. ");
+        evaluationError();
+    }
+    Value *cur = car(cdr(args));
+    if (!isNull(cur) && cur->type != CONS_TYPE) {
+        printf("Invalid syntax in 'let'. ");
+        evaluationError();
+    }
+    Value *body = cdr(cdr(args));
+    if (isNull(body)) {
+        printf("Empty body in 'let'. ");
+        evaluationError();
+    }
+    Frame *nameFrame = talloc(sizeof(Frame));
+    Frame *loopFrame = talloc(sizeof(Frame));
+    if (!nameFrame || !loopFrame) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    nameFrame->parent = frame;
+    nameFrame->bindings = makeNull();
+    nameFrame->captured = false;
+    loopFrame->parent = nameFrame;
+    loopFrame->bindings = makeNull();
+    loopFrame->captured = false;
+    Value *vars = makeNull();
+    while (cur->type != NULL_TYPE) {
+        if (car(cur)->type != CONS_TYPE || length(car(cur)) != 2) {
+            printf("Invalid syntax in 'let' bindings. ");
+            evaluationError();
+        }
+        if (car(car(cur))->type != SYMBOL_TYPE) {
+            printf("Invalid syntax in 'let'. Not a valid identifier! ");
+            evaluationError();
+        }    
+        Value *v = eval(car(cdr(car(cur))), frame);
+        addBindingLocal(car(car(cur)), v, loopFrame);
+        vars = cons(car(car(cur)), vars);
+        cur = cdr(cur);
+    }
+    vars = reverse(vars);
+    Value *loop = talloc(sizeof(Value));
+    if (!loop) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    loop->type = CLOSURE_TYPE;
+    loop->closure.formal = vars;
+    loop->closure.body = body;
+    loop->closure.frame = nameFrame;
+    addBindingLocal(name, loop, nameFrame);
+    return evalLoopBody(name, loop, vars, body, loopFrame);
+}
+
+/*
+ * Helper function to evaluate the DO special form. All variables
+ * live in one frame whose slots are updated in place after each
+ * iteration (see rebindLoopFrame).
+ */
+Value *evalDo(Value *args, Frame *frame) {
+    if (length(args) < 2 || (!isNull(car(args)) && car(args)->type != CONS_TYPE)
+        || car(cdr(args))->type != CONS_TYPE) {
+        printf("Invalid syntax in 'do'. ");
+        evaluationError();
+    }
+    Frame *loopFrame = talloc(sizeof(Frame));
+    if (!loopFrame) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    loopFrame->parent = frame;
+    loopFrame->bindings = makeNull();
+    loopFrame->captured = false;
+    Value *vars = makeNull();
+    Value *steps = makeNull();
+    for (Value *cur = car(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *spec = car(cur);
+        if (spec->type != CONS_TYPE || car(spec)->type != SYMBOL_TYPE ||
+            cdr(spec)->type != CONS_TYPE || length(spec) > 3) {
+            printf("Invalid syntax in 'do' bindings. ");
+            evaluationError();
+        }
+        Value *v = eval(car(cdr(spec)), frame);
+        addBindingLocal(car(spec), v, loopFrame);
+        vars = cons(car(spec), vars);
+        steps = cons(spec, steps);
+    }
+    vars = reverse(vars);
+    steps = reverse(steps);
+    int count = length(vars);
+    Value *values[count > 0 ? count : 1];
+    Value *test = car(car(cdr(args)));
+    Value *exprs = cdr(car(cdr(args)));
+    Value *body = cdr(cdr(args));
+    while (true) {
+        Value *testValue = eval(test, loopFrame);
+        if (!(testValue->type == BOOL_TYPE && !strcmp(testValue->s, "#f"))) {
+            return evalBegin(exprs, loopFrame);
+        }
+        for (Value *cur = body; cur->type != NULL_TYPE; cur = cdr(cur)) {
+            eval(car(cur), loopFrame);
+        }
+        int i = 0;
+        for (Value *cur = steps; cur->type != NULL_TYPE; cur = cdr(cur)) {
+            Value *step = cdr(cdr(car(cur)));
+            if (step->type == NULL_TYPE) {
+                values[i] = NULL;
+            } else {
+                values[i] = eval(car(step), loopFrame);
+            }
+            i++;
+        }
+        loopFrame = rebindLoopFrame(vars, values, loopFrame);
+    }
 }
 
 /*
@@ -582,26 +1131,16 @@ Value *evalSet(Value *args, Frame *frame){
     } 
     Frame *curFrame = frame;
     while (curFrame != NULL) {
-	    if (lookUpSymbol(car(args), curFrame)) {
-	        Value *newBindings = makeNull(); 
-	        Value *newValue = eval(car(cdr(args)),frame);
-   	        Value *oldBindings = curFrame->bindings;
-	        assert(oldBindings != NULL);
-    	    while (oldBindings->type != NULL_TYPE) {
-	    	    Value *curBinding = car(oldBindings);
-		        Value *name = car(curBinding);
-		        assert(name->type == SYMBOL_TYPE);
-	   	        if (!strcmp(name->s, car(args)->s)){
-		            curBinding = cons(name, cons(newValue, makeNull()));
-	    	    }
-		        newBindings = cons(curBinding, newBindings);
-       		    oldBindings = cdr(oldBindings);
-	        }
-	        curFrame->bindings = newBindings;
-	        return result;
-	    }
-	    curFrame = curFrame->parent;
+        Value *curBinding = isBounded(car(args), curFrame);
+        if (curBinding) {
+            Value *newValue = eval(car(cdr(args)), frame);
+            curBinding->c.cdr = cons(newValue, makeNull());
+            return result;
+        }
+        curFrame = curFrame->parent;
     }
+    printf("The symbol %s is unbounded! ", car(args)->s);
+    evaluationError();
     return result;
 }
 
@@ -634,144 +1173,130 @@ Value *evalLambda(Value *args, Frame *frame) {
     closure->closure.formal = car(args);
     closure->closure.body = cdr(args);
     closure->closure.frame = frame;
+    markCaptured(frame);
     return closure;
 }
 
 
 /*
- * Implementing the Scheme primitive +.
+ * Helper function to test whether a value is a number.
  */
-Value *primitiveAdd(Value *args) {
-    Value *result = talloc(sizeof(Value));
-    if (!result) {
-        printf("Error! Not enough memory!\n");
-        evaluationError();
+bool isNumber(Value *value) {
+    return value->type == INT_TYPE || value->type == DOUBLE_TYPE ||
+           value->type == BIGNUM_TYPE;
+}
+
+
+/*
+ * Helper function to read a number as a double.
+ */
+double numberValue(Value *value) {
+    if (value->type == DOUBLE_TYPE) {
+        return value->d;
     }
-    result->type = INT_TYPE;
-    double result_num = 0;    
-    Value *cur_arg = args; 
-    while (cur_arg->type != NULL_TYPE) {
-        Value *cur_num = car(cur_arg);
-        if (cur_num->type != INT_TYPE) {
-            if (cur_num->type == DOUBLE_TYPE) {
-                result->type = DOUBLE_TYPE;
-                result_num += cur_num->d;
-            } else {
-                printf("Expected numerical arguments for addition. ");
-                evaluationError();
+    return value->type == INT_TYPE ? value->i : exactToDouble(value);
+}
+
+
+/* The operations done by +, -, *, and /. */
+enum Operation { ADD, SUBTRACT, MULTIPLY, DIVIDE };
+
+
+/*
+ * Helper function to combine two numbers. Exact integers give exact
+ * results, growing into bignums when they overflow 64 bits, except for
+ * a division with a remainder. Anything involving a double is a double.
+ */
+Value *combineNumbers(Value *first, Value *second, enum Operation operation) {
+    if (isExactInteger(first) && isExactInteger(second)) {
+        switch (operation) {
+            case ADD:
+                return addExact(first, second);
+            case SUBTRACT:
+                return subtractExact(first, second);
+            case MULTIPLY:
+                return multiplyExact(first, second);
+            default: {
+                Value *quotient;
+                Value *remainder;
+                divideExact(first, second, &quotient, &remainder);
+                if (signOfExact(remainder) == 0) {
+                    return quotient;
+                }
+                break;
             }
-        } else {
-            result_num += cur_num->i;    
         }
-        cur_arg = cdr(cur_arg);
     }
-    
-    if (result->type == INT_TYPE) {
-        result->i = (int) result_num;
-    } else {
-        result->d = result_num;
+    double x = numberValue(first);
+    double y = numberValue(second);
+    switch (operation) {
+        case ADD:
+            return makeDouble(x + y);
+        case SUBTRACT:
+            return makeDouble(x - y);
+        case MULTIPLY:
+            return makeDouble(x * y);
+        default:
+            return makeDouble(x / y);
     }
-    return result;
 }
 
 
 /*
- * Implementing the Scheme primitive *.
+ * Helper function to combine the arguments of +, -, *, or / from left
+ * to right, starting with `result'.
  */
-Value *primitiveMult(Value *args) {
-    Value *result = talloc(sizeof(Value));
-    if (!result) {
-        printf("Error! Not enough memory!\n");
-        evaluationError();
-    }
-    result->type = INT_TYPE;
-    double result_num = 1;
-    
-    Value *cur_arg = args; 
-    while (cur_arg->type != NULL_TYPE) {
-        Value *cur_num = car(cur_arg);
-        if (cur_num->type != INT_TYPE) {
-            if (cur_num->type == DOUBLE_TYPE) {
-                result->type = DOUBLE_TYPE;
-                result_num *= cur_num->d;
-            } else {
-                printf("Expected numerical arguments for multiplication. ");
-                evaluationError();
-            }
-        } else {
-            result_num *= cur_num->i;    
+Value *foldNumbers(Value *result, Value *args, enum Operation operation,
+                   char *message) {
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *number = car(cur);
+        if (!isNumber(number)) {
+            printf("%s", message);
+            evaluationError();
         }
-        cur_arg = cdr(cur_arg);
-    }
-    
-    if (result->type == INT_TYPE) {
-        result->i = (int) result_num;
-    } else {
-        result->d = result_num;
+        if (operation == DIVIDE && numberValue(number) == 0) {
+            printf("/: division by 0. ");
+            evaluationError();
+        }
+        result = result ? combineNumbers(result, number, operation) : number;
     }
     return result;
 }
 
 
+/*
+ * Implementing the Scheme primitive +.
+ */
+Value *primitiveAdd(Value *args) {
+    Value *result = foldNumbers(NULL, args, ADD,
+                                "Expected numerical arguments for addition. ");
+    return result ? result : makeInteger(0);
+}
+
+
+/*
+ * Implementing the Scheme primitive *.
+ */
+Value *primitiveMult(Value *args) {
+    Value *result = foldNumbers(NULL, args, MULTIPLY,
+                                "Expected numerical arguments for multiplication. ");
+    return result ? result : makeInteger(1);
+}
+
+
 /*
  * Implementing the Scheme primitive -.
  */
 Value *primitiveSub(Value *args) {
-    Value *result = talloc(sizeof(Value));
-    if (!result) {
-        printf("Error! Not enough memory!\n");
-        evaluationError();
-    }
     if (length(args) == 0) {
         printf("Arity mismatch. Expected: at least 1. Given: 0. ");
         evaluationError();
     }
-
-    result->type = car(args)->type;
-    double result_num;
-    
-    if (result->type == INT_TYPE) {
-        if (length(args) == 1) {
-            result->i = 0 - car(args)->i;
-            return result;
-        } else {
-            result_num = car(args)->i;
-        } 
-    } else if (result->type == DOUBLE_TYPE) {
-        if (length(args) == 1) {
-            result->d = 0 - car(args)->d;
-            return result;
-        } else {
-            result_num = car(args)->d;
-        }
-    } else {
-        printf("Expected numerical arguments for subtraction. ");
-        evaluationError();
-    }
-
-    Value *cur_arg = cdr(args); 
-    while (cur_arg->type != NULL_TYPE) {
-        Value *cur_num = car(cur_arg);
-        if (cur_num->type != INT_TYPE) {
-            if (cur_num->type == DOUBLE_TYPE) {
-                result->type = DOUBLE_TYPE;
-                result_num -= cur_num->d;
-            } else {
-                printf("Expected numerical arguments for subtraction. ");
-                evaluationError();
-            }
-        } else {
-            result_num -= cur_num->i;    
-        }
-        cur_arg = cdr(cur_arg);
+    char *message = "Expected numerical arguments for subtraction. ";
+    if (cdr(args)->type == NULL_TYPE) {
+        return foldNumbers(makeInteger(0), args, SUBTRACT, message);
     }
-    
-    if (result->type == INT_TYPE) {
-        result->i = (int) result_num;
-    } else {
-        result->d = result_num;
-    }
-    return result;
+    return foldNumbers(NULL, args, SUBTRACT, message);
 }
 
 
@@ -779,77 +1304,19 @@ Value *primitiveSub(Value *args) {
  * Implementing the Scheme primitive /.
  */
 Value *primitiveDiv(Value *args) {
-    Value *result = talloc(sizeof(Value));
-    if (!result) {
-        printf("Error! Not enough memory!\n");
-        evaluationError();
-    }
     if (length(args) == 0) {
         printf("Arity mismatch. Expected: at least 1. Given: 0. ");
         evaluationError();
     }
-    result->type = car(args)->type;
-    double result_num;
-    
-    if (result->type == INT_TYPE) {
-        if (length(args) == 1) {
-            if (car(args)->i == 0) {
-                printf("/: division by 0. ");
-                evaluationError();
-            }
-            result->i = 1 / car(args)->i;
-            return result;
-        } else {
-            result_num = car(args)->i;
-        } 
-    } else if (result->type == DOUBLE_TYPE) {
-        if (length(args) == 1) {
-            if (car(args)->d == 0) {
-                printf("/: division by 0. ");
-                evaluationError();
-            }
-            result->d = 1 / car(args)->d;
-            return result;
-        } else {
-            result_num = car(args)->d;
-        }
-    } else {
-        printf("Expected numerical arguments for division. ");
-        evaluationError();
-    }
-
-    Value *cur_arg = cdr(args); 
-    while (cur_arg->type != NULL_TYPE) {
-        Value *cur_num = car(cur_arg);
-        if (cur_num->type != INT_TYPE) {
-            if (cur_num->type == DOUBLE_TYPE) {
-                result->type = DOUBLE_TYPE;
-                if (cur_num->d == 0) {
-                    printf("/: division by 0. ");
-                    evaluationError();
-                }   
-                result_num /= cur_num->d;
-            } else {
-                printf("Expected numerical arguments for subtraction. ");
-                evaluationError();
-            }
-        } else {
-            if (cur_num->i == 0) {
-                printf("/: division by 0. ");
-                evaluationError();
-            }
-            result_num /= cur_num->i;    
-        }
-        cur_arg = cdr(cur_arg);
+    char *message = "Expected numerical arguments for division. ";
+    if (cdr(args)->type == NULL_TYPE) {
+        return foldNumbers(makeInteger(1), args, DIVIDE, message);
     }
-
-    if (result->type == INT_TYPE && (int) result_num == result_num) {
-        result->i = result_num;
-    } else {
-        result->type = DOUBLE_TYPE;
-        result->d = result_num;
+    if (!isNumber(car(args))) {
+        printf("%s", message);
+        evaluationError();
     }
-    return result;
+    return foldNumbers(car(args), cdr(args), DIVIDE, message);
 }
 
 
@@ -920,62 +1387,536 @@ Value *primitiveCons(Value *args) {
 }
 
 
-/* 
- * Implementing the Scheme primitive <= function.
+/*
+ * Helper function to report a wrong argument to a procedure that used
+ * to be defined in math.scm, with the same message.
  */
-Value *primitiveLeq(Value *args) {
-    Value *result = talloc(sizeof(Value));
-    if (!result) {
-        printf("Error! Not enough memory!\n");
-        evaluationError();
+void libraryError(char *message) {
+    printf("%s\n", message);
+    evaluationError();
+}
+
+
+/* The comparisons done by =, <, >, >=, and <=. */
+enum Comparison {
+    NUM_EQUAL, NUM_LESS, NUM_GREATER, NUM_GREATER_EQUAL, NUM_LESS_EQUAL
+};
+
+
+/*
+ * Helper function to compare two numbers. Exact integers are compared
+ * exactly; otherwise both are compared as doubles.
+ */
+bool compareNumbers(Value *first, Value *second, enum Comparison comparison) {
+    if (!isExactInteger(first) || !isExactInteger(second)) {
+        double x = numberValue(first);
+        double y = numberValue(second);
+        switch (comparison) {
+            case NUM_EQUAL:
+                return x == y;
+            case NUM_LESS:
+                return x < y;
+            case NUM_GREATER:
+                return x > y;
+            case NUM_GREATER_EQUAL:
+                return x >= y;
+            default:
+                return x <= y;
+        }
+    }
+    int order;
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        order = (first->i > second->i) - (first->i < second->i);
+    } else {
+        order = compareExact(first, second);
+    }
+    switch (comparison) {
+        case NUM_EQUAL:
+            return order == 0;
+        case NUM_LESS:
+            return order < 0;
+        case NUM_GREATER:
+            return order > 0;
+        case NUM_GREATER_EQUAL:
+            return order >= 0;
+        default:
+            return order <= 0;
     }
+}
+
+
+/*
+ * Helper function to compare each pair of neighboring arguments in a
+ * single pass. All arguments are checked to be numbers, even after
+ * the result is known.
+ */
+Value *compareChain(Value *args, enum Comparison comparison, char *message) {
     if (length(args) < 2) {
-        printf("Arity mismatch. Expected: at least 2. Given: %i. ", 
+        printf("Arity mismatch. Expected: at least 2. Given: %i. ",
                length(args));
         evaluationError();
     }
-    result->type = BOOL_TYPE; 
-    result->s = "#t";
-    double cur_largest;
-    
-    if (car(args)->type == INT_TYPE) {
-        cur_largest = car(args)->i;
-    } else if (car(args)->type == DOUBLE_TYPE) {
-        cur_largest = car(args)->d;
-    } else {
-        printf("type: %i\n", car(args)->type);
-        printf("Expected numerical arguments for <=. ");
+    bool result = true;
+    Value *previous = car(args);
+    if (!isNumber(previous)) {
+        libraryError(message);
+    }
+    for (Value *cur = cdr(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *next = car(cur);
+        if (!isNumber(next)) {
+            libraryError(message);
+        }
+        if (result && !compareNumbers(previous, next, comparison)) {
+            result = false;
+        }
+        previous = next;
+    }
+    return makeBoolean(result);
+}
+
+
+/* 
+ * Implementing the Scheme primitive <= function.
+ */
+Value *primitiveLeq(Value *args) {
+    return compareChain(args, NUM_LESS_EQUAL,
+                        "Expected numerical arguments for <=.");
+}
+
+
+/*
+ * Implementing the Scheme primitive = function.
+ */
+Value *primitiveNumEqual(Value *args) {
+    return compareChain(args, NUM_EQUAL, "= expects numbers as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive < function.
+ */
+Value *primitiveLess(Value *args) {
+    return compareChain(args, NUM_LESS, "< expects numbers as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive > function.
+ */
+Value *primitiveGreater(Value *args) {
+    return compareChain(args, NUM_GREATER, "> expects numbers as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive >= function.
+ */
+Value *primitiveGeq(Value *args) {
+    return compareChain(args, NUM_GREATER_EQUAL, ">= expects numbers as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive zero? function.
+ */
+Value *primitiveIsZero(Value *args) {
+    checkArity(args, 1, 1);
+    if (!isNumber(car(args))) {
+        libraryError("zero? expects a number as input");
+    }
+    return makeBoolean(numberValue(car(args)) == 0);
+}
+
+
+/*
+ * Implementing the Scheme primitive positive? function.
+ */
+Value *primitiveIsPositive(Value *args) {
+    checkArity(args, 1, 1);
+    if (!isNumber(car(args))) {
+        libraryError("positive? expects a real number as input");
+    }
+    return makeBoolean(numberValue(car(args)) > 0);
+}
+
+
+/*
+ * Implementing the Scheme primitive negative? function.
+ */
+Value *primitiveIsNegative(Value *args) {
+    checkArity(args, 1, 1);
+    if (!isNumber(car(args))) {
+        libraryError("negative? expects a real number as input");
+    }
+    return makeBoolean(numberValue(car(args)) < 0);
+}
+
+
+/*
+ * Implementing the Scheme primitive even? function.
+ */
+Value *primitiveIsEven(Value *args) {
+    checkArity(args, 1, 1);
+    if (!isExactInteger(car(args))) {
+        libraryError("even? expects a integer as input");
+    }
+    return makeBoolean(!isOddExact(car(args)));
+}
+
+
+/*
+ * Implementing the Scheme primitive odd? function.
+ */
+Value *primitiveIsOdd(Value *args) {
+    checkArity(args, 1, 1);
+    if (!isExactInteger(car(args))) {
+        libraryError("odd? expects a integer as input");
+    }
+    return makeBoolean(isOddExact(car(args)));
+}
+
+
+/*
+ * Helper function to find the largest or smallest argument. The
+ * result is inexact if any argument is.
+ */
+Value *extremeNumber(Value *args, bool largest, char *message) {
+    checkArity(args, 1, -1);
+    Value *result = car(args);
+    bool inexact = false;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *next = car(cur);
+        if (!isNumber(next)) {
+            libraryError(message);
+        }
+        inexact = inexact || next->type == DOUBLE_TYPE;
+        if (compareNumbers(next, result, largest ? NUM_GREATER : NUM_LESS)) {
+            result = next;
+        }
+    }
+    if (inexact && result->type != DOUBLE_TYPE) {
+        return makeDouble(numberValue(result));
+    }
+    return result;
+}
+
+
+/*
+ * Implementing the Scheme primitive max function.
+ */
+Value *primitiveMax(Value *args) {
+    return extremeNumber(args, true, "max expects real numbers as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive min function.
+ */
+Value *primitiveMin(Value *args) {
+    return extremeNumber(args, false, "min expects real numbers as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive abs function.
+ */
+Value *primitiveAbs(Value *args) {
+    checkArity(args, 1, 1);
+    Value *number = car(args);
+    if (!isNumber(number)) {
+        libraryError("abs a expects real numbers as input");
+    }
+    if (number->type == DOUBLE_TYPE) {
+        return number->d < 0 ? makeDouble(-number->d) : number;
+    }
+    return signOfExact(number) < 0 ? negateExact(number) : number;
+}
+
+
+/*
+ * Helper function to apply a libm rounding function to a number.
+ * Integers are returned as they are, and doubles stay inexact.
+ */
+Value *roundNumber(Value *args, double (*function)(double), char *message) {
+    checkArity(args, 1, 1);
+    Value *number = car(args);
+    if (isExactInteger(number)) {
+        return number;
+    }
+    if (number->type != DOUBLE_TYPE) {
+        libraryError(message);
+    }
+    return makeDouble(function(number->d));
+}
+
+
+/*
+ * Implementing the Scheme primitive floor function.
+ */
+Value *primitiveFloor(Value *args) {
+    return roundNumber(args, floor, "floor expects a real number as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive ceiling function.
+ */
+Value *primitiveCeiling(Value *args) {
+    return roundNumber(args, ceil, "ceiling expects a real number as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive truncate function.
+ */
+Value *primitiveTruncate(Value *args) {
+    return roundNumber(args, trunc, "truncate expects a real number as input");
+}
+
+
+/*
+ * Implementing the Scheme primitive round function, which rounds to
+ * even when the number is halfway between two integers.
+ */
+Value *primitiveRound(Value *args) {
+    return roundNumber(args, nearbyint, "round expects a real number as input");
+}
+
+
+/*
+ * Helper function to test whether a value is an integer, exact or
+ * inexact.
+ */
+bool isInteger(Value *value) {
+    if (value->type == DOUBLE_TYPE) {
+        return isfinite(value->d) && value->d == trunc(value->d);
+    }
+    return isExactInteger(value);
+}
+
+
+/*
+ * Helper function to check the two integer arguments of an integer
+ * division.
+ *
+ * Returns true if either of them is inexact.
+ */
+bool checkDivision(Value *args, char *name, char *message) {
+    checkArity(args, 2, 2);
+    Value *divisor = car(cdr(args));
+    if (!isInteger(car(args)) || !isInteger(divisor)) {
+        libraryError(message);
+    }
+    if (numberValue(divisor) == 0) {
+        printf("%s: undefined for 0. ", name);
         evaluationError();
     }
+    return car(args)->type == DOUBLE_TYPE || divisor->type == DOUBLE_TYPE;
+}
 
-    Value *cur_arg = cdr(args); 
-    while (cur_arg->type != NULL_TYPE) {
-        Value *cur_num = car(cur_arg);
-        if (cur_num->type != INT_TYPE) {
-            if (cur_num->type == DOUBLE_TYPE) {
-                if (cur_largest <= cur_num->d) {
-                    cur_largest = cur_num->d;
-                } else {
-                    result->s = "#f";
-                    return result;
-                }
-            } else {
-                printf("Expected numerical arguments for <=. ");
-                evaluationError();
-            }
+
+/*
+ * Helper function to take the remainder of two integers at least one
+ * of which is inexact, with the sign of the divisor if `floored' and
+ * of the dividend otherwise.
+ */
+double inexactRemainder(Value *args, bool floored) {
+    double x = numberValue(car(args));
+    double y = numberValue(car(cdr(args)));
+    double remainder = fmod(x, y);
+    if (floored && remainder != 0 && (remainder < 0) != (y < 0)) {
+        remainder += y;
+    }
+    return remainder;
+}
+
+
+/*
+ * Implementing the Scheme primitive quotient function, which rounds
+ * toward zero.
+ */
+Value *primitiveQuotient(Value *args) {
+    if (checkDivision(args, "quotient",
+                      "quotient expects integers as input")) {
+        double x = numberValue(car(args));
+        return makeDouble((x - inexactRemainder(args, false)) /
+                          numberValue(car(cdr(args))));
+    }
+    Value *quotient;
+    divideExact(car(args), car(cdr(args)), &quotient, NULL);
+    return quotient;
+}
+
+
+/*
+ * Implementing the Scheme primitive remainder function, whose result
+ * has the sign of the dividend.
+ */
+Value *primitiveRemainder(Value *args) {
+    if (checkDivision(args, "remainder",
+                      "remainder expects integers as input")) {
+        return makeDouble(inexactRemainder(args, false));
+    }
+    Value *remainder;
+    divideExact(car(args), car(cdr(args)), NULL, &remainder);
+    return remainder;
+}
+
+
+/*
+ * Implementing the Scheme primitive modulo function, whose result has
+ * the sign of the divisor.
+ */
+Value *primitiveModulo(Value *args) {
+    if (checkDivision(args, "modulo", "modulo expects integers as input")) {
+        return makeDouble(inexactRemainder(args, true));
+    }
+    Value *divisor = car(cdr(args));
+    Value *remainder;
+    divideExact(car(args), divisor, NULL, &remainder);
+    int sign = signOfExact(remainder);
+    if (sign != 0 && sign != signOfExact(divisor)) {
+        return addExact(remainder, divisor);
+    }
+    return remainder;
+}
+
+
+/*
+ * Helper function to find the greatest common divisor of two
+ * non-negative exact integers.
+ */
+Value *gcdOf(Value *x, Value *y) {
+    while (signOfExact(y) != 0) {
+        Value *next;
+        divideExact(x, y, NULL, &next);
+        x = y;
+        y = next;
+    }
+    return x;
+}
+
+
+/*
+ * Helper function to check an argument of gcd or lcm and take its
+ * absolute value as an exact integer.
+ */
+Value *gcdArgument(Value *number, char *message) {
+    if (!isInteger(number)) {
+        libraryError(message);
+    }
+    if (number->type == DOUBLE_TYPE) {
+        number = exactFromDouble(number->d);
+    }
+    return signOfExact(number) < 0 ? negateExact(number) : number;
+}
+
+
+/*
+ * Helper function to make the result of gcd or lcm inexact if any of
+ * the arguments was.
+ */
+Value *gcdResult(Value *result, Value *args) {
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (car(cur)->type == DOUBLE_TYPE) {
+            return makeDouble(exactToDouble(result));
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Implementing the Scheme primitive gcd function. The result is always
+ * non-negative, and 0 for no arguments.
+ */
+Value *primitiveGcd(Value *args) {
+    Value *result = makeInteger(0);
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        result = gcdOf(result, gcdArgument(car(cur),
+                                           "gcd expects integers as input"));
+    }
+    return gcdResult(result, args);
+}
+
+
+/*
+ * Implementing the Scheme primitive lcm function. The result is always
+ * non-negative, and 1 for no arguments.
+ */
+Value *primitiveLcm(Value *args) {
+    Value *result = makeInteger(1);
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *n = gcdArgument(car(cur), "lcm expects integers as input");
+        if (signOfExact(n) == 0 || signOfExact(result) == 0) {
+            result = makeInteger(0);
         } else {
-            if (cur_largest <= cur_num->i) {
-                cur_largest = cur_num->i;
-            } else {
-                result->s = "#f";
-                return result;
-            }    
+            Value *quotient;
+            divideExact(result, gcdOf(result, n), &quotient, NULL);
+            result = multiplyExact(quotient, n);
         }
-        cur_arg = cdr(cur_arg);
     }
+    return gcdResult(result, args);
+}
 
-    return result;
-    
+
+/*
+ * Implementing the Scheme primitive expt function. An exact integer
+ * raised to a non-negative integer power is exact.
+ */
+Value *primitiveExpt(Value *args) {
+    checkArity(args, 2, 2);
+    Value *base = car(args);
+    Value *power = car(cdr(args));
+    if (!isNumber(base) || !isNumber(power)) {
+        libraryError("expt expects numbers as input");
+    }
+    if (isExactInteger(base) && power->type == INT_TYPE && power->i >= 0) {
+        // Exponentiation by squaring
+        Value *result = makeInteger(1);
+        Value *square = base;
+        for (int64_t exponent = power->i; exponent > 0; exponent >>= 1) {
+            if (exponent & 1) {
+                result = multiplyExact(result, square);
+            }
+            if (exponent > 1) {
+                square = multiplyExact(square, square);
+            }
+        }
+        return result;
+    }
+    return makeDouble(pow(numberValue(base), numberValue(power)));
+}
+
+
+/*
+ * Implementing the Scheme primitive exact->inexact function.
+ */
+Value *primitiveExactToInexact(Value *args) {
+    checkArity(args, 1, 1);
+    Value *number = car(args);
+    if (!isNumber(number)) {
+        libraryError("exact->inexact expects a number as input");
+    }
+    return number->type == DOUBLE_TYPE ? number : makeDouble(numberValue(number));
+}
+
+
+/*
+ * Implementing the Scheme primitive inexact->exact function. There are
+ * no exact fractions, so only integral numbers can be converted.
+ */
+Value *primitiveInexactToExact(Value *args) {
+    checkArity(args, 1, 1);
+    Value *number = car(args);
+    if (isExactInteger(number)) {
+        return number;
+    }
+    if (number->type != DOUBLE_TYPE || !isfinite(number->d) ||
+        number->d != floor(number->d)) {
+        libraryError("inexact->exact expects a number with an integer value");
+    }
+    return exactFromDouble(number->d);
 }
 
 
@@ -1036,13 +1977,17 @@ Value *primitiveIsEq(Value *args) {
             resultBool = (second->type == INT_TYPE &&
                           first->i == second->i);
             break;
+        case BIGNUM_TYPE:
+            resultBool = (second->type == BIGNUM_TYPE &&
+                          compareExact(first, second) == 0);
+            break;
         case DOUBLE_TYPE:
             resultBool = (second->type == DOUBLE_TYPE &&
                           first->d == second->d);
             break;
         case STR_TYPE:
-            resultBool = (second->type == STR_TYPE &&
-                         !strcmp(first->s, second->s));
+        case CHAR_TYPE:
+            resultBool = isEqv(first, second);
             break;
         case NULL_TYPE:
             resultBool = second->type == NULL_TYPE;
@@ -1059,6 +2004,19 @@ Value *primitiveIsEq(Value *args) {
             resultBool = (second->type == PRIMITIVE_TYPE &&
                           &first->pf == &second->pf);
             break;
+        case COMPILED_TYPE:
+        case NUMVECTOR_TYPE:
+        case VECTOR_TYPE:
+        case HASHTABLE_TYPE:
+        case IMAP_TYPE:
+        case RECORD_TYPE:
+        case RECORD_DESCRIPTOR_TYPE:
+        case RECORD_PROCEDURE_TYPE:
+        case PROMISE_TYPE:
+        case MEMOIZED_TYPE:
+        case WEAK_TYPE:
+            resultBool = first == second;
+            break;
         default:
             resultBool = (second->type == CLOSURE_TYPE &&
                           &first == &second);
@@ -1073,17 +2031,61 @@ Value *primitiveIsEq(Value *args) {
 }
 
 
+/*
+ * Implementing the Scheme primitive eqv? function. Like eq?, it
+ * compares numbers, characters, and strings by content.
+ */
+Value *primitiveIsEqv(Value *args) {
+    checkArity(args, 2, 2);
+    return makeBoolean(isEqv(car(args), car(cdr(args))));
+}
+
+
+/*
+ * Implementing the Scheme primitive equal? function, which compares
+ * pairs, vectors, and numeric vectors by their contents.
+ */
+Value *primitiveIsEqual(Value *args) {
+    checkArity(args, 2, 2);
+    return makeBoolean(isEqual(car(args), car(cdr(args))));
+}
+
+
 /*
  * Helper function that applies a function to a given set of 
  * arguments.
  *
  * Right now only supports applying closure type functions.
  */
-Value *apply(Value *function, Value *args, Frame *frame) {
+Value *apply(Value *function, Value *args) {
     // Apply primitive f
     if (function->type == PRIMITIVE_TYPE) {
         return (function->pf)(args);
     }
+    // Apply a compiled procedure
+    if (function->type == COMPILED_TYPE) {
+        int count = length(args);
+        Value *argv[count > 0 ? count : 1];
+        for (int i = 0; i < count; i++) {
+            argv[i] = car(args);
+            args = cdr(args);
+        }
+        return (function->compiled.code)(count, argv, function->compiled.env);
+    }
+    // Apply a record constructor, predicate, accessor, or modifier
+    if (function->type == RECORD_PROCEDURE_TYPE) {
+        int count = length(args);
+        Value *argv[count > 0 ? count : 1];
+        for (int i = 0; i < count; i++) {
+            argv[i] = car(args);
+            args = cdr(args);
+        }
+        return callRecordProcedure(function, count, argv);
+    }
+    // Apply a memoized procedure, which looks up its arguments first
+    if (function->type == MEMOIZED_TYPE) {
+        return callMemoized(function, args);
+    }
     if (function->type != CLOSURE_TYPE) {
         printf("Expected the first argument to be a procedure! ");
         evaluationError();
@@ -1103,6 +2105,7 @@ Value *apply(Value *function, Value *args, Frame *frame) {
     }
     newFrame->parent = parentFrame;
     newFrame->bindings = makeNull();
+    newFrame->captured = false;
      Value *curFormal = formal;
     Value *curActual = args;
     if (curFormal->type == CONS_TYPE) { 
@@ -1161,12 +2164,8 @@ Value *primitiveApply(Value *args) {
             cur_arg = cdr(cur_arg);
         }
     }
-    
-    Frame *frame = talloc(sizeof(Frame));
-    frame->bindings = makeNull();
-    frame->parent = NULL;
-    
-    return apply(procedure, arguments, frame);
+
+    return apply(procedure, arguments);
 }
 
 
@@ -1174,7 +2173,7 @@ Value *primitiveApply(Value *args) {
  * Implements the primitive load function.
  */
 Value *primitiveLoad(Value *arg) {
-    char *filename = car(arg)->s;
+    char *filename = stringToC(car(arg));
     FILE *stream;
     stream = fopen(filename, "r");
     if (stream == NULL) {
@@ -1198,7 +2197,9 @@ Value *primitiveLoad(Value *arg) {
  * procedures
  */
 Value *primitiveEvalError (Value *errorMessage){
-    printf("%s\n", car(errorMessage)->s);
+    fwrite(car(errorMessage)->str.chars, 1, car(errorMessage)->str.length,
+           stdout);
+    printf("\n");
     evaluationError();
     Value *values = makeNull();
         if (!values) {
@@ -1223,7 +2224,7 @@ Value *primitiveNumberCheck (Value *args){
     }
     
     result->type = BOOL_TYPE; 
-    if (car(args)->type == INT_TYPE || car(args)->type ==DOUBLE_TYPE) {
+    if (isNumber(car(args))) {
         result->s = "#t";
     } else {
         result->s = "#f";
@@ -1246,7 +2247,7 @@ Value *primitiveIntegerCheck (Value *args){
     }
     
     result->type = BOOL_TYPE; 
-    if (car(args)->type == INT_TYPE) {
+    if (isExactInteger(car(args))) {
         result->s = "#t";
     } else {
         result->s = "#f";
@@ -1266,12 +2267,21 @@ Value *eval(Value *expr, Frame *frame){
 	case INT_TYPE:
 	    return expr;
 	    break;
+	case BIGNUM_TYPE:
+	    return expr;
+	    break;
+	case VECTOR_TYPE:
+	    return expr;
+	    break;
 	case DOUBLE_TYPE:
 	    return expr;
 	    break;
 	case STR_TYPE:
 	    return expr;
 	    break;
+	case CHAR_TYPE:
+	    return expr;
+	    break;
 	case BOOL_TYPE:
 	    return expr;
 	    break;
@@ -1302,10 +2312,19 @@ Value *eval(Value *expr, Frame *frame){
         }
         else if (!strcmp(first->s, "cond")) {
             return evalCond(args, frame);
+        }
+        else if (!strcmp(first->s, "case")) {
+            return evalCase(args, frame);
         }
 	    else if (!strcmp(first->s, "let")) { 
+                if (args->type == CONS_TYPE && car(args)->type == SYMBOL_TYPE) {
+                    return evalNamedLet(args, frame);
+                }
 	    	return evalLet(args, frame);
 	    }
+	    else if (!strcmp(first->s, "do")) {
+		return evalDo(args, frame);
+	    }
 	    else if (!strcmp(first->s, "letrec")) {
 		return evalLetrec(args, frame);
 	    }
@@ -1315,6 +2334,27 @@ Value *eval(Value *expr, Frame *frame){
 	    else if (!strcmp(first->s, "define")) {
             	return evalDefine(args, frame);
             }
+	    else if (!strcmp(first->s, "define-record-type")) {
+		return evalDefineRecordType(args, frame);
+	    }
+	    else if (!strcmp(first->s, "receive")) {
+		return evalReceive(args, frame);
+	    }
+	    else if (!strcmp(first->s, "let-values")) {
+		return evalLetValues(args, frame);
+	    }
+	    else if (!strcmp(first->s, "delay")) {
+		return evalDelay(args, frame);
+	    }
+	    else if (!strcmp(first->s, "delay-force")) {
+		return evalDelayForce(args, frame);
+	    }
+	    else if (!strcmp(first->s, "cons-stream")) {
+		return evalConsStream(args, frame);
+	    }
+	    else if (!strcmp(first->s, "define-memoized")) {
+		return evalDefineMemoized(args, frame);
+	    }
 	    else if (!strcmp(first->s, "set!")) {
 	    	return evalSet(args, frame);
 	    }
@@ -1334,6 +2374,7 @@ Value *eval(Value *expr, Frame *frame){
                     Value *loadTree = (loadFunction->pf)(args);
                     Value *curLoad = loadTree;
                     while (curLoad != NULL && curLoad->type == CONS_TYPE){
+                        curLoad->c.car = expandMacros(car(curLoad));
                         eval(car(curLoad), frame);
                         curLoad = cdr(curLoad);
                     }
@@ -1342,16 +2383,45 @@ Value *eval(Value *expr, Frame *frame){
                     return voidResult;
                     
                 } else {
-                    Value *cur = expr;
+                    Value *function = eval(first, frame);
+                    // Fuse map/filter/fold pipelines into one loop
+                    if (isCombinator(function)) {
+                        Value *result = evalPipeline(function, args, frame);
+                        if (result) {
+                            return result;
+                        }
+                    }
+                    // Specialize arithmetic to the operand types seen here
+                    if (isArithmetic(function)) {
+                        Value *result = evalArithmetic(function, args, frame);
+                        if (result) {
+                            return result;
+                        }
+                    }
+                    // Call the fixnum, flonum, and bitwise operators directly
+                    if (isFixFlo(function)) {
+                        Value *result = evalFixFlo(function, args, frame);
+                        if (result) {
+                            return result;
+                        }
+                    }
+                    // Record procedures take their arguments in an array
+                    if (function->type == RECORD_PROCEDURE_TYPE) {
+                        return evalRecordCall(function, args, frame);
+                    }
+                    // Multiple values are returned without an argument list
+                    if (function->type == PRIMITIVE_TYPE &&
+                        function->pf == primitiveValues) {
+                        return evalValuesCall(args, frame);
+                    }
+                    Value *cur = args;
                     while (cur->type != NULL_TYPE) {
                         Value *cur_value = eval(car(cur), frame);
                         values = cons(cur_value, values);
                         cur = cdr(cur);
                     }
-                    values = reverse(values);
-                    Value *function = car(values);
-                    Value *actual = cdr(values);
-                    return apply(function, actual, frame);
+                    Value *actual = reverse(values);
+                    return apply(function, actual);
                 }          
 	    }		
 	    break;
@@ -1365,49 +2435,108 @@ Value *eval(Value *expr, Frame *frame){
 
 
 /*
- * This function takes a list of S-expressions and call eval on 
- * each S-expression in the top-level environment and prints each
- * result 
+ * Bind the primitive functions in the given top-level frame.
  */
-void interpret(Value *tree, Frame *topFrame){
-  /*  Frame *topFrame = talloc(sizeof(Frame));
-    if (!topFrame) {
-        printf("Error! Not enough memory!\n");
-        texit(1);
-    }
-    topFrame->bindings = makeNull();
-    topFrame->parent = NULL;
-*/
-    // Bind the primitive functions
+void bindPrimitives(Frame *topFrame) {
     bind("+", primitiveAdd, topFrame);
     bind("*", primitiveMult, topFrame);
     bind("-", primitiveSub, topFrame);
     bind("/", primitiveDiv, topFrame);
     bind("<=", primitiveLeq, topFrame);
+    bind("=", primitiveNumEqual, topFrame);
+    bind("<", primitiveLess, topFrame);
+    bind(">", primitiveGreater, topFrame);
+    bind(">=", primitiveGeq, topFrame);
+    bind("zero?", primitiveIsZero, topFrame);
+    bind("positive?", primitiveIsPositive, topFrame);
+    bind("negative?", primitiveIsNegative, topFrame);
+    bind("even?", primitiveIsEven, topFrame);
+    bind("odd?", primitiveIsOdd, topFrame);
+    bind("max", primitiveMax, topFrame);
+    bind("min", primitiveMin, topFrame);
+    bind("abs", primitiveAbs, topFrame);
+    bind("floor", primitiveFloor, topFrame);
+    bind("ceiling", primitiveCeiling, topFrame);
+    bind("truncate", primitiveTruncate, topFrame);
+    bind("round", primitiveRound, topFrame);
+    bind("quotient", primitiveQuotient, topFrame);
+    bind("remainder", primitiveRemainder, topFrame);
+    bind("modulo", primitiveModulo, topFrame);
+    bind("gcd", primitiveGcd, topFrame);
+    bind("lcm", primitiveLcm, topFrame);
+    bind("expt", primitiveExpt, topFrame);
+    bind("exact->inexact", primitiveExactToInexact, topFrame);
+    bind("inexact->exact", primitiveInexactToExact, topFrame);
     bind("eq?", primitiveIsEq, topFrame);
+    bind("eqv?", primitiveIsEqv, topFrame);
+    bind("equal?", primitiveIsEqual, topFrame);
     bind("pair?", primitiveIsPair, topFrame);
     bind("null?", primitiveIsNull, topFrame);
     bind("apply", primitiveApply, topFrame);
     bind("car", primitiveCar, topFrame);
     bind("cdr", primitiveCdr, topFrame);
     bind("cons", primitiveCons, topFrame);
+    bind("map", primitiveMap, topFrame);
+    bind("for-each", primitiveForEach, topFrame);
+    bind("filter", primitiveFilter, topFrame);
+    bind("foldl", primitiveFoldl, topFrame);
+    bind("foldr", primitiveFoldr, topFrame);
+    bindListPrimitives(topFrame);
+    bindNumVectorPrimitives(topFrame);
+    bindBytevectorPrimitives(topFrame);
+    bindFixFloPrimitives(topFrame);
+    bindVectorPrimitives(topFrame);
+    bindDictionaryPrimitives(topFrame);
+    bindHamtPrimitives(topFrame);
+    bindSortPrimitives(topFrame);
+    bindValuesPrimitives(topFrame);
+    bindPromisePrimitives(topFrame);
+    bindMemoPrimitives(topFrame);
+    bindWeakPrimitives(topFrame);
+    bindTextPrimitives(topFrame);
     bind("load", primitiveLoad, topFrame);
     //to be used in math.scm&list.scm
     bind("number?", primitiveNumberCheck, topFrame);
     bind("evaluationError", primitiveEvalError, topFrame);
     bind("integer?", primitiveIntegerCheck, topFrame);
+}
+
+
+/*
+ * Print the value of a top-level expression.
+ */
+void printResult(Value *result) {
+    if (result->type == VALUES_TYPE) {
+        int64_t count = result->values.count;
+        Value *items[count > 0 ? count : 1];
+        copyValues(result, items);
+        for (int64_t i = 0; i < count; i++) {
+            printResult(items[i]);
+        }
+    } else if (result->type == CONS_TYPE){
+        printf("(");
+        displayEval(result, false);
+        printf(")\n");
+    } else {
+        displayEval(result, true);
+    }
+}
+
+
+/*
+ * This function takes a list of S-expressions and call eval on 
+ * each S-expression in the top-level environment and prints each
+ * result 
+ */
+void interpret(Value *tree, Frame *topFrame){
+    bindPrimitives(topFrame);
     
     // Evaluate the program
     Value *cur = tree;
     while (cur != NULL && cur->type == CONS_TYPE){
+        cur->c.car = expandMacros(car(cur));
     	Value *result = eval(car(cur), topFrame);
-        if (result->type == CONS_TYPE){
-            printf("(");
-            displayEval(result, false);
-            printf(")\n");
-        } else {
-            displayEval(result, true);
-        }
+        printResult(result);
         cur = cdr(cur);
     }
 }
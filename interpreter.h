@@ -23,4 +23,113 @@ void interpret(Value *tree, Frame *frame);
  */
 Value *eval(Value *expr, Frame *frame);
 
+/*
+ * Applies a procedure (primitive, closure, compiled, or made by
+ * define-record-type) to a list of arguments.
+ */
+Value *apply(Value *function, Value *args);
+
+/*
+ * Bind the primitive functions in the given top-level frame.
+ */
+void bindPrimitives(Frame *topFrame);
+
+/*
+ * Print the value of a top-level expression the way the REPL does.
+ */
+void printResult(Value *result);
+
+/*
+ * Helper function to check whether a variable is already bounded in
+ * the given frame.
+ *
+ * Returns current binding if the variable is already bounded;
+ *         null if the variable is not bounded.
+ */
+Value *isBounded(Value *var, Frame *frame);
+
+/*
+ * Helper function to create new let bindings.
+ */
+void addBindingLocal(Value *var, Value *expr, Frame *frame);
+
+/*
+ * Helper function to create new define bindings.
+ */
+void addBindingGlobal(Value *var, Value *expr, Frame *frame);
+
+/*
+ * Mark the given frame and all of its ancestors as captured, so that
+ * loop forms know they can no longer rebind its slots in place.
+ */
+void markCaptured(Frame *frame);
+
+/*
+ * Bind a primitive function to a name in the given frame.
+ */
+void bind(char *name, Value *(*function)(Value *), Frame *frame);
+
+/*
+ * Helper function for displaying evaluation err message.
+ */
+void evaluationError();
+
+/*
+ * Report a wrong argument to the primitive `name' and stop evaluating.
+ */
+void primitiveError(char *name, char *message);
+
+/*
+ * Stop evaluating unless a primitive was given between `minimum' and
+ * `maximum' arguments, where a `maximum' of -1 means any number.
+ * checkArgumentCount does the same for a count of arguments.
+ */
+void checkArity(Value *args, int minimum, int maximum);
+void checkArgumentCount(int given, int minimum, int maximum);
+
+/*
+ * The primitive procedures. Each takes its arguments as a list.
+ */
+Value *primitiveAdd(Value *args);
+Value *primitiveMult(Value *args);
+Value *primitiveSub(Value *args);
+Value *primitiveDiv(Value *args);
+Value *primitiveLeq(Value *args);
+Value *primitiveNumEqual(Value *args);
+Value *primitiveLess(Value *args);
+Value *primitiveGreater(Value *args);
+Value *primitiveGeq(Value *args);
+Value *primitiveIsZero(Value *args);
+Value *primitiveIsPositive(Value *args);
+Value *primitiveIsNegative(Value *args);
+Value *primitiveIsEven(Value *args);
+Value *primitiveIsOdd(Value *args);
+Value *primitiveMax(Value *args);
+Value *primitiveMin(Value *args);
+Value *primitiveAbs(Value *args);
+Value *primitiveFloor(Value *args);
+Value *primitiveCeiling(Value *args);
+Value *primitiveTruncate(Value *args);
+Value *primitiveRound(Value *args);
+Value *primitiveQuotient(Value *args);
+Value *primitiveRemainder(Value *args);
+Value *primitiveModulo(Value *args);
+Value *primitiveGcd(Value *args);
+Value *primitiveLcm(Value *args);
+Value *primitiveExpt(Value *args);
+Value *primitiveExactToInexact(Value *args);
+Value *primitiveInexactToExact(Value *args);
+Value *primitiveIsEq(Value *args);
+Value *primitiveIsEqv(Value *args);
+Value *primitiveIsEqual(Value *args);
+Value *primitiveIsPair(Value *args);
+Value *primitiveIsNull(Value *args);
+Value *primitiveApply(Value *args);
+Value *primitiveCar(Value *args);
+Value *primitiveCdr(Value *args);
+Value *primitiveCons(Value *args);
+Value *primitiveNumberCheck(Value *args);
+Value *primitiveIntegerCheck(Value *args);
+Value *primitiveEvalError(Value *args);
+
 #endif
@@ -9,11 +9,13 @@
 
 #include "linkedlist.h"
 #include "talloc.h"
+#include "numformat.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
 #include "talloc.h"
+#include "numformat.h"
 /*
  * Create an empty list (a new Value object of type NULL_TYPE).
  *
@@ -39,16 +41,17 @@ Value *makeNull() {
  */
 Value *cons(Value *car, Value *cdr) {
     assert(car != NULL && cdr != NULL);
-    struct ConsCell cell;
-    cell.car = car;
-    cell.cdr = cdr;
     Value *newValue =talloc(sizeof(Value));
     if (!newValue) {
         printf("Out of memory!\n");
         return newValue;
     }
+    // Set the fields one by one, since copying a whole cell would copy
+    // its padding, which the collector would read as pointers
     newValue->type = CONS_TYPE;
-    newValue->c = cell;
+    newValue->c.car = car;
+    newValue->c.cdr = cdr;
+    newValue->c.feedback = 0;
     return newValue;
 }
 
@@ -69,13 +72,16 @@ void display(Value *list){
     while(cur->type != NULL_TYPE){
 	   switch(cur->c.car->type){
             case INT_TYPE:
-                printf("%i ",cur->c.car->i);
+                writeInteger(cur->c.car->i, stdout);
+                putchar(' ');
                 break;
             case DOUBLE_TYPE:
-                printf("%f ",cur->c.car->d);
+                writeDouble(cur->c.car->d, stdout);
+                putchar(' ');
                 break;
             case STR_TYPE:
-                printf("%s ",cur->c.car->s);
+                fwrite(cur->c.car->str.chars, 1, cur->c.car->str.length, stdout);
+                putchar(' ');
                 break;
             case SYMBOL_TYPE:
                 printf("%s ",cur->c.car->s);
@@ -0,0 +1,312 @@
+/*
+ * This program implements the list procedures of lists.scm in C. Each
+ * walks its list once, in a loop, so none of them takes time
+ * quadratic in the length of the list or uses up the C stack.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "lists.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "hashtable.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/*
+ * Helper function to check that a list ends in the empty list.
+ */
+void checkProperList(char *name, Value *list) {
+    Value *cur = list;
+    while (cur->type == CONS_TYPE) {
+        cur = cdr(cur);
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError(name, "expects list as input");
+    }
+}
+
+/*
+ * Implementing the Scheme primitive length.
+ */
+Value *primitiveLength(Value *args) {
+    checkArity(args, 1, 1);
+    int64_t count = 0;
+    Value *cur = car(args);
+    while (cur->type == CONS_TYPE) {
+        count++;
+        cur = cdr(cur);
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError("length", "expects list as input");
+    }
+    return makeInteger(count);
+}
+
+/*
+ * Helper function to drop the first k items of a list, as given by
+ * the arguments of list-ref and list-tail.
+ */
+Value *dropItems(char *name, Value *args) {
+    checkArity(args, 2, 2);
+    Value *index = car(cdr(args));
+    if (index->type != INT_TYPE || index->i < 0) {
+        primitiveError(name, "expects list and non-negative integer as input");
+    }
+    Value *cur = car(args);
+    for (int64_t i = 0; i < index->i; i++) {
+        if (cur->type != CONS_TYPE) {
+            primitiveError(name,
+                           "expects list and non-negative integer as input");
+        }
+        cur = cdr(cur);
+    }
+    return cur;
+}
+
+/*
+ * Implementing the Scheme primitive list-ref.
+ */
+Value *primitiveListRef(Value *args) {
+    Value *rest = dropItems("list-ref", args);
+    if (rest->type != CONS_TYPE) {
+        primitiveError("list-ref",
+                       "expects list and non-negative integer as input");
+    }
+    return car(rest);
+}
+
+/*
+ * Implementing the Scheme primitive list-tail.
+ */
+Value *primitiveListTail(Value *args) {
+    return dropItems("list-tail", args);
+}
+
+/*
+ * Helper function to test whether two values are the same, with the
+ * given procedure or, without one, with the given C function.
+ */
+bool sameItem(Value *compare, bool (*same)(Value *, Value *), Value *first,
+              Value *second) {
+    if (compare == NULL) {
+        return same(first, second);
+    }
+    Value *result = apply(compare, cons(first, cons(second, makeNull())));
+    return !(result->type == BOOL_TYPE && !strcmp(result->s, "#f"));
+}
+
+/*
+ * Helper function to find the first part of a list whose first item
+ * is the same as the given value.
+ *
+ * Returns #f if there is none.
+ */
+Value *findMember(char *name, Value *args, bool (*same)(Value *, Value *),
+                  bool withCompare) {
+    checkArity(args, 2, withCompare ? 3 : 2);
+    Value *item = car(args);
+    Value *compare = cdr(cdr(args))->type == CONS_TYPE ?
+                     car(cdr(cdr(args))) : NULL;
+    Value *cur = car(cdr(args));
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        if (sameItem(compare, same, item, car(cur))) {
+            return cur;
+        }
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError(name, "expects list as one of the input");
+    }
+    return makeBoolean(false);
+}
+
+/*
+ * Helper function to find the first pair in an association list whose
+ * key is the same as the given value.
+ *
+ * Returns #f if there is none.
+ */
+Value *findAssociation(char *name, Value *args,
+                       bool (*same)(Value *, Value *), bool withCompare) {
+    checkArity(args, 2, withCompare ? 3 : 2);
+    Value *key = car(args);
+    Value *compare = cdr(cdr(args))->type == CONS_TYPE ?
+                     car(cdr(cdr(args))) : NULL;
+    Value *cur = car(cdr(args));
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *entry = car(cur);
+        if (entry->type != CONS_TYPE) {
+            primitiveError(name, "expects a list of pairs as one of the input");
+        }
+        if (sameItem(compare, same, key, car(entry))) {
+            return entry;
+        }
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError(name, "expects list as one of the input");
+    }
+    return makeBoolean(false);
+}
+
+/*
+ * Implementing the Scheme primitives member and memq. member compares
+ * with equal?, or with the procedure given as a third argument.
+ */
+Value *primitiveMember(Value *args) {
+    return findMember("member", args, isEqual, true);
+}
+
+Value *primitiveMemq(Value *args) {
+    return findMember("memq", args, isEqv, false);
+}
+
+/*
+ * Implementing the Scheme primitives assq and assoc. assoc compares
+ * with equal?, or with the procedure given as a third argument.
+ */
+Value *primitiveAssq(Value *args) {
+    return findAssociation("assq", args, isEqv, false);
+}
+
+Value *primitiveAssoc(Value *args) {
+    return findAssociation("assoc", args, isEqual, true);
+}
+
+/*
+ * Implementing the Scheme primitive append. Every list but the last is
+ * copied; the last becomes the tail of the result as it is.
+ */
+Value *primitiveAppend(Value *args) {
+    if (args->type == NULL_TYPE) {
+        return makeNull();
+    }
+    Value *head = makeNull();
+    Value *tail = NULL;
+    Value *cur = args;
+    for (; cdr(cur)->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *item = car(cur);
+        for (; item->type == CONS_TYPE; item = cdr(item)) {
+            Value *cell = cons(car(item), makeNull());
+            if (tail == NULL) {
+                head = cell;
+            } else {
+                tail->c.cdr = cell;
+            }
+            tail = cell;
+        }
+        if (item->type != NULL_TYPE) {
+            primitiveError("append", "expects pairs as input");
+        }
+    }
+    if (tail == NULL) {
+        return car(cur);
+    }
+    tail->c.cdr = car(cur);
+    return head;
+}
+
+/*
+ * Implementing the Scheme primitive reverse.
+ */
+Value *primitiveReverse(Value *args) {
+    checkArity(args, 1, 1);
+    Value *result = makeNull();
+    Value *cur = car(args);
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        result = cons(car(cur), result);
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError("reverse", "expects a list as input");
+    }
+    return result;
+}
+
+/*
+ * Helper function to follow a path of cars and cdrs, such as "ad" for
+ * cadr, from its last letter to its first.
+ */
+Value *walkCxr(char *name, char *path, Value *args) {
+    checkArity(args, 1, 1);
+    Value *value = car(args);
+    for (int i = strlen(path) - 1; i >= 0; i--) {
+        if (value->type != CONS_TYPE) {
+            primitiveError(name, "expects pairs as input");
+        }
+        value = path[i] == 'a' ? car(value) : cdr(value);
+    }
+    return value;
+}
+
+#define CXR(function, name, path) \
+    Value *function(Value *args) { \
+        return walkCxr(name, path, args); \
+    }
+
+CXR(primitiveCaar, "caar", "aa")
+CXR(primitiveCadr, "cadr", "ad")
+CXR(primitiveCdar, "cdar", "da")
+CXR(primitiveCddr, "cddr", "dd")
+CXR(primitiveCaaar, "caaar", "aaa")
+CXR(primitiveCaadr, "caadr", "aad")
+CXR(primitiveCadar, "cadar", "ada")
+CXR(primitiveCaddr, "caddr", "add")
+CXR(primitiveCdaar, "cdaar", "daa")
+CXR(primitiveCdadr, "cdadr", "dad")
+CXR(primitiveCddar, "cddar", "dda")
+CXR(primitiveCdddr, "cdddr", "ddd")
+CXR(primitiveCaaaar, "caaaar", "aaaa")
+CXR(primitiveCaaadr, "caaadr", "aaad")
+CXR(primitiveCaadar, "caadar", "aada")
+CXR(primitiveCaaddr, "caaddr", "aadd")
+CXR(primitiveCadaar, "cadaar", "adaa")
+CXR(primitiveCadadr, "cadadr", "adad")
+CXR(primitiveCaddar, "caddar", "adda")
+CXR(primitiveCadddr, "cadddr", "addd")
+CXR(primitiveCdaaar, "cdaaar", "daaa")
+CXR(primitiveCdaadr, "cdaadr", "daad")
+CXR(primitiveCdadar, "cdadar", "dada")
+CXR(primitiveCdaddr, "cdaddr", "dadd")
+CXR(primitiveCddaar, "cddaar", "ddaa")
+CXR(primitiveCddadr, "cddadr", "ddad")
+CXR(primitiveCdddar, "cdddar", "ddda")
+CXR(primitiveCddddr, "cddddr", "dddd")
+/*
+ * Bind the list primitives in the given top-level frame.
+ */
+void bindListPrimitives(Frame *topFrame) {
+    bind("length", primitiveLength, topFrame);
+    bind("list-ref", primitiveListRef, topFrame);
+    bind("list-tail", primitiveListTail, topFrame);
+    bind("member", primitiveMember, topFrame);
+    bind("memq", primitiveMemq, topFrame);
+    bind("assq", primitiveAssq, topFrame);
+    bind("assoc", primitiveAssoc, topFrame);
+    bind("append", primitiveAppend, topFrame);
+    bind("reverse", primitiveReverse, topFrame);
+    bind("caar", primitiveCaar, topFrame);
+    bind("cadr", primitiveCadr, topFrame);
+    bind("cdar", primitiveCdar, topFrame);
+    bind("cddr", primitiveCddr, topFrame);
+    bind("caaar", primitiveCaaar, topFrame);
+    bind("caadr", primitiveCaadr, topFrame);
+    bind("cadar", primitiveCadar, topFrame);
+    bind("caddr", primitiveCaddr, topFrame);
+    bind("cdaar", primitiveCdaar, topFrame);
+    bind("cdadr", primitiveCdadr, topFrame);
+    bind("cddar", primitiveCddar, topFrame);
+    bind("cdddr", primitiveCdddr, topFrame);
+    bind("caaaar", primitiveCaaaar, topFrame);
+    bind("caaadr", primitiveCaaadr, topFrame);
+    bind("caadar", primitiveCaadar, topFrame);
+    bind("caaddr", primitiveCaaddr, topFrame);
+    bind("cadaar", primitiveCadaar, topFrame);
+    bind("cadadr", primitiveCadadr, topFrame);
+    bind("caddar", primitiveCaddar, topFrame);
+    bind("cadddr", primitiveCadddr, topFrame);
+    bind("cdaaar", primitiveCdaaar, topFrame);
+    bind("cdaadr", primitiveCdaadr, topFrame);
+    bind("cdadar", primitiveCdadar, topFrame);
+    bind("cdaddr", primitiveCdaddr, topFrame);
+    bind("cddaar", primitiveCddaar, topFrame);
+    bind("cddadr", primitiveCddadr, topFrame);
+    bind("cdddar", primitiveCdddar, topFrame);
+    bind("cddddr", primitiveCddddr, topFrame);}
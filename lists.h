@@ -0,0 +1,65 @@
+/*
+ * This program implements the list procedures of lists.scm in C, each
+ * as a single loop over its list.
+ */
+#include "value.h"
+
+#ifndef LISTS_H
+#define LISTS_H
+
+/*
+ * Implementing the Scheme primitives length, list-ref, list-tail,
+ * member, memq, assq, assoc, append, and reverse.
+ */
+Value *primitiveLength(Value *args);
+Value *primitiveListRef(Value *args);
+Value *primitiveListTail(Value *args);
+Value *primitiveMember(Value *args);
+Value *primitiveMemq(Value *args);
+Value *primitiveAssq(Value *args);
+Value *primitiveAssoc(Value *args);
+Value *primitiveAppend(Value *args);
+Value *primitiveReverse(Value *args);
+
+/*
+ * Implementing the Scheme primitives caar through cddddr.
+ */
+Value *primitiveCaar(Value *args);
+Value *primitiveCadr(Value *args);
+Value *primitiveCdar(Value *args);
+Value *primitiveCddr(Value *args);
+Value *primitiveCaaar(Value *args);
+Value *primitiveCaadr(Value *args);
+Value *primitiveCadar(Value *args);
+Value *primitiveCaddr(Value *args);
+Value *primitiveCdaar(Value *args);
+Value *primitiveCdadr(Value *args);
+Value *primitiveCddar(Value *args);
+Value *primitiveCdddr(Value *args);
+Value *primitiveCaaaar(Value *args);
+Value *primitiveCaaadr(Value *args);
+Value *primitiveCaadar(Value *args);
+Value *primitiveCaaddr(Value *args);
+Value *primitiveCadaar(Value *args);
+Value *primitiveCadadr(Value *args);
+Value *primitiveCaddar(Value *args);
+Value *primitiveCadddr(Value *args);
+Value *primitiveCdaaar(Value *args);
+Value *primitiveCdaadr(Value *args);
+Value *primitiveCdadar(Value *args);
+Value *primitiveCdaddr(Value *args);
+Value *primitiveCddaar(Value *args);
+Value *primitiveCddadr(Value *args);
+Value *primitiveCdddar(Value *args);
+Value *primitiveCddddr(Value *args);
+
+/*
+ * Bind the list primitives in the given top-level frame.
+ *
+ *   length list-ref list-tail append reverse
+ *   member [compare] memq assq assoc [compare]
+ *   caar cadr ... cdddr cddddr
+ */
+void bindListPrimitives(Frame *topFrame);
+
+#endif
@@ -0,0 +1,540 @@
+/*
+ * This program implements syntax-rules macros, expanded in a pass
+ * over the parse tree before evaluation.
+ *
+ * Macros are not hygienic: symbols introduced by a template refer to
+ * whatever they are bound to where the macro is used.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "macro.h"
+#include "hashtable.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "vector.h"
+
+/* How deeply macro uses may expand into further macro uses, so that a
+ * macro that expands into itself forever is reported instead of
+ * overflowing the stack. */
+#define MAX_EXPANSION_DEPTH 1000
+
+/* A macro defined with syntax-rules. */
+struct Macro {
+    Value *literals;    /* Symbols that match only themselves */
+    Value *rules;       /* List of (pattern template) pairs */
+    char *ellipsis;     /* Usually "..." */
+};
+
+/* What a pattern variable matched: a form, or for a variable under an
+ * ellipsis, one match per repetition. */
+struct Match {
+    Value *form;
+    struct Match **items;
+    int count;
+    bool sequence;
+};
+
+/* The pattern variables bound while expanding one use. */
+struct Binding {
+    Value *name;
+    struct Match *match;
+    struct Binding *next;
+};
+
+/* The macros defined so far, by name. */
+static HashTable *macros;
+
+/* How many macro uses are being expanded inside one another. */
+static int expansionDepth = 0;
+
+/*
+ * Helper function to report a syntax error in a macro.
+ */
+void macroError(char *message, Value *name) {
+    printf("%s '%s'. ", message, name->s);
+    evaluationError();
+}
+
+/*
+ * Helper function to test whether a symbol is a literal of a macro.
+ */
+bool isLiteral(Value *symbol, struct Macro *macro) {
+    for (Value *cur = macro->literals; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (!strcmp(car(cur)->s, symbol->s)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Helper function to test whether a value is the ellipsis of a macro.
+ */
+bool isEllipsis(Value *value, struct Macro *macro) {
+    return value->type == SYMBOL_TYPE && !strcmp(value->s, macro->ellipsis);
+}
+
+/*
+ * Helper function to find the binding of a pattern variable.
+ */
+struct Binding *findBinding(Value *name, struct Binding *bindings) {
+    for (struct Binding *cur = bindings; cur != NULL; cur = cur->next) {
+        if (!strcmp(cur->name->s, name->s)) {
+            return cur;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Helper function to add a binding in front of the given ones.
+ */
+struct Binding *addBinding(Value *name, struct Match *match,
+                           struct Binding *bindings) {
+    struct Binding *binding = talloc(sizeof(struct Binding));
+    if (!binding) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    binding->name = name;
+    binding->match = match;
+    binding->next = bindings;
+    return binding;
+}
+
+/*
+ * Helper function to allocate a match.
+ */
+struct Match *makeMatch(Value *form, int count) {
+    struct Match *match = talloc(sizeof(struct Match));
+    if (!match) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    match->form = form;
+    match->count = count;
+    match->sequence = form == NULL;
+    match->items = NULL;
+    if (match->sequence && count > 0) {
+        match->items = talloc(sizeof(struct Match *) * count);
+        if (!match->items) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+    }
+    return match;
+}
+
+/*
+ * Helper function to collect the pattern variables of a pattern.
+ */
+Value *patternVariables(Value *pattern, struct Macro *macro, Value *vars) {
+    if (pattern->type == SYMBOL_TYPE) {
+        if (!isEllipsis(pattern, macro) && !isLiteral(pattern, macro) &&
+            strcmp(pattern->s, "_")) {
+            return cons(pattern, vars);
+        }
+    } else if (pattern->type == CONS_TYPE) {
+        for (Value *cur = pattern; cur->type == CONS_TYPE; cur = cdr(cur)) {
+            vars = patternVariables(car(cur), macro, vars);
+        }
+    } else if (pattern->type == VECTOR_TYPE) {
+        vars = patternVariables(listFromVector(pattern), macro, vars);
+    }
+    return vars;
+}
+
+/*
+ * Helper function to match a form against a pattern, adding the
+ * bindings of its pattern variables.
+ *
+ * Returns true if the form matches.
+ */
+bool matchPattern(Value *pattern, Value *form, struct Macro *macro,
+                  struct Binding **bindings) {
+    switch (pattern->type) {
+        case SYMBOL_TYPE:
+            if (!strcmp(pattern->s, "_")) {
+                return true;
+            }
+            if (isLiteral(pattern, macro)) {
+                return form->type == SYMBOL_TYPE && !strcmp(form->s, pattern->s);
+            }
+            *bindings = addBinding(pattern, makeMatch(form, 0), *bindings);
+            return true;
+        case CONS_TYPE:
+            break;
+        case NULL_TYPE:
+            return form->type == NULL_TYPE;
+        case VECTOR_TYPE:
+            // A vector pattern matches a vector whose elements match
+            return form->type == VECTOR_TYPE &&
+                   matchPattern(listFromVector(pattern), listFromVector(form),
+                                macro, bindings);
+        default:
+            return isEqv(pattern, form);
+    }
+    Value *cur = pattern;
+    while (cur->type == CONS_TYPE) {
+        if (cdr(cur)->type == CONS_TYPE && isEllipsis(car(cdr(cur)), macro)) {
+            // Match as many repetitions as the patterns after it allow
+            Value *repeated = car(cur);
+            Value *after = cdr(cdr(cur));
+            int available = 0;
+            Value *rest = form;
+            for (; rest->type == CONS_TYPE; rest = cdr(rest)) {
+                available++;
+            }
+            if (rest->type != NULL_TYPE) {
+                return false;
+            }
+            int count = available - length(after);
+            if (count < 0) {
+                return false;
+            }
+            Value *vars = patternVariables(repeated, macro, makeNull());
+            for (Value *var = vars; var->type != NULL_TYPE; var = cdr(var)) {
+                *bindings = addBinding(car(var), makeMatch(NULL, count), *bindings);
+            }
+            for (int i = 0; i < count; i++) {
+                struct Binding *inner = NULL;
+                if (!matchPattern(repeated, car(form), macro, &inner)) {
+                    return false;
+                }
+                for (Value *var = vars; var->type != NULL_TYPE; var = cdr(var)) {
+                    struct Match *sequence = findBinding(car(var), *bindings)->match;
+                    sequence->items[i] = findBinding(car(var), inner)->match;
+                }
+                form = cdr(form);
+            }
+            cur = after;
+            continue;
+        }
+        if (form->type != CONS_TYPE ||
+            !matchPattern(car(cur), car(form), macro, bindings)) {
+            return false;
+        }
+        cur = cdr(cur);
+        form = cdr(form);
+    }
+    return form->type == NULL_TYPE;
+}
+
+/*
+ * Helper function to copy the lists of a form, so that expanding one
+ * copy in place leaves the others alone.
+ */
+Value *copyForm(Value *form) {
+    if (form->type != CONS_TYPE) {
+        return form;
+    }
+    Value *copy = makeNull();
+    for (Value *cur = form; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        copy = cons(copyForm(car(cur)), copy);
+    }
+    return reverse(copy);
+}
+
+Value *expandTemplate(Value *template, struct Macro *macro, Value *name,
+                      struct Binding *bindings);
+
+/*
+ * Helper function to instantiate the elements of a list or vector
+ * template, repeating those followed by an ellipsis.
+ *
+ * Returns the list of the elements.
+ */
+Value *expandElements(Value *template, struct Macro *macro, Value *name,
+                      struct Binding *bindings) {
+    Value *result = makeNull();
+    for (Value *cur = template; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *element = car(cur);
+        if (cdr(cur)->type != CONS_TYPE || !isEllipsis(car(cdr(cur)), macro)) {
+            result = cons(expandTemplate(element, macro, name, bindings), result);
+            continue;
+        }
+        // Repeat the element once per match of its sequence variables
+        Value *vars = patternVariables(element, macro, makeNull());
+        int count = -1;
+        for (Value *var = vars; var->type != NULL_TYPE; var = cdr(var)) {
+            struct Binding *binding = findBinding(car(var), bindings);
+            if (binding != NULL && binding->match->sequence) {
+                if (count != -1 && count != binding->match->count) {
+                    macroError("Mismatched ellipsis lengths in", name);
+                }
+                count = binding->match->count;
+            }
+        }
+        if (count == -1) {
+            macroError("No pattern variable before the ellipsis in", name);
+        }
+        for (int i = 0; i < count; i++) {
+            struct Binding *inner = bindings;
+            for (Value *var = vars; var->type != NULL_TYPE; var = cdr(var)) {
+                struct Binding *binding = findBinding(car(var), bindings);
+                if (binding != NULL && binding->match->sequence) {
+                    inner = addBinding(car(var), binding->match->items[i], inner);
+                }
+            }
+            result = cons(expandTemplate(element, macro, name, inner), result);
+        }
+        cur = cdr(cur);
+    }
+    return reverse(result);
+}
+
+/*
+ * Helper function to instantiate a template with the given bindings.
+ */
+Value *expandTemplate(Value *template, struct Macro *macro, Value *name,
+                      struct Binding *bindings) {
+    if (template->type == SYMBOL_TYPE) {
+        struct Binding *binding = findBinding(template, bindings);
+        if (binding == NULL) {
+            return template;
+        }
+        if (binding->match->sequence) {
+            macroError("Pattern variable used without an ellipsis in", name);
+        }
+        return copyForm(binding->match->form);
+    }
+    if (template->type == VECTOR_TYPE) {
+        return vectorFromList(expandElements(listFromVector(template), macro,
+                                             name, bindings));
+    }
+    if (template->type != CONS_TYPE) {
+        return template;
+    }
+    // (... template) stands for the template with ellipses taken literally
+    if (isEllipsis(car(template), macro) && cdr(template)->type == CONS_TYPE) {
+        return car(cdr(template));
+    }
+    return expandElements(template, macro, name, bindings);
+}
+
+/*
+ * Helper function to expand one use of a macro.
+ */
+Value *expandUse(struct Macro *macro, Value *form) {
+    for (Value *rule = macro->rules; rule->type != NULL_TYPE; rule = cdr(rule)) {
+        Value *pattern = car(car(rule));
+        struct Binding *bindings = NULL;
+        // The keyword position of the pattern is ignored
+        if (matchPattern(cdr(pattern), cdr(form), macro, &bindings)) {
+            return expandTemplate(car(cdr(car(rule))), macro, car(form), bindings);
+        }
+    }
+    macroError("No syntax rule matches this use of", car(form));
+    return NULL;
+}
+
+/*
+ * Helper function to register the macro of a define-syntax form.
+ */
+void defineSyntax(Value *args) {
+    if (length(args) != 2 || car(args)->type != SYMBOL_TYPE) {
+        printf("Invalid syntax in 'define-syntax'. ");
+        evaluationError();
+    }
+    Value *name = car(args);
+    Value *spec = car(cdr(args));
+    if (spec->type != CONS_TYPE || car(spec)->type != SYMBOL_TYPE ||
+        strcmp(car(spec)->s, "syntax-rules") || cdr(spec)->type != CONS_TYPE) {
+        macroError("Expected syntax-rules in the definition of", name);
+    }
+    struct Macro *macro = talloc(sizeof(struct Macro));
+    if (!macro) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    macro->ellipsis = "...";
+    Value *rest = cdr(spec);
+    if (car(rest)->type == SYMBOL_TYPE) {
+        macro->ellipsis = car(rest)->s;
+        rest = cdr(rest);
+    }
+    if (rest->type != CONS_TYPE ||
+        (car(rest)->type != CONS_TYPE && car(rest)->type != NULL_TYPE)) {
+        macroError("Expected a list of literals in the definition of", name);
+    }
+    macro->literals = car(rest);
+    for (Value *cur = macro->literals; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (car(cur)->type != SYMBOL_TYPE) {
+            macroError("Literals must be symbols in the definition of", name);
+        }
+    }
+    macro->rules = cdr(rest);
+    for (Value *cur = macro->rules; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *rule = car(cur);
+        if (rule->type != CONS_TYPE || length(rule) != 2 ||
+            car(rule)->type != CONS_TYPE) {
+            macroError("Invalid syntax rule in the definition of", name);
+        }
+    }
+    if (!macros) {
+        macros = makeHashTable(16, hashEqv, isEqv);
+    }
+    hashTablePut(macros, name, macro);
+}
+
+/*
+ * Helper function to test whether a symbol is bound by an enclosing
+ * local form, which hides a macro of the same name.
+ */
+bool isShadowed(Value *symbol, Value *bound) {
+    for (Value *cur = bound; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        if (!strcmp(car(cur)->s, symbol->s)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Helper function to add the symbols of a formals list or binding list
+ * to the locally bound names.
+ */
+Value *bindNames(Value *names, bool pairs, Value *bound) {
+    if (names->type == SYMBOL_TYPE) {
+        return cons(names, bound);
+    }
+    for (Value *cur = names; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *name = pairs && car(cur)->type == CONS_TYPE ? car(car(cur)) : car(cur);
+        if (name->type == SYMBOL_TYPE) {
+            bound = cons(name, bound);
+        }
+    }
+    return bound;
+}
+
+Value *expandForm(Value *form, Value *bound, bool topLevel);
+
+/*
+ * Helper function to expand every expression of a list in place.
+ */
+void expandEach(Value *list, Value *bound, bool topLevel) {
+    for (Value *cur = list; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        cur->c.car = expandForm(car(cur), bound, topLevel);
+    }
+}
+
+/*
+ * Helper function to expand the expressions of a binding list
+ * ((name expression) ...) in place.
+ */
+void expandBindings(Value *bindings, Value *bound) {
+    for (Value *cur = bindings; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        if (car(cur)->type == CONS_TYPE) {
+            expandEach(cdr(car(cur)), bound, false);
+        }
+    }
+}
+
+/*
+ * Helper function to expand the macro uses in a form. `bound' lists
+ * the local variables in scope.
+ */
+Value *expandForm(Value *form, Value *bound, bool topLevel) {
+    if (form->type != CONS_TYPE) {
+        return form;
+    }
+    Value *first = car(form);
+    Value *args = cdr(form);
+    if (first->type != SYMBOL_TYPE) {
+        expandEach(form, bound, false);
+        return form;
+    }
+    char *name = first->s;
+    if (macros && !isShadowed(first, bound)) {
+        struct Macro *macro = hashTableGet(macros, first);
+        if (macro) {
+            if (++expansionDepth > MAX_EXPANSION_DEPTH) {
+                macroError("Macro expansion too deep in", first);
+            }
+            Value *expanded = expandForm(expandUse(macro, form), bound,
+                                         topLevel);
+            expansionDepth--;
+            return expanded;
+        }
+    }
+    if (!strcmp(name, "quote")) {
+        return form;
+    } else if (!strcmp(name, "define-syntax")) {
+        if (!topLevel) {
+            printf("'define-syntax' expressions only allowed"
+                   " in the global environment. ");
+            evaluationError();
+        }
+        defineSyntax(args);
+        Value *begin = talloc(sizeof(Value));
+        if (!begin) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        begin->type = SYMBOL_TYPE;
+        begin->s = "begin";
+        return cons(begin, makeNull());
+    } else if (!strcmp(name, "begin")) {
+        expandEach(args, bound, topLevel);
+    } else if (!strcmp(name, "lambda") && args->type == CONS_TYPE) {
+        expandEach(cdr(args), bindNames(car(args), false, bound), false);
+    } else if (!strcmp(name, "let") && args->type == CONS_TYPE) {
+        Value *inner = bound;
+        if (car(args)->type == SYMBOL_TYPE) {
+            inner = cons(car(args), inner);
+            args = cdr(args);
+        }
+        if (args->type == CONS_TYPE) {
+            expandBindings(car(args), bound);
+            inner = bindNames(car(args), true, inner);
+            expandEach(cdr(args), inner, false);
+        }
+    } else if (!strcmp(name, "let*") && args->type == CONS_TYPE) {
+        Value *inner = bound;
+        for (Value *cur = car(args); cur->type == CONS_TYPE; cur = cdr(cur)) {
+            expandBindings(cons(car(cur), makeNull()), inner);
+            inner = bindNames(cons(car(cur), makeNull()), true, inner);
+        }
+        expandEach(cdr(args), inner, false);
+    } else if (!strcmp(name, "letrec") && args->type == CONS_TYPE) {
+        Value *inner = bindNames(car(args), true, bound);
+        expandBindings(car(args), inner);
+        expandEach(cdr(args), inner, false);
+    } else if (!strcmp(name, "do") && args->type == CONS_TYPE) {
+        Value *inner = bindNames(car(args), true, bound);
+        for (Value *cur = car(args); cur->type == CONS_TYPE; cur = cdr(cur)) {
+            if (car(cur)->type == CONS_TYPE && cdr(car(cur))->type == CONS_TYPE) {
+                Value *init = cdr(car(cur));
+                init->c.car = expandForm(car(init), bound, false);
+                expandEach(cdr(init), inner, false);
+            }
+        }
+        if (cdr(args)->type == CONS_TYPE) {
+            expandEach(car(cdr(args)), inner, false);
+            expandEach(cdr(cdr(args)), inner, false);
+        }
+    } else if (!strcmp(name, "case") && args->type == CONS_TYPE) {
+        args->c.car = expandForm(car(args), bound, false);
+        for (Value *cur = cdr(args); cur->type == CONS_TYPE; cur = cdr(cur)) {
+            if (car(cur)->type == CONS_TYPE) {
+                expandEach(cdr(car(cur)), bound, false);
+            }
+        }
+    } else {
+        expandEach(form, bound, false);
+    }
+    return form;
+}
+
+/*
+ * Expand the macro uses in a top-level form. A define-syntax form
+ * registers its macro and becomes an empty (begin). Every list of the
+ * form is rewritten in place, so each use is expanded exactly once and
+ * later evaluations see only the expansion.
+ *
+ * Returns the expanded form.
+ */
+Value *expandMacros(Value *form) {
+    return expandForm(form, makeNull(), true);
+}
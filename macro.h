@@ -0,0 +1,20 @@
+/*
+ * This program implements syntax-rules macros, expanded in a pass
+ * over the parse tree before evaluation.
+ */
+#include "value.h"
+
+#ifndef MACRO_H
+#define MACRO_H
+
+/*
+ * Expand the macro uses in a top-level form. A define-syntax form
+ * registers its macro and becomes an empty (begin). Every list of the
+ * form is rewritten in place, so each use is expanded exactly once and
+ * later evaluations see only the expansion.
+ *
+ * Returns the expanded form.
+ */
+Value *expandMacros(Value *form);
+
+#endif
@@ -1,17 +1,75 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "value.h"
 #include "tokenizer.h"
 #include "parser.h"
 #include "interpreter.h"
+#include "compiler.h"
 #include <unistd.h>
 
-int main(void) {
+/*
+ * Translate a Scheme file into C, for
+ *     interpreter --compile foo.scm [-o foo.c]
+ * The C code is written to standard output unless -o is given.
+ */
+int compileMain(int argc, char **argv) {
+    char *source = NULL;
+    char *target = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            target = argv[++i];
+        } else if (source == NULL) {
+            source = argv[i];
+        } else {
+            source = NULL;
+            break;
+        }
+    }
+    if (source == NULL) {
+        printf("Usage: interpreter --compile file.scm [-o file.c]\n");
+        return 1;
+    }
+    FILE *in = fopen(source, "r");
+    if (in == NULL) {
+        printf("Cannot open file \"%s\".\n", source);
+        return 1;
+    }
+    Value *list = tokenize(in);
+    fclose(in);
+    if (list == NULL) {
+        texit(1);
+    }
+    Value *tree = parse(list);
+    if (tree == NULL) {
+        texit(1);
+    }
+    FILE *out = stdout;
+    if (target != NULL) {
+        out = fopen(target, "w");
+        if (out == NULL) {
+            printf("Cannot open file \"%s\".\n", target);
+            texit(1);
+        }
+    }
+    compileProgram(tree, source, out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    tfree();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && !strcmp(argv[1], "--compile")) {
+        return compileMain(argc, argv);
+    }
     bool terminal = isatty(fileno(stdin));
     // Create the global frame
     Frame *topFrame = talloc(sizeof(Frame));
     topFrame->bindings = makeNull();
     topFrame->parent = NULL;
+    topFrame->captured = true;
     if (!topFrame) 
         printf("Error! Not enough memory!\n");
     do {
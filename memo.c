@@ -0,0 +1,267 @@
+/*
+ * This program implements memoized procedures.
+ *
+ * The results of a memoized procedure are kept in a hash table from
+ * argument lists, hashed with equal-hash, to entries. The entries are
+ * also linked from the most recently used to the least, so that a
+ * table with a capacity can evict the least recently used result in
+ * constant time. A lookup uses the argument list of the call as it is;
+ * only a miss copies it to keep as a key, and copies multiple values
+ * out of the buffer values reuses to keep as the result.
+ */
+#include <stdio.h>
+#include "memo.h"
+#include "interpreter.h"
+#include "hashtable.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/* A remembered result */
+typedef struct MemoEntry {
+    Value *key;
+    Value *value;
+    /* The entries used just after and just before this one */
+    struct MemoEntry *newer;
+    struct MemoEntry *older;
+} MemoEntry;
+
+/* The state of a memoized procedure */
+typedef struct Memo {
+    Value *procedure;
+    HashTable *table;
+    int64_t capacity;   /* The most results to keep, or 0 for no limit */
+    int64_t hits;
+    int64_t misses;
+    MemoEntry *newest;
+    MemoEntry *oldest;
+} Memo;
+
+/*
+ * Helper function to check that an argument is a memoized procedure.
+ */
+Memo *memoArgument(char *name, Value *value) {
+    if (value->type != MEMOIZED_TYPE) {
+        primitiveError(name, "expects a memoized procedure as input");
+    }
+    return value->memo.state;
+}
+
+/*
+ * Helper function to check the capacity given to memoize or
+ * define-memoized.
+ */
+int64_t capacityArgument(char *name, Value *limit) {
+    if (limit->type != INT_TYPE || limit->i <= 0) {
+        primitiveError(name, "expects a positive integer capacity");
+    }
+    return limit->i;
+}
+
+/*
+ * Helper function to make a memoized procedure.
+ */
+Value *makeMemoized(Value *procedure, int64_t capacity) {
+    Value *memo = talloc(sizeof(Value));
+    Memo *state = talloc(sizeof(Memo));
+    if (!memo || !state) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    state->procedure = procedure;
+    state->table = makeHashTable(16, hashEqual, isEqual);
+    state->capacity = capacity;
+    state->hits = 0;
+    state->misses = 0;
+    state->newest = NULL;
+    state->oldest = NULL;
+    memo->type = MEMOIZED_TYPE;
+    memo->memo.state = state;
+    return memo;
+}
+
+/*
+ * Helper function to take an entry out of the recency list.
+ */
+void unlinkEntry(Memo *state, MemoEntry *entry) {
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        state->newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        state->oldest = entry->newer;
+    }
+}
+
+/*
+ * Helper function to put an entry at the front of the recency list.
+ */
+void pushEntry(Memo *state, MemoEntry *entry) {
+    entry->newer = NULL;
+    entry->older = state->newest;
+    if (state->newest) {
+        state->newest->newer = entry;
+    } else {
+        state->oldest = entry;
+    }
+    state->newest = entry;
+}
+
+/*
+ * Helper function to mark an entry as the most recently used. Only a
+ * table with a capacity keeps the order up to date.
+ */
+void touchEntry(Memo *state, MemoEntry *entry) {
+    if (state->capacity > 0 && state->newest != entry) {
+        unlinkEntry(state, entry);
+        pushEntry(state, entry);
+    }
+}
+
+/*
+ * Helper function to copy the spine of an argument list, which the
+ * caller may reuse, to keep as a key.
+ */
+Value *copyArguments(Value *args) {
+    Value head;
+    head.type = CONS_TYPE;
+    Value *tail = &head;
+    for (; args->type == CONS_TYPE; args = cdr(args)) {
+        tail->c.cdr = cons(car(args), makeNull());
+        tail = tail->c.cdr;
+    }
+    tail->c.cdr = makeNull();
+    return head.c.cdr;
+}
+
+Value *callMemoized(Value *memo, Value *args) {
+    Memo *state = memo->memo.state;
+    MemoEntry *entry = hashTableGet(state->table, args);
+    if (entry) {
+        state->hits++;
+        touchEntry(state, entry);
+        return entry->value;
+    }
+    state->misses++;
+    Value *result = apply(state->procedure, args);
+    // A recursive call with the same arguments may have stored a result
+    entry = hashTableGet(state->table, args);
+    if (entry) {
+        entry->value = result;
+        touchEntry(state, entry);
+        return result;
+    }
+    entry = talloc(sizeof(MemoEntry));
+    if (!entry) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    entry->key = copyArguments(args);
+    entry->value = result;
+    pushEntry(state, entry);
+    hashTablePut(state->table, entry->key, entry);
+    if (state->capacity > 0 && state->table->size > state->capacity) {
+        MemoEntry *oldest = state->oldest;
+        unlinkEntry(state, oldest);
+        hashTableDelete(state->table, oldest->key);
+    }
+    return result;
+}
+
+Value *evalDefineMemoized(Value *args, Frame *frame) {
+    if (frame->parent != NULL) {
+        printf("'define-memoized' expressions only allowed"
+               " in the global environment. ");
+        evaluationError();
+    }
+    int64_t capacity = 0;
+    if (args->type == CONS_TYPE && car(args)->type != CONS_TYPE) {
+        capacity = capacityArgument("define-memoized", car(args));
+        args = cdr(args);
+    }
+    if (length(args) < 2 || car(args)->type != CONS_TYPE ||
+        car(car(args))->type != SYMBOL_TYPE) {
+        printf("Invalid syntax in 'define-memoized'. ");
+        evaluationError();
+    }
+    Value *lambda = cons(makeSymbol("lambda"),
+                         cons(cdr(car(args)), cdr(args)));
+    addBindingGlobal(car(car(args)),
+                     makeMemoized(eval(lambda, frame), capacity), frame);
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitive memoize.
+ */
+Value *primitiveMemoize(Value *args) {
+    checkArity(args, 1, 2);
+    Value *procedure = car(args);
+    if (procedure->type != PRIMITIVE_TYPE && procedure->type != CLOSURE_TYPE &&
+        procedure->type != COMPILED_TYPE &&
+        procedure->type != RECORD_PROCEDURE_TYPE &&
+        procedure->type != MEMOIZED_TYPE) {
+        primitiveError("memoize", "expects a procedure as input");
+    }
+    int64_t capacity = 0;
+    if (cdr(args)->type == CONS_TYPE) {
+        capacity = capacityArgument("memoize", car(cdr(args)));
+    }
+    return makeMemoized(procedure, capacity);
+}
+
+/*
+ * Implementing the Scheme primitive memoized?.
+ */
+Value *primitiveIsMemoized(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == MEMOIZED_TYPE);
+}
+
+/*
+ * Implementing the Scheme primitives memoize-hits, memoize-misses, and
+ * memoize-size.
+ */
+Value *primitiveMemoizeHits(Value *args) {
+    checkArity(args, 1, 1);
+    return makeInteger(memoArgument("memoize-hits", car(args))->hits);
+}
+
+Value *primitiveMemoizeMisses(Value *args) {
+    checkArity(args, 1, 1);
+    return makeInteger(memoArgument("memoize-misses", car(args))->misses);
+}
+
+Value *primitiveMemoizeSize(Value *args) {
+    checkArity(args, 1, 1);
+    return makeInteger(memoArgument("memoize-size", car(args))->table->size);
+}
+
+/*
+ * Implementing the Scheme primitive memoize-clear!.
+ */
+Value *primitiveMemoizeClear(Value *args) {
+    checkArity(args, 1, 1);
+    Memo *state = memoArgument("memoize-clear!", car(args));
+    state->table = makeHashTable(16, hashEqual, isEqual);
+    state->hits = 0;
+    state->misses = 0;
+    state->newest = NULL;
+    state->oldest = NULL;
+    return makeVoid();
+}
+
+/*
+ * Bind the memoization primitives in the given top-level frame.
+ */
+void bindMemoPrimitives(Frame *topFrame) {
+    bind("memoize", primitiveMemoize, topFrame);
+    bind("memoized?", primitiveIsMemoized, topFrame);
+    bind("memoize-hits", primitiveMemoizeHits, topFrame);
+    bind("memoize-misses", primitiveMemoizeMisses, topFrame);
+    bind("memoize-size", primitiveMemoizeSize, topFrame);
+    bind("memoize-clear!", primitiveMemoizeClear, topFrame);
+}
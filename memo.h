@@ -0,0 +1,53 @@
+/*
+ * This program implements memoized procedures. A memoized procedure
+ * keeps the results of the procedure it wraps in a hash table keyed on
+ * the list of arguments, compared with equal?, and may be limited to a
+ * number of results, evicting the least recently used.
+ */
+#include "value.h"
+
+#ifndef MEMO_H
+#define MEMO_H
+
+/*
+ * Call a memoized procedure on a list of arguments.
+ */
+Value *callMemoized(Value *memo, Value *args);
+
+/*
+ * Evaluate the DEFINE-MEMOIZED special form:
+ *
+ *   (define-memoized (fib n) body ...)
+ *   (define-memoized 100 (fib n) body ...)
+ *
+ * which defines fib as a memoized procedure, so its recursive calls
+ * are memoized too. A leading positive integer is the capacity, as
+ * for memoize.
+ */
+Value *evalDefineMemoized(Value *args, Frame *frame);
+
+/*
+ * The primitives below, for compiled programs.
+ */
+Value *primitiveMemoize(Value *args);
+Value *primitiveIsMemoized(Value *args);
+Value *primitiveMemoizeHits(Value *args);
+Value *primitiveMemoizeMisses(Value *args);
+Value *primitiveMemoizeSize(Value *args);
+Value *primitiveMemoizeClear(Value *args);
+
+/*
+ * Bind the memoization primitives in the given top-level frame.
+ *
+ *   memoize f [capacity]   f with its results remembered; with a
+ *                          capacity, at most that many, evicting the
+ *                          least recently used
+ *   memoized? p
+ *   memoize-hits p         calls answered from the table
+ *   memoize-misses p       calls that called f
+ *   memoize-size p         results remembered
+ *   memoize-clear! p       forget the results and reset the counts
+ */
+void bindMemoPrimitives(Frame *topFrame);
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ * This program writes numbers in decimal: integers, and doubles in the
+ * shortest form that reads back as the same double.
+ *
+ * Doubles are converted with the Ryu algorithm (Ulf Adams, "Ryu: Fast
+ * Float-to-String Conversion", PLDI 2018), which finds the shortest
+ * decimal in the interval of reals that round to the double using
+ * 64-bit arithmetic and a table of 128-bit approximations of powers
+ * of 5. The table is computed exactly with bignums the first time a
+ * double is written.
+ */
+#include <string.h>
+#include <stdbool.h>
+#include "numformat.h"
+#include "bignum.h"
+#include "runtime.h"
+
+/* The bits of the table entries, and the range of powers needed. */
+#define POW5_INV_BITCOUNT 125
+#define POW5_BITCOUNT 125
+#define POW5_INV_TABLE_SIZE 342
+#define POW5_TABLE_SIZE 326
+
+/* 2^k / 5^i rounded up, and 5^i / 2^k rounded down, with k chosen
+ * so that the entries have 125 significant bits; low word first. */
+static uint64_t pow5InvSplit[POW5_INV_TABLE_SIZE][2];
+static uint64_t pow5Split[POW5_TABLE_SIZE][2];
+static bool tablesReady = false;
+
+static const char digitPairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* A double as a decimal: mantissa * 10^exponent. */
+struct Decimal {
+    uint64_t mantissa;
+    int exponent;
+};
+
+
+/*
+ * Helper function to write the digits of an unsigned number, two at a
+ * time, ending just before `end'.
+ *
+ * Returns where the digits start.
+ */
+char *formatDigits(uint64_t number, char *end) {
+    char *cur = end;
+    while (number >= 100) {
+        int pair = (int) (number % 100) * 2;
+        number /= 100;
+        *--cur = digitPairs[pair + 1];
+        *--cur = digitPairs[pair];
+    }
+    if (number >= 10) {
+        int pair = (int) number * 2;
+        *--cur = digitPairs[pair + 1];
+        *--cur = digitPairs[pair];
+    } else {
+        *--cur = (char) ('0' + number);
+    }
+    return cur;
+}
+
+
+/*
+ * Write an integer into the buffer.
+ *
+ * Returns the number of characters written, not counting the NUL.
+ */
+int formatInteger(int64_t i, char *buffer) {
+    char digits[20];
+    uint64_t magnitude = i < 0 ? -(uint64_t) i : (uint64_t) i;
+    char *start = formatDigits(magnitude, digits + sizeof(digits));
+    int count = (int) (digits + sizeof(digits) - start);
+    int length = 0;
+    if (i < 0) {
+        buffer[length++] = '-';
+    }
+    memcpy(buffer + length, start, count);
+    length += count;
+    buffer[length] = '\0';
+    return length;
+}
+
+
+/*
+ * Helper functions for the bit length of 5^e, and for floor(log10(2^e))
+ * and floor(log10(5^e)), exact over the range of doubles.
+ */
+int pow5Bits(int e) {
+    return (int) (((uint32_t) e * 1217359) >> 19) + 1;
+}
+
+int log10Pow2(int e) {
+    return (int) (((uint32_t) e * 78913) >> 18);
+}
+
+int log10Pow5(int e) {
+    return (int) (((uint32_t) e * 732923) >> 20);
+}
+
+
+/*
+ * Helper function to make 2^e as an exact integer.
+ */
+Value *powerOfTwo(int e) {
+    Value *result = makeInteger(1);
+    for (; e >= 62; e -= 62) {
+        result = multiplyExact(result, makeInteger(INT64_C(1) << 62));
+    }
+    return multiplyExact(result, makeInteger(INT64_C(1) << e));
+}
+
+
+/*
+ * Helper function to store a non-negative exact integer below 2^128
+ * as two 64-bit words.
+ */
+void storeWords(Value *number, uint64_t words[2]) {
+    if (number->type == INT_TYPE) {
+        words[0] = (uint64_t) number->i;
+        words[1] = 0;
+        return;
+    }
+    words[0] = 0;
+    words[1] = 0;
+    for (int d = 0; d < number->big.size && d < 4; d++) {
+        words[d / 2] |= (uint64_t) number->big.digits[d] << (32 * (d % 2));
+    }
+}
+
+
+/*
+ * Helper function to compute the tables of powers of 5.
+ */
+void buildPowerTables() {
+    Value *pow5 = makeInteger(1);
+    for (int i = 0; i < POW5_INV_TABLE_SIZE; i++) {
+        int bits = pow5Bits(i);
+        Value *inverse;
+        divideExact(powerOfTwo(bits - 1 + POW5_INV_BITCOUNT), pow5,
+                    &inverse, NULL);
+        storeWords(addExact(inverse, makeInteger(1)), pow5InvSplit[i]);
+        if (i < POW5_TABLE_SIZE) {
+            Value *split;
+            if (bits > POW5_BITCOUNT) {
+                divideExact(pow5, powerOfTwo(bits - POW5_BITCOUNT), &split, NULL);
+            } else {
+                split = multiplyExact(pow5, powerOfTwo(POW5_BITCOUNT - bits));
+            }
+            storeWords(split, pow5Split[i]);
+        }
+        pow5 = multiplyExact(pow5, makeInteger(5));
+    }
+    tablesReady = true;
+}
+
+
+/*
+ * Helper function to multiply m by a 128-bit table entry and shift the
+ * product right by j >= 64 bits.
+ */
+uint64_t mulShift(uint64_t m, uint64_t *factor, int j) {
+    unsigned __int128 low = (unsigned __int128) m * factor[0];
+    unsigned __int128 high = (unsigned __int128) m * factor[1];
+    return (uint64_t) (((low >> 64) + high) >> (j - 64));
+}
+
+
+/*
+ * Helper function to count the factors of 5 in a non-zero number.
+ */
+int pow5Factor(uint64_t value) {
+    int count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count;
+}
+
+
+/*
+ * Helper function to convert a double that is an integer below 2^53
+ * without the tables.
+ *
+ * Returns false if the double is not such an integer.
+ */
+bool smallInteger(uint64_t ieeeMantissa, int ieeeExponent,
+                  struct Decimal *result) {
+    uint64_t m2 = (UINT64_C(1) << 52) | ieeeMantissa;
+    int e2 = ieeeExponent - 1075;
+    if (e2 > 0 || e2 < -52 || (m2 & ((UINT64_C(1) << -e2) - 1)) != 0) {
+        return false;
+    }
+    result->mantissa = m2 >> -e2;
+    result->exponent = 0;
+    while (result->mantissa % 10 == 0) {
+        result->mantissa /= 10;
+        result->exponent++;
+    }
+    return true;
+}
+
+
+/*
+ * Helper function to find the shortest decimal that lies in the
+ * interval of reals rounding to a finite, non-zero double; when there
+ * are several, the one closest to the double.
+ */
+struct Decimal shortestDecimal(uint64_t ieeeMantissa, int ieeeExponent) {
+    if (!tablesReady) {
+        buildPowerTables();
+    }
+    // The double is mv * 2^e2 with mv = 4 * m2, and the interval
+    // reaches halfway to its neighbours, from mv - 1 - mmShift to
+    // mv + 2; the lower neighbour is closer at powers of two
+    int e2;
+    uint64_t m2;
+    if (ieeeExponent == 0) {
+        e2 = 1 - 1023 - 52 - 2;
+        m2 = ieeeMantissa;
+    } else {
+        e2 = ieeeExponent - 1023 - 52 - 2;
+        m2 = (UINT64_C(1) << 52) | ieeeMantissa;
+    }
+    bool acceptBounds = (m2 & 1) == 0;
+    uint64_t mv = 4 * m2;
+    int mmShift = ieeeMantissa != 0 || ieeeExponent <= 1;
+
+    // Scale the interval by a power of 10, so that vm, vr, and vp
+    // are its lower bound, the double, and its upper bound
+    uint64_t vr, vp, vm;
+    int e10;
+    bool vmIsTrailingZeros = false;
+    bool vrIsTrailingZeros = false;
+    if (e2 >= 0) {
+        int q = log10Pow2(e2) - (e2 > 3);
+        e10 = q;
+        int k = POW5_INV_BITCOUNT + pow5Bits(q) - 1;
+        int i = -e2 + q + k;
+        vr = mulShift(4 * m2, pow5InvSplit[q], i);
+        vp = mulShift(4 * m2 + 2, pow5InvSplit[q], i);
+        vm = mulShift(4 * m2 - 1 - mmShift, pow5InvSplit[q], i);
+        if (q <= 21) {
+            // Only then can the scaled values be exact integers
+            if (mv % 5 == 0) {
+                vrIsTrailingZeros = pow5Factor(mv) >= q;
+            } else if (acceptBounds) {
+                vmIsTrailingZeros = pow5Factor(mv - 1 - mmShift) >= q;
+            } else {
+                vp -= pow5Factor(mv + 2) >= q;
+            }
+        }
+    } else {
+        int q = log10Pow5(-e2) - (-e2 > 1);
+        e10 = q + e2;
+        int i = -e2 - q;
+        int k = pow5Bits(i) - POW5_BITCOUNT;
+        int j = q - k;
+        vr = mulShift(4 * m2, pow5Split[i], j);
+        vp = mulShift(4 * m2 + 2, pow5Split[i], j);
+        vm = mulShift(4 * m2 - 1 - mmShift, pow5Split[i], j);
+        if (q <= 1) {
+            vrIsTrailingZeros = true;
+            if (acceptBounds) {
+                vmIsTrailingZeros = mmShift == 1;
+            } else {
+                vp--;
+            }
+        } else if (q < 63) {
+            vrIsTrailingZeros = (mv & ((UINT64_C(1) << q) - 1)) == 0;
+        }
+    }
+
+    // Drop digits while the bounds still differ, rounding vr
+    int removed = 0;
+    int lastRemovedDigit = 0;
+    uint64_t output;
+    if (vmIsTrailingZeros || vrIsTrailingZeros) {
+        // Rare: the bounds or the double are exact, so ties matter
+        while (vp / 10 > vm / 10) {
+            vmIsTrailingZeros &= vm % 10 == 0;
+            vrIsTrailingZeros &= lastRemovedDigit == 0;
+            lastRemovedDigit = (int) (vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vmIsTrailingZeros) {
+            while (vm % 10 == 0) {
+                vrIsTrailingZeros &= lastRemovedDigit == 0;
+                lastRemovedDigit = (int) (vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vrIsTrailingZeros && lastRemovedDigit == 5 && vr % 2 == 0) {
+            // Round half to even
+            lastRemovedDigit = 4;
+        }
+        output = vr + ((vr == vm && (!acceptBounds || !vmIsTrailingZeros)) ||
+                       lastRemovedDigit >= 5);
+    } else {
+        bool roundUp = false;
+        while (vp / 10 > vm / 10) {
+            roundUp = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || roundUp);
+    }
+    struct Decimal result = {output, e10 + removed};
+    return result;
+}
+
+
+/*
+ * Write a double into the buffer with the fewest digits that read back
+ * as the same double.
+ *
+ * Returns the number of characters written, not counting the NUL.
+ */
+int formatDouble(double d, char *buffer) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    bool negative = bits >> 63;
+    uint64_t ieeeMantissa = bits & ((UINT64_C(1) << 52) - 1);
+    int ieeeExponent = (int) ((bits >> 52) & 0x7ff);
+    if (ieeeExponent == 0x7ff) {
+        strcpy(buffer, ieeeMantissa ? "+nan.0" : negative ? "-inf.0" : "+inf.0");
+        return (int) strlen(buffer);
+    }
+    char *out = buffer;
+    if (negative) {
+        *out++ = '-';
+    }
+    if (ieeeExponent == 0 && ieeeMantissa == 0) {
+        strcpy(out, "0.0");
+        return (int) (out - buffer) + 3;
+    }
+    struct Decimal decimal;
+    if (ieeeExponent == 0 ||
+        !smallInteger(ieeeMantissa, ieeeExponent, &decimal)) {
+        decimal = shortestDecimal(ieeeMantissa, ieeeExponent);
+    }
+
+    char digits[20];
+    char *start = formatDigits(decimal.mantissa, digits + sizeof(digits));
+    int count = (int) (digits + sizeof(digits) - start);
+    // The number is 0.<digits> * 10^point
+    int point = count + decimal.exponent;
+    if (point > -6 && point <= 21) {
+        if (point <= 0) {
+            *out++ = '0';
+            *out++ = '.';
+            memset(out, '0', -point);
+            out += -point;
+            memcpy(out, start, count);
+            out += count;
+        } else if (point >= count) {
+            memcpy(out, start, count);
+            out += count;
+            memset(out, '0', point - count);
+            out += point - count;
+            *out++ = '.';
+            *out++ = '0';
+        } else {
+            memcpy(out, start, point);
+            out += point;
+            *out++ = '.';
+            memcpy(out, start + point, count - point);
+            out += count - point;
+        }
+    } else {
+        *out++ = start[0];
+        if (count > 1) {
+            *out++ = '.';
+            memcpy(out, start + 1, count - 1);
+            out += count - 1;
+        }
+        *out++ = 'e';
+        out += formatInteger(point - 1, out);
+    }
+    *out = '\0';
+    return (int) (out - buffer);
+}
+
+
+/*
+ * Write an integer to a stream.
+ */
+void writeInteger(int64_t i, FILE *out) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    fwrite(buffer, 1, formatInteger(i, buffer), out);
+}
+
+
+/*
+ * Write a double to a stream.
+ */
+void writeDouble(double d, FILE *out) {
+    char buffer[NUMBER_BUFFER_SIZE];
+    fwrite(buffer, 1, formatDouble(d, buffer), out);
+}
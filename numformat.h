@@ -0,0 +1,38 @@
+/*
+ * This program writes numbers in decimal: integers, and doubles in the
+ * shortest form that reads back as the same double.
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef NUMFORMAT_H
+#define NUMFORMAT_H
+
+/* Room for any number written by the functions below, with its NUL. */
+#define NUMBER_BUFFER_SIZE 32
+
+/*
+ * Write an integer into the buffer.
+ *
+ * Returns the number of characters written, not counting the NUL.
+ */
+int formatInteger(int64_t i, char *buffer);
+
+/*
+ * Write a double into the buffer with the fewest digits that read back
+ * as the same double, e.g. 0.1, 3.0, 1e-9, or 1.5e+300 as 1.5e300.
+ * Numbers from 1e-6 up to, but not including, 1e21 are written without
+ * an exponent; the others as a digit, a fraction, and an exponent.
+ * Infinities and NaN are written as +inf.0, -inf.0, and +nan.0.
+ *
+ * Returns the number of characters written, not counting the NUL.
+ */
+int formatDouble(double d, char *buffer);
+
+/*
+ * Write an integer or a double to a stream, as formatted above.
+ */
+void writeInteger(int64_t i, FILE *out);
+void writeDouble(double d, FILE *out);
+
+#endif
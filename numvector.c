@@ -0,0 +1,1221 @@
+/*
+ * This program implements the homogeneous numeric vectors of SRFI 4,
+ * f64vectors, s64vectors, and u8vectors, whose elements are stored
+ * unboxed in one block, and bulk arithmetic over them.
+ *
+ * On x86-64 the bulk operations run SSE2 loops, or AVX2 loops when the
+ * processor has AVX2, and finish the last few elements with plain C
+ * loops, which are also all that is used on other processors.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "numvector.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+#include "bignum.h"
+#include "numformat.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define X86_SIMD
+#include <immintrin.h>
+/* Compile a kernel for AVX2; callers check hasAvx2() first. */
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+static char *vectorNames[] = {"f64vector", "s64vector", "u8vector"};
+static char *vectorTags[] = {"f64", "s64", "u8"};
+static size_t elementSizes[] = {sizeof(double), sizeof(int64_t),
+                                sizeof(uint8_t)};
+
+/* The element by element operations. */
+enum BulkOperation { BULK_ADD, BULK_MUL };
+
+/* The comparisons that produce masks; > is < with the operands swapped. */
+enum MaskComparison { MASK_LESS, MASK_EQUAL, MASK_GREATER };
+
+
+#ifdef X86_SIMD
+/*
+ * Helper function to test, once, whether the processor has AVX2.
+ */
+bool hasAvx2() {
+    static int avx2 = -1;
+    if (avx2 < 0) {
+        __builtin_cpu_init();
+        avx2 = __builtin_cpu_supports("avx2") != 0;
+    }
+    return avx2;
+}
+
+
+/*
+ * Helper function to turn the low `count' bits of a movemask into a
+ * mask of 0 and 1 bytes.
+ */
+void storeMaskBits(uint8_t *out, int bits, int count) {
+    for (int j = 0; j < count; j++) {
+        out[j] = (bits >> j) & 1;
+    }
+}
+#endif
+
+
+/*
+ * Helper function to keep the smaller or larger of two elements, or a
+ * NaN if either is one, so that the minimum or maximum of a vector
+ * holding a NaN is NaN wherever the NaN is.
+ */
+double moreExtreme(double result, double x, bool largest) {
+    if (isnan(result)) {
+        return result;
+    }
+    if (isnan(x) || (largest ? x > result : x < result)) {
+        return x;
+    }
+    return result;
+}
+
+
+/*
+ * The kernels. Each AVX2 kernel handles a prefix of the vectors and
+ * returns the index where it stopped, so that the SSE2 loop and then
+ * the C loop of its caller can finish the rest.
+ */
+
+#ifdef X86_SIMD
+AVX2 int64_t arithmeticF64Avx2(enum BulkOperation operation, double *out,
+                               double *a, double *b, int64_t n) {
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256d y = _mm256_loadu_pd(b + i);
+        _mm256_storeu_pd(out + i, operation == BULK_ADD ?
+                         _mm256_add_pd(x, y) : _mm256_mul_pd(x, y));
+    }
+    return i;
+}
+
+AVX2 int64_t scaleF64Avx2(double *out, double *a, double k, int64_t n) {
+    __m256d factor = _mm256_set1_pd(k);
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), factor));
+    }
+    return i;
+}
+
+AVX2 int64_t dotF64Avx2(double *a, double *b, int64_t n, double *result) {
+    __m256d sum = _mm256_setzero_pd();
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(a + i),
+                                               _mm256_loadu_pd(b + i)));
+    }
+    double parts[4];
+    _mm256_storeu_pd(parts, sum);
+    *result += (parts[0] + parts[1]) + (parts[2] + parts[3]);
+    return i;
+}
+
+AVX2 int64_t sumF64Avx2(double *a, int64_t n, double *result) {
+    __m256d sum = _mm256_setzero_pd();
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        sum = _mm256_add_pd(sum, _mm256_loadu_pd(a + i));
+    }
+    double parts[4];
+    _mm256_storeu_pd(parts, sum);
+    *result += (parts[0] + parts[1]) + (parts[2] + parts[3]);
+    return i;
+}
+
+AVX2 int64_t extremeF64Avx2(double *a, int64_t n, bool largest,
+                            double *result) {
+    if (n < 4) {
+        return 0;
+    }
+    __m256d extreme = _mm256_loadu_pd(a);
+    // max and min drop a NaN in their first operand, so NaNs are kept
+    // in a mask of their own
+    __m256d nans = _mm256_cmp_pd(extreme, extreme, _CMP_UNORD_Q);
+    int64_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        nans = _mm256_or_pd(nans, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+        extreme = largest ? _mm256_max_pd(extreme, x) : _mm256_min_pd(extreme, x);
+    }
+    double parts[4];
+    _mm256_storeu_pd(parts, _mm256_or_pd(extreme, nans));
+    for (int j = 0; j < 4; j++) {
+        *result = moreExtreme(*result, parts[j], largest);
+    }
+    return i;
+}
+
+AVX2 int64_t compareF64Avx2(enum MaskComparison comparison, uint8_t *out,
+                            double *a, double *b, int64_t n) {
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        __m256d y = _mm256_loadu_pd(b + i);
+        __m256d mask = comparison == MASK_EQUAL ?
+                       _mm256_cmp_pd(x, y, _CMP_EQ_OQ) :
+                       _mm256_cmp_pd(x, y, _CMP_LT_OQ);
+        storeMaskBits(out + i, _mm256_movemask_pd(mask), 4);
+    }
+    return i;
+}
+
+AVX2 int64_t addS64Avx2(int64_t *out, int64_t *a, int64_t *b, int64_t n) {
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((__m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((__m256i *) (b + i));
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_add_epi64(x, y));
+    }
+    return i;
+}
+
+AVX2 int64_t extremeS64Avx2(int64_t *a, int64_t n, bool largest,
+                            int64_t *result) {
+    if (n < 4) {
+        return 0;
+    }
+    __m256i extreme = _mm256_loadu_si256((__m256i *) a);
+    int64_t i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((__m256i *) (a + i));
+        __m256i replace = largest ? _mm256_cmpgt_epi64(x, extreme) :
+                                    _mm256_cmpgt_epi64(extreme, x);
+        extreme = _mm256_blendv_epi8(extreme, x, replace);
+    }
+    int64_t parts[4];
+    _mm256_storeu_si256((__m256i *) parts, extreme);
+    for (int j = 0; j < 4; j++) {
+        if (largest ? parts[j] > *result : parts[j] < *result) {
+            *result = parts[j];
+        }
+    }
+    return i;
+}
+
+AVX2 int64_t compareS64Avx2(enum MaskComparison comparison, uint8_t *out,
+                            int64_t *a, int64_t *b, int64_t n) {
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((__m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((__m256i *) (b + i));
+        __m256i mask = comparison == MASK_EQUAL ? _mm256_cmpeq_epi64(x, y) :
+                                                  _mm256_cmpgt_epi64(y, x);
+        storeMaskBits(out + i, _mm256_movemask_pd(_mm256_castsi256_pd(mask)), 4);
+    }
+    return i;
+}
+
+AVX2 int64_t addU8Avx2(uint8_t *out, uint8_t *a, uint8_t *b, int64_t n) {
+    int64_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((__m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((__m256i *) (b + i));
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_add_epi8(x, y));
+    }
+    return i;
+}
+
+AVX2 int64_t sumU8Avx2(uint8_t *a, int64_t n, uint64_t *result) {
+    __m256i sum = _mm256_setzero_si256();
+    int64_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((__m256i *) (a + i));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(x, _mm256_setzero_si256()));
+    }
+    uint64_t parts[4];
+    _mm256_storeu_si256((__m256i *) parts, sum);
+    *result += parts[0] + parts[1] + parts[2] + parts[3];
+    return i;
+}
+
+AVX2 int64_t extremeU8Avx2(uint8_t *a, int64_t n, bool largest,
+                           uint8_t *result) {
+    if (n < 32) {
+        return 0;
+    }
+    __m256i extreme = _mm256_loadu_si256((__m256i *) a);
+    int64_t i = 32;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((__m256i *) (a + i));
+        extreme = largest ? _mm256_max_epu8(extreme, x) : _mm256_min_epu8(extreme, x);
+    }
+    uint8_t parts[32];
+    _mm256_storeu_si256((__m256i *) parts, extreme);
+    for (int j = 0; j < 32; j++) {
+        if (largest ? parts[j] > *result : parts[j] < *result) {
+            *result = parts[j];
+        }
+    }
+    return i;
+}
+
+AVX2 int64_t compareU8Avx2(enum MaskComparison comparison, uint8_t *out,
+                           uint8_t *a, uint8_t *b, int64_t n) {
+    // There is no unsigned byte comparison, so flip the sign bits
+    __m256i bias = _mm256_set1_epi8((char) 0x80);
+    __m256i one = _mm256_set1_epi8(1);
+    int64_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((__m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((__m256i *) (b + i));
+        __m256i mask = comparison == MASK_EQUAL ? _mm256_cmpeq_epi8(x, y) :
+                       _mm256_cmpgt_epi8(_mm256_xor_si256(y, bias),
+                                         _mm256_xor_si256(x, bias));
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_and_si256(mask, one));
+    }
+    return i;
+}
+#endif
+
+
+/*
+ * Helper function to add or multiply two f64vectors element by element.
+ */
+void arithmeticF64(enum BulkOperation operation, double *out, double *a,
+                   double *b, int64_t n) {
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = arithmeticF64Avx2(operation, out, a, b, n);
+    }
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        __m128d y = _mm_loadu_pd(b + i);
+        _mm_storeu_pd(out + i, operation == BULK_ADD ?
+                      _mm_add_pd(x, y) : _mm_mul_pd(x, y));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = operation == BULK_ADD ? a[i] + b[i] : a[i] * b[i];
+    }
+}
+
+
+/*
+ * Helper function to multiply every element of an f64vector by k.
+ */
+void scaleF64(double *out, double *a, double k, int64_t n) {
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = scaleF64Avx2(out, a, k, n);
+    }
+    __m128d factor = _mm_set1_pd(k);
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), factor));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = a[i] * k;
+    }
+}
+
+
+/*
+ * Helper function to compute the dot product of two f64vectors. The
+ * products are added in a different order than a plain loop would, so
+ * the last bits of the result can differ from one.
+ */
+double dotF64(double *a, double *b, int64_t n) {
+    double result = 0;
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = dotF64Avx2(a, b, n, &result);
+    }
+    __m128d sum = _mm_setzero_pd();
+    for (; i + 2 <= n; i += 2) {
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(a + i),
+                                         _mm_loadu_pd(b + i)));
+    }
+    double parts[2];
+    _mm_storeu_pd(parts, sum);
+    result += parts[0] + parts[1];
+#endif
+    for (; i < n; i++) {
+        result += a[i] * b[i];
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to compute the sum of an f64vector, in the same
+ * order as dotF64.
+ */
+double sumF64(double *a, int64_t n) {
+    double result = 0;
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = sumF64Avx2(a, n, &result);
+    }
+    __m128d sum = _mm_setzero_pd();
+    for (; i + 2 <= n; i += 2) {
+        sum = _mm_add_pd(sum, _mm_loadu_pd(a + i));
+    }
+    double parts[2];
+    _mm_storeu_pd(parts, sum);
+    result += parts[0] + parts[1];
+#endif
+    for (; i < n; i++) {
+        result += a[i];
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to find the smallest or largest element of a
+ * non-empty f64vector.
+ */
+double extremeF64(double *a, int64_t n, bool largest) {
+    double result = a[0];
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = extremeF64Avx2(a, n, largest, &result);
+    }
+    if (i + 2 <= n) {
+        __m128d extreme = _mm_loadu_pd(a + i);
+        __m128d nans = _mm_cmpunord_pd(extreme, extreme);
+        for (i += 2; i + 2 <= n; i += 2) {
+            __m128d x = _mm_loadu_pd(a + i);
+            nans = _mm_or_pd(nans, _mm_cmpunord_pd(x, x));
+            extreme = largest ? _mm_max_pd(extreme, x) : _mm_min_pd(extreme, x);
+        }
+        double parts[2];
+        _mm_storeu_pd(parts, _mm_or_pd(extreme, nans));
+        for (int j = 0; j < 2; j++) {
+            result = moreExtreme(result, parts[j], largest);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        result = moreExtreme(result, a[i], largest);
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to compare two f64vectors element by element with
+ * < or =, writing 1 where the comparison holds and 0 elsewhere.
+ */
+void compareF64(enum MaskComparison comparison, uint8_t *out, double *a,
+                double *b, int64_t n) {
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = compareF64Avx2(comparison, out, a, b, n);
+    }
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        __m128d y = _mm_loadu_pd(b + i);
+        __m128d mask = comparison == MASK_EQUAL ? _mm_cmpeq_pd(x, y) :
+                                                  _mm_cmplt_pd(x, y);
+        storeMaskBits(out + i, _mm_movemask_pd(mask), 2);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = comparison == MASK_EQUAL ? a[i] == b[i] : a[i] < b[i];
+    }
+}
+
+
+/*
+ * Helper function to add or multiply two s64vectors element by element,
+ * wrapping around on overflow.
+ */
+void arithmeticS64(enum BulkOperation operation, int64_t *out, int64_t *a,
+                   int64_t *b, int64_t n) {
+    int64_t i = 0;
+    if (operation == BULK_MUL) {
+        // Neither SSE2 nor AVX2 multiplies 64-bit integers
+        for (; i < n; i++) {
+            out[i] = (int64_t) ((uint64_t) a[i] * (uint64_t) b[i]);
+        }
+        return;
+    }
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = addS64Avx2(out, a, b, n);
+    }
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((__m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((__m128i *) (b + i));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_add_epi64(x, y));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = (int64_t) ((uint64_t) a[i] + (uint64_t) b[i]);
+    }
+}
+
+
+/*
+ * Helper function to compute the exact dot product of two s64vectors.
+ * It stays in 64 bits until the sum overflows and then goes on with
+ * exact integers of any size.
+ */
+Value *dotS64(int64_t *a, int64_t *b, int64_t n) {
+    int64_t sum = 0;
+    int64_t i = 0;
+    for (; i < n; i++) {
+        int64_t product;
+        if (__builtin_mul_overflow(a[i], b[i], &product) ||
+            __builtin_add_overflow(sum, product, &product)) {
+            break;
+        }
+        sum = product;
+    }
+    Value *result = makeInteger(sum);
+    for (; i < n; i++) {
+        result = addExact(result, multiplyExact(makeInteger(a[i]),
+                                                makeInteger(b[i])));
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to compute the exact sum of an s64vector.
+ */
+Value *sumS64(int64_t *a, int64_t n) {
+    int64_t sum = 0;
+    int64_t i = 0;
+    for (; i < n; i++) {
+        int64_t next;
+        if (__builtin_add_overflow(sum, a[i], &next)) {
+            break;
+        }
+        sum = next;
+    }
+    Value *result = makeInteger(sum);
+    for (; i < n; i++) {
+        result = addExact(result, makeInteger(a[i]));
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to find the smallest or largest element of a
+ * non-empty s64vector. SSE2 cannot compare 64-bit integers, so only
+ * the AVX2 kernel is used.
+ */
+int64_t extremeS64(int64_t *a, int64_t n, bool largest) {
+    int64_t result = a[0];
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = extremeS64Avx2(a, n, largest, &result);
+    }
+#endif
+    for (; i < n; i++) {
+        if (largest ? a[i] > result : a[i] < result) {
+            result = a[i];
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to compare two s64vectors element by element with
+ * < or =.
+ */
+void compareS64(enum MaskComparison comparison, uint8_t *out, int64_t *a,
+                int64_t *b, int64_t n) {
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = compareS64Avx2(comparison, out, a, b, n);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = comparison == MASK_EQUAL ? a[i] == b[i] : a[i] < b[i];
+    }
+}
+
+
+/*
+ * Helper function to add or multiply two u8vectors element by element,
+ * modulo 256.
+ */
+void arithmeticU8(enum BulkOperation operation, uint8_t *out, uint8_t *a,
+                  uint8_t *b, int64_t n) {
+    int64_t i = 0;
+    if (operation == BULK_MUL) {
+        for (; i < n; i++) {
+            out[i] = (uint8_t) (a[i] * b[i]);
+        }
+        return;
+    }
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = addU8Avx2(out, a, b, n);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((__m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((__m128i *) (b + i));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_add_epi8(x, y));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = (uint8_t) (a[i] + b[i]);
+    }
+}
+
+
+/*
+ * Helper function to compute the sum of a u8vector, which cannot
+ * overflow 64 bits.
+ */
+uint64_t sumU8(uint8_t *a, int64_t n) {
+    uint64_t result = 0;
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = sumU8Avx2(a, n, &result);
+    }
+    // The sum of absolute differences from zero adds up 8 bytes at once
+    __m128i sum = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((__m128i *) (a + i));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(x, _mm_setzero_si128()));
+    }
+    uint64_t parts[2];
+    _mm_storeu_si128((__m128i *) parts, sum);
+    result += parts[0] + parts[1];
+#endif
+    for (; i < n; i++) {
+        result += a[i];
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to find the smallest or largest element of a
+ * non-empty u8vector.
+ */
+uint8_t extremeU8(uint8_t *a, int64_t n, bool largest) {
+    uint8_t result = a[0];
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = extremeU8Avx2(a, n, largest, &result);
+    }
+    if (i + 16 <= n) {
+        __m128i extreme = _mm_loadu_si128((__m128i *) (a + i));
+        for (i += 16; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128((__m128i *) (a + i));
+            extreme = largest ? _mm_max_epu8(extreme, x) : _mm_min_epu8(extreme, x);
+        }
+        uint8_t parts[16];
+        _mm_storeu_si128((__m128i *) parts, extreme);
+        for (int j = 0; j < 16; j++) {
+            if (largest ? parts[j] > result : parts[j] < result) {
+                result = parts[j];
+            }
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (largest ? a[i] > result : a[i] < result) {
+            result = a[i];
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Helper function to compare two u8vectors element by element with
+ * < or =.
+ */
+void compareU8(enum MaskComparison comparison, uint8_t *out, uint8_t *a,
+               uint8_t *b, int64_t n) {
+    int64_t i = 0;
+#ifdef X86_SIMD
+    if (hasAvx2()) {
+        i = compareU8Avx2(comparison, out, a, b, n);
+    }
+    __m128i bias = _mm_set1_epi8((char) 0x80);
+    __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((__m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((__m128i *) (b + i));
+        __m128i mask = comparison == MASK_EQUAL ? _mm_cmpeq_epi8(x, y) :
+                       _mm_cmplt_epi8(_mm_xor_si128(x, bias),
+                                      _mm_xor_si128(y, bias));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_and_si128(mask, one));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = comparison == MASK_EQUAL ? a[i] == b[i] : a[i] < b[i];
+    }
+}
+
+
+/*
+ * Create a numeric vector of the given kind and length. The elements
+ * are zero.
+ */
+Value *makeNumVector(numVectorKind kind, int64_t length) {
+    Value *vector = talloc(sizeof(Value));
+    // One spare byte so that empty vectors still get a block
+    void *data = talloc(elementSizes[kind] * length + 1);
+    if (!vector || !data) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    memset(data, 0, elementSizes[kind] * length);
+    vector->type = NUMVECTOR_TYPE;
+    vector->numvec.kind = kind;
+    vector->numvec.length = length;
+    vector->numvec.data = data;
+    vector->numvec.readOnly = false;
+    return vector;
+}
+
+
+/*
+ * Print a numeric vector, e.g. #u8(1 2 3).
+ */
+void displayNumVector(Value *vector) {
+    printf("#%s(", vectorTags[vector->numvec.kind]);
+    for (int64_t i = 0; i < vector->numvec.length; i++) {
+        if (i > 0) {
+            printf(" ");
+        }
+        switch (vector->numvec.kind) {
+            case F64_VECTOR:
+                writeDouble(((double *) vector->numvec.data)[i], stdout);
+                break;
+            case S64_VECTOR:
+                writeInteger(((int64_t *) vector->numvec.data)[i], stdout);
+                break;
+            case U8_VECTOR:
+                writeInteger(((uint8_t *) vector->numvec.data)[i], stdout);
+                break;
+        }
+    }
+    printf(")");
+}
+
+
+/*
+ * Helper function to report a wrong argument to a vector primitive.
+ * `format' gives the name of the primitive with %s in place of the
+ * vector type, e.g. "%s-ref".
+ */
+void vectorError(numVectorKind kind, char *format, char *message) {
+    printf(format, vectorNames[kind]);
+    printf(" %s\n", message);
+    evaluationError();
+}
+
+
+/*
+ * Helper function to check that an argument is a vector of the given
+ * kind.
+ */
+Value *vectorArgument(Value *value, numVectorKind kind, char *format) {
+    if (value->type != NUMVECTOR_TYPE || value->numvec.kind != kind) {
+        printf(format, vectorNames[kind]);
+        printf(" expects a %s as input\n", vectorNames[kind]);
+        evaluationError();
+    }
+    return value;
+}
+
+
+/*
+ * Helper function to check that the two arguments of a bulk operation
+ * are vectors of the given kind with the same length.
+ */
+void checkSameShape(Value *args, numVectorKind kind, char *format) {
+    checkArity(args, 2, 2);
+    Value *first = vectorArgument(car(args), kind, format);
+    Value *second = vectorArgument(car(cdr(args)), kind, format);
+    if (first->numvec.length != second->numvec.length) {
+        vectorError(kind, format, "expects vectors of the same length");
+    }
+}
+
+
+/*
+ * Helper function to read an element of a numeric vector as a Scheme
+ * number.
+ */
+Value *elementValue(Value *vector, int64_t index) {
+    switch (vector->numvec.kind) {
+        case F64_VECTOR:
+            return makeDouble(((double *) vector->numvec.data)[index]);
+        case S64_VECTOR:
+            return makeInteger(((int64_t *) vector->numvec.data)[index]);
+        default:
+            return makeInteger(((uint8_t *) vector->numvec.data)[index]);
+    }
+}
+
+
+/*
+ * Helper function to read a Scheme number as a double.
+ *
+ * Returns false if the value is not a number.
+ */
+bool realValue(Value *value, double *d) {
+    switch (value->type) {
+        case DOUBLE_TYPE:
+            *d = value->d;
+            return true;
+        case INT_TYPE:
+            *d = value->i;
+            return true;
+        case BIGNUM_TYPE:
+            *d = exactToDouble(value);
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+/*
+ * Helper function to store a Scheme number into an element of a
+ * numeric vector, checking that the vector can hold it.
+ */
+void storeElement(Value *vector, int64_t index, Value *value, char *format) {
+    numVectorKind kind = vector->numvec.kind;
+    if (vector->numvec.readOnly) {
+        vectorError(kind, format, "cannot change a read-only vector");
+    }
+    switch (kind) {
+        case F64_VECTOR: {
+            double d = 0;
+            if (!realValue(value, &d)) {
+                vectorError(kind, format, "expects numbers as elements");
+            }
+            ((double *) vector->numvec.data)[index] = d;
+            break;
+        }
+        case S64_VECTOR:
+            if (value->type != INT_TYPE) {
+                vectorError(kind, format,
+                            "expects exact integers that fit in 64 bits as elements");
+            }
+            ((int64_t *) vector->numvec.data)[index] = value->i;
+            break;
+        case U8_VECTOR:
+            if (value->type != INT_TYPE || value->i < 0 || value->i > 255) {
+                vectorError(kind, format,
+                            "expects exact integers from 0 to 255 as elements");
+            }
+            ((uint8_t *) vector->numvec.data)[index] = (uint8_t) value->i;
+            break;
+    }
+}
+
+
+/*
+ * Helper function to check an index into a numeric vector.
+ */
+int64_t indexArgument(Value *vector, Value *index, char *format) {
+    if (index->type != INT_TYPE || index->i < 0 ||
+        index->i >= vector->numvec.length) {
+        vectorError(vector->numvec.kind, format,
+                    "expects an index within the vector");
+    }
+    return index->i;
+}
+
+
+/*
+ * Implementing make-f64vector and friends: (make-f64vector n [fill]).
+ */
+Value *makeVectorOf(numVectorKind kind, Value *args) {
+    checkArity(args, 1, 2);
+    Value *size = car(args);
+    if (size->type != INT_TYPE || size->i < 0) {
+        vectorError(kind, "make-%s", "expects a non-negative length");
+    }
+    Value *vector = makeNumVector(kind, size->i);
+    if (cdr(args)->type != NULL_TYPE) {
+        for (int64_t i = 0; i < size->i; i++) {
+            storeElement(vector, i, car(cdr(args)), "make-%s");
+        }
+    }
+    return vector;
+}
+
+
+/*
+ * Implementing f64vector and friends, which collect their arguments.
+ */
+Value *vectorOfArguments(numVectorKind kind, Value *args) {
+    Value *vector = makeNumVector(kind, length(args));
+    int64_t i = 0;
+    for (Value *cur = args; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        storeElement(vector, i++, car(cur), "%s");
+    }
+    return vector;
+}
+
+
+/*
+ * Implementing f64vector? and friends.
+ */
+Value *isVectorOf(numVectorKind kind, Value *args) {
+    checkArity(args, 1, 1);
+    Value *value = car(args);
+    return makeBoolean(value->type == NUMVECTOR_TYPE &&
+                       value->numvec.kind == kind);
+}
+
+
+/*
+ * Implementing f64vector-length and friends.
+ */
+Value *vectorLengthOf(numVectorKind kind, Value *args) {
+    checkArity(args, 1, 1);
+    Value *vector = vectorArgument(car(args), kind, "%s-length");
+    return makeInteger(vector->numvec.length);
+}
+
+
+/*
+ * Implementing f64vector-ref and friends.
+ */
+Value *vectorRef(numVectorKind kind, Value *args) {
+    checkArity(args, 2, 2);
+    Value *vector = vectorArgument(car(args), kind, "%s-ref");
+    return elementValue(vector, indexArgument(vector, car(cdr(args)), "%s-ref"));
+}
+
+
+/*
+ * Implementing f64vector-set! and friends.
+ */
+Value *vectorSet(numVectorKind kind, Value *args) {
+    checkArity(args, 3, 3);
+    Value *vector = vectorArgument(car(args), kind, "%s-set!");
+    int64_t index = indexArgument(vector, car(cdr(args)), "%s-set!");
+    storeElement(vector, index, car(cdr(cdr(args))), "%s-set!");
+    return makeVoid();
+}
+
+
+/*
+ * Implementing f64vector->list and friends.
+ */
+Value *vectorToList(numVectorKind kind, Value *args) {
+    checkArity(args, 1, 1);
+    Value *vector = vectorArgument(car(args), kind, "%s->list");
+    Value *list = makeNull();
+    for (int64_t i = vector->numvec.length - 1; i >= 0; i--) {
+        list = cons(elementValue(vector, i), list);
+    }
+    return list;
+}
+
+
+/*
+ * Implementing list->f64vector and friends.
+ */
+Value *listToVector(numVectorKind kind, Value *args) {
+    checkArity(args, 1, 1);
+    Value *list = car(args);
+    int64_t count = 0;
+    Value *cur = list;
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        count++;
+    }
+    if (cur->type != NULL_TYPE) {
+        vectorError(kind, "list->%s", "expects a list as input");
+    }
+    Value *vector = makeNumVector(kind, count);
+    int64_t i = 0;
+    for (cur = list; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        storeElement(vector, i++, car(cur), "list->%s");
+    }
+    return vector;
+}
+
+
+/*
+ * Implementing f64vector-add, f64vector-mul, and friends.
+ */
+Value *vectorArithmetic(numVectorKind kind, Value *args,
+                        enum BulkOperation operation) {
+    char *format = operation == BULK_ADD ? "%s-add" : "%s-mul";
+    checkSameShape(args, kind, format);
+    Value *a = car(args);
+    Value *b = car(cdr(args));
+    int64_t n = a->numvec.length;
+    Value *result = makeNumVector(kind, n);
+    switch (kind) {
+        case F64_VECTOR:
+            arithmeticF64(operation, result->numvec.data, a->numvec.data,
+                          b->numvec.data, n);
+            break;
+        case S64_VECTOR:
+            arithmeticS64(operation, result->numvec.data, a->numvec.data,
+                          b->numvec.data, n);
+            break;
+        case U8_VECTOR:
+            arithmeticU8(operation, result->numvec.data, a->numvec.data,
+                         b->numvec.data, n);
+            break;
+    }
+    return result;
+}
+
+
+/*
+ * Implementing f64vector-scale and friends, which multiply every
+ * element by a number. s64vectors and u8vectors are scaled by exact
+ * integers, wrapping around like f64vector-mul.
+ */
+Value *vectorScale(numVectorKind kind, Value *args) {
+    checkArity(args, 2, 2);
+    Value *a = vectorArgument(car(args), kind, "%s-scale");
+    Value *factor = car(cdr(args));
+    int64_t n = a->numvec.length;
+    Value *result = makeNumVector(kind, n);
+    if (kind == F64_VECTOR) {
+        double k = 0;
+        if (!realValue(factor, &k)) {
+            vectorError(kind, "%s-scale", "expects a number as the factor");
+        }
+        scaleF64(result->numvec.data, a->numvec.data, k, n);
+        return result;
+    }
+    if (factor->type != INT_TYPE) {
+        vectorError(kind, "%s-scale", "expects an exact integer factor");
+    }
+    uint64_t k = (uint64_t) factor->i;
+    for (int64_t i = 0; i < n; i++) {
+        if (kind == S64_VECTOR) {
+            int64_t *in = a->numvec.data;
+            ((int64_t *) result->numvec.data)[i] = (int64_t) ((uint64_t) in[i] * k);
+        } else {
+            uint8_t *in = a->numvec.data;
+            ((uint8_t *) result->numvec.data)[i] = (uint8_t) (in[i] * k);
+        }
+    }
+    return result;
+}
+
+
+/*
+ * Implementing f64vector-dot and friends.
+ */
+Value *vectorDot(numVectorKind kind, Value *args) {
+    checkSameShape(args, kind, "%s-dot");
+    Value *a = car(args);
+    Value *b = car(cdr(args));
+    int64_t n = a->numvec.length;
+    switch (kind) {
+        case F64_VECTOR:
+            return makeDouble(dotF64(a->numvec.data, b->numvec.data, n));
+        case S64_VECTOR:
+            return dotS64(a->numvec.data, b->numvec.data, n);
+        default: {
+            uint8_t *x = a->numvec.data;
+            uint8_t *y = b->numvec.data;
+            uint64_t sum = 0;
+            for (int64_t i = 0; i < n; i++) {
+                sum += x[i] * y[i];
+            }
+            return makeInteger((int64_t) sum);
+        }
+    }
+}
+
+
+/*
+ * Implementing f64vector-sum and friends.
+ */
+Value *vectorSum(numVectorKind kind, Value *args) {
+    checkArity(args, 1, 1);
+    Value *a = vectorArgument(car(args), kind, "%s-sum");
+    int64_t n = a->numvec.length;
+    switch (kind) {
+        case F64_VECTOR:
+            return makeDouble(sumF64(a->numvec.data, n));
+        case S64_VECTOR:
+            return sumS64(a->numvec.data, n);
+        default:
+            return makeInteger((int64_t) sumU8(a->numvec.data, n));
+    }
+}
+
+
+/*
+ * Implementing f64vector-min, f64vector-max, and friends.
+ */
+Value *vectorExtreme(numVectorKind kind, Value *args, bool largest) {
+    char *format = largest ? "%s-max" : "%s-min";
+    checkArity(args, 1, 1);
+    Value *a = vectorArgument(car(args), kind, format);
+    int64_t n = a->numvec.length;
+    if (n == 0) {
+        vectorError(kind, format, "expects a non-empty vector");
+    }
+    switch (kind) {
+        case F64_VECTOR:
+            return makeDouble(extremeF64(a->numvec.data, n, largest));
+        case S64_VECTOR:
+            return makeInteger(extremeS64(a->numvec.data, n, largest));
+        default:
+            return makeInteger(extremeU8(a->numvec.data, n, largest));
+    }
+}
+
+
+/*
+ * Implementing f64vector<, f64vector=, f64vector>, and friends, which
+ * return a u8vector holding 1 where the comparison holds and 0
+ * elsewhere.
+ */
+Value *vectorCompare(numVectorKind kind, Value *args,
+                     enum MaskComparison comparison) {
+    static char *formats[] = {"%s<", "%s=", "%s>"};
+    checkSameShape(args, kind, formats[comparison]);
+    Value *a = car(args);
+    Value *b = car(cdr(args));
+    if (comparison == MASK_GREATER) {
+        a = car(cdr(args));
+        b = car(args);
+        comparison = MASK_LESS;
+    }
+    int64_t n = a->numvec.length;
+    Value *mask = makeNumVector(U8_VECTOR, n);
+    switch (kind) {
+        case F64_VECTOR:
+            compareF64(comparison, mask->numvec.data, a->numvec.data,
+                       b->numvec.data, n);
+            break;
+        case S64_VECTOR:
+            compareS64(comparison, mask->numvec.data, a->numvec.data,
+                       b->numvec.data, n);
+            break;
+        case U8_VECTOR:
+            compareU8(comparison, mask->numvec.data, a->numvec.data,
+                      b->numvec.data, n);
+            break;
+    }
+    return mask;
+}
+
+
+/*
+ * The primitives for one kind of vector, which pass the kind on to the
+ * functions above. DEFINE_PRIMITIVES(F64, F64_VECTOR) defines
+ * primitiveF64Make, primitiveF64Ref, and so on.
+ */
+#define DEFINE_PRIMITIVES(Kind, KIND) \
+    Value *primitive##Kind##Make(Value *args) { \
+        return makeVectorOf(KIND, args); \
+    } \
+    Value *primitive##Kind##Vector(Value *args) { \
+        return vectorOfArguments(KIND, args); \
+    } \
+    Value *primitive##Kind##IsVector(Value *args) { \
+        return isVectorOf(KIND, args); \
+    } \
+    Value *primitive##Kind##Length(Value *args) { \
+        return vectorLengthOf(KIND, args); \
+    } \
+    Value *primitive##Kind##Ref(Value *args) { \
+        return vectorRef(KIND, args); \
+    } \
+    Value *primitive##Kind##Set(Value *args) { \
+        return vectorSet(KIND, args); \
+    } \
+    Value *primitive##Kind##ToList(Value *args) { \
+        return vectorToList(KIND, args); \
+    } \
+    Value *primitive##Kind##FromList(Value *args) { \
+        return listToVector(KIND, args); \
+    } \
+    Value *primitive##Kind##Add(Value *args) { \
+        return vectorArithmetic(KIND, args, BULK_ADD); \
+    } \
+    Value *primitive##Kind##Mul(Value *args) { \
+        return vectorArithmetic(KIND, args, BULK_MUL); \
+    } \
+    Value *primitive##Kind##Scale(Value *args) { \
+        return vectorScale(KIND, args); \
+    } \
+    Value *primitive##Kind##Dot(Value *args) { \
+        return vectorDot(KIND, args); \
+    } \
+    Value *primitive##Kind##Sum(Value *args) { \
+        return vectorSum(KIND, args); \
+    } \
+    Value *primitive##Kind##Min(Value *args) { \
+        return vectorExtreme(KIND, args, false); \
+    } \
+    Value *primitive##Kind##Max(Value *args) { \
+        return vectorExtreme(KIND, args, true); \
+    } \
+    Value *primitive##Kind##Less(Value *args) { \
+        return vectorCompare(KIND, args, MASK_LESS); \
+    } \
+    Value *primitive##Kind##Equal(Value *args) { \
+        return vectorCompare(KIND, args, MASK_EQUAL); \
+    } \
+    Value *primitive##Kind##Greater(Value *args) { \
+        return vectorCompare(KIND, args, MASK_GREATER); \
+    }
+
+DEFINE_PRIMITIVES(F64, F64_VECTOR)
+DEFINE_PRIMITIVES(S64, S64_VECTOR)
+DEFINE_PRIMITIVES(U8, U8_VECTOR)
+
+/*
+ * Bind the primitives defined by DEFINE_PRIMITIVES(Kind, ...) under the
+ * names of SRFI 4 for the type `tag', e.g. "f64".
+ */
+#define BIND_PRIMITIVES(Kind, tag) \
+    bind("make-" tag "vector", primitive##Kind##Make, topFrame); \
+    bind(tag "vector", primitive##Kind##Vector, topFrame); \
+    bind(tag "vector?", primitive##Kind##IsVector, topFrame); \
+    bind(tag "vector-length", primitive##Kind##Length, topFrame); \
+    bind(tag "vector-ref", primitive##Kind##Ref, topFrame); \
+    bind(tag "vector-set!", primitive##Kind##Set, topFrame); \
+    bind(tag "vector->list", primitive##Kind##ToList, topFrame); \
+    bind("list->" tag "vector", primitive##Kind##FromList, topFrame); \
+    bind(tag "vector-add", primitive##Kind##Add, topFrame); \
+    bind(tag "vector-mul", primitive##Kind##Mul, topFrame); \
+    bind(tag "vector-scale", primitive##Kind##Scale, topFrame); \
+    bind(tag "vector-dot", primitive##Kind##Dot, topFrame); \
+    bind(tag "vector-sum", primitive##Kind##Sum, topFrame); \
+    bind(tag "vector-min", primitive##Kind##Min, topFrame); \
+    bind(tag "vector-max", primitive##Kind##Max, topFrame); \
+    bind(tag "vector<", primitive##Kind##Less, topFrame); \
+    bind(tag "vector=", primitive##Kind##Equal, topFrame); \
+    bind(tag "vector>", primitive##Kind##Greater, topFrame);
+
+/*
+ * Bind the numeric vector primitives in the given top-level frame.
+ */
+void bindNumVectorPrimitives(Frame *topFrame) {
+    BIND_PRIMITIVES(F64, "f64")
+    BIND_PRIMITIVES(S64, "s64")
+    BIND_PRIMITIVES(U8, "u8")
+}
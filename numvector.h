@@ -0,0 +1,40 @@
+/*
+ * This program implements the homogeneous numeric vectors of SRFI 4,
+ * f64vectors, s64vectors, and u8vectors, whose elements are stored
+ * unboxed in one block, and bulk arithmetic over them.
+ */
+#include "value.h"
+
+#ifndef NUMVECTOR_H
+#define NUMVECTOR_H
+
+/*
+ * Create a numeric vector of the given kind and length. The elements
+ * are zero.
+ */
+Value *makeNumVector(numVectorKind kind, int64_t length);
+
+/*
+ * Print a numeric vector, e.g. #u8(1 2 3).
+ */
+void displayNumVector(Value *vector);
+
+/*
+ * Bind the numeric vector primitives in the given top-level frame.
+ * For each of f64, s64, and u8 these are
+ *
+ *   make-f64vector f64vector f64vector? f64vector-length f64vector-ref
+ *   f64vector-set! f64vector->list list->f64vector
+ *
+ * from SRFI 4, and the bulk operations
+ *
+ *   f64vector-add f64vector-mul f64vector-scale   element by element
+ *   f64vector-dot f64vector-sum f64vector-min f64vector-max
+ *   f64vector< f64vector= f64vector>   masks: u8vectors of 0 and 1
+ *
+ * Arithmetic on s64vectors and u8vectors wraps around as it does in C;
+ * the dot products and sums are exact.
+ */
+void bindNumVectorPrimitives(Frame *topFrame);
+
+#endif
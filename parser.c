@@ -11,6 +11,10 @@
 #include "parser.h"
 #include "talloc.h"
 #include "linkedlist.h"
+#include "bignum.h"
+#include "numformat.h"
+#include "vector.h"
+#include "text.h"
 
 /*
  * Check whether the given token is an atom.
@@ -19,7 +23,8 @@ bool isAtom(Value *token) {
     int tokenType = token->type;
     return (tokenType == BOOL_TYPE || tokenType == SYMBOL_TYPE ||
            tokenType == INT_TYPE || tokenType == DOUBLE_TYPE ||
-           tokenType == STR_TYPE);
+           tokenType == STR_TYPE || tokenType == BIGNUM_TYPE ||
+           tokenType == VECTOR_TYPE || tokenType == CHAR_TYPE);
 }
 
 bool specialChar(Value *ch){
@@ -59,16 +64,37 @@ void printTreeHelper(Value *tree, Value *prev) {
                     break;
                 case INT_TYPE:
                     printSpace(prev); 
-                    printf("%d", car(cur)->i);
+                    writeInteger(car(cur)->i, stdout);
+                    break;
+                case BIGNUM_TYPE:
+                    printSpace(prev);
+                    printf("%s", exactToString(car(cur)));
                     break;
                 case DOUBLE_TYPE:
                     printSpace(prev);
-                    printf("%f", car(cur)->d);
+                    writeDouble(car(cur)->d, stdout);
                     break;
                 case STR_TYPE:
                     printSpace(prev);
-                    printf("%s", car(cur)->s);
+                    fwrite(car(cur)->str.chars, 1, car(cur)->str.length, stdout);
+                    break;
+                case CHAR_TYPE:
+                    printSpace(prev);
+                    writeCharacter(car(cur)->i, stdout);
                     break;
+                case VECTOR_TYPE: {
+                    printSpace(prev);
+                    printf("#(");
+                    Value *open = talloc(sizeof(Value));
+                    if (!open) {
+                        printf("Error! Not enough memory!\n");
+                        return;
+                    }
+                    open->type = OPEN_TYPE;
+                    printTreeHelper(listFromVector(car(cur)), open);
+                    printf(")");
+                    break;
+                }
                 default:
                     printf("ERROR\n");
             }
@@ -109,7 +135,7 @@ Value *parse(Value *tokens) {
     int quoteDepth = 0;
     while (current->type != NULL_TYPE) {
         Value *token = car(current);
-        if (token->type == OPEN_TYPE) {
+        if (token->type == OPEN_TYPE || token->type == VECTOR_OPEN_TYPE) {
             depth ++;
             if (quote) {
                 quoteDepth ++;
@@ -128,15 +154,19 @@ Value *parse(Value *tokens) {
             // Access top item in the list
             Value *head = car(stack);
             Value *inner = makeNull();
-                while (head->type != OPEN_TYPE) {
+                while (head->type != OPEN_TYPE && head->type != VECTOR_OPEN_TYPE) {
                    inner = cons(head, inner);
                     // Pop off the top item
                     stack = cdr(stack);
                     head = car(stack);
                 }
-                // Pop off the (
+                // Pop off the ( and turn #( ... ) into a vector
                 stack = cdr(stack);
-            if (!quote) {
+                if (head->type == VECTOR_OPEN_TYPE) {
+                    inner = vectorFromList(inner);
+                }
+            // Only the outermost datum after a quote is wrapped in it
+            if (!quote || quoteDepth > 0) {
                 // Push the list back on to the stack
                 stack = cons(inner, stack);
             } else {
@@ -0,0 +1,435 @@
+/*
+ * This program implements promises and streams.
+ *
+ * A promise points to a state: either its value, once forced, or what
+ * computes the value, an expression with its environment or a step
+ * written in C. Forcing follows SRFI 45. When a delay-force promise
+ * evaluates to another promise, the other promise's state is copied
+ * into its own, and the other promise is pointed at that state, and
+ * the loop goes on with the new contents. A chain of any length is
+ * forced in one loop, and all promises along it share the result.
+ *
+ * The built-in stream procedures make their promises with C steps,
+ * which take the rest of the input stream from the step's data and
+ * loop over it rather than recursing.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "promise.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/* The state of a promise, shared by the promises chained to it. */
+typedef struct Promise {
+    bool done;
+    /* The computation gives a promise to force in turn (delay-force) */
+    bool chained;
+    /* The value, once done */
+    Value *value;
+    /* The expression to evaluate and its environment, or NULL */
+    Value *expr;
+    Frame *frame;
+    /* Otherwise the step in C to call on `data' */
+    Value *(*step)(Value *data);
+    Value *data;
+} Promise;
+
+/*
+ * Helper function to make a promise with an empty state.
+ */
+Value *makePromise(bool done, bool chained) {
+    Value *promise = talloc(sizeof(Value));
+    Promise *state = talloc(sizeof(Promise));
+    if (!promise || !state) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    memset(state, 0, sizeof(Promise));
+    state->done = done;
+    state->chained = chained;
+    promise->type = PROMISE_TYPE;
+    promise->promise.state = state;
+    return promise;
+}
+
+/*
+ * Helper function to make a promise already forced to a value.
+ */
+Value *makeForcedPromise(Value *value) {
+    Value *promise = makePromise(true, false);
+    promise->promise.state->value = value;
+    return promise;
+}
+
+/*
+ * Helper function to make a promise computed by a step in C.
+ */
+Value *makeStepPromise(Value *(*step)(Value *), Value *data) {
+    Value *promise = makePromise(false, false);
+    promise->promise.state->step = step;
+    promise->promise.state->data = data;
+    return promise;
+}
+
+/*
+ * Helper function to make a promise of an expression in the given
+ * environment.
+ */
+Value *delayExpression(char *name, Value *args, Frame *frame, bool chained) {
+    if (length(args) != 1) {
+        printf("Invalid syntax in '%s'. Expected one expression. ", name);
+        evaluationError();
+    }
+    Value *promise = makePromise(false, chained);
+    promise->promise.state->expr = car(args);
+    promise->promise.state->frame = frame;
+    // Loops must not rebind the slots of a frame the promise holds
+    markCaptured(frame);
+    return promise;
+}
+
+Value *evalDelay(Value *args, Frame *frame) {
+    return delayExpression("delay", args, frame, false);
+}
+
+Value *evalDelayForce(Value *args, Frame *frame) {
+    return delayExpression("delay-force", args, frame, true);
+}
+
+Value *evalConsStream(Value *args, Frame *frame) {
+    if (length(args) != 2) {
+        printf("Invalid syntax in 'cons-stream'. Expected two expressions. ");
+        evaluationError();
+    }
+    Value *first = eval(car(args), frame);
+    return cons(first, delayExpression("cons-stream", cdr(args), frame,
+                                       false));
+}
+
+Value *forceValue(Value *value) {
+    if (value->type != PROMISE_TYPE) {
+        return value;
+    }
+    while (!value->promise.state->done) {
+        Promise *state = value->promise.state;
+        Value *result;
+        if (state->step != NULL) {
+            result = state->step(state->data);
+        } else {
+            result = eval(state->expr, state->frame);
+        }
+        // Forcing the promise again while computing it may have done it
+        if (state->done) {
+            break;
+        }
+        if (!state->chained) {
+            state->done = true;
+            state->value = result;
+        } else if (result->type != PROMISE_TYPE) {
+            primitiveError("force", "expects delay-force to give a promise");
+        } else {
+            *state = *result->promise.state;
+            result->promise.state = state;
+        }
+        // Drop what computed the value so that it can be collected
+        if (state->done) {
+            state->expr = NULL;
+            state->frame = NULL;
+            state->step = NULL;
+            state->data = NULL;
+        }
+    }
+    return value->promise.state->value;
+}
+
+void displayPromise(void) {
+    printf("#promise");
+}
+
+/*
+ * Implementing the Scheme primitive force.
+ */
+Value *primitiveForce(Value *args) {
+    checkArity(args, 1, 1);
+    return forceValue(car(args));
+}
+
+/*
+ * Implementing the Scheme primitive make-promise, which returns a
+ * promise as it is and makes a forced promise of anything else.
+ */
+Value *primitiveMakePromise(Value *args) {
+    checkArity(args, 1, 1);
+    if (car(args)->type == PROMISE_TYPE) {
+        return car(args);
+    }
+    return makeForcedPromise(car(args));
+}
+
+/*
+ * Implementing the Scheme primitive promise?.
+ */
+Value *primitiveIsPromise(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == PROMISE_TYPE);
+}
+
+/*
+ * Helper function to check that an argument is a stream pair.
+ */
+Value *streamPairArgument(char *name, Value *stream) {
+    if (stream->type != CONS_TYPE) {
+        primitiveError(name, "expects a non-empty stream as input");
+    }
+    return stream;
+}
+
+/*
+ * Helper function to check that an argument is a stream.
+ */
+Value *streamArgument(char *name, Value *stream) {
+    if (stream->type != CONS_TYPE && stream->type != NULL_TYPE) {
+        primitiveError(name, "expects a stream as input");
+    }
+    return stream;
+}
+
+/*
+ * Helper function to check that an argument is a count.
+ */
+int64_t countArgument(char *name, Value *count) {
+    if (count->type != INT_TYPE || count->i < 0) {
+        primitiveError(name, "expects a non-negative integer as input");
+    }
+    return count->i;
+}
+
+/*
+ * Helper function to follow a stream to its rest.
+ */
+Value *streamRest(char *name, Value *stream) {
+    return streamArgument(name, forceValue(cdr(stream)));
+}
+
+/*
+ * Helper function to call a procedure on one argument.
+ */
+Value *callStreamProcedure(Value *procedure, Value *argument) {
+    return apply(procedure, cons(argument, makeNull()));
+}
+
+/*
+ * Implementing the Scheme primitives stream-car, stream-cdr,
+ * stream-pair?, and stream-null?.
+ */
+Value *primitiveStreamCar(Value *args) {
+    checkArity(args, 1, 1);
+    return car(streamPairArgument("stream-car", car(args)));
+}
+
+Value *primitiveStreamCdr(Value *args) {
+    checkArity(args, 1, 1);
+    return streamRest("stream-cdr", streamPairArgument("stream-cdr",
+                                                       car(args)));
+}
+
+Value *primitiveIsStreamPair(Value *args) {
+    checkArity(args, 1, 1);
+    Value *stream = car(args);
+    return makeBoolean(stream->type == CONS_TYPE &&
+                       cdr(stream)->type == PROMISE_TYPE);
+}
+
+Value *primitiveIsStreamNull(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == NULL_TYPE);
+}
+
+Value *mapStreamStep(Value *data);
+
+/*
+ * Helper function to map a procedure over a stream: the first element
+ * now, and a promise of the rest. `data' is (procedure . stream).
+ */
+Value *mapStream(Value *data) {
+    Value *stream = cdr(data);
+    if (stream->type == NULL_TYPE) {
+        return stream;
+    }
+    Value *first = callStreamProcedure(car(data), car(stream));
+    Value *rest = cons(car(data), cdr(stream));
+    return cons(first, makeStepPromise(mapStreamStep, rest));
+}
+
+/*
+ * Helper function to force the rest of a stream given as the promise
+ * in the cdr of `data', and map over it.
+ */
+Value *mapStreamStep(Value *data) {
+    Value *stream = streamArgument("stream-map", forceValue(cdr(data)));
+    return mapStream(cons(car(data), stream));
+}
+
+/*
+ * Implementing the Scheme primitive stream-map.
+ */
+Value *primitiveStreamMap(Value *args) {
+    checkArity(args, 2, 2);
+    Value *stream = streamArgument("stream-map", car(cdr(args)));
+    return mapStream(cons(car(args), stream));
+}
+
+Value *filterStreamStep(Value *data);
+
+/*
+ * Helper function to filter a stream: skip, in a loop, to the first
+ * element that satisfies the predicate, and return it with a promise
+ * of the rest. `data' is (predicate . stream).
+ */
+Value *filterStream(Value *data) {
+    Value *predicate = car(data);
+    Value *stream = cdr(data);
+    while (stream->type == CONS_TYPE &&
+           !isTrue(callStreamProcedure(predicate, car(stream)))) {
+        stream = streamRest("stream-filter", stream);
+    }
+    if (stream->type == NULL_TYPE) {
+        return stream;
+    }
+    return cons(car(stream), makeStepPromise(filterStreamStep,
+                                             cons(predicate, cdr(stream))));
+}
+
+/*
+ * Helper function to force the rest of a stream given as the promise
+ * in the cdr of `data', and filter it.
+ */
+Value *filterStreamStep(Value *data) {
+    Value *stream = streamArgument("stream-filter", forceValue(cdr(data)));
+    return filterStream(cons(car(data), stream));
+}
+
+/*
+ * Implementing the Scheme primitive stream-filter.
+ */
+Value *primitiveStreamFilter(Value *args) {
+    checkArity(args, 2, 2);
+    Value *stream = streamArgument("stream-filter", car(cdr(args)));
+    return filterStream(cons(car(args), stream));
+}
+
+/*
+ * Helper function to take the given number of elements of a stream.
+ * `data' is (count . stream), where the stream may still be a promise.
+ */
+Value *takeStream(Value *data) {
+    int64_t count = car(data)->i;
+    if (count == 0) {
+        return makeNull();
+    }
+    Value *stream = streamArgument("stream-take", forceValue(cdr(data)));
+    if (stream->type == NULL_TYPE) {
+        return stream;
+    }
+    Value *rest = cons(makeInteger(count - 1), cdr(stream));
+    return cons(car(stream), makeStepPromise(takeStream, rest));
+}
+
+/*
+ * Implementing the Scheme primitive stream-take: (stream-take n s).
+ */
+Value *primitiveStreamTake(Value *args) {
+    checkArity(args, 2, 2);
+    countArgument("stream-take", car(args));
+    Value *stream = streamArgument("stream-take", car(cdr(args)));
+    return takeStream(cons(car(args), stream));
+}
+
+/*
+ * Implementing the Scheme primitive stream-ref: (stream-ref s n).
+ */
+Value *primitiveStreamRef(Value *args) {
+    checkArity(args, 2, 2);
+    Value *stream = streamArgument("stream-ref", car(args));
+    int64_t index = countArgument("stream-ref", car(cdr(args)));
+    for (; index > 0 && stream->type == CONS_TYPE; index--) {
+        stream = streamRest("stream-ref", stream);
+    }
+    if (stream->type != CONS_TYPE) {
+        primitiveError("stream-ref", "index out of bounds");
+    }
+    return car(stream);
+}
+
+/*
+ * Implementing the Scheme primitive stream->list, which takes the
+ * whole stream, or at most the given number of elements.
+ */
+Value *primitiveStreamToList(Value *args) {
+    checkArity(args, 1, 2);
+    Value *stream = streamArgument("stream->list", car(args));
+    int64_t limit = -1;
+    if (cdr(args)->type == CONS_TYPE) {
+        limit = countArgument("stream->list", car(cdr(args)));
+    }
+    Value head;
+    head.type = CONS_TYPE;
+    Value *tail = &head;
+    for (; limit != 0 && stream->type == CONS_TYPE; limit--) {
+        tail->c.cdr = cons(car(stream), makeNull());
+        tail = tail->c.cdr;
+        if (limit != 1) {
+            stream = streamRest("stream->list", stream);
+        }
+    }
+    tail->c.cdr = makeNull();
+    return head.c.cdr;
+}
+
+/*
+ * Implementing the Scheme primitive list->stream.
+ */
+Value *primitiveListToStream(Value *args) {
+    checkArity(args, 1, 1);
+    Value *result = makeNull();
+    Value *list = car(args);
+    int count = 0;
+    for (Value *cur = list; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        count++;
+    }
+    Value **elements = talloc(sizeof(Value *) * (count > 0 ? count : 1));
+    if (!elements) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    int i = 0;
+    for (Value *cur = list; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        elements[i++] = car(cur);
+    }
+    for (i = count - 1; i >= 0; i--) {
+        result = cons(elements[i], makeForcedPromise(result));
+    }
+    return result;
+}
+
+/*
+ * Bind the promise and stream primitives in the given top-level frame.
+ */
+void bindPromisePrimitives(Frame *topFrame) {
+    addBindingGlobal(makeSymbol("the-empty-stream"), makeNull(), topFrame);
+    bind("force", primitiveForce, topFrame);
+    bind("make-promise", primitiveMakePromise, topFrame);
+    bind("promise?", primitiveIsPromise, topFrame);
+    bind("stream-car", primitiveStreamCar, topFrame);
+    bind("stream-cdr", primitiveStreamCdr, topFrame);
+    bind("stream-pair?", primitiveIsStreamPair, topFrame);
+    bind("stream-null?", primitiveIsStreamNull, topFrame);
+    bind("stream-map", primitiveStreamMap, topFrame);
+    bind("stream-filter", primitiveStreamFilter, topFrame);
+    bind("stream-take", primitiveStreamTake, topFrame);
+    bind("stream-ref", primitiveStreamRef, topFrame);
+    bind("stream->list", primitiveStreamToList, topFrame);
+    bind("list->stream", primitiveListToStream, topFrame);
+}
@@ -0,0 +1,68 @@
+/*
+ * This program implements the promises of R7RS, with the semantics of
+ * SRFI 45, and the streams of SICP built on them. Forcing a chain of
+ * delay-force promises takes a loop rather than recursion, so it runs
+ * in constant C stack space however long the chain is.
+ */
+#include "value.h"
+
+#ifndef PROMISE_H
+#define PROMISE_H
+
+/*
+ * Evaluate the special forms
+ *
+ *   (delay expr)         a promise to evaluate expr once, when forced
+ *   (delay-force expr)   the same, for an expr that gives a promise,
+ *                        which is forced in turn
+ *   (cons-stream a b)    (cons a (delay b))
+ */
+Value *evalDelay(Value *args, Frame *frame);
+Value *evalDelayForce(Value *args, Frame *frame);
+Value *evalConsStream(Value *args, Frame *frame);
+
+/*
+ * Force a promise, for the interpreter and for compiled programs to
+ * call directly. Anything other than a promise is its own value.
+ */
+Value *forceValue(Value *value);
+
+/*
+ * Print a promise.
+ */
+void displayPromise(void);
+
+/*
+ * The primitives below, for compiled programs.
+ */
+Value *primitiveForce(Value *args);
+Value *primitiveMakePromise(Value *args);
+Value *primitiveIsPromise(Value *args);
+Value *primitiveStreamCar(Value *args);
+Value *primitiveStreamCdr(Value *args);
+Value *primitiveIsStreamPair(Value *args);
+Value *primitiveIsStreamNull(Value *args);
+Value *primitiveStreamMap(Value *args);
+Value *primitiveStreamFilter(Value *args);
+Value *primitiveStreamTake(Value *args);
+Value *primitiveStreamRef(Value *args);
+Value *primitiveStreamToList(Value *args);
+Value *primitiveListToStream(Value *args);
+
+/*
+ * Bind the promise and stream primitives in the given top-level frame.
+ * A stream is the empty list or a pair whose cdr is a promise of a
+ * stream.
+ *
+ *   force make-promise promise?
+ *   the-empty-stream stream-null? stream-pair? stream-car stream-cdr
+ *   stream-map f s   stream-filter pred s   stream-take n s
+ *   stream-ref s n   stream->list s [n]   list->stream
+ *
+ * stream-map, stream-filter, and stream-take are lazy: each element
+ * is computed when the stream is first followed that far, with a loop
+ * in C, so skipping any number of elements takes constant stack.
+ */
+void bindPromisePrimitives(Frame *topFrame);
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * This program implements the record types of R7RS. A record type
+ * knows its name and the names of its fields; a record points to its
+ * type and holds one slot per field. The constructor, predicate,
+ * accessors, and modifiers of a type are values of their own that
+ * remember the type and, for accessors and modifiers, the slot, so a
+ * call compares one pointer and then loads or stores one slot.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "record.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/*
+ * Helper function to report invalid syntax in define-record-type.
+ */
+void recordSyntaxError(char *message) {
+    printf("Invalid syntax in 'define-record-type'. %s ", message);
+    evaluationError();
+}
+
+/*
+ * Helper function to allocate a value of the given type.
+ */
+Value *makeRecordValue(valueType type) {
+    Value *value = talloc(sizeof(Value));
+    if (!value) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    value->type = type;
+    return value;
+}
+
+/*
+ * Helper function to make a procedure of the given kind for a record
+ * type, to be bound to `name'.
+ */
+Value *makeRecordProcedure(recordProcedureKind kind, Value *name,
+                           Value *descriptor, int64_t index) {
+    if (name->type != SYMBOL_TYPE) {
+        recordSyntaxError("Procedure names must be symbols.");
+    }
+    // The fields of the procedure follow the value in one block
+    Value *procedure = talloc(sizeof(Value) + sizeof(struct RecordProcedure));
+    if (!procedure) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    procedure->type = RECORD_PROCEDURE_TYPE;
+    procedure->recproc = (struct RecordProcedure *) (procedure + 1);
+    procedure->recproc->kind = kind;
+    procedure->recproc->name = name;
+    procedure->recproc->descriptor = descriptor;
+    procedure->recproc->index = index;
+    procedure->recproc->count = 0;
+    procedure->recproc->positions = NULL;
+    return procedure;
+}
+
+/*
+ * Helper function to find the slot of a field of a record type.
+ *
+ * Returns the slot, or -1 if the type has no such field.
+ */
+int64_t fieldSlot(Value *descriptor, Value *field) {
+    for (int64_t i = 0; i < descriptor->rtd.count; i++) {
+        if (!strcmp(descriptor->rtd.fields[i]->s, field->s)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Helper function to make the record type of a define-record-type
+ * form from its field specifications.
+ */
+Value *makeDescriptor(Value *name, Value *specs) {
+    Value *descriptor = makeRecordValue(RECORD_DESCRIPTOR_TYPE);
+    int64_t count = length(specs);
+    descriptor->rtd.name = name;
+    descriptor->rtd.count = 0;
+    descriptor->rtd.fields = talloc(sizeof(Value *) * (count > 0 ? count : 1));
+    if (!descriptor->rtd.fields) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    for (Value *cur = specs; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *spec = car(cur);
+        int given = spec->type == CONS_TYPE ? length(spec) : 0;
+        if (given < 2 || given > 3 || car(spec)->type != SYMBOL_TYPE) {
+            recordSyntaxError("Fields must be (field accessor [modifier]).");
+        }
+        if (fieldSlot(descriptor, car(spec)) >= 0) {
+            recordSyntaxError("Duplicate field name.");
+        }
+        descriptor->rtd.fields[descriptor->rtd.count++] = car(spec);
+    }
+    return descriptor;
+}
+
+/*
+ * Helper function to make the constructor of a record type from its
+ * specification (name field ...).
+ */
+Value *makeConstructor(Value *spec, Value *descriptor) {
+    if (spec->type != CONS_TYPE) {
+        recordSyntaxError("The constructor must be (name field ...).");
+    }
+    Value *constructor = makeRecordProcedure(RECORD_CONSTRUCTOR, car(spec),
+                                             descriptor, 0);
+    int64_t count = length(cdr(spec));
+    int64_t *positions = talloc(sizeof(int64_t) * (count > 0 ? count : 1));
+    if (!positions) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    int64_t i = 0;
+    for (Value *cur = cdr(spec); cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *field = car(cur);
+        int64_t slot = field->type == SYMBOL_TYPE ?
+                       fieldSlot(descriptor, field) : -1;
+        if (slot < 0) {
+            recordSyntaxError("The constructor names an unknown field.");
+        }
+        for (int64_t j = 0; j < i; j++) {
+            if (positions[j] == slot) {
+                recordSyntaxError("The constructor names a field twice.");
+            }
+        }
+        positions[i++] = slot;
+    }
+    constructor->recproc->count = count;
+    constructor->recproc->positions = positions;
+    return constructor;
+}
+
+Value *makeRecordType(Value *args) {
+    if (length(args) < 3) {
+        recordSyntaxError("Expected a name, a constructor, and a predicate.");
+    }
+    if (car(args)->type != SYMBOL_TYPE) {
+        recordSyntaxError("The type name must be a symbol.");
+    }
+    return makeDescriptor(car(args), cdr(cdr(cdr(args))));
+}
+
+void bindRecordType(Value *args, Value *descriptor, Frame *frame) {
+    Value *name = car(args);
+    Value *constructorSpec = car(cdr(args));
+    Value *predicateName = car(cdr(cdr(args)));
+    Value *specs = cdr(cdr(cdr(args)));
+    Value *constructor = makeConstructor(constructorSpec, descriptor);
+    Value *predicate = makeRecordProcedure(RECORD_PREDICATE, predicateName,
+                                           descriptor, 0);
+    addBindingGlobal(name, descriptor, frame);
+    addBindingGlobal(constructor->recproc->name, constructor, frame);
+    addBindingGlobal(predicateName, predicate, frame);
+    int64_t slot = 0;
+    for (Value *cur = specs; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *spec = cdr(car(cur));
+        Value *accessor = makeRecordProcedure(RECORD_ACCESSOR, car(spec),
+                                              descriptor, slot);
+        addBindingGlobal(car(spec), accessor, frame);
+        if (cdr(spec)->type == CONS_TYPE) {
+            Value *modifier = makeRecordProcedure(RECORD_MODIFIER,
+                                                  car(cdr(spec)),
+                                                  descriptor, slot);
+            addBindingGlobal(car(cdr(spec)), modifier, frame);
+        }
+        slot++;
+    }
+}
+
+Value *evalDefineRecordType(Value *args, Frame *frame) {
+    if (frame->parent != NULL) {
+        printf("'define-record-type' expressions only allowed"
+               " in the global environment. ");
+        evaluationError();
+    }
+    bindRecordType(args, makeRecordType(args), frame);
+    return makeVoid();
+}
+
+void recordTypeError(char *name) {
+    printf("%s expects a record of its type as input\n", name);
+    evaluationError();
+}
+
+/*
+ * Helper function to check that the argument of an accessor or
+ * modifier is a record of its type.
+ */
+Value *recordArgument(Value *procedure, Value *value) {
+    if (value->type != RECORD_TYPE ||
+        value->record.descriptor != procedure->recproc->descriptor) {
+        recordTypeError(procedure->recproc->name->s);
+    }
+    return value;
+}
+
+Value *makeRecord(Value *descriptor, int64_t given) {
+    int64_t count = descriptor->rtd.count;
+    Value *record = makeRecordValue(RECORD_TYPE);
+    record->record.descriptor = descriptor;
+    record->record.slots = talloc(sizeof(Value *) * (count > 0 ? count : 1));
+    if (!record->record.slots) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    if (given < count) {
+        Value *unspecified = makeVoid();
+        for (int64_t i = 0; i < count; i++) {
+            record->record.slots[i] = unspecified;
+        }
+    }
+    return record;
+}
+
+/*
+ * Helper function to make a record of the type of a constructor out of
+ * its arguments.
+ */
+Value *constructRecord(Value *constructor, Value **argv) {
+    Value *record = makeRecord(constructor->recproc->descriptor,
+                               constructor->recproc->count);
+    for (int64_t i = 0; i < constructor->recproc->count; i++) {
+        record->record.slots[constructor->recproc->positions[i]] = argv[i];
+    }
+    return record;
+}
+
+Value *callRecordProcedure(Value *procedure, int argc, Value **argv) {
+    switch (procedure->recproc->kind) {
+        case RECORD_CONSTRUCTOR:
+            checkArgumentCount(argc, procedure->recproc->count,
+                               procedure->recproc->count);
+            return constructRecord(procedure, argv);
+        case RECORD_PREDICATE:
+            checkArgumentCount(argc, 1, 1);
+            return makeBoolean(argv[0]->type == RECORD_TYPE &&
+                               argv[0]->record.descriptor ==
+                               procedure->recproc->descriptor);
+        case RECORD_ACCESSOR:
+            checkArgumentCount(argc, 1, 1);
+            recordArgument(procedure, argv[0]);
+            return argv[0]->record.slots[procedure->recproc->index];
+        case RECORD_MODIFIER:
+            checkArgumentCount(argc, 2, 2);
+            recordArgument(procedure, argv[0]);
+            argv[0]->record.slots[procedure->recproc->index] = argv[1];
+            return makeVoid();
+    }
+    return makeVoid();
+}
+
+Value *evalRecordCall(Value *procedure, Value *args, Frame *frame) {
+    int count = length(args);
+    Value *argv[count > 0 ? count : 1];
+    for (int i = 0; i < count; i++) {
+        argv[i] = eval(car(args), frame);
+        args = cdr(args);
+    }
+    return callRecordProcedure(procedure, count, argv);
+}
+
+void displayRecord(Value *value) {
+    if (value->type == RECORD_DESCRIPTOR_TYPE) {
+        printf("#record-type");
+    } else {
+        printf("#%s", value->record.descriptor->rtd.name->s);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * This program implements the record types of R7RS. A record keeps its
+ * fields in an array of slots, so the procedures define-record-type
+ * makes check the type of a record and then read or write one slot.
+ */
+#include "value.h"
+
+#ifndef RECORD_H
+#define RECORD_H
+
+/*
+ * Evaluate the DEFINE-RECORD-TYPE special form:
+ *
+ *   (define-record-type <point> (make-point x y) point?
+ *     (x point-x set-point-x!)
+ *     (y point-y))
+ *
+ * binds <point> to the record type, and the constructor, predicate,
+ * accessors, and modifiers to procedures in the global environment.
+ * Fields the constructor does not name start out unspecified.
+ */
+Value *evalDefineRecordType(Value *args, Frame *frame);
+
+/*
+ * Make the record type of a define-record-type form from the rest of
+ * the form, and bind it and its procedures in the given frame. The
+ * compiler makes the type when a program starts, so that calls it
+ * translates can compare records against it.
+ */
+Value *makeRecordType(Value *args);
+void bindRecordType(Value *args, Value *descriptor, Frame *frame);
+
+/*
+ * Make a record of the given type. Its slots start out unspecified
+ * unless the caller is about to fill all `given' of them.
+ */
+Value *makeRecord(Value *descriptor, int64_t given);
+
+/*
+ * Report a value passed to the accessor or modifier `name' that is not
+ * a record of its type.
+ */
+void recordTypeError(char *name);
+
+/*
+ * Call a procedure made by define-record-type with an array of
+ * arguments, for the interpreter and for compiled programs.
+ */
+Value *callRecordProcedure(Value *procedure, int argc, Value **argv);
+
+/*
+ * Evaluate the arguments of a call to a procedure made by
+ * define-record-type and call it, without building an argument list.
+ */
+Value *evalRecordCall(Value *procedure, Value *args, Frame *frame);
+
+/*
+ * Print a record or a record type.
+ */
+void displayRecord(Value *value);
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * This program implements the support routines that programs
+ * translated to C by the compiler call into.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "runtime.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "record.h"
+
+Frame *runtimeFrame;
+
+/*
+ * Create the top-level frame and bind the primitive functions.
+ */
+void startRuntime() {
+    runtimeFrame = talloc(sizeof(Frame));
+    if (!runtimeFrame) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    runtimeFrame->bindings = makeNull();
+    runtimeFrame->parent = NULL;
+    runtimeFrame->captured = true;
+    bindPrimitives(runtimeFrame);
+}
+
+/*
+ * Helper function to allocate a value of the given type.
+ */
+Value *makeValue(valueType type) {
+    Value *value = talloc(sizeof(Value));
+    if (!value) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    value->type = type;
+    return value;
+}
+
+Value *makeInteger(int64_t i) {
+    Value *value = makeValue(INT_TYPE);
+    value->i = i;
+    return value;
+}
+
+Value *makeDouble(double d) {
+    Value *value = makeValue(DOUBLE_TYPE);
+    value->d = d;
+    return value;
+}
+
+Value *makeString(char *s) {
+    Value *value = makeValue(STR_TYPE);
+    value->str.chars = s;
+    value->str.length = strlen(s);
+    value->str.shared = true;
+    value->str.literal = true;
+    return value;
+}
+
+Value *makeSymbol(char *s) {
+    Value *value = makeValue(SYMBOL_TYPE);
+    value->s = s;
+    return value;
+}
+
+/* Booleans are never modified, so every #t and #f can be shared. */
+static Value trueValue = { .type = BOOL_TYPE, .s = "#t" };
+static Value falseValue = { .type = BOOL_TYPE, .s = "#f" };
+
+Value *makeBoolean(bool b) {
+    return b ? &trueValue : &falseValue;
+}
+
+Value *makeCharacter(int c) {
+    Value *value = makeValue(CHAR_TYPE);
+    value->i = (unsigned char) c;
+    return value;
+}
+
+Value *makeVoid() {
+    return makeValue(VOID_TYPE);
+}
+
+/*
+ * Test whether a value counts as true (anything but #f).
+ */
+bool isTrue(Value *value) {
+    return !(value->type == BOOL_TYPE && !strcmp(value->s, "#f"));
+}
+
+/*
+ * Allocate an environment with the given number of slots. Slot 0
+ * holds the parent environment; the variables start at slot 1.
+ */
+Value **makeEnv(Value **parent, int count) {
+    Value **env = talloc(sizeof(Value *) * (count + 1));
+    if (!env) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    env[0] = (Value *) parent;
+    for (int i = 1; i <= count; i++) {
+        env[i] = NULL;
+    }
+    return env;
+}
+
+/*
+ * Copy the slots of an environment into a fresh one, for loops whose
+ * environment may have been captured by a closure.
+ */
+Value **copyEnv(Value **env, int count) {
+    Value **copy = makeEnv((Value **) env[0], count);
+    for (int i = 1; i <= count; i++) {
+        copy[i] = env[i];
+    }
+    return copy;
+}
+
+/*
+ * Read a letrec variable, raising an error if it is not yet bound.
+ */
+Value *boundValue(Value *value, char *name) {
+    if (value == NULL) {
+        printf("The symbol %s is unbounded! ", name);
+        evaluationError();
+    }
+    return value;
+}
+
+/*
+ * Helper function to find the binding of a global variable.
+ */
+Value *findGlobal(Value **cell, char *name) {
+    if (*cell == NULL) {
+        Value symbol;
+        symbol.type = SYMBOL_TYPE;
+        symbol.s = name;
+        *cell = isBounded(&symbol, runtimeFrame);
+    }
+    return *cell;
+}
+
+/*
+ * Read a global variable through its cached binding.
+ */
+Value *globalValue(Value **cell, char *name) {
+    if (findGlobal(cell, name) == NULL) {
+        printf("The symbol %s is unbounded! ", name);
+        evaluationError();
+    }
+    return car(cdr(*cell));
+}
+
+/*
+ * Define a global variable, caching its binding.
+ */
+void defineGlobal(Value **cell, char *name, Value *value) {
+    addBindingGlobal(makeSymbol(name), value, runtimeFrame);
+    *cell = NULL;
+    findGlobal(cell, name);
+}
+
+/*
+ * Assign an existing global variable.
+ */
+void setGlobal(Value **cell, char *name, Value *value) {
+    if (findGlobal(cell, name) == NULL) {
+        printf("The symbol %s is unbounded! ", name);
+        evaluationError();
+    }
+    (*cell)->c.cdr = cons(value, makeNull());
+}
+
+/*
+ * Create a compiled procedure closing over the given environment.
+ */
+Value *makeCompiled(Value *(*code)(int, Value **, Value **), Value **env) {
+    Value *value = makeValue(COMPILED_TYPE);
+    value->compiled.code = code;
+    value->compiled.env = env;
+    return value;
+}
+
+/*
+ * Check the number of arguments passed to a compiled procedure.
+ */
+void checkClosureArity(int expected, int given) {
+    if (expected != given) {
+        printf("Expected %i arguments, supplied %i. ", expected, given);
+        evaluationError();
+    }
+}
+
+/*
+ * Build a list out of an array of values.
+ */
+Value *listOfValues(int count, Value **values) {
+    Value *list = makeNull();
+    for (int i = count - 1; i >= 0; i--) {
+        list = cons(values[i], list);
+    }
+    return list;
+}
+
+/*
+ * Call any procedure with an array of arguments. Compiled procedures
+ * take the array directly; everything else goes through apply.
+ */
+Value *callProcedure(Value *function, int argc, Value **argv) {
+    if (function->type == COMPILED_TYPE) {
+        return (function->compiled.code)(argc, argv, function->compiled.env);
+    }
+    if (function->type == RECORD_PROCEDURE_TYPE) {
+        return callRecordProcedure(function, argc, argv);
+    }
+    return apply(function, listOfValues(argc, argv));
+}
+
+/*
+ * Helper function to call a primitive on two arguments.
+ */
+Value *callBinary(Value *(*primitive)(Value *), Value *first, Value *second) {
+    return primitive(cons(first, cons(second, makeNull())));
+}
+
+Value *addValues(Value *first, Value *second) {
+    int64_t result;
+    if (first->type == INT_TYPE && second->type == INT_TYPE &&
+        !__builtin_add_overflow(first->i, second->i, &result)) {
+        return makeInteger(result);
+    }
+    return callBinary(primitiveAdd, first, second);
+}
+
+Value *subtractValues(Value *first, Value *second) {
+    int64_t result;
+    if (first->type == INT_TYPE && second->type == INT_TYPE &&
+        !__builtin_sub_overflow(first->i, second->i, &result)) {
+        return makeInteger(result);
+    }
+    return callBinary(primitiveSub, first, second);
+}
+
+Value *multiplyValues(Value *first, Value *second) {
+    int64_t result;
+    if (first->type == INT_TYPE && second->type == INT_TYPE &&
+        !__builtin_mul_overflow(first->i, second->i, &result)) {
+        return makeInteger(result);
+    }
+    return callBinary(primitiveMult, first, second);
+}
+
+Value *lessOrEqual(Value *first, Value *second) {
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        return makeBoolean(first->i <= second->i);
+    }
+    return callBinary(primitiveLeq, first, second);
+}
+
+Value *numbersEqual(Value *first, Value *second) {
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        return makeBoolean(first->i == second->i);
+    }
+    return callBinary(primitiveNumEqual, first, second);
+}
+
+Value *lessThan(Value *first, Value *second) {
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        return makeBoolean(first->i < second->i);
+    }
+    return callBinary(primitiveLess, first, second);
+}
+
+Value *greaterThan(Value *first, Value *second) {
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        return makeBoolean(first->i > second->i);
+    }
+    return callBinary(primitiveGreater, first, second);
+}
+
+Value *greaterOrEqual(Value *first, Value *second) {
+    if (first->type == INT_TYPE && second->type == INT_TYPE) {
+        return makeBoolean(first->i >= second->i);
+    }
+    return callBinary(primitiveGeq, first, second);
+}
+
+Value *carValue(Value *pair) {
+    if (pair->type != CONS_TYPE) {
+        printf("Contract violation. Expected: non-empty list. ");
+        evaluationError();
+    }
+    return pair->c.car;
+}
+
+Value *cdrValue(Value *pair) {
+    if (pair->type != CONS_TYPE) {
+        printf("Contract violation. Expected: non-empty list. ");
+        evaluationError();
+    }
+    return pair->c.cdr;
+}
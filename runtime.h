@@ -0,0 +1,101 @@
+/*
+ * This program implements the support routines that programs
+ * translated to C by the compiler call into.
+ */
+#include <stdbool.h>
+#include "value.h"
+
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+/* The top-level frame that compiled programs define globals in. */
+extern Frame *runtimeFrame;
+
+/*
+ * Create the top-level frame and bind the primitive functions.
+ */
+void startRuntime();
+
+/*
+ * Constructors for the constants of a compiled program. makeString
+ * does not copy the NUL-terminated characters it is given, and makes a
+ * literal string, which cannot be changed.
+ */
+Value *makeInteger(int64_t i);
+Value *makeDouble(double d);
+Value *makeString(char *s);
+Value *makeSymbol(char *s);
+Value *makeBoolean(bool b);
+Value *makeCharacter(int c);
+Value *makeVoid();
+
+/*
+ * Test whether a value counts as true (anything but #f).
+ */
+bool isTrue(Value *value);
+
+/*
+ * Allocate an environment with the given number of slots. Slot 0
+ * holds the parent environment; the variables start at slot 1.
+ */
+Value **makeEnv(Value **parent, int count);
+
+/*
+ * Copy the slots of an environment into a fresh one, for loops whose
+ * environment may have been captured by a closure.
+ */
+Value **copyEnv(Value **env, int count);
+
+/*
+ * Read a letrec variable, raising an error if it is not yet bound.
+ */
+Value *boundValue(Value *value, char *name);
+
+/*
+ * Read, define and assign global variables. `cell' caches the binding
+ * of the variable in the top-level frame.
+ */
+Value *globalValue(Value **cell, char *name);
+void defineGlobal(Value **cell, char *name, Value *value);
+void setGlobal(Value **cell, char *name, Value *value);
+
+/*
+ * Create a compiled procedure closing over the given environment.
+ */
+Value *makeCompiled(Value *(*code)(int, Value **, Value **), Value **env);
+
+/*
+ * Check the number of arguments passed to a compiled procedure.
+ */
+void checkClosureArity(int expected, int given);
+
+/*
+ * Build a list out of an array of values.
+ */
+Value *listOfValues(int count, Value **values);
+
+/*
+ * Call any procedure with an array of arguments.
+ */
+Value *callProcedure(Value *function, int argc, Value **argv);
+
+/*
+ * Binary versions of the arithmetic and comparison primitives with a
+ * fast path for two integers; other cases are handed to the primitive.
+ */
+Value *addValues(Value *first, Value *second);
+Value *subtractValues(Value *first, Value *second);
+Value *multiplyValues(Value *first, Value *second);
+Value *lessOrEqual(Value *first, Value *second);
+Value *numbersEqual(Value *first, Value *second);
+Value *lessThan(Value *first, Value *second);
+Value *greaterThan(Value *first, Value *second);
+Value *greaterOrEqual(Value *first, Value *second);
+
+/*
+ * The car and cdr primitives without the argument list.
+ */
+Value *carValue(Value *pair);
+Value *cdrValue(Value *pair);
+
+#endif
@@ -0,0 +1,448 @@
+/*
+ * This program implements stable sorting of lists and vectors.
+ *
+ * A list is sorted by merging its pairs into lists of 1, 2, 4, ...
+ * elements, relinking the pairs instead of allocating new ones. A
+ * vector is sorted the way Timsort does it: the vector is split into
+ * runs already in order (a descending run is reversed), short runs are
+ * extended with binary insertion sort, and runs are merged from a
+ * stack whose lengths are kept growing, so that merges stay balanced.
+ * Before two runs are merged, the elements of each that are already
+ * in place are skipped with a binary search.
+ *
+ * The less-than procedure is called directly: < and > on two fixnums
+ * or two doubles are compared inline, the fixnum and flonum operators
+ * are called without an argument list, other primitives get one list
+ * reused for every call, and only closures go through apply.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sort.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "fixflo.h"
+#include "vector.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/* Runs shorter than about this are extended before being merged. */
+#define MIN_MERGE 32
+
+/* The most runs that can wait to be merged: from the bottom of the
+ * stack up, their lengths shrink at least as fast as the Fibonacci
+ * numbers do. */
+#define MAX_RUNS 90
+
+/* How a sort compares two elements. */
+typedef struct Comparator {
+    Value *procedure;
+    /* The fixnum or flonum operator behind the procedure, or NULL */
+    Value *(*binary)(Value *, Value *);
+    /* The argument list passed to a primitive, reused for each call */
+    Value *args;
+} Comparator;
+
+/* A run of a vector that is in order and waits to be merged. */
+typedef struct Run {
+    int64_t base;
+    int64_t length;
+} Run;
+
+/*
+ * Helper function to make the comparator of a sort out of its
+ * less-than procedure.
+ */
+Comparator makeComparator(char *name, Value *procedure) {
+    if (procedure->type != PRIMITIVE_TYPE &&
+        procedure->type != CLOSURE_TYPE &&
+        procedure->type != COMPILED_TYPE &&
+        procedure->type != RECORD_PROCEDURE_TYPE &&
+        procedure->type != MEMOIZED_TYPE) {
+        primitiveError(name, "expects a procedure as input");
+    }
+    Comparator less;
+    less.procedure = procedure;
+    less.binary = binaryOperatorOf(procedure);
+    less.args = cons(makeNull(), cons(makeNull(), makeNull()));
+    return less;
+}
+
+/*
+ * Helper function to test whether the first element comes before the
+ * second.
+ */
+bool isLess(Comparator *less, Value *first, Value *second) {
+    Value *procedure = less->procedure;
+    if (procedure->type == PRIMITIVE_TYPE) {
+        bool ascending = procedure->pf == primitiveLess;
+        if (first->type == second->type &&
+            (ascending || procedure->pf == primitiveGreater)) {
+            if (first->type == INT_TYPE) {
+                return ascending ? first->i < second->i : first->i > second->i;
+            } else if (first->type == DOUBLE_TYPE) {
+                return ascending ? first->d < second->d : first->d > second->d;
+            }
+        }
+        if (less->binary) {
+            return isTrue(less->binary(first, second));
+        }
+        less->args->c.car = first;
+        less->args->c.cdr->c.car = second;
+        return isTrue((procedure->pf)(less->args));
+    }
+    if (procedure->type == COMPILED_TYPE) {
+        Value *argv[2] = {first, second};
+        return isTrue((procedure->compiled.code)(2, argv,
+                                                 procedure->compiled.env));
+    }
+    return isTrue(apply(procedure, cons(first, cons(second, makeNull()))));
+}
+
+/*
+ * Helper function to merge two sorted lists by relinking their pairs.
+ * On ties, the element of the left list comes first.
+ */
+Value *mergeLists(Comparator *less, Value *left, Value *right) {
+    Value head;
+    head.type = CONS_TYPE;
+    Value *tail = &head;
+    while (left->type == CONS_TYPE && right->type == CONS_TYPE) {
+        if (isLess(less, right->c.car, left->c.car)) {
+            tail->c.cdr = right;
+            right = right->c.cdr;
+        } else {
+            tail->c.cdr = left;
+            left = left->c.cdr;
+        }
+        tail = tail->c.cdr;
+    }
+    tail->c.cdr = left->type == CONS_TYPE ? left : right;
+    return head.c.cdr;
+}
+
+/*
+ * Helper function to sort a proper list by relinking its pairs.
+ * bins[i] holds a sorted list of 2^i elements, or NULL; each pair in
+ * turn is merged with the full bins below the first empty one, which
+ * holds the result. The bins higher up hold earlier elements.
+ */
+Value *sortPairs(Comparator *less, Value *list) {
+    Value *bins[64];
+    int used = 0;
+    Value *empty = makeNull();
+    while (list->type == CONS_TYPE) {
+        Value *carry = list;
+        list = list->c.cdr;
+        carry->c.cdr = empty;
+        int i = 0;
+        while (i < used && bins[i] != NULL) {
+            carry = mergeLists(less, bins[i], carry);
+            bins[i] = NULL;
+            i++;
+        }
+        if (i == used) {
+            used++;
+        }
+        bins[i] = carry;
+    }
+    Value *result = empty;
+    for (int i = 0; i < used; i++) {
+        if (bins[i] != NULL) {
+            result = mergeLists(less, bins[i], result);
+        }
+    }
+    return result;
+}
+
+/*
+ * Helper function to find the length below which runs of a vector of
+ * the given length are extended, so that the number of runs is a
+ * power of two or just below one.
+ */
+int64_t minimumRun(int64_t count) {
+    int64_t extra = 0;
+    while (count >= MIN_MERGE) {
+        extra |= count & 1;
+        count >>= 1;
+    }
+    return count + extra;
+}
+
+/*
+ * Helper function to find the length of the run starting at `low',
+ * reversing it if it descends strictly.
+ */
+int64_t countRun(Comparator *less, Value **items, int64_t low,
+                 int64_t high) {
+    int64_t end = low + 1;
+    if (end == high) {
+        return 1;
+    }
+    if (isLess(less, items[end], items[low])) {
+        end++;
+        while (end < high && isLess(less, items[end], items[end - 1])) {
+            end++;
+        }
+        for (int64_t i = low, j = end - 1; i < j; i++, j--) {
+            Value *item = items[i];
+            items[i] = items[j];
+            items[j] = item;
+        }
+    } else {
+        end++;
+        while (end < high && !isLess(less, items[end], items[end - 1])) {
+            end++;
+        }
+    }
+    return end - low;
+}
+
+/*
+ * Helper function to sort items[low..high) with binary insertion sort,
+ * given that items[low..start) is already sorted.
+ */
+void insertionSort(Comparator *less, Value **items, int64_t low,
+                   int64_t high, int64_t start) {
+    for (; start < high; start++) {
+        Value *pivot = items[start];
+        int64_t left = low;
+        int64_t right = start;
+        while (left < right) {
+            int64_t middle = left + (right - left) / 2;
+            if (isLess(less, pivot, items[middle])) {
+                right = middle;
+            } else {
+                left = middle + 1;
+            }
+        }
+        memmove(&items[left + 1], &items[left],
+                sizeof(Value *) * (start - left));
+        items[left] = pivot;
+    }
+}
+
+/*
+ * Helper function to find the first of items[low..high) that `key'
+ * comes before, or `high'.
+ */
+int64_t searchAfter(Comparator *less, Value *key, Value **items,
+                    int64_t low, int64_t high) {
+    while (low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if (isLess(less, key, items[middle])) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+/*
+ * Helper function to find the first of items[low..high) that does not
+ * come before `key', or `high'.
+ */
+int64_t searchNotBefore(Comparator *less, Value *key, Value **items,
+                        int64_t low, int64_t high) {
+    while (low < high) {
+        int64_t middle = low + (high - low) / 2;
+        if (isLess(less, items[middle], key)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*
+ * Helper function to merge two adjacent runs. Only the part of the
+ * left run that does not already come before the whole right run is
+ * copied out to `buffer', and the merge stops once the part of the
+ * right run that comes after the whole left run is reached.
+ */
+void mergeRuns(Comparator *less, Value **items, Value **buffer, Run left,
+               Run right) {
+    int64_t start = searchAfter(less, items[right.base], items, left.base,
+                                right.base);
+    int64_t end = searchNotBefore(less, items[right.base - 1], items,
+                                  right.base, right.base + right.length);
+    int64_t count = right.base - start;
+    memcpy(buffer, &items[start], sizeof(Value *) * count);
+    int64_t i = 0;
+    int64_t j = right.base;
+    int64_t next = start;
+    while (i < count && j < end) {
+        if (isLess(less, items[j], buffer[i])) {
+            items[next++] = items[j++];
+        } else {
+            items[next++] = buffer[i++];
+        }
+    }
+    memcpy(&items[next], &buffer[i], sizeof(Value *) * (count - i));
+}
+
+/*
+ * Helper function to merge the runs at `position' and `position' + 1
+ * of the stack.
+ *
+ * Returns the new number of runs.
+ */
+int mergeAt(Comparator *less, Value **items, Value **buffer, Run *runs,
+            int count, int position) {
+    mergeRuns(less, items, buffer, runs[position], runs[position + 1]);
+    runs[position].length += runs[position + 1].length;
+    if (position + 2 < count) {
+        runs[position + 1] = runs[position + 2];
+    }
+    return count - 1;
+}
+
+/*
+ * Helper function to merge runs at the top of the stack until each
+ * run is longer than the one above it and than the two above it
+ * together, or, if `all' is set, until only one run is left.
+ *
+ * Returns the new number of runs.
+ */
+int collapseRuns(Comparator *less, Value **items, Value **buffer,
+                 Run *runs, int count, bool all) {
+    while (count > 1) {
+        int n = count - 2;
+        if (all) {
+            if (n > 0 && runs[n - 1].length < runs[n + 1].length) {
+                n--;
+            }
+        } else if ((n > 0 && runs[n - 1].length <=
+                             runs[n].length + runs[n + 1].length) ||
+                   (n > 1 && runs[n - 2].length <=
+                             runs[n - 1].length + runs[n].length)) {
+            if (runs[n - 1].length < runs[n + 1].length) {
+                n--;
+            }
+        } else if (runs[n].length > runs[n + 1].length) {
+            break;
+        }
+        count = mergeAt(less, items, buffer, runs, count, n);
+    }
+    return count;
+}
+
+/*
+ * Helper function to sort an array of values in place.
+ */
+void sortItems(Comparator *less, Value **items, int64_t count) {
+    if (count < 2) {
+        return;
+    }
+    Value **buffer = talloc(sizeof(Value *) * count);
+    if (!buffer) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    Run runs[MAX_RUNS];
+    int used = 0;
+    int64_t minimum = minimumRun(count);
+    int64_t low = 0;
+    while (low < count) {
+        int64_t length = countRun(less, items, low, count);
+        if (length < minimum) {
+            int64_t forced = count - low < minimum ? count - low : minimum;
+            insertionSort(less, items, low, low + forced, low + length);
+            length = forced;
+        }
+        runs[used].base = low;
+        runs[used].length = length;
+        used = collapseRuns(less, items, buffer, runs, used + 1, false);
+        low += length;
+    }
+    collapseRuns(less, items, buffer, runs, used, true);
+}
+
+/*
+ * Helper function to sort a list or vector, a copy of it if `copy' is
+ * set.
+ */
+Value *sortSequence(char *name, Value *sequence, Value *procedure,
+                    bool copy) {
+    Comparator less = makeComparator(name, procedure);
+    if (sequence->type == VECTOR_TYPE) {
+        Value *vector = sequence;
+        if (copy) {
+            vector = makeVector(sequence->vec.length, makeNull());
+            memcpy(vector->vec.items, sequence->vec.items,
+                   sizeof(Value *) * sequence->vec.length);
+        }
+        sortItems(&less, vector->vec.items, vector->vec.length);
+        return vector;
+    }
+    Value *cur = sequence;
+    while (cur->type == CONS_TYPE) {
+        cur = cdr(cur);
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError(name, "expects a list or vector as input");
+    }
+    Value *list = sequence;
+    if (copy) {
+        Value head;
+        head.type = CONS_TYPE;
+        Value *tail = &head;
+        for (cur = sequence; cur->type == CONS_TYPE; cur = cdr(cur)) {
+            tail->c.cdr = cons(car(cur), makeNull());
+            tail = tail->c.cdr;
+        }
+        tail->c.cdr = makeNull();
+        list = head.c.cdr;
+    }
+    return sortPairs(&less, list);
+}
+
+/*
+ * Implementing the Scheme primitive sort: (sort sequence less?).
+ */
+Value *primitiveSort(Value *args) {
+    checkArity(args, 2, 2);
+    return sortSequence("sort", car(args), car(cdr(args)), true);
+}
+
+/*
+ * Implementing the Scheme primitive sort!: (sort! sequence less?).
+ */
+Value *primitiveSortInPlace(Value *args) {
+    checkArity(args, 2, 2);
+    return sortSequence("sort!", car(args), car(cdr(args)), false);
+}
+
+/*
+ * Implementing the Scheme primitive list-sort: (list-sort less? list).
+ */
+Value *primitiveListSort(Value *args) {
+    checkArity(args, 2, 2);
+    if (car(cdr(args))->type == VECTOR_TYPE) {
+        primitiveError("list-sort", "expects a list as input");
+    }
+    return sortSequence("list-sort", car(cdr(args)), car(args), true);
+}
+
+/*
+ * Implementing the Scheme primitive vector-sort:
+ * (vector-sort less? vector).
+ */
+Value *primitiveVectorSort(Value *args) {
+    checkArity(args, 2, 2);
+    if (car(cdr(args))->type != VECTOR_TYPE) {
+        primitiveError("vector-sort", "expects a vector as input");
+    }
+    return sortSequence("vector-sort", car(cdr(args)), car(args), true);
+}
+
+/*
+ * Bind the sorting primitives in the given top-level frame.
+ */
+void bindSortPrimitives(Frame *topFrame) {
+    bind("sort", primitiveSort, topFrame);
+    bind("sort!", primitiveSortInPlace, topFrame);
+    bind("list-sort", primitiveListSort, topFrame);
+    bind("vector-sort", primitiveVectorSort, topFrame);
+}
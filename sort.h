@@ -0,0 +1,33 @@
+/*
+ * This program implements stable sorting of lists and vectors with a
+ * procedure that tells whether one element comes before another.
+ * Lists are merge sorted by relinking their pairs, and vectors are
+ * sorted in the manner of Timsort, which merges the runs already in
+ * order, so sorted or nearly sorted input takes close to linear time.
+ */
+#include "value.h"
+
+#ifndef SORT_H
+#define SORT_H
+
+/*
+ * The primitives below, for compiled programs.
+ */
+Value *primitiveSort(Value *args);
+Value *primitiveSortInPlace(Value *args);
+Value *primitiveListSort(Value *args);
+Value *primitiveVectorSort(Value *args);
+
+/*
+ * Bind the sorting primitives in the given top-level frame. Each sort
+ * is stable: elements neither of which comes before the other keep
+ * their order.
+ *
+ *   sort sequence less?      a sorted copy of a list or vector
+ *   sort! sequence less?     sorts in place; use the result for a list
+ *   list-sort less? list
+ *   vector-sort less? vector
+ */
+void bindSortPrimitives(Frame *topFrame);
+
+#endif
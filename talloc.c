@@ -1,54 +1,119 @@
 /* This code implements a garbage collector to manage memory
- * usage throughout the interpreter project. 
- * 
+ * usage throughout the interpreter project.
+ *
+ * Every block talloc hands out follows a header linking it into the
+ * list of blocks. tfree frees them all at once, and tcollect frees the
+ * ones the program can no longer reach: it marks every block that a
+ * word of the static data, the stack, the registers, or a marked block
+ * points into, treating any such word as a pointer, and frees the rest.
+ * Finding the static data and the stack depends on the platform; where
+ * it is not known how, tcollect frees nothing.
+ *
  * Authors: Yitong Chen, Yingying Wang, Megan Zhao
  */
 
-#include <assert.h>
 #include <stdio.h>
-#include "talloc.h"
+#include <stdint.h>
 #include <string.h>
-#include "linkedlist.h"
+#include <setjmp.h>
+#include "talloc.h"
+
+#if defined(__APPLE__)
+#include <pthread.h>
+#include <mach-o/getsect.h>
+#include <mach-o/ldsyms.h>
+#define SCANS_ROOTS 1
+#elif defined(__GLIBC__)
+/* The bounds of the static data and of the stack, set up by the C
+ * library and the linker */
+extern char __data_start[];
+extern char _end[];
+extern void *__libc_stack_end;
+#define SCANS_ROOTS 1
+#else
+#define SCANS_ROOTS 0
+#endif
+
+/* The header in front of every block */
+typedef struct Block {
+    struct Block *next;
+    size_t size;
+    bool marked;
+    bool traced;    /* Whether a collection scans the block for pointers */
+    bool external;  /* Whether the block stands for memory from tadopt */
+} Block;
 
-// The global static variable
-static Value *head;
-static Value *usefulListHead;
+/* The memory an external block stands for, held in the block */
+typedef struct External {
+    char *memory;
+    size_t size;
+    void (*release)(void *, size_t);
+} External;
+
+/* The size of a header, keeping blocks aligned for any type */
+#define HEADER_SIZE ((sizeof(Block) + 15) & ~(size_t) 15)
+
+/* The blocks handed out, newest first, and how many there are */
+static Block *blocks = NULL;
+static size_t blockCount = 0;
+
+/* Whether a collection has run, after which malloc may hand out memory
+ * still holding pointers a later collection would follow */
+static bool reusing = false;
+
+/* During a collection: the blocks in address order, and the marked
+ * blocks still to scan. Only pointers to memory from malloc are kept
+ * here, since the collector scans the static data. */
+static bool collecting = false;
+static Block **ordered = NULL;
+static size_t orderedCount;
+static Block **pending = NULL;
+static size_t pendingSize;
+static size_t pendingCapacity;
 
 /*
- * Create an empty list (a new Value object of type NULL_TYPE).
- *
- * Returns a pointer to an empty list.
- * If memory allocation fails, returns a null pointer.
+ * Helper function to find the start of the memory of a block.
  */
-Value *talloc_makeNull() {
-    Value *nullList = malloc(sizeof(Value));
-    if (!nullList) {
-        printf("Out of memory!\n");
-        return nullList;
+char *blockData(Block *block) {
+    return (char *) block + HEADER_SIZE;
+}
+
+/*
+ * Helper functions to find the memory a block covers, which for an
+ * external block is the memory given to tadopt.
+ */
+char *blockStart(Block *block) {
+    if (block->external) {
+        return ((External *) blockData(block))->memory;
+    }
+    return blockData(block);
+}
+
+size_t blockSize(Block *block) {
+    if (block->external) {
+        return ((External *) blockData(block))->size;
     }
-    nullList->type = NULL_TYPE;
-    return nullList;
+    return block->size;
 }
 
 /*
- * Create a nonempty list (a new Value object of type CONS_TYPE).
- *
- * Returns a pointer to a non-empty list.
- * If memory allocation fails, returns a null pointer.
- * Asserts that car is not a list (so no nested list)
- */
-Value *talloc_cons(Value *car, Value *cdr) {
-    struct ConsCell cell;
-    cell.car = car;
-    cell.cdr = cdr;
-    Value *newValue = malloc(sizeof(Value));
-    if (!newValue) {
-        printf("Out of memory!\n");
-        return newValue;
+ * Helper function to free a block, releasing the memory it stands for
+ * if it is external.
+ */
+void freeBlock(Block *block) {
+    if (block->external) {
+        External *external = (External *) blockData(block);
+        external->release(external->memory, external->size);
     }
-    newValue->type = CONS_TYPE;
-    newValue->c = cell;
-    return newValue;
+    free(block);
+}
+
+/*
+ * Helper function to find the header of the block holding the memory
+ * talloc returned.
+ */
+Block *blockOf(void *pointer) {
+    return (Block *) ((char *) pointer - HEADER_SIZE);
 }
 
 /*
@@ -60,28 +125,23 @@ Value *talloc_cons(Value *car, Value *cdr) {
  * modify the linked list to use talloc instead of malloc.)
  */
 void *talloc(size_t size){
-	if (head == NULL){
-		head = talloc_makeNull();
-		if (!head){
-			printf("Out of memory!\n");
-			return head;
-		}
-	}
-	Value *newHead = malloc(sizeof(Value));
-	if (!newHead){
-		printf("Out of memory!\n");
-		return newHead;
-	}
-	newHead->type = PTR_TYPE;
-//    newHead->useful = false;
-	newHead->p = malloc(size);
-//    newHead->useful = false;
-	if (!newHead->p){
-		printf("Out of memory!\n");
-        return newHead->p;
-	}
-	head = talloc_cons(newHead, head);
-	return newHead->p;
+    Block *block = malloc(HEADER_SIZE + size);
+    if (!block){
+        printf("Out of memory!\n");
+        return NULL;
+    }
+    if (reusing) {
+        memset(blockData(block), 0, size);
+    }
+    block->size = size;
+    // Blocks made while a collection runs survive it
+    block->marked = collecting;
+    block->traced = true;
+    block->external = false;
+    block->next = blocks;
+    blocks = block;
+    blockCount++;
+    return blockData(block);
 }
 
 /*
@@ -89,17 +149,14 @@ void *talloc(size_t size){
  * malloc'ed to create/update the active list.
  */
 void tfree(){
-	Value *cur = head;
-	Value *next;
-	while (cur->type != NULL_TYPE){
-		next = cur->c.cdr;
-		free(cur->c.car->p);
-		free(cur->c.car);
-		free(cur);
-		cur = next;
-	} 
-	free(next);
-	head = NULL;
+    Block *cur = blocks;
+    while (cur != NULL){
+        Block *next = cur->next;
+        freeBlock(cur);
+        cur = next;
+    }
+    blocks = NULL;
+    blockCount = 0;
 }
 
 /*
@@ -109,7 +166,232 @@ void tfree(){
  * cleaned up when exiting.)
  */
 void texit(int status){
-	tfree();
-	exit(status);
+    tfree();
+    exit(status);
+}
+
+void tuntrace(void *pointer) {
+    blockOf(pointer)->traced = false;
+}
+
+void tadopt(void *memory, size_t size, void (*release)(void *, size_t)) {
+    External *external = talloc(sizeof(External));
+    if (!external) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    external->memory = memory;
+    external->size = size;
+    external->release = release;
+    Block *block = blockOf(external);
+    block->external = true;
+    block->traced = false;
+}
+
+/*
+ * Helper function to order blocks by the address of their memory.
+ */
+int compareBlocks(const void *first, const void *second) {
+    uintptr_t x = (uintptr_t) blockStart(*(Block * const *) first);
+    uintptr_t y = (uintptr_t) blockStart(*(Block * const *) second);
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Helper function to find the block whose memory a word points into.
+ *
+ * Returns the block, or NULL if the word points into none.
+ */
+Block *findBlock(uintptr_t word) {
+    if (ordered == NULL || word < (uintptr_t) blockStart(ordered[0])) {
+        return NULL;
+    }
+    size_t low = 0;
+    size_t high = orderedCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        Block *block = ordered[middle];
+        uintptr_t start = (uintptr_t) blockStart(block);
+        if (word < start) {
+            high = middle;
+        } else if (word >= start + blockSize(block)) {
+            low = middle + 1;
+        } else {
+            return block;
+        }
+    }
+    return NULL;
 }
 
+/*
+ * Helper function to mark a block, leaving it to be scanned if it is
+ * traced.
+ */
+void markBlock(Block *block) {
+    block->marked = true;
+    if (!block->traced) {
+        return;
+    }
+    if (pendingSize == pendingCapacity) {
+        size_t capacity = pendingCapacity > 0 ? pendingCapacity * 2 : 1024;
+        Block **grown = realloc(pending, sizeof(Block *) * capacity);
+        if (!grown) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        pending = grown;
+        pendingCapacity = capacity;
+    }
+    pending[pendingSize++] = block;
+}
+
+/*
+ * Helper function to mark the blocks the aligned words of a range of
+ * memory point into.
+ */
+void scanRange(char *start, char *end) {
+    uintptr_t cur = ((uintptr_t) start + sizeof(void *) - 1) &
+                    ~(uintptr_t) (sizeof(void *) - 1);
+    for (; cur + sizeof(void *) <= (uintptr_t) end; cur += sizeof(void *)) {
+        uintptr_t word;
+        memcpy(&word, (void *) cur, sizeof(word));
+        Block *block = findBlock(word);
+        if (block != NULL && !block->marked) {
+            markBlock(block);
+        }
+    }
+}
+
+/*
+ * Helper function to scan the marked blocks not yet scanned, and
+ * everything they lead to.
+ */
+void drainPending() {
+    while (pendingSize > 0) {
+        Block *block = pending[--pendingSize];
+        scanRange(blockData(block), blockData(block) + block->size);
+    }
+}
+
+#if SCANS_ROOTS
+/*
+ * Helper function to scan the static data of the program.
+ */
+void scanStaticData() {
+#if defined(__APPLE__)
+    static const char *segments[] = {"__DATA", "__DATA_DIRTY"};
+    for (int i = 0; i < 2; i++) {
+        unsigned long size = 0;
+        char *start = (char *) getsegmentdata(&_mh_execute_header,
+                                              segments[i], &size);
+        if (start != NULL) {
+            scanRange(start, start + size);
+        }
+    }
+#else
+    scanRange(__data_start, _end);
+#endif
+}
+
+/*
+ * Helper function to find the end of the stack the program started
+ * on, which grows down from there.
+ */
+char *stackBase() {
+#if defined(__APPLE__)
+    return pthread_get_stackaddr_np(pthread_self());
+#else
+    return __libc_stack_end;
+#endif
+}
+
+/*
+ * Helper function to scan the stack from the frame of this function
+ * up. It is not inlined, so that the registers its caller saved are
+ * in the range it scans.
+ */
+__attribute__((noinline)) void scanStack() {
+    volatile char here = 0;
+    scanRange((char *) &here, stackBase());
+}
+
+/*
+ * Helper function to mark what the static data, the registers, and
+ * the stack point to.
+ */
+__attribute__((noinline)) void markRoots() {
+    // Spill the registers onto the stack, where scanStack finds them
+    jmp_buf registers;
+    setjmp(registers);
+    scanStaticData();
+    scanStack();
+    drainPending();
+}
+#endif
+
+bool tmark(void *pointer) {
+    Block *block = findBlock((uintptr_t) pointer);
+    if (block == NULL || block->marked) {
+        return false;
+    }
+    markBlock(block);
+    drainPending();
+    return true;
+}
+
+bool tmarked(void *pointer) {
+    Block *block = findBlock((uintptr_t) pointer);
+    return block == NULL || block->marked;
+}
+
+/*
+ * Helper function to free the blocks left unmarked and clear the marks
+ * of the others.
+ */
+void freeUnmarked() {
+    Block **link = &blocks;
+    while (*link != NULL) {
+        Block *block = *link;
+        if (block->marked) {
+            block->marked = false;
+            link = &block->next;
+        } else {
+            *link = block->next;
+            freeBlock(block);
+            blockCount--;
+        }
+    }
+}
+
+void tcollect(bool (*propagate)(void), void (*sweep)(void)) {
+    if (!SCANS_ROOTS || collecting || blockCount == 0) {
+        return;
+    }
+    ordered = malloc(sizeof(Block *) * blockCount);
+    if (!ordered) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    size_t i = 0;
+    for (Block *cur = blocks; cur != NULL; cur = cur->next) {
+        ordered[i++] = cur;
+    }
+    orderedCount = blockCount;
+    qsort(ordered, orderedCount, sizeof(Block *), compareBlocks);
+    collecting = true;
+    reusing = true;
+    pendingSize = 0;
+#if SCANS_ROOTS
+    markRoots();
+#endif
+    while (propagate != NULL && propagate()) {
+    }
+    if (sweep != NULL) {
+        sweep();
+    }
+    // Blocks made by sweep are not in the ordered list, and are marked
+    collecting = false;
+    free(ordered);
+    ordered = NULL;
+    freeUnmarked();
+}
@@ -28,4 +28,49 @@ void tfree();
  */
 void texit(int status);
 
+/*
+ * Collect garbage: mark every block from talloc that the static data,
+ * the registers, or the stack point into, and every block a marked
+ * block points into, then free the blocks left unmarked. Any word that
+ * points into a block counts as a pointer to it.
+ *
+ * Blocks passed to tuntrace are marked but not scanned, which is how
+ * weak references leave what they refer to unmarked. After marking,
+ * `propagate' is called until it returns false; it marks with tmark
+ * what weak structures keep alive, and reports whether it marked
+ * anything. Then `sweep' is called, and may ask tmarked which blocks
+ * survive, before the others are freed. Either may be NULL.
+ *
+ * On platforms where the static data and the stack cannot be found,
+ * tcollect does nothing.
+ */
+void tcollect(bool (*propagate)(void), void (*sweep)(void));
+
+/*
+ * Keep collections from scanning the block of memory talloc returned.
+ */
+void tuntrace(void *pointer);
+
+/*
+ * Track memory that did not come from talloc, such as a mapped file,
+ * as a block of its own: pointers into it keep it alive, and when it
+ * is collected, or at tfree, `release' is called with it and its size.
+ */
+void tadopt(void *memory, size_t size, void (*release)(void *, size_t));
+
+/*
+ * During a collection, mark the block a pointer points into and
+ * everything it leads to.
+ *
+ * Returns true if the block was not marked before.
+ */
+bool tmark(void *pointer);
+
+/*
+ * During a collection, test whether the block a pointer points into
+ * is marked. Pointers into no block, and blocks made during the
+ * collection, count as marked.
+ */
+bool tmarked(void *pointer);
+
 #endif
@@ -0,0 +1,648 @@
+/*
+ * This program implements strings and characters. A string keeps its
+ * length next to its characters, which need not end in a NUL: a
+ * substring points into the characters of the string it is taken
+ * from, and both are marked shared so that whichever changes first
+ * copies its characters before writing.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "text.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "bignum.h"
+#include "numformat.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/* The characters written by name, and their names. */
+static struct {
+    int c;
+    char *name;
+} characterNames[] = {
+    {' ', "space"},
+    {'\n', "newline"},
+    {'\t', "tab"},
+    {'\r', "return"},
+    {0, "null"},
+    {0, "nul"},
+    {7, "alarm"},
+    {8, "backspace"},
+    {27, "escape"},
+    {127, "delete"},
+    {-1, NULL}
+};
+
+/*
+ * Helper function to allocate room for the given number of characters
+ * and a NUL.
+ */
+char *makeChars(int64_t length) {
+    char *chars = talloc(length + 1);
+    if (!chars) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    chars[length] = '\0';
+    return chars;
+}
+
+/*
+ * Create a string holding a copy of the given characters.
+ */
+Value *makeStringOf(char *chars, int64_t length) {
+    Value *string = talloc(sizeof(Value));
+    if (!string) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    string->type = STR_TYPE;
+    string->str.chars = makeChars(length);
+    memcpy(string->str.chars, chars, length);
+    string->str.length = length;
+    string->str.shared = false;
+    string->str.literal = false;
+    return string;
+}
+
+/*
+ * Copy the characters of a string into a new NUL-terminated C string.
+ */
+char *stringToC(Value *string) {
+    char *chars = makeChars(string->str.length);
+    memcpy(chars, string->str.chars, string->str.length);
+    return chars;
+}
+
+/*
+ * Write a character as it is read, e.g. #\a, #\space, or #\x7.
+ */
+void writeCharacter(int c, FILE *out) {
+    for (int i = 0; characterNames[i].name; i++) {
+        if (characterNames[i].c == c) {
+            fprintf(out, "#\\%s", characterNames[i].name);
+            return;
+        }
+    }
+    if (c > ' ' && c <= '~') {
+        fprintf(out, "#\\%c", c);
+    } else {
+        fprintf(out, "#\\x%x", c);
+    }
+}
+
+/*
+ * Find the character with the given name, e.g. space, newline, or x41.
+ *
+ * Returns -1 if there is no such character.
+ */
+int characterFromName(char *name) {
+    for (int i = 0; characterNames[i].name; i++) {
+        if (!strcmp(characterNames[i].name, name)) {
+            return characterNames[i].c;
+        }
+    }
+    if (name[0] == 'x' && name[1] != '\0') {
+        char *end;
+        long c = strtol(name + 1, &end, 16);
+        if (*end == '\0' && c >= 0 && c <= 255) {
+            return (int) c;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Helper function to check that an argument is a string.
+ */
+Value *stringArgument(char *name, Value *value) {
+    if (value->type != STR_TYPE) {
+        primitiveError(name, "expects a string as input");
+    }
+    return value;
+}
+
+/*
+ * Helper function to check that an argument is a character.
+ */
+Value *characterArgument(char *name, Value *value) {
+    if (value->type != CHAR_TYPE) {
+        primitiveError(name, "expects a character as input");
+    }
+    return value;
+}
+
+/*
+ * Helper function to read the optional index argument at the given
+ * position in the arguments, which must lie between `low' and `high'.
+ */
+int64_t stringIndexArgument(char *name, Value *args, int position,
+                            int64_t fallback, int64_t low, int64_t high) {
+    for (int i = 0; i < position && args->type == CONS_TYPE; i++) {
+        args = cdr(args);
+    }
+    if (args->type != CONS_TYPE) {
+        return fallback;
+    }
+    Value *index = car(args);
+    if (index->type != INT_TYPE) {
+        primitiveError(name, "expects an exact integer index");
+    } else if (index->i < low || index->i > high) {
+        primitiveError(name, "index is out of range");
+    }
+    return index->i;
+}
+
+/*
+ * Helper function to give a string characters of its own before it is
+ * changed.
+ */
+void unshareString(Value *string) {
+    if (string->str.shared) {
+        char *chars = makeChars(string->str.length);
+        memcpy(chars, string->str.chars, string->str.length);
+        string->str.chars = chars;
+        string->str.shared = false;
+    }
+}
+
+/*
+ * Helper function to compare two strings character by character.
+ *
+ * Returns a negative number, zero, or a positive number when the
+ * first sorts before, the same as, or after the second.
+ */
+int compareStrings(Value *first, Value *second) {
+    int64_t shorter = first->str.length < second->str.length
+                      ? first->str.length : second->str.length;
+    int order = memcmp(first->str.chars, second->str.chars, shorter);
+    if (order != 0) {
+        return order;
+    }
+    return (first->str.length > second->str.length) -
+           (first->str.length < second->str.length);
+}
+
+/*
+ * Measure, index, and compare strings, for the interpreter and for
+ * compiled programs to call directly.
+ */
+Value *stringLengthValue(Value *string) {
+    stringArgument("string-length", string);
+    return makeInteger(string->str.length);
+}
+
+Value *stringRefValue(Value *string, Value *index) {
+    stringArgument("string-ref", string);
+    if (index->type != INT_TYPE) {
+        primitiveError("string-ref", "expects an exact integer index");
+    } else if (index->i < 0 || index->i >= string->str.length) {
+        primitiveError("string-ref", "index is out of range");
+    }
+    return makeCharacter(string->str.chars[index->i]);
+}
+
+Value *stringsEqual(Value *first, Value *second) {
+    stringArgument("string=?", first);
+    stringArgument("string=?", second);
+    return makeBoolean(compareStrings(first, second) == 0);
+}
+
+/*
+ * Implementing the Scheme primitive string?.
+ */
+Value *primitiveIsString(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == STR_TYPE);
+}
+
+/*
+ * Implementing the Scheme primitive make-string, which fills the
+ * string with spaces unless given a character.
+ */
+Value *primitiveMakeString(Value *args) {
+    checkArity(args, 1, 2);
+    Value *size = car(args);
+    if (size->type != INT_TYPE || size->i < 0) {
+        primitiveError("make-string", "expects a non-negative length");
+    }
+    int fill = ' ';
+    if (cdr(args)->type == CONS_TYPE) {
+        fill = characterArgument("make-string", car(cdr(args)))->i;
+    }
+    Value *string = makeStringOf("", 0);
+    string->str.chars = makeChars(size->i);
+    memset(string->str.chars, fill, size->i);
+    string->str.length = size->i;
+    return string;
+}
+
+/*
+ * Implementing the Scheme primitive string, which makes a string of
+ * the given characters.
+ */
+Value *primitiveString(Value *args) {
+    Value *string = makeStringOf("", 0);
+    string->str.chars = makeChars(length(args));
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *c = characterArgument("string", car(cur));
+        string->str.chars[string->str.length++] = c->i;
+    }
+    return string;
+}
+
+/*
+ * Implementing the Scheme primitive string-length.
+ */
+Value *primitiveStringLength(Value *args) {
+    checkArity(args, 1, 1);
+    return stringLengthValue(car(args));
+}
+
+/*
+ * Implementing the Scheme primitive string-ref.
+ */
+Value *primitiveStringRef(Value *args) {
+    checkArity(args, 2, 2);
+    return stringRefValue(car(args), car(cdr(args)));
+}
+
+/*
+ * Implementing the Scheme primitive string-set!.
+ */
+Value *primitiveStringSet(Value *args) {
+    checkArity(args, 3, 3);
+    Value *string = stringArgument("string-set!", car(args));
+    int64_t index = stringIndexArgument("string-set!", args, 1, 0, 0,
+                                        string->str.length - 1);
+    Value *c = characterArgument("string-set!", car(cdr(cdr(args))));
+    if (string->str.literal) {
+        primitiveError("string-set!", "cannot change a literal string");
+    }
+    unshareString(string);
+    string->str.chars[index] = c->i;
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitive substring. The result shares the
+ * characters of the string instead of copying them.
+ */
+Value *primitiveSubstring(Value *args) {
+    checkArity(args, 2, 3);
+    Value *string = stringArgument("substring", car(args));
+    int64_t start = stringIndexArgument("substring", args, 1, 0, 0,
+                                        string->str.length);
+    int64_t end = stringIndexArgument("substring", args, 2,
+                                      string->str.length, start,
+                                      string->str.length);
+    Value *view = talloc(sizeof(Value));
+    if (!view) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    view->type = STR_TYPE;
+    view->str.chars = string->str.chars + start;
+    view->str.length = end - start;
+    view->str.shared = true;
+    view->str.literal = false;
+    string->str.shared = true;
+    return view;
+}
+
+/*
+ * Implementing the Scheme primitive string-append, which copies all
+ * the characters once into a string of the total length.
+ */
+Value *primitiveStringAppend(Value *args) {
+    int64_t total = 0;
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        total += stringArgument("string-append", car(cur))->str.length;
+    }
+    Value *string = makeStringOf("", 0);
+    string->str.chars = makeChars(total);
+    for (Value *cur = args; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        memcpy(string->str.chars + string->str.length, car(cur)->str.chars,
+               car(cur)->str.length);
+        string->str.length += car(cur)->str.length;
+    }
+    return string;
+}
+
+/*
+ * Implementing the Scheme primitive string-copy.
+ */
+Value *primitiveStringCopy(Value *args) {
+    checkArity(args, 1, 3);
+    Value *string = stringArgument("string-copy", car(args));
+    int64_t start = stringIndexArgument("string-copy", args, 1, 0, 0,
+                                        string->str.length);
+    int64_t end = stringIndexArgument("string-copy", args, 2,
+                                      string->str.length, start,
+                                      string->str.length);
+    return makeStringOf(string->str.chars + start, end - start);
+}
+
+/*
+ * Helper function to test that each pair of neighboring strings is in
+ * the given order: 0 for equal, -1 for ascending, 1 for descending.
+ */
+Value *compareStringChain(char *name, Value *args, int order) {
+    checkArity(args, 1, INT32_MAX);
+    bool result = true;
+    Value *previous = stringArgument(name, car(args));
+    for (Value *cur = cdr(args); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        Value *next = stringArgument(name, car(cur));
+        int comparison = compareStrings(previous, next);
+        if ((comparison > 0) - (comparison < 0) != order) {
+            result = false;
+        }
+        previous = next;
+    }
+    return makeBoolean(result);
+}
+
+/*
+ * Implementing the Scheme primitives string=?, string<?, and string>?.
+ */
+Value *primitiveStringEqual(Value *args) {
+    return compareStringChain("string=?", args, 0);
+}
+
+Value *primitiveStringLess(Value *args) {
+    return compareStringChain("string<?", args, -1);
+}
+
+Value *primitiveStringGreater(Value *args) {
+    return compareStringChain("string>?", args, 1);
+}
+
+/*
+ * Helper function to read an optional radix argument.
+ */
+int radixArgument(char *name, Value *args) {
+    if (args->type != CONS_TYPE) {
+        return 10;
+    }
+    Value *radix = car(args);
+    if (radix->type != INT_TYPE || (radix->i != 2 && radix->i != 8 &&
+                                    radix->i != 10 && radix->i != 16)) {
+        primitiveError(name, "expects a radix of 2, 8, 10, or 16");
+    }
+    return radix->i;
+}
+
+/*
+ * Helper function to find the value of a digit in the given radix.
+ *
+ * Returns -1 if it is not a digit.
+ */
+int digitValue(char c, int radix) {
+    int digit = -1;
+    if (c >= '0' && c <= '9') {
+        digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+    }
+    return digit < radix ? digit : -1;
+}
+
+/*
+ * Helper function to read a decimal number: an integer, or a number
+ * with a fraction or an exponent.
+ *
+ * Returns #f if the text is not a number.
+ */
+Value *readDecimal(char *text) {
+    if (!strcmp(text, "+inf.0") || !strcmp(text, "-inf.0")) {
+        return makeDouble(text[0] == '-' ? -HUGE_VAL : HUGE_VAL);
+    } else if (!strcmp(text, "+nan.0") || !strcmp(text, "-nan.0")) {
+        return makeDouble(NAN);
+    }
+    char *cur = text;
+    if (*cur == '+' || *cur == '-') {
+        cur++;
+    }
+    int digits = 0;
+    bool inexact = false;
+    while (digitValue(*cur, 10) >= 0) {
+        cur++;
+        digits++;
+    }
+    if (*cur == '.') {
+        inexact = true;
+        cur++;
+        while (digitValue(*cur, 10) >= 0) {
+            cur++;
+            digits++;
+        }
+    }
+    if (digits == 0) {
+        return makeBoolean(false);
+    }
+    if (*cur == 'e' || *cur == 'E') {
+        inexact = true;
+        cur++;
+        if (*cur == '+' || *cur == '-') {
+            cur++;
+        }
+        if (digitValue(*cur, 10) < 0) {
+            return makeBoolean(false);
+        }
+        while (digitValue(*cur, 10) >= 0) {
+            cur++;
+        }
+    }
+    if (*cur != '\0') {
+        return makeBoolean(false);
+    }
+    return inexact ? makeDouble(strtod(text, NULL)) : parseExactInteger(text);
+}
+
+/*
+ * Implementing the Scheme primitive string->number.
+ *
+ * Returns #f if the string is not a number.
+ */
+Value *primitiveStringToNumber(Value *args) {
+    checkArity(args, 1, 2);
+    Value *string = stringArgument("string->number", car(args));
+    int radix = radixArgument("string->number", cdr(args));
+    if (memchr(string->str.chars, '\0', string->str.length)) {
+        return makeBoolean(false);
+    }
+    char *text = stringToC(string);
+    if (radix == 10) {
+        return readDecimal(text);
+    }
+    char *cur = text;
+    bool negative = *cur == '-';
+    if (*cur == '+' || *cur == '-') {
+        cur++;
+    }
+    if (*cur == '\0') {
+        return makeBoolean(false);
+    }
+    Value *result = makeInteger(0);
+    Value *base = makeInteger(radix);
+    for (; *cur; cur++) {
+        int digit = digitValue(*cur, radix);
+        if (digit < 0) {
+            return makeBoolean(false);
+        }
+        result = addExact(multiplyExact(result, base), makeInteger(digit));
+    }
+    return negative ? negateExact(result) : result;
+}
+
+/*
+ * Implementing the Scheme primitive number->string. Only exact
+ * integers may be written in a radix other than 10.
+ */
+Value *primitiveNumberToString(Value *args) {
+    checkArity(args, 1, 2);
+    Value *number = car(args);
+    int radix = radixArgument("number->string", cdr(args));
+    char buffer[NUMBER_BUFFER_SIZE];
+    if (number->type == DOUBLE_TYPE && radix == 10) {
+        int size = formatDouble(number->d, buffer);
+        return makeStringOf(buffer, size);
+    } else if (!isExactInteger(number)) {
+        primitiveError("number->string",
+                       radix == 10 ? "expects a number as input"
+                                   : "expects an exact integer for this radix");
+    } else if (radix == 10) {
+        char *text = exactToString(number);
+        return makeStringOf(text, strlen(text));
+    }
+    // Peel off digits, lowest first, then reverse them
+    Value *digits = makeNull();
+    int64_t count = 0;
+    bool negative = signOfExact(number) < 0;
+    Value *rest = negative ? negateExact(number) : number;
+    Value *base = makeInteger(radix);
+    do {
+        Value *digit;
+        divideExact(rest, base, &rest, &digit);
+        digits = cons(makeCharacter("0123456789abcdef"[digit->i]), digits);
+        count++;
+    } while (signOfExact(rest) != 0);
+    Value *string = makeStringOf("", 0);
+    string->str.chars = makeChars(count + negative);
+    if (negative) {
+        string->str.chars[string->str.length++] = '-';
+    }
+    for (Value *cur = digits; cur->type != NULL_TYPE; cur = cdr(cur)) {
+        string->str.chars[string->str.length++] = car(cur)->i;
+    }
+    return string;
+}
+
+/*
+ * Implementing the Scheme primitive string->symbol.
+ */
+Value *primitiveStringToSymbol(Value *args) {
+    checkArity(args, 1, 1);
+    return makeSymbol(stringToC(stringArgument("string->symbol", car(args))));
+}
+
+/*
+ * Implementing the Scheme primitive symbol->string.
+ */
+Value *primitiveSymbolToString(Value *args) {
+    checkArity(args, 1, 1);
+    Value *symbol = car(args);
+    if (symbol->type != SYMBOL_TYPE) {
+        primitiveError("symbol->string", "expects a symbol as input");
+    }
+    return makeStringOf(symbol->s, strlen(symbol->s));
+}
+
+/*
+ * Implementing the Scheme primitive string->list.
+ */
+Value *primitiveStringToList(Value *args) {
+    checkArity(args, 1, 1);
+    Value *string = stringArgument("string->list", car(args));
+    Value *list = makeNull();
+    for (int64_t i = string->str.length - 1; i >= 0; i--) {
+        list = cons(makeCharacter(string->str.chars[i]), list);
+    }
+    return list;
+}
+
+/*
+ * Implementing the Scheme primitive list->string.
+ */
+Value *primitiveListToString(Value *args) {
+    checkArity(args, 1, 1);
+    Value *cur = car(args);
+    while (cur->type == CONS_TYPE) {
+        cur = cdr(cur);
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError("list->string", "expects a list of characters");
+    }
+    return primitiveString(car(args));
+}
+
+/*
+ * Implementing the Scheme primitive char?.
+ */
+Value *primitiveIsChar(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == CHAR_TYPE);
+}
+
+/*
+ * Implementing the Scheme primitive char->integer.
+ */
+Value *primitiveCharToInteger(Value *args) {
+    checkArity(args, 1, 1);
+    return makeInteger(characterArgument("char->integer", car(args))->i);
+}
+
+/*
+ * Implementing the Scheme primitive integer->char. Characters are
+ * bytes, from 0 to 255.
+ */
+Value *primitiveIntegerToChar(Value *args) {
+    checkArity(args, 1, 1);
+    Value *code = car(args);
+    if (code->type != INT_TYPE || code->i < 0 || code->i > 255) {
+        primitiveError("integer->char", "expects an integer from 0 to 255");
+    }
+    return makeCharacter(code->i);
+}
+
+/*
+ * Bind the string and character primitives in the given top-level
+ * frame.
+ */
+void bindTextPrimitives(Frame *topFrame) {
+    bind("string?", primitiveIsString, topFrame);
+    bind("make-string", primitiveMakeString, topFrame);
+    bind("string", primitiveString, topFrame);
+    bind("string-length", primitiveStringLength, topFrame);
+    bind("string-ref", primitiveStringRef, topFrame);
+    bind("string-set!", primitiveStringSet, topFrame);
+    bind("substring", primitiveSubstring, topFrame);
+    bind("string-append", primitiveStringAppend, topFrame);
+    bind("string-copy", primitiveStringCopy, topFrame);
+    bind("string=?", primitiveStringEqual, topFrame);
+    bind("string<?", primitiveStringLess, topFrame);
+    bind("string>?", primitiveStringGreater, topFrame);
+    bind("string->number", primitiveStringToNumber, topFrame);
+    bind("number->string", primitiveNumberToString, topFrame);
+    bind("string->symbol", primitiveStringToSymbol, topFrame);
+    bind("symbol->string", primitiveSymbolToString, topFrame);
+    bind("string->list", primitiveStringToList, topFrame);
+    bind("list->string", primitiveListToString, topFrame);
+    bind("char?", primitiveIsChar, topFrame);
+    bind("char->integer", primitiveCharToInteger, topFrame);
+    bind("integer->char", primitiveIntegerToChar, topFrame);
+}
@@ -0,0 +1,78 @@
+/*
+ * This program implements strings and characters. A string knows its
+ * length, so measuring it takes constant time, and a substring shares
+ * the characters of the string it is taken from until either changes.
+ */
+#include <stdio.h>
+#include "value.h"
+
+#ifndef TEXT_H
+#define TEXT_H
+
+/*
+ * Create a string holding a copy of the given characters.
+ */
+Value *makeStringOf(char *chars, int64_t length);
+
+/*
+ * Copy the characters of a string into a new NUL-terminated C string.
+ */
+char *stringToC(Value *string);
+
+/*
+ * Write a character as it is read, e.g. #\a, #\space, or #\x7.
+ */
+void writeCharacter(int c, FILE *out);
+
+/*
+ * Find the character with the given name, e.g. space, newline, or x41.
+ *
+ * Returns -1 if there is no such character.
+ */
+int characterFromName(char *name);
+
+/*
+ * Measure, index, and compare strings, for the interpreter and for
+ * compiled programs to call directly.
+ */
+Value *stringLengthValue(Value *string);
+Value *stringRefValue(Value *string, Value *index);
+Value *stringsEqual(Value *first, Value *second);
+
+/*
+ * Bind the string and character primitives in the given top-level
+ * frame:
+ *
+ *   string? make-string string string-length string-ref string-set!
+ *   substring string-append string-copy string=? string<? string>?
+ *   string->number number->string string->symbol symbol->string
+ *   string->list list->string char? char->integer integer->char
+ */
+void bindTextPrimitives(Frame *topFrame);
+
+/*
+ * The primitives above, for compiled programs.
+ */
+Value *primitiveIsString(Value *args);
+Value *primitiveMakeString(Value *args);
+Value *primitiveString(Value *args);
+Value *primitiveStringLength(Value *args);
+Value *primitiveStringRef(Value *args);
+Value *primitiveStringSet(Value *args);
+Value *primitiveSubstring(Value *args);
+Value *primitiveStringAppend(Value *args);
+Value *primitiveStringCopy(Value *args);
+Value *primitiveStringEqual(Value *args);
+Value *primitiveStringLess(Value *args);
+Value *primitiveStringGreater(Value *args);
+Value *primitiveStringToNumber(Value *args);
+Value *primitiveNumberToString(Value *args);
+Value *primitiveStringToSymbol(Value *args);
+Value *primitiveSymbolToString(Value *args);
+Value *primitiveStringToList(Value *args);
+Value *primitiveListToString(Value *args);
+Value *primitiveIsChar(Value *args);
+Value *primitiveCharToInteger(Value *args);
+Value *primitiveIntegerToChar(Value *args);
+
+#endif
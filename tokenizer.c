@@ -13,6 +13,9 @@
 #include "tokenizer.h"
 #include "talloc.h"
 #include "value.h"
+#include "bignum.h"
+#include "numformat.h"
+#include "text.h"
 #include <unistd.h>
 
 /* 
@@ -129,9 +132,8 @@ int addVector(Vector *list, int index, char value) {
  * Convert the given vector into a string.
  * 
  * Returns a string constructed from the values stored in the vector.
- * Appends additional quotation marks when if isStr is true.
  */
-char *convertVector(Vector *list, bool isStr) {
+char *convertVector(Vector *list) {
     char *result = talloc(sizeof(char) * (list->size) + 3);
     if (!result) {
         printf("Error! Not enough memory!\n");
@@ -168,6 +170,7 @@ bool parseNumber(Value *entry, FILE* src) {
     }
     
     bool isFloat = false;
+    bool hasExponent = false;
     
     // Check if the number starts with a decimal point
     char nextChar = fgetc(src);
@@ -197,6 +200,20 @@ bool parseNumber(Value *entry, FILE* src) {
             } else {
                 isFloat = true;
             }
+        } else if ((nextChar == 'e' || nextChar == 'E') && !hasExponent) {
+            // An exponent, as in 1e-9, makes the number a double
+            hasExponent = true;
+            isFloat = true;
+            addVector(vector, 0, nextChar);
+            nextChar = fgetc(src);
+            if (nextChar == '+' || nextChar == '-') {
+                addVector(vector, 0, nextChar);
+                nextChar = fgetc(src);
+            }
+            if (!isdigit(nextChar)) {
+                printf("Error! Unrecognized sequence with %c in number!\n", nextChar);
+                return false;
+            }
         } else if (!isdigit(nextChar)) {
             printf("Error! Unrecognized sequence with %c in number!\n", nextChar);
             return false;
@@ -205,7 +222,7 @@ bool parseNumber(Value *entry, FILE* src) {
         nextChar = fgetc(src);
     }
     // Convert vector into string
-    char *valueStr = convertVector(vector, false);
+    char *valueStr = convertVector(vector);
     
     // Convert string into numeric values
     if (isFloat) {
@@ -215,13 +232,20 @@ bool parseNumber(Value *entry, FILE* src) {
             value = value * -1;
         }   
         entry->d = value;
-    } else {
+    } else if (strlen(valueStr) <= 18) {
         entry->type = INT_TYPE;
-        int value = atoi(valueStr);
+        int64_t value = strtoll(valueStr, NULL, 10);
         if (neg) {
             value = value * -1;
         }   
         entry->i = value;
+    } else {
+        // Too long to be sure it fits in 64 bits
+        Value *value = parseExactInteger(valueStr);
+        if (neg) {
+            value = negateExact(value);
+        }
+        *entry = *value;
     }
     
     // Restore the delimiter
@@ -230,6 +254,32 @@ bool parseNumber(Value *entry, FILE* src) {
 }
 
 
+/*
+ * Helper function to read the rest of the identifier "..." after its
+ * first dot, used as the ellipsis in syntax-rules.
+ *
+ * Return true if it is there, otherwise leave the input untouched.
+ */
+bool peekEllipsis(FILE *src) {
+    char second = fgetc(src);
+    if (second != '.') {
+        ungetc(second, src);
+        return false;
+    }
+    char third = fgetc(src);
+    if (third != '.') {
+        printf("Error! Unrecognized sequence with %c!\n", third);
+        texit(1);
+    }
+    char next = fgetc(src);
+    ungetc(next, src);
+    if (!isDelimiter(next)) {
+        printf("Error! Illegal identifier!\n");
+        texit(1);
+    }
+    return true;
+}
+
 /*
  * Helper function to parse a string.
  *
@@ -284,7 +334,10 @@ bool parseString(Value *entry, FILE *src) {
         return false;
     }
     entry->type = STR_TYPE;
-    entry->s = convertVector(vector, true);
+    entry->str.length = vector->size;
+    entry->str.chars = convertVector(vector);
+    entry->str.shared = false;
+    entry->str.literal = true;
     return true;
 }
 
@@ -316,6 +369,42 @@ bool parseBool(Value *entry, FILE *src) {
     return true;
 }
 
+/*
+ * Helper function to parse a character after its #\\, either the
+ * character itself or a name such as space or x41.
+ *
+ * Return true if the parsing is successful, false if the parsing fails.
+ */
+bool parseCharacter(Value *entry, FILE *src) {
+    int first = fgetc(src);
+    if (first == EOF) {
+        printf("Error! Expected a character after #\\!\n");
+        return false;
+    }
+    char name[16];
+    int size = 0;
+    name[size++] = first;
+    char nextChar = fgetc(src);
+    while (!isDelimiter(nextChar)) {
+        if (size == (int) sizeof(name) - 1) {
+            printf("Error! Unrecognized character name!\n");
+            return false;
+        }
+        name[size++] = nextChar;
+        nextChar = fgetc(src);
+    }
+    ungetc(nextChar, src);
+    name[size] = '\0';
+    int c = size == 1 ? (unsigned char) first : characterFromName(name);
+    if (c < 0) {
+        printf("Error! Unrecognized character name!\n");
+        return false;
+    }
+    entry->type = CHAR_TYPE;
+    entry->i = c;
+    return true;
+}
+
 /*
  * Helper function to parse an identifier.
  *
@@ -342,7 +431,7 @@ bool parseIdentifier(Value *entry, FILE *src) {
         nextChar = fgetc(src);
     }
     entry->type = SYMBOL_TYPE;
-    entry->s = convertVector(vector, false);
+    entry->s = convertVector(vector);
     // Restore the delimiter
     ungetc(nextChar, src);
     return true;
@@ -363,7 +452,7 @@ Value *tokenize(FILE *src){
         printf("Error! Not enough memory!\n");
         return list;
     }
-    bool interactive = isatty(fileno(stdin));
+    bool interactive = isatty(fileno(src));
     if (interactive) {
         printf("> ");
     }
@@ -386,9 +475,23 @@ Value *tokenize(FILE *src){
                 count -= 1;
             }
         } else if (charRead == '#') {
-            bool success = parseBool(entry, src);
-            if (!success) {
-                texit(1);
+            char nextChar = fgetc(src);
+            if (nextChar == '(') {
+                entry->type = VECTOR_OPEN_TYPE;
+                if (interactive) {
+                    count += 1;
+                }
+            } else if (nextChar == '\\') {
+                bool success = parseCharacter(entry, src);
+                if (!success) {
+                    texit(1);
+                }
+            } else {
+                ungetc(nextChar, src);
+                bool success = parseBool(entry, src);
+                if (!success) {
+                    texit(1);
+                }
             }
         } else if (charRead == '"') {
             bool success = parseString(entry, src);
@@ -444,6 +547,9 @@ Value *tokenize(FILE *src){
         } else if (charRead == '\n' || charRead == '\t' || charRead == ' ') {
             charRead = fgetc(src);
             continue;
+        } else if (charRead == '.' && peekEllipsis(src)) {
+            entry->type = SYMBOL_TYPE;
+            entry->s = "...";
         } else if (isdigit(charRead) || charRead == '.') {
             ungetc(charRead, src);
             bool success = parseNumber(entry, src);
@@ -478,6 +584,9 @@ void displayTokens(Value *list){
             case OPEN_TYPE:
                 printf("(:open\n");
                 break;
+            case VECTOR_OPEN_TYPE:
+                printf("#(:open\n");
+                break;
             case CLOSE_TYPE:
                 printf("):close\n");
                 break;
@@ -488,16 +597,26 @@ void displayTokens(Value *list){
                 printf("%s:symbol\n", car(cur)->s);
                 break;
             case INT_TYPE:
-                printf("%d:integer\n", car(cur)->i);
+                writeInteger(car(cur)->i, stdout);
+                printf(":integer\n");
+                break;
+            case BIGNUM_TYPE:
+                printf("%s:integer\n", exactToString(car(cur)));
                 break;
             case DOUBLE_TYPE:
-                printf("%f:double\n", car(cur)->d);
+                writeDouble(car(cur)->d, stdout);
+                printf(":double\n");
                 break;
             case STR_TYPE:
                 printf("\"");
-                printf("%s:string", car(cur)->s);
+                fwrite(car(cur)->str.chars, 1, car(cur)->str.length, stdout);
+                printf(":string");
                 printf("\"\n");
                 break;
+            case CHAR_TYPE:
+                writeCharacter(car(cur)->i, stdout);
+                printf(":character\n");
+                break;
             default:
                 printf("ERROR\n");
         }
@@ -1,4 +1,5 @@
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifndef VALUE_H
 #define VALUE_H
@@ -16,19 +17,120 @@ typedef enum {
    NULL_TYPE,
    VOID_TYPE,
    CLOSURE_TYPE,
-   PRIMITIVE_TYPE
+   PRIMITIVE_TYPE,
+   COMPILED_TYPE,
+   BIGNUM_TYPE,
+   NUMVECTOR_TYPE,
+   VECTOR_TYPE,
+   VECTOR_OPEN_TYPE,
+   HASHTABLE_TYPE,
+   CHAR_TYPE,
+   IMAP_TYPE,
+   RECORD_TYPE,
+   RECORD_DESCRIPTOR_TYPE,
+   RECORD_PROCEDURE_TYPE,
+   VALUES_TYPE,
+   PROMISE_TYPE,
+   MEMOIZED_TYPE,
+   WEAK_TYPE
 } valueType;
 
+/* The element types of the homogeneous numeric vectors of SRFI 4. */
+typedef enum {
+   F64_VECTOR,
+   S64_VECTOR,
+   U8_VECTOR
+} numVectorKind;
+
+/* The procedures define-record-type makes for a record type. */
+typedef enum {
+   RECORD_CONSTRUCTOR,
+   RECORD_PREDICATE,
+   RECORD_ACCESSOR,
+   RECORD_MODIFIER
+} recordProcedureKind;
+
+/* The weak references: a weak box holds its value weakly, and an
+ * ephemeron holds its datum only as long as its key is alive. */
+typedef enum {
+   WEAK_BOX,
+   EPHEMERON
+} weakKind;
+
+/* Which part of each entry a hash table holds weakly, if any. */
+typedef enum {
+   WEAK_NONE,
+   WEAK_KEYS,
+   WEAK_VALUES
+} hashTableWeakness;
+
+/* The parts of a value too large to fit in it, which follow it in the
+ * same block. */
+
+/* A Scheme hash table: the table itself, the equality and hash
+ * procedures given when it was made, or NULL for the built-in ones,
+ * and what it holds weakly.
+ */
+struct SchemeHashTable {
+   struct HashTable *table;
+   struct Value *equality;
+   struct Value *hash;
+   hashTableWeakness weakness;
+};
+
+/* A persistent map or set: a hash array mapped trie of `count'
+ * entries. A transient one owns the `edit' token and changes the
+ * nodes carrying the same token in place; the token is NULL once it
+ * has been made persistent.
+ */
+struct ImmutableMap {
+   struct HamtNode *root;
+   int64_t count;
+   bool isSet;
+   bool transient;
+   void *edit;
+};
+
+/* A constructor, predicate, accessor, or modifier of a record type, and
+ * the name it was defined with. An accessor or modifier reads or writes
+ * slot `index'; a constructor takes `count' arguments and stores
+ * argument i in slot `positions[i]'.
+ */
+struct RecordProcedure {
+   recordProcedureKind kind;
+   struct Value *name;
+   struct Value *descriptor;
+   int64_t index;
+   int64_t count;
+   int64_t *positions;
+};
+
 struct Value {
    valueType type;
    union {
       void *p;
-      int i;
+      int64_t i;          /* An integer, or the code of a character */
       double d;
       char *s;
+      /* A string: `length' characters at `chars', which need not end
+       * in a NUL. A shared string's characters may also belong to other
+       * strings, so they are copied before the string is changed. A
+       * literal string, written in the program, cannot be changed.
+       */
+      struct SchemeString {
+         char *chars;
+         int64_t length;
+         bool shared;
+         bool literal;
+      } str;
+      /* A pair. When the pair is the argument list of a call to an
+       * arithmetic primitive, `feedback' records the operand types
+       * the call site has seen (see feedback.c); it is 0 otherwise.
+       */
       struct ConsCell {
          struct Value *car;
          struct Value *cdr;
+         unsigned char feedback;
       } c;
       struct Closure {
          struct Value *formal;
@@ -39,15 +141,97 @@ struct Value {
        * Note: `pf' is the variable name I chose for the function pointer.
        */
       struct Value *(*pf)(struct Value *);
+      /* A procedure translated to C by the compiler, together with the
+       * environment it closes over. `code' receives the number of
+       * arguments, the arguments, and `env'.
+       */
+      struct Compiled {
+         struct Value *(*code)(int, struct Value **, struct Value **);
+         struct Value **env;
+      } compiled;
+      /* An integer too large for `i': its magnitude as 32-bit digits,
+       * least significant first, and its sign.
+       */
+      struct Bignum {
+         uint32_t *digits;
+         int size;
+         bool negative;
+      } big;
+      /* A homogeneous numeric vector: `length' elements of one kind,
+       * stored unboxed one after another in `data'. A `readOnly'
+       * vector maps a file and cannot be changed.
+       */
+      struct NumVector {
+         numVectorKind kind;
+         bool readOnly;
+         int64_t length;
+         void *data;
+      } numvec;
+      /* A vector: `length' values stored one after another. */
+      struct ValueVector {
+         int64_t length;
+         struct Value **items;
+      } vec;
+      struct SchemeHashTable *dict;          /* A Scheme hash table */
+      struct ImmutableMap *imap;             /* A persistent map or set */
+      /* A record type made by define-record-type: its name, and the
+       * names of its `count' fields in the order of their slots.
+       */
+      struct RecordDescriptor {
+         struct Value *name;
+         int64_t count;
+         struct Value **fields;
+      } rtd;
+      /* A record: its type, and one slot for each field of the type. */
+      struct Record {
+         struct Value *descriptor;
+         struct Value **slots;
+      } record;
+      struct RecordProcedure *recproc;       /* A record procedure */
+      /* The results of values other than a single one: `count' values
+       * at `items', which the caller must take before anything else
+       * returns multiple values.
+       */
+      struct MultipleValues {
+         int64_t count;
+         struct Value **items;
+      } values;
+      /* A promise made by delay, delay-force, or make-promise. Promises
+       * chained by delay-force come to share one state as they are
+       * forced.
+       */
+      struct PromiseValue {
+         struct Promise *state;
+      } promise;
+      /* A procedure made by memoize, with its table of results */
+      struct MemoizedValue {
+         struct Memo *state;
+      } memo;
+      /* A weak box, whose value is `key', or an ephemeron. Once the
+       * key has been reclaimed the reference is broken, and key and
+       * datum are dropped.
+       */
+      struct WeakReference {
+         weakKind kind;
+         bool broken;
+         struct Value *key;
+         struct Value *datum;
+      } weak;
    };
 };
 
 struct Frame {
     struct Value *bindings;
     struct Frame *parent;
+    /* Set once a closure may refer to this frame, after which its
+     * bindings must not be overwritten in place by loop forms. */
+    bool captured;
 };
 typedef struct Frame Frame;
 
 typedef struct Value Value;
 
+/* Every pair, number, and symbol is a value, so values stay small */
+_Static_assert(sizeof(Value) <= 32, "a value must fit in 32 bytes");
+
 #endif
@@ -0,0 +1,367 @@
+/*
+ * This program implements multiple return values.
+ *
+ * A call of values with one argument returns the argument itself. Any
+ * other number of values makes a VALUES_TYPE result holding them in
+ * the same block, so the result stays valid wherever it is kept.
+ * Whoever receives them, call-with-values, receive, or let-values,
+ * copies them onto the C stack and binds them from there, so no list
+ * is built unless the formals ask for one. When the expression of
+ * receive or let-values is itself a call of values, its arguments are
+ * evaluated straight onto the C stack, and no result is made at all.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "values.h"
+#include "interpreter.h"
+#include "bignum.h"
+#include "linkedlist.h"
+#include "record.h"
+#include "talloc.h"
+#include "runtime.h"
+
+Value *returnValues(int64_t count, Value **items) {
+    if (count == 1) {
+        return items[0];
+    }
+    // The items follow the result in one block
+    Value *result = talloc(sizeof(Value) + sizeof(Value *) * count);
+    if (!result) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    result->type = VALUES_TYPE;
+    result->values.count = count;
+    result->values.items = (Value **) (result + 1);
+    memcpy(result->values.items, items, sizeof(Value *) * count);
+    return result;
+}
+
+Value *returnTwoValues(Value *first, Value *second) {
+    Value *items[2] = {first, second};
+    return returnValues(2, items);
+}
+
+int64_t valuesCount(Value *result) {
+    return result->type == VALUES_TYPE ? result->values.count : 1;
+}
+
+void copyValues(Value *result, Value **items) {
+    if (result->type == VALUES_TYPE) {
+        memcpy(items, result->values.items,
+               sizeof(Value *) * result->values.count);
+    } else {
+        items[0] = result;
+    }
+}
+
+/*
+ * Helper function to find whether an expression is a call of the
+ * primitive values, whose arguments a receiver can evaluate itself.
+ */
+bool isValuesCall(Value *expr, Frame *frame) {
+    if (expr->type != CONS_TYPE || car(expr)->type != SYMBOL_TYPE) {
+        return false;
+    }
+    Value *function = eval(car(expr), frame);
+    return function->type == PRIMITIVE_TYPE && function->pf == primitiveValues;
+}
+
+/*
+ * Helper function to evaluate the expression a receiver binds, and
+ * find the number of values it gives. A call of values is left for
+ * receiveValues to evaluate, with NULL as the result.
+ */
+int64_t receiveCount(Value *expr, Frame *frame, Value **result) {
+    if (isValuesCall(expr, frame)) {
+        *result = NULL;
+        return length(cdr(expr));
+    }
+    *result = eval(expr, frame);
+    return valuesCount(*result);
+}
+
+/*
+ * Helper function to copy the values receiveCount found into an array
+ * with room for them.
+ */
+void receiveValues(Value *expr, Frame *frame, Value *result,
+                   Value **items) {
+    if (result != NULL) {
+        copyValues(result, items);
+        return;
+    }
+    int64_t i = 0;
+    for (Value *cur = cdr(expr); cur->type != NULL_TYPE; cur = cdr(cur)) {
+        items[i++] = eval(car(cur), frame);
+    }
+}
+
+/*
+ * Helper function to create an empty frame below the given one.
+ */
+Frame *makeValuesFrame(Frame *parent) {
+    Frame *frame = talloc(sizeof(Frame));
+    if (!frame) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    frame->parent = parent;
+    frame->bindings = makeNull();
+    frame->captured = false;
+    return frame;
+}
+
+/*
+ * Helper function to bind formals to an array of values in the given
+ * frame. A symbol is bound to a list of all the values; a list of
+ * symbols must have one symbol per value.
+ */
+void bindValueArray(char *form, Value *formals, int64_t count,
+                    Value **items, Frame *frame) {
+    if (formals->type == SYMBOL_TYPE) {
+        addBindingLocal(formals, listOfValues(count, items), frame);
+        return;
+    }
+    int64_t expected = 0;
+    Value *cur = formals;
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        if (car(cur)->type != SYMBOL_TYPE) {
+            printf("Invalid syntax in '%s'. Not a valid identifier! ", form);
+            evaluationError();
+        }
+        expected++;
+    }
+    if (cur->type != NULL_TYPE) {
+        printf("Invalid syntax in '%s'. ", form);
+        evaluationError();
+    }
+    if (expected != count) {
+        printf("Expected %i values, received %i. ", (int) expected,
+               (int) count);
+        evaluationError();
+    }
+    cur = formals;
+    for (int64_t i = 0; i < count; i++) {
+        addBindingLocal(car(cur), items[i], frame);
+        cur = cdr(cur);
+    }
+}
+
+/*
+ * Helper function to evaluate a body in the given frame and return the
+ * value of its last expression.
+ */
+Value *evalValuesBody(Value *body, Frame *frame) {
+    while (cdr(body)->type != NULL_TYPE) {
+        eval(car(body), frame);
+        body = cdr(body);
+    }
+    return eval(car(body), frame);
+}
+
+/*
+ * Helper function to call a procedure with an array of arguments. A
+ * closure binds them in its frame directly, without a list.
+ */
+Value *applyToValues(Value *consumer, int64_t count, Value **items) {
+    if (consumer->type == COMPILED_TYPE) {
+        return (consumer->compiled.code)(count, items, consumer->compiled.env);
+    } else if (consumer->type == RECORD_PROCEDURE_TYPE) {
+        return callRecordProcedure(consumer, count, items);
+    } else if (consumer->type != CLOSURE_TYPE) {
+        return apply(consumer, listOfValues(count, items));
+    }
+    Frame *frame = makeValuesFrame(consumer->closure.frame);
+    bindValueArray("lambda", consumer->closure.formal, count, items, frame);
+    return evalValuesBody(consumer->closure.body, frame);
+}
+
+Value *evalValuesCall(Value *args, Frame *frame) {
+    int count = length(args);
+    Value *items[count > 0 ? count : 1];
+    for (int i = 0; i < count; i++) {
+        items[i] = eval(car(args), frame);
+        args = cdr(args);
+    }
+    return returnValues(count, items);
+}
+
+Value *evalReceive(Value *args, Frame *frame) {
+    if (length(args) < 3) {
+        printf("Invalid syntax in 'receive'. ");
+        evaluationError();
+    }
+    Value *result;
+    int64_t count = receiveCount(car(cdr(args)), frame, &result);
+    Value *items[count > 0 ? count : 1];
+    receiveValues(car(cdr(args)), frame, result, items);
+    Frame *bodyFrame = makeValuesFrame(frame);
+    bindValueArray("receive", car(args), count, items, bodyFrame);
+    return evalValuesBody(cdr(cdr(args)), bodyFrame);
+}
+
+Value *evalLetValues(Value *args, Frame *frame) {
+    if (length(args) < 2) {
+        printf("Invalid syntax in 'let-values'. ");
+        evaluationError();
+    }
+    Frame *bodyFrame = makeValuesFrame(frame);
+    Value *cur = car(args);
+    for (; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        Value *binding = car(cur);
+        if (binding->type != CONS_TYPE || length(binding) != 2) {
+            printf("Invalid syntax in 'let-values' bindings. ");
+            evaluationError();
+        }
+        Value *result;
+        int64_t count = receiveCount(car(cdr(binding)), frame, &result);
+        Value *items[count > 0 ? count : 1];
+        receiveValues(car(cdr(binding)), frame, result, items);
+        bindValueArray("let-values", car(binding), count, items, bodyFrame);
+    }
+    if (cur->type != NULL_TYPE) {
+        printf("Invalid syntax in 'let-values'. ");
+        evaluationError();
+    }
+    return evalValuesBody(cdr(args), bodyFrame);
+}
+
+/*
+ * Implementing the Scheme primitive values.
+ */
+Value *primitiveValues(Value *args) {
+    int count = length(args);
+    Value *items[count > 0 ? count : 1];
+    for (int i = 0; i < count; i++) {
+        items[i] = car(args);
+        args = cdr(args);
+    }
+    return returnValues(count, items);
+}
+
+/*
+ * Implementing the Scheme primitive call-with-values.
+ */
+Value *primitiveCallWithValues(Value *args) {
+    checkArity(args, 2, 2);
+    Value *producer = car(args);
+    Value *result;
+    if (producer->type == COMPILED_TYPE) {
+        Value *none[1];
+        result = (producer->compiled.code)(0, none, producer->compiled.env);
+    } else {
+        result = apply(producer, makeNull());
+    }
+    int64_t count = valuesCount(result);
+    Value *items[count > 0 ? count : 1];
+    copyValues(result, items);
+    return applyToValues(car(cdr(args)), count, items);
+}
+
+/*
+ * Helper function to build the argument list of a primitive taking
+ * two arguments.
+ */
+Value *pairOfArguments(Value *first, Value *second) {
+    return cons(first, cons(second, makeNull()));
+}
+
+/*
+ * Helper function to turn an argument of floor/ or truncate/ into a
+ * double, raising an error unless it is an integer.
+ */
+double integralArgument(char *name, Value *value) {
+    double d = NAN;
+    if (value->type == DOUBLE_TYPE) {
+        d = value->d;
+    } else if (isExactInteger(value)) {
+        d = exactToDouble(value);
+    }
+    if (!isfinite(d) || d != trunc(d)) {
+        printf("%s expects integers as input\n", name);
+        evaluationError();
+    }
+    return d;
+}
+
+/*
+ * Helper function to divide two integers at least one of which is
+ * inexact, rounding the quotient down if `floored' and toward zero
+ * otherwise. Both results are inexact.
+ */
+Value *divideInexact(char *name, Value *n, Value *d, bool floored) {
+    double x = integralArgument(name, n);
+    double y = integralArgument(name, d);
+    if (y == 0) {
+        printf("%s: undefined for 0. ", name);
+        evaluationError();
+    }
+    double remainder = fmod(x, y);
+    if (floored && remainder != 0 && (remainder < 0) != (y < 0)) {
+        remainder += y;
+    }
+    return returnTwoValues(makeDouble((x - remainder) / y),
+                           makeDouble(remainder));
+}
+
+/*
+ * Implementing the Scheme primitive floor/, which returns the quotient
+ * rounded toward negative infinity and the remainder with the sign of
+ * the divisor.
+ */
+Value *primitiveFloorDivide(Value *args) {
+    checkArity(args, 2, 2);
+    Value *n = car(args);
+    Value *d = car(cdr(args));
+    if (n->type == INT_TYPE && d->type == INT_TYPE && d->i != 0 &&
+        !(n->i == INT64_MIN && d->i == -1)) {
+        int64_t quotient = n->i / d->i;
+        int64_t remainder = n->i % d->i;
+        if (remainder != 0 && (remainder < 0) != (d->i < 0)) {
+            quotient--;
+            remainder += d->i;
+        }
+        return returnTwoValues(makeInteger(quotient), makeInteger(remainder));
+    }
+    if (n->type == DOUBLE_TYPE || d->type == DOUBLE_TYPE) {
+        return divideInexact("floor/", n, d, true);
+    }
+    Value *remainder = primitiveModulo(pairOfArguments(n, d));
+    Value *exact = primitiveSub(pairOfArguments(n, remainder));
+    return returnTwoValues(primitiveQuotient(pairOfArguments(exact, d)),
+                           remainder);
+}
+
+/*
+ * Implementing the Scheme primitive truncate/, which returns the
+ * quotient rounded toward zero and the remainder with the sign of the
+ * dividend.
+ */
+Value *primitiveTruncateDivide(Value *args) {
+    checkArity(args, 2, 2);
+    Value *n = car(args);
+    Value *d = car(cdr(args));
+    if (n->type == INT_TYPE && d->type == INT_TYPE && d->i != 0 &&
+        !(n->i == INT64_MIN && d->i == -1)) {
+        return returnTwoValues(makeInteger(n->i / d->i),
+                               makeInteger(n->i % d->i));
+    }
+    if (n->type == DOUBLE_TYPE || d->type == DOUBLE_TYPE) {
+        return divideInexact("truncate/", n, d, false);
+    }
+    Value *quotient = primitiveQuotient(pairOfArguments(n, d));
+    return returnTwoValues(quotient,
+                           primitiveRemainder(pairOfArguments(n, d)));
+}
+
+/*
+ * Bind the multiple-value primitives in the given top-level frame.
+ */
+void bindValuesPrimitives(Frame *topFrame) {
+    bind("values", primitiveValues, topFrame);
+    bind("call-with-values", primitiveCallWithValues, topFrame);
+    bind("floor/", primitiveFloorDivide, topFrame);
+    bind("truncate/", primitiveTruncateDivide, topFrame);
+}
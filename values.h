@@ -0,0 +1,73 @@
+/*
+ * This program implements multiple return values. Results other than
+ * a single one are held in one block with their values, which the
+ * caller copies onto the C stack. receive and let-values evaluate a
+ * call of values in place, so binding its values allocates nothing.
+ */
+#include "value.h"
+
+#ifndef VALUES_H
+#define VALUES_H
+
+/*
+ * Return the given values: the value itself if there is one, or a new
+ * multiple-values result otherwise.
+ */
+Value *returnValues(int64_t count, Value **items);
+
+/*
+ * Return two values, for compiled programs to call directly.
+ */
+Value *returnTwoValues(Value *first, Value *second);
+
+/*
+ * Find the number of values a result stands for, and copy them into
+ * an array with room for that many.
+ */
+int64_t valuesCount(Value *result);
+void copyValues(Value *result, Value **items);
+
+/*
+ * Evaluate the arguments of a call to values and return them, without
+ * building an argument list.
+ */
+Value *evalValuesCall(Value *args, Frame *frame);
+
+/*
+ * Evaluate the RECEIVE special form of SRFI 8:
+ *
+ *   (receive (q r) (floor/ 7 2) body ...)
+ *
+ * and the LET-VALUES special form of R7RS:
+ *
+ *   (let-values (((q r) (floor/ 7 2)) ((x) 1)) body ...)
+ *
+ * Formals that are a single symbol are bound to a list of all the
+ * values.
+ */
+Value *evalReceive(Value *args, Frame *frame);
+Value *evalLetValues(Value *args, Frame *frame);
+
+/*
+ * The primitives below, for compiled programs.
+ */
+Value *primitiveValues(Value *args);
+Value *primitiveCallWithValues(Value *args);
+Value *primitiveFloorDivide(Value *args);
+Value *primitiveTruncateDivide(Value *args);
+
+/*
+ * Bind the multiple-value primitives in the given top-level frame.
+ *
+ *   values x ...
+ *   call-with-values producer consumer
+ *   floor/ n d        the quotient rounded down, and the remainder
+ *   truncate/ n d     the quotient rounded toward zero, and the
+ *                     remainder
+ *
+ * The division procedures take exact or inexact integers; if either
+ * is inexact, so are both results.
+ */
+void bindValuesPrimitives(Frame *topFrame);
+
+#endif
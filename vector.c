@@ -0,0 +1,202 @@
+/*
+ * This program implements vectors: fixed-length sequences of any
+ * values. The elements are kept in one array of pointers, so reading or
+ * writing one takes constant time.
+ */
+#include <stdio.h>
+#include "vector.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/*
+ * Create a vector of the given length with every element `fill'.
+ */
+Value *makeVector(int64_t length, Value *fill) {
+    Value *vector = talloc(sizeof(Value));
+    Value **items = talloc(sizeof(Value *) * (length > 0 ? length : 1));
+    if (!vector || !items) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    for (int64_t i = 0; i < length; i++) {
+        items[i] = fill;
+    }
+    vector->type = VECTOR_TYPE;
+    vector->vec.length = length;
+    vector->vec.items = items;
+    return vector;
+}
+
+/*
+ * Create a vector holding the elements of a list.
+ */
+Value *vectorFromList(Value *list) {
+    Value *vector = makeVector(length(list), NULL);
+    int64_t i = 0;
+    for (Value *cur = list; cur->type == CONS_TYPE; cur = cdr(cur)) {
+        vector->vec.items[i++] = car(cur);
+    }
+    return vector;
+}
+
+/*
+ * Create a list holding the elements of a vector.
+ */
+Value *listFromVector(Value *vector) {
+    Value *list = makeNull();
+    for (int64_t i = vector->vec.length - 1; i >= 0; i--) {
+        list = cons(vector->vec.items[i], list);
+    }
+    return list;
+}
+
+/*
+ * Helper function to check that an argument is a vector.
+ */
+void checkIsVector(char *name, Value *value) {
+    if (value->type != VECTOR_TYPE) {
+        primitiveError(name, "expects a vector as input");
+    }
+}
+
+/*
+ * Helper function to check that an index is a fixnum within a vector.
+ */
+void checkVectorIndex(char *name, Value *vector, Value *index) {
+    checkIsVector(name, vector);
+    if (index->type != INT_TYPE) {
+        primitiveError(name, "expects an exact integer index");
+    } else if (index->i < 0 || index->i >= vector->vec.length) {
+        primitiveError(name, "index is out of range");
+    }
+}
+
+/*
+ * Read, write, and measure a vector, for the interpreter and for
+ * compiled programs to call directly.
+ */
+Value *vectorRefValue(Value *vector, Value *index) {
+    checkVectorIndex("vector-ref", vector, index);
+    return vector->vec.items[index->i];
+}
+
+Value *vectorSetValue(Value *vector, Value *index, Value *value) {
+    checkVectorIndex("vector-set!", vector, index);
+    vector->vec.items[index->i] = value;
+    return makeVoid();
+}
+
+Value *vectorLengthValue(Value *vector) {
+    checkIsVector("vector-length", vector);
+    return makeInteger(vector->vec.length);
+}
+
+/*
+ * Implementing the Scheme primitive make-vector. The elements are 0
+ * unless a fill is given.
+ */
+Value *primitiveMakeVector(Value *args) {
+    checkArity(args, 1, 2);
+    Value *size = car(args);
+    if (size->type != INT_TYPE || size->i < 0) {
+        primitiveError("make-vector", "expects a non-negative length");
+    }
+    Value *fill = makeInteger(0);
+    if (cdr(args)->type != NULL_TYPE) {
+        fill = car(cdr(args));
+    }
+    return makeVector(size->i, fill);
+}
+
+/*
+ * Implementing the Scheme primitive vector.
+ */
+Value *primitiveVector(Value *args) {
+    return vectorFromList(args);
+}
+
+/*
+ * Implementing the Scheme primitive vector?.
+ */
+Value *primitiveIsVector(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == VECTOR_TYPE);
+}
+
+/*
+ * Implementing the Scheme primitive vector-length.
+ */
+Value *primitiveVectorLength(Value *args) {
+    checkArity(args, 1, 1);
+    return vectorLengthValue(car(args));
+}
+
+/*
+ * Implementing the Scheme primitive vector-ref.
+ */
+Value *primitiveVectorRef(Value *args) {
+    checkArity(args, 2, 2);
+    return vectorRefValue(car(args), car(cdr(args)));
+}
+
+/*
+ * Implementing the Scheme primitive vector-set!.
+ */
+Value *primitiveVectorSet(Value *args) {
+    checkArity(args, 3, 3);
+    return vectorSetValue(car(args), car(cdr(args)), car(cdr(cdr(args))));
+}
+
+/*
+ * Implementing the Scheme primitive vector-fill!.
+ */
+Value *primitiveVectorFill(Value *args) {
+    checkArity(args, 2, 2);
+    Value *vector = car(args);
+    checkIsVector("vector-fill!", vector);
+    for (int64_t i = 0; i < vector->vec.length; i++) {
+        vector->vec.items[i] = car(cdr(args));
+    }
+    return makeVoid();
+}
+
+/*
+ * Implementing the Scheme primitive vector->list.
+ */
+Value *primitiveVectorToList(Value *args) {
+    checkArity(args, 1, 1);
+    checkIsVector("vector->list", car(args));
+    return listFromVector(car(args));
+}
+
+/*
+ * Implementing the Scheme primitive list->vector.
+ */
+Value *primitiveListToVector(Value *args) {
+    checkArity(args, 1, 1);
+    Value *cur = car(args);
+    while (cur->type == CONS_TYPE) {
+        cur = cdr(cur);
+    }
+    if (cur->type != NULL_TYPE) {
+        primitiveError("list->vector", "expects a list as input");
+    }
+    return vectorFromList(car(args));
+}
+
+/*
+ * Bind the vector primitives in the given top-level frame.
+ */
+void bindVectorPrimitives(Frame *topFrame) {
+    bind("make-vector", primitiveMakeVector, topFrame);
+    bind("vector", primitiveVector, topFrame);
+    bind("vector?", primitiveIsVector, topFrame);
+    bind("vector-length", primitiveVectorLength, topFrame);
+    bind("vector-ref", primitiveVectorRef, topFrame);
+    bind("vector-set!", primitiveVectorSet, topFrame);
+    bind("vector-fill!", primitiveVectorFill, topFrame);
+    bind("vector->list", primitiveVectorToList, topFrame);
+    bind("list->vector", primitiveListToVector, topFrame);
+}
@@ -0,0 +1,54 @@
+/*
+ * This program implements vectors: fixed-length sequences of any
+ * values, stored one after another so that an element is found in
+ * constant time.
+ */
+#include "value.h"
+
+#ifndef VECTOR_H
+#define VECTOR_H
+
+/*
+ * Create a vector of the given length with every element `fill'.
+ */
+Value *makeVector(int64_t length, Value *fill);
+
+/*
+ * Create a vector holding the elements of a list.
+ */
+Value *vectorFromList(Value *list);
+
+/*
+ * Create a list holding the elements of a vector.
+ */
+Value *listFromVector(Value *vector);
+
+/*
+ * Read, write, and measure a vector, for the interpreter and for
+ * compiled programs to call directly. The index must be a fixnum
+ * within the vector.
+ */
+Value *vectorRefValue(Value *vector, Value *index);
+Value *vectorSetValue(Value *vector, Value *index, Value *value);
+Value *vectorLengthValue(Value *vector);
+
+/*
+ * The Scheme primitives make-vector, vector, vector?, vector-length,
+ * vector-ref, vector-set!, vector-fill!, vector->list, and list->vector.
+ */
+Value *primitiveMakeVector(Value *args);
+Value *primitiveVector(Value *args);
+Value *primitiveIsVector(Value *args);
+Value *primitiveVectorLength(Value *args);
+Value *primitiveVectorRef(Value *args);
+Value *primitiveVectorSet(Value *args);
+Value *primitiveVectorFill(Value *args);
+Value *primitiveVectorToList(Value *args);
+Value *primitiveListToVector(Value *args);
+
+/*
+ * Bind the vector primitives in the given top-level frame.
+ */
+void bindVectorPrimitives(Frame *topFrame);
+
+#endif
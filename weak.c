@@ -0,0 +1,325 @@
+/*
+ * This program implements weak references.
+ *
+ * A weak box or ephemeron is a WEAK_TYPE value with a `broken' flag,
+ * in a block the collector does not scan, so that its key stays
+ * unmarked unless something else reaches it. Weak objects and weak
+ * tables are kept in registries the collector does not scan either.
+ * After marking, the collector marks the datum of each ephemeron whose
+ * key is marked, and the value of each entry of a weak-key table whose
+ * key is marked, until nothing changes; then it breaks the references
+ * whose key is unmarked and removes the dead entries of weak tables.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "weak.h"
+#include "dictionary.h"
+#include "hashtable.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "runtime.h"
+
+/* A registry of weak values, in a block the collector does not scan */
+typedef struct Registry {
+    Value **items;
+    int64_t count;
+    int64_t capacity;
+} Registry;
+
+/* The weak boxes and ephemerons not yet broken, and the weak tables */
+static Registry weakObjects = {NULL, 0, 0};
+static Registry weakTables = {NULL, 0, 0};
+
+/*
+ * Helper function to check that an argument is a weak reference of
+ * the given kind.
+ */
+Value *weakArgument(char *name, Value *value, weakKind kind) {
+    if (value->type != WEAK_TYPE || value->weak.kind != kind) {
+        primitiveError(name,
+                       kind == WEAK_BOX ? "expects a weak box as input"
+                                        : "expects an ephemeron as input");
+    }
+    return value;
+}
+
+/*
+ * Helper function to add a value to a registry.
+ */
+void addToRegistry(Registry *registry, Value *value) {
+    if (registry->count == registry->capacity) {
+        int64_t capacity = registry->capacity > 0 ? registry->capacity * 2 : 16;
+        Value **items = talloc(sizeof(Value *) * capacity);
+        if (!items) {
+            printf("Error! Not enough memory!\n");
+            texit(1);
+        }
+        tuntrace(items);
+        if (registry->count > 0) {
+            memcpy(items, registry->items, sizeof(Value *) * registry->count);
+        }
+        registry->items = items;
+        registry->capacity = capacity;
+    }
+    registry->items[registry->count++] = value;
+}
+
+/*
+ * Helper function to make and register a weak reference.
+ */
+Value *makeWeak(weakKind kind, Value *key, Value *datum) {
+    Value *weak = talloc(sizeof(Value));
+    if (!weak) {
+        printf("Error! Not enough memory!\n");
+        texit(1);
+    }
+    weak->type = WEAK_TYPE;
+    weak->weak.kind = kind;
+    weak->weak.broken = false;
+    weak->weak.key = key;
+    weak->weak.datum = datum;
+    tuntrace(weak);
+    addToRegistry(&weakObjects, weak);
+    return weak;
+}
+
+void registerWeakTable(Value *table) {
+    addToRegistry(&weakTables, table);
+}
+
+/*
+ * Helper function to test whether a value is one a program can make
+ * again, such as a number, a character, or a symbol, which eqv? cannot
+ * tell from the original. Weak references never let go of these.
+ */
+bool isPermanent(Value *value) {
+    switch (value->type) {
+        case INT_TYPE:
+        case BIGNUM_TYPE:
+        case DOUBLE_TYPE:
+        case CHAR_TYPE:
+        case BOOL_TYPE:
+        case SYMBOL_TYPE:
+        case NULL_TYPE:
+        case VOID_TYPE:
+        case PRIMITIVE_TYPE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Helper function to mark a weakly held value if it is permanent.
+ *
+ * Returns true if this marked something new.
+ */
+bool markPermanent(Value *value) {
+    return isPermanent(value) && tmark(value);
+}
+
+/*
+ * Helper function to mark what the live weak tables hold strongly: the
+ * keys of a weak-value table, and the values of a weak-key table whose
+ * keys are marked.
+ *
+ * Returns true if this marked something new.
+ */
+bool propagateWeakTables() {
+    bool changed = false;
+    for (int64_t i = 0; i < weakTables.count; i++) {
+        Value *table = weakTables.items[i];
+        if (!tmarked(table)) {
+            continue;
+        }
+        int position = 0;
+        Value *key;
+        void *value;
+        while (hashTableNext(table->dict->table, &position, &key, &value)) {
+            if (table->dict->weakness == WEAK_KEYS) {
+                changed |= markPermanent(key);
+                if (tmarked(key)) {
+                    changed |= tmark(value);
+                }
+            } else {
+                changed |= tmark(key);
+                changed |= markPermanent(value);
+            }
+        }
+    }
+    return changed;
+}
+
+/*
+ * Helper function to mark what live weak objects hold strongly: a
+ * permanent key, and the datum of an ephemeron whose key is marked.
+ * The collector calls it, with the tables, until nothing changes, since
+ * a datum may lead to the key of another ephemeron.
+ *
+ * Returns true if this marked something new.
+ */
+bool propagateWeak() {
+    bool changed = false;
+    for (int64_t i = 0; i < weakObjects.count; i++) {
+        Value *weak = weakObjects.items[i];
+        if (!tmarked(weak)) {
+            continue;
+        }
+        changed |= markPermanent(weak->weak.key);
+        if (weak->weak.kind == EPHEMERON && tmarked(weak->weak.key)) {
+            changed |= tmark(weak->weak.datum);
+        }
+    }
+    return propagateWeakTables() || changed;
+}
+
+/*
+ * Helper function to test whether a value survives the collection
+ * under way.
+ */
+bool isMarked(Value *value) {
+    return tmarked(value);
+}
+
+/*
+ * Helper function to break the weak references whose key did not
+ * survive a collection, remove the dead entries of weak tables, and
+ * drop from the registries what will be freed or is broken.
+ */
+void sweepWeak() {
+    int64_t kept = 0;
+    for (int64_t i = 0; i < weakObjects.count; i++) {
+        Value *weak = weakObjects.items[i];
+        if (!tmarked(weak)) {
+            continue;
+        }
+        if (!tmarked(weak->weak.key)) {
+            weak->weak.broken = true;
+            weak->weak.key = NULL;
+            weak->weak.datum = NULL;
+            continue;
+        }
+        weakObjects.items[kept++] = weak;
+    }
+    weakObjects.count = kept;
+    kept = 0;
+    for (int64_t i = 0; i < weakTables.count; i++) {
+        Value *table = weakTables.items[i];
+        if (tmarked(table)) {
+            sweepWeakDictionary(table, isMarked);
+            weakTables.items[kept++] = table;
+        }
+    }
+    weakTables.count = kept;
+}
+
+void displayWeak(Value *weak) {
+    printf(weak->weak.kind == WEAK_BOX ? "#weak-box" : "#ephemeron");
+}
+
+/*
+ * Helper function to return a part of a weak reference, or the default
+ * given after the reference, #f unless given, once it is broken.
+ */
+Value *weakPart(Value *weak, Value *part, Value *args) {
+    if (!weak->weak.broken) {
+        return part;
+    }
+    return cdr(args)->type == CONS_TYPE ? car(cdr(args)) : makeBoolean(false);
+}
+
+/*
+ * Implementing the Scheme primitives make-weak-box, weak-box?, and
+ * weak-box-value.
+ */
+Value *primitiveMakeWeakBox(Value *args) {
+    checkArity(args, 1, 1);
+    return makeWeak(WEAK_BOX, car(args), NULL);
+}
+
+Value *primitiveIsWeakBox(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == WEAK_TYPE &&
+                       car(args)->weak.kind == WEAK_BOX);
+}
+
+Value *primitiveWeakBoxValue(Value *args) {
+    checkArity(args, 1, 2);
+    Value *box = weakArgument("weak-box-value", car(args), WEAK_BOX);
+    return weakPart(box, box->weak.key, args);
+}
+
+/*
+ * Implementing the Scheme primitives make-ephemeron, ephemeron?,
+ * ephemeron-key, and ephemeron-datum.
+ */
+Value *primitiveMakeEphemeron(Value *args) {
+    checkArity(args, 2, 2);
+    return makeWeak(EPHEMERON, car(args), car(cdr(args)));
+}
+
+Value *primitiveIsEphemeron(Value *args) {
+    checkArity(args, 1, 1);
+    return makeBoolean(car(args)->type == WEAK_TYPE &&
+                       car(args)->weak.kind == EPHEMERON);
+}
+
+Value *primitiveEphemeronKey(Value *args) {
+    checkArity(args, 1, 2);
+    Value *ephemeron = weakArgument("ephemeron-key", car(args), EPHEMERON);
+    return weakPart(ephemeron, ephemeron->weak.key, args);
+}
+
+Value *primitiveEphemeronDatum(Value *args) {
+    checkArity(args, 1, 2);
+    Value *ephemeron = weakArgument("ephemeron-datum", car(args), EPHEMERON);
+    return weakPart(ephemeron, ephemeron->weak.datum, args);
+}
+
+/*
+ * Implementing the Scheme primitives weak-box-broken? and
+ * ephemeron-broken?.
+ */
+Value *primitiveIsBroken(Value *args) {
+    checkArity(args, 1, 1);
+    if (car(args)->type != WEAK_TYPE) {
+        primitiveError("weak-box-broken?", "expects a weak reference as input");
+    }
+    return makeBoolean(car(args)->weak.broken);
+}
+
+/*
+ * Implementing the Scheme primitive collect-garbage, which frees what
+ * the program can no longer reach and breaks the weak references to
+ * it.
+ */
+Value *primitiveCollectGarbage(Value *args) {
+    checkArity(args, 0, 0);
+    // The slots of weak tables are left for propagateWeakTables to mark
+    for (int64_t i = 0; i < weakTables.count; i++) {
+        HashTable *table = weakTables.items[i]->dict->table;
+        tuntrace(table->entries);
+        if (table->oldEntries != NULL) {
+            tuntrace(table->oldEntries);
+        }
+    }
+    tcollect(propagateWeak, sweepWeak);
+    return makeVoid();
+}
+
+/*
+ * Bind the weak reference primitives in the given top-level frame.
+ */
+void bindWeakPrimitives(Frame *topFrame) {
+    bind("make-weak-box", primitiveMakeWeakBox, topFrame);
+    bind("weak-box?", primitiveIsWeakBox, topFrame);
+    bind("weak-box-value", primitiveWeakBoxValue, topFrame);
+    bind("weak-box-broken?", primitiveIsBroken, topFrame);
+    bind("make-ephemeron", primitiveMakeEphemeron, topFrame);
+    bind("ephemeron?", primitiveIsEphemeron, topFrame);
+    bind("ephemeron-key", primitiveEphemeronKey, topFrame);
+    bind("ephemeron-datum", primitiveEphemeronDatum, topFrame);
+    bind("ephemeron-broken?", primitiveIsBroken, topFrame);
+    bind("collect-garbage", primitiveCollectGarbage, topFrame);
+}
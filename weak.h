@@ -0,0 +1,54 @@
+/*
+ * This program implements weak references: weak boxes, ephemerons,
+ * and hash tables that hold their keys or values weakly. collect-garbage
+ * frees what the program can no longer reach, and breaks the weak
+ * references to it: a weak box lets go of its value, an ephemeron of
+ * its key and datum, and a weak table drops the entry.
+ */
+#include <stdbool.h>
+#include "value.h"
+
+#ifndef WEAK_H
+#define WEAK_H
+
+/*
+ * Register a hash table made with weak keys or weak values.
+ */
+void registerWeakTable(Value *table);
+
+/*
+ * Print a weak box or an ephemeron.
+ */
+void displayWeak(Value *weak);
+
+/*
+ * The primitives below, for compiled programs.
+ */
+Value *primitiveMakeWeakBox(Value *args);
+Value *primitiveIsWeakBox(Value *args);
+Value *primitiveWeakBoxValue(Value *args);
+Value *primitiveMakeEphemeron(Value *args);
+Value *primitiveIsEphemeron(Value *args);
+Value *primitiveEphemeronKey(Value *args);
+Value *primitiveEphemeronDatum(Value *args);
+Value *primitiveIsBroken(Value *args);
+Value *primitiveCollectGarbage(Value *args);
+
+/*
+ * Bind the weak reference primitives in the given top-level frame.
+ *
+ *   make-weak-box x   weak-box?   weak-box-value box [default]
+ *   make-ephemeron key datum   ephemeron?
+ *   ephemeron-key e [default]   ephemeron-datum e [default]
+ *   weak-box-broken? ephemeron-broken?
+ *
+ *   collect-garbage
+ *
+ * The accessors return the default, #f unless given, once the
+ * reference is broken. An ephemeron keeps its datum alive only while
+ * its key is reachable other than through the datum. Numbers,
+ * characters, booleans, and symbols are never let go of.
+ */
+void bindWeakPrimitives(Frame *topFrame);
+
+#endif